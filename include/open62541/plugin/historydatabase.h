@@ -39,9 +39,22 @@ struct UA_HistoryDatabase {
                 UA_Boolean historizing,
                 const UA_DataValue *value);
 
+    /* Same as setValue for several nodes at once, e.g. for the values of a
+     * received DataSet or a bulk write. nodeIds, historizing and values are
+     * arrays of valuesSize entries. Set it to NULL if you do not need it. */
+    void
+    (*setValues)(UA_Server *server,
+                 void *hdbContext,
+                 const UA_NodeId *sessionId,
+                 void *sessionContext,
+                 size_t valuesSize,
+                 const UA_NodeId *nodeIds,
+                 const UA_Boolean *historizing,
+                 const UA_DataValue *values);
+
     /* This function will be called when an event is triggered.
      * Use it to insert data into your event database.
-     * No default implementation is provided by UA_HistoryDatabase_default.
+     * Implemented by UA_HistoryDatabase_defaultWithEvents.
      *
      * server is the server this node lives in.
      * hdbContext is the context of the UA_HistoryDatabase.
@@ -112,8 +125,8 @@ struct UA_HistoryDatabase {
                UA_HistoryReadResponse *response,
                UA_HistoryModifiedData * const * const historyData);
 
-    /* No default implementation is provided by UA_HistoryDatabase_default
-     * for the following function */
+    /* UA_HistoryDatabase_defaultWithEvents applies the EventFilter of the
+     * request to the recorded events */
     void
     (*readEvent)(UA_Server *server,
                void *hdbContext,
@@ -128,8 +141,9 @@ struct UA_HistoryDatabase {
                UA_HistoryReadResponse *response,
                UA_HistoryEvent * const * const historyData);
 
-    /* No default implementation is provided by UA_HistoryDatabase_default
-     * for the following function */
+    /* UA_HistoryDatabase_default computes the Interpolative, Average,
+     * TimeAverage, Total, Minimum, Maximum, Count, Start and End aggregates
+     * from the samples of the backend */
     void
     (*readProcessed)(UA_Server *server,
                void *hdbContext,
@@ -144,8 +158,8 @@ struct UA_HistoryDatabase {
                UA_HistoryReadResponse *response,
                UA_HistoryData * const * const historyData);
 
-    /* No default implementation is provided by UA_HistoryDatabase_default
-     * for the following function */
+    /* UA_HistoryDatabase_default returns the raw sample at the requested
+     * time or a value interpolated from the samples around it */
     void
     (*readAtTime)(UA_Server *server,
                void *hdbContext,
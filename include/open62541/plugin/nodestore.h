@@ -292,6 +292,17 @@ UA_NodePointer_fromNodeId(const UA_NodeId *id);
 UA_NodePointer UA_EXPORT
 UA_NodePointer_fromExpandedNodeId(const UA_ExpandedNodeId *id);
 
+/* Direct pointer to a node in the Nodestore. Only the Nodestore knows how long
+ * the node stays at that address. So direct pointers are placed in the
+ * references only by Nodestores that fix them up when the target node is
+ * replaced or removed. */
+UA_NodePointer UA_EXPORT
+UA_NodePointer_fromNode(const UA_NodeHead *node);
+
+/* Returns the node if the NodePointer is a direct pointer. NULL otherwise. */
+UA_EXPORT const UA_NodeHead *
+UA_NodePointer_getNode(UA_NodePointer np);
+
 /* Can point to the memory from the NodePointer */
 UA_ExpandedNodeId UA_EXPORT
 UA_NodePointer_toExpandedNodeId(UA_NodePointer np);
@@ -335,12 +346,26 @@ typedef struct UA_ReferenceTargetTreeElem {
 } UA_ReferenceTargetTreeElem;
 
 
+/* Index for the sorted array of reference targets. The first ``sortedSize``
+ * targets are ordered by their targetId (see UA_NodePointer_order). New
+ * targets are appended to an unsorted tail. The tail is merged into the sorted
+ * part in one pass once it grows beyond a fraction of the sorted part. The
+ * BrowseName hashes of the sorted part are kept in ascending order, together
+ * with the position of the target that has the hash. */
+typedef struct {
+    size_t capacity;          /* Allocated length of the arrays */
+    size_t sortedSize;
+    UA_UInt32 *nameHashes;    /* Ascending BrowseName hashes */
+    UA_UInt32 *namePositions; /* Position of the target in the array */
+} UA_ReferenceTargetIndex;
+
 /* List of reference targets with the same reference type and direction. Uses
- * either an array or a tree structure. The SDK will not change the type of
- * reference target structure internally. The nodestore implementations may
- * switch internally when a node is updated.
+ * either an array, a sorted array or a tree structure. The SDK will not change
+ * the type of reference target structure internally. The nodestore
+ * implementations may switch internally when a node is updated.
  *
- * The recommendation is to switch to a tree once the number of refs > 8. */
+ * The recommendation is to switch to a tree or a sorted array once the number
+ * of refs > 8. */
 typedef struct {
     union {
         /* Organize the references in an array. Uses less memory, but incurs
@@ -357,11 +382,23 @@ typedef struct {
             UA_ReferenceTargetTreeElem *idRoot;   /* Lookup based on target id */
             UA_ReferenceTargetTreeElem *nameRoot; /* Lookup based on browseName*/
         } tree;
+
+        /* Organize the references in an array that is sorted by the target id.
+         * Lookups use binary search on the array and on the index of the
+         * BrowseName hashes. Uses about a third of the memory of the tree and
+         * keeps the targets contiguous. Recommended for a large number of
+         * references, e.g. folders with many children. The array member is
+         * identical to the unsorted array above. */
+        struct {
+            UA_ReferenceTarget *array;
+            UA_ReferenceTargetIndex *index;
+        } sorted;
     } targets;
     size_t targetsSize;
     UA_Boolean hasRefTree; /* RefTree or RefArray? */
     UA_Byte referenceTypeIndex;
     UA_Boolean isInverse;
+    UA_Boolean hasSortedArray; /* The RefArray is sorted and indexed */
 } UA_NodeReferenceKind;
 
 /* Iterate over the references. Aborts when the first callback return a non-NULL
@@ -375,16 +412,41 @@ UA_NodeReferenceKind_iterate(UA_NodeReferenceKind *rk,
                              UA_NodeReferenceKind_iterateCallback callback,
                              void *context);
 
+/* Iterate over the targets of a sorted array in ascending order of the target
+ * NodeId, including the unsorted tail. Starts after the given target if it is
+ * not NULL. That target does not have to be present. The result of the
+ * callback that aborted the iteration is returned in *result. Returns an error
+ * if the tail cannot be sorted (out-of-memory). */
+UA_EXPORT UA_StatusCode
+UA_NodeReferenceKind_iterateSorted(UA_NodeReferenceKind *rk,
+                                   const UA_NodePointer *after,
+                                   UA_NodeReferenceKind_iterateCallback callback,
+                                   void *context, void **result);
+
 /* Returns the entry for the targetId or NULL if not found */
 UA_EXPORT const UA_ReferenceTarget *
 UA_NodeReferenceKind_findTarget(const UA_NodeReferenceKind *rk,
                                 const UA_ExpandedNodeId *targetId);
 
-/* Switch between array and tree representation. Does nothing upon error (e.g.
- * out-of-memory). */
+/* Iterate over the references whose target has the BrowseName hash. Aborts
+ * when the first callback returns a non-NULL pointer and returns that
+ * pointer. */
+UA_EXPORT void *
+UA_NodeReferenceKind_iterateName(UA_NodeReferenceKind *rk, UA_UInt32 targetNameHash,
+                                 UA_NodeReferenceKind_iterateCallback callback,
+                                 void *context);
+
+/* Switch between array and tree representation. A sorted array is switched to
+ * a tree. Does nothing upon error (e.g. out-of-memory). */
 UA_EXPORT UA_StatusCode
 UA_NodeReferenceKind_switch(UA_NodeReferenceKind *rk);
 
+/* Switch from the array or tree representation to the sorted array. Merges the
+ * tail if the array is already sorted. Upon error (e.g. out-of-memory), the
+ * targets remain in a valid representation. */
+UA_EXPORT UA_StatusCode
+UA_NodeReferenceKind_sort(UA_NodeReferenceKind *rk);
+
 /* Singly-linked LocalizedText list */
 typedef struct UA_LocalizedTextListEntry {
     struct UA_LocalizedTextListEntry *next;
@@ -568,11 +630,35 @@ typedef struct {
                                const UA_DataValue *data);
 } UA_ExternalValueCallback;
 
+/**
+ * Borrowed Data Source
+ * ~~~~~~~~~~~~~~~~~~~~
+ * The read callback of a borrowed data source can return a read-only view into
+ * the memory of the application instead of a copy. For this, the variant in the
+ * returned DataValue has the ``UA_VARIANT_DATA_NODELETE`` storage type. The
+ * server then does not copy the value for a Read request. The response is
+ * encoded directly from the application memory. MonitoredItems compare the
+ * sampled view with the last value and take a copy only if the value has
+ * changed. For all other uses (e.g. the local read API) the server copies the
+ * value right away.
+ *
+ * The viewed memory must stay valid and unchanged until the release callback
+ * is called. The release callback is called exactly once for every value that
+ * was returned with ``UA_VARIANT_DATA_NODELETE``. It gets the DataValue as it
+ * was returned by the read callback. The release callback is not called for
+ * values that are owned by the server (that don't have
+ * ``UA_VARIANT_DATA_NODELETE`` set). */
+
+typedef void
+(*UA_DataSourceReleaseCallback)(UA_Server *server, const UA_NodeId *nodeId,
+                                void *nodeContext, UA_DataValue *value);
+
 typedef enum {
     UA_VALUEBACKENDTYPE_NONE,
     UA_VALUEBACKENDTYPE_INTERNAL,
     UA_VALUEBACKENDTYPE_DATA_SOURCE_CALLBACK,
-    UA_VALUEBACKENDTYPE_EXTERNAL
+    UA_VALUEBACKENDTYPE_EXTERNAL,
+    UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED
 } UA_ValueBackendType;
 
 typedef struct {
@@ -587,6 +673,10 @@ typedef struct {
             UA_DataValue **value;
             UA_ExternalValueCallback callback;
         } external;
+        struct {
+            UA_DataSource dataSource;
+            UA_DataSourceReleaseCallback release;
+        } borrowed;
     } backend;
 } UA_ValueBackend;
 
@@ -806,7 +896,9 @@ typedef struct {
      *
      * The attribute-mask and reference-description indicate if only a subset of
      * the attributes and referencs are to be modified. Other attributes and
-     * references shall not be changed. */
+     * references shall not be changed. For example, writing the Value attribute
+     * uses ``UA_NODEATTRIBUTESMASK_VALUE`` with no references. Then only the
+     * value (and value source) of the VariableNode is changed. */
     UA_Node * (*getEditNode)(void *nsCtx, const UA_NodeId *nodeId,
                              UA_UInt32 attributeMask,
                              UA_ReferenceTypeSet references,
@@ -852,6 +944,24 @@ typedef struct {
     /* Execute a callback for every node in the nodestore. */
     void (*iterate)(void *nsCtx, UA_NodestoreVisitor visitor,
                     void *visitorCtx);
+
+    /* Prepare the insertion of (at least) the given number of additional
+     * nodes. For example, by resizing internal tables only once before
+     * bulk-loading nodes. Optional, can be NULL. */
+    UA_StatusCode (*reserve)(void *nsCtx, size_t additionalNodes);
+
+    /* Serialize all nodes (attributes, references and the values of variables
+     * with an internal value) into a binary snapshot. Node contexts, callbacks
+     * and DataSources are not part of the snapshot. Optional, can be NULL. */
+    UA_StatusCode (*snapshot)(void *nsCtx, UA_ByteString *snapshot);
+
+    /* Add the nodes from a snapshot. Nodes that already exist are kept and only
+     * receive the references from the snapshot they are missing. The custom
+     * DataTypes (can be NULL) are used to decode the values. If the restore
+     * fails, a part of the nodes may already have been added. Optional, can be
+     * NULL. */
+    UA_StatusCode (*restore)(void *nsCtx, const UA_ByteString *snapshot,
+                             const UA_DataTypeArray *customTypes);
 } UA_Nodestore;
 
 /* Attributes must be of a matching type (VariableAttributes, ObjectAttributes,
@@ -877,6 +987,15 @@ UA_Node_addReference(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForward,
                      const UA_ExpandedNodeId *targetNodeId,
                      UA_UInt32 targetBrowseNameHash);
 
+/* Add the references to the targets that are not yet contained in the node.
+ * In the sorted array representation, the new targets are sorted and merged
+ * into the array in one pass. The number of added references is returned in
+ * ``added`` (can be NULL). */
+UA_StatusCode UA_EXPORT
+UA_Node_addReferences(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForward,
+                      size_t targetsSize, const UA_ExpandedNodeId *targetNodeIds,
+                      const UA_UInt32 *targetBrowseNameHashes, size_t *added);
+
 /* Delete a single reference from the node */
 UA_StatusCode UA_EXPORT
 UA_Node_deleteReference(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForward,
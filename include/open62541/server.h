@@ -1439,6 +1439,28 @@ UA_Server_addObjectNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
                                nodeContext, outNewNodeId);
 })
 
+/* Add ``count`` instances of the same ObjectType below a common parent. The
+ * instances share the attributes and the node context. They differ in the
+ * BrowseName and optionally in the requested NodeId. The children of the
+ * ObjectType (and its supertypes) are collected once in an instantiation plan
+ * that is replayed for every instance. If an instance cannot be added, the
+ * instances added so far are deleted again.
+ *
+ * @param requestedNewNodeIds Array of length count or NULL. For NULL (or a
+ *        null NodeId in the array) the server assigns the NodeId.
+ * @param browseNames Array of length count.
+ * @param outNewNodeIds Array of length count or NULL. Receives the NodeIds of
+ *        the new instances. */
+UA_StatusCode UA_EXPORT UA_THREADSAFE
+UA_Server_addObjectNodes(UA_Server *server, size_t count,
+                         const UA_NodeId *requestedNewNodeIds,
+                         const UA_NodeId parentNodeId,
+                         const UA_NodeId referenceTypeId,
+                         const UA_QualifiedName *browseNames,
+                         const UA_NodeId typeDefinition,
+                         const UA_ObjectAttributes attr,
+                         void *nodeContext, UA_NodeId *outNewNodeIds);
+
 UA_INLINABLE( UA_THREADSAFE UA_StatusCode
 UA_Server_addObjectTypeNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
                             const UA_NodeId parentNodeId,
@@ -1597,6 +1619,50 @@ UA_Server_addNode_begin(UA_Server *server, const UA_NodeClass nodeClass,
 UA_StatusCode UA_EXPORT UA_THREADSAFE
 UA_Server_addNode_finish(UA_Server *server, const UA_NodeId nodeId);
 
+/* Bulk-loading of nodes. The items are processed in three phases:
+ *
+ * 1. All nodes are created and added to the Nodestore. The Nodestore is
+ *    prepared for the number of new nodes beforehand.
+ * 2. The references to the parent and the TypeDefinition are added. The items
+ *    are sorted by their parent node for this.
+ * 3. The nodes are type-checked, their mandatory children are instantiated
+ *    and the constructors are called (see UA_Server_addNode_finish).
+ *
+ * So the items can refer to each other (as parent or TypeDefinition)
+ * regardless of their order in the array. New ReferenceTypes are fully added
+ * before all other nodes. The operation is atomic: if one item fails, all new
+ * nodes are removed again. The index of the failed item is returned in
+ * ``failedIndex`` (can be NULL).
+ *
+ * @param nodeContexts Array of length itemsSize or NULL.
+ * @param outNewNodeIds Array of length itemsSize or NULL. Receives the NodeIds
+ *        of the new nodes. */
+UA_StatusCode UA_EXPORT UA_THREADSAFE
+UA_Server_addNodesBulk(UA_Server *server, size_t itemsSize,
+                       const UA_AddNodesItem *items, void **nodeContexts,
+                       UA_NodeId *outNewNodeIds, size_t *failedIndex);
+
+/* Snapshot of the information model for faster restarts. The snapshot holds
+ * all nodes with their attributes, references and the values that are stored
+ * in the nodes. It can be written to a file and restored after the restart
+ * instead of building the information model again. Node contexts, value
+ * callbacks, DataSources and method callbacks are not part of the snapshot.
+ * They have to be attached to the restored nodes by the application (e.g. with
+ * UA_Server_setNodeContext). Constructors are not called for restored nodes.
+ *
+ * The restored nodes are added to the existing information model. Nodes that
+ * already exist (e.g. namespace zero) are kept and only receive the references
+ * from the snapshot. Namespaces have to be added in the same order as when the
+ * snapshot was taken.
+ *
+ * Requires support from the Nodestore (the HashMap Nodestore supports
+ * snapshots). Otherwise UA_STATUSCODE_BADNOTSUPPORTED is returned. */
+UA_StatusCode UA_EXPORT UA_THREADSAFE
+UA_Server_snapshotNodestore(UA_Server *server, UA_ByteString *snapshot);
+
+UA_StatusCode UA_EXPORT UA_THREADSAFE
+UA_Server_restoreNodestore(UA_Server *server, const UA_ByteString *snapshot);
+
 #ifdef UA_ENABLE_METHODCALLS
 
 UA_StatusCode UA_EXPORT UA_THREADSAFE
@@ -1680,6 +1746,28 @@ UA_Server_triggerEvent(UA_Server *server, const UA_NodeId eventNodeId,
                        const UA_NodeId originId, UA_ByteString *outEventId,
                        const UA_Boolean deleteEventNode);
 
+/* Apply an EventFilter to events that were recorded earlier, e.g. in the event
+ * history. The fields of the stored events are the result of the
+ * select-clauses in storedSelect (typically the HistoricalEventFilter of the
+ * emitting node). The operands of the filter are resolved from the stored
+ * field with the same BrowsePath and AttributeId.
+ *
+ * @param server The server object
+ * @param filter The EventFilter to apply
+ * @param storedSelectSize Number of select-clauses of the stored events
+ * @param storedSelect The select-clauses the events were recorded with
+ * @param eventsSize Number of stored events
+ * @param events The stored events
+ * @param results Array of eventsSize EventFieldLists. If the where-clause does
+ *        not match the event, the EventFieldList is empty.
+ * @return The StatusCode of the UA_Server_filterStoredEvents method */
+UA_StatusCode UA_EXPORT UA_THREADSAFE
+UA_Server_filterStoredEvents(UA_Server *server, const UA_EventFilter *filter,
+                             size_t storedSelectSize,
+                             const UA_SimpleAttributeOperand *storedSelect,
+                             size_t eventsSize, const UA_EventFieldList *events,
+                             UA_EventFieldList *results);
+
 #endif /* UA_ENABLE_SUBSCRIPTIONS_EVENTS */
 
 /**
@@ -0,0 +1,100 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef HISTORY_NODEID_INDEX_H_
+#define HISTORY_NODEID_INDEX_H_
+
+#include <open62541/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+_UA_BEGIN_DECLS
+
+/* Hash index over the NodeIds of an array of entries. The index stores the
+ * position of the entries, so that the array can be reallocated. Open
+ * addressing with linear probing. The table has a power-of-two size and is
+ * kept at most half full. Entries cannot be removed. */
+
+typedef struct {
+    size_t entry; /* Position of the entry + 1. Zero for an empty slot. */
+    UA_UInt32 hash;
+} UA_NodeIdIndexSlot;
+
+typedef struct {
+    UA_NodeIdIndexSlot *slots;
+    size_t slotsSize;
+    size_t count;
+} UA_NodeIdIndex;
+
+#define UA_NODEIDINDEX_MINSIZE 16
+
+/* Returns the position of the entry with the NodeId or SIZE_MAX. The NodeId
+ * is found at the byte offset nodeIdOffset of each entry. */
+static UA_INLINE size_t
+UA_NodeIdIndex_find(const UA_NodeIdIndex *index, const UA_NodeId *nodeId,
+                    const void *entries, size_t entrySize, size_t nodeIdOffset) {
+    if(index->slotsSize == 0)
+        return SIZE_MAX;
+    UA_UInt32 hash = UA_NodeId_hash(nodeId);
+    size_t mask = index->slotsSize - 1;
+    for(size_t i = hash & mask; index->slots[i].entry != 0; i = (i + 1) & mask) {
+        if(index->slots[i].hash != hash)
+            continue;
+        size_t pos = index->slots[i].entry - 1;
+        const UA_NodeId *entryId = (const UA_NodeId*)
+            ((const UA_Byte*)entries + (pos * entrySize) + nodeIdOffset);
+        if(UA_NodeId_equal(entryId, nodeId))
+            return pos;
+    }
+    return SIZE_MAX;
+}
+
+static UA_INLINE void
+UA_NodeIdIndex_insertSlot(UA_NodeIdIndexSlot *slots, size_t slotsSize,
+                          UA_UInt32 hash, size_t entry) {
+    size_t mask = slotsSize - 1;
+    size_t i = hash & mask;
+    while(slots[i].entry != 0)
+        i = (i + 1) & mask;
+    slots[i].entry = entry;
+    slots[i].hash = hash;
+}
+
+/* Add the entry at position pos. The NodeId must not be in the index. */
+static UA_INLINE UA_StatusCode
+UA_NodeIdIndex_add(UA_NodeIdIndex *index, const UA_NodeId *nodeId, size_t pos) {
+    if((index->count + 1) * 2 > index->slotsSize) {
+        size_t newSize = (index->slotsSize > 0) ?
+            index->slotsSize * 2 : UA_NODEIDINDEX_MINSIZE;
+        UA_NodeIdIndexSlot *slots = (UA_NodeIdIndexSlot*)
+            UA_calloc(newSize, sizeof(UA_NodeIdIndexSlot));
+        if(!slots)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(size_t i = 0; i < index->slotsSize; i++) {
+            if(index->slots[i].entry != 0)
+                UA_NodeIdIndex_insertSlot(slots, newSize, index->slots[i].hash,
+                                          index->slots[i].entry);
+        }
+        UA_free(index->slots);
+        index->slots = slots;
+        index->slotsSize = newSize;
+    }
+    UA_NodeIdIndex_insertSlot(index->slots, index->slotsSize,
+                              UA_NodeId_hash(nodeId), pos + 1);
+    index->count++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_INLINE void
+UA_NodeIdIndex_clear(UA_NodeIdIndex *index) {
+    UA_free(index->slots);
+    memset(index, 0, sizeof(UA_NodeIdIndex));
+}
+
+_UA_END_DECLS
+
+#endif /* HISTORY_NODEID_INDEX_H_ */
@@ -0,0 +1,1292 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/plugin/historydata/history_data_backend_memory.h>
+
+#include "ziptree.h"
+
+#include <string.h>
+
+/* The samples of a node are stored in chunks that are sorted by timestamp.
+ * Within a chunk the timestamps, status codes and values are held in separate
+ * columns. Scalar values of a fixed-size type are stored inline in the value
+ * column. A chunk that receives a sample that does not fit the columns (arrays,
+ * strings, picoseconds, a different type) is converted to a "generic" chunk
+ * that keeps full DataValues. The timestamp column is used for the binary
+ * search in either case.
+ *
+ * With compression enabled, full chunks of scalar values with up to 8 bytes
+ * are packed into a bit stream when the next chunk is started. Timestamps are
+ * stored as delta-of-deltas, values are XOR'ed with the previous value and
+ * status codes and flags are only stored when they change. Reading decodes
+ * the columns of a packed chunk into a cache of the node. Modifying a packed
+ * chunk unpacks it again. */
+
+#define SAMPLE_HASVALUE           0x01
+#define SAMPLE_HASSTATUS          0x02
+#define SAMPLE_HASSOURCETIMESTAMP 0x04
+
+typedef struct {
+    size_t start; /* Index of the first sample in the history of the node */
+    size_t size;
+
+    /* The sort key. This is the source timestamp if it is defined, otherwise
+     * the server timestamp. The allocation also holds the serverTimestamps,
+     * status and flags columns. */
+    UA_DateTime *timestamps;
+    UA_DateTime *serverTimestamps;
+    UA_StatusCode *status;
+    UA_Byte *flags;
+
+    const UA_DataType *valueType; /* Set with the first value */
+    void *values;
+
+    UA_DataValue *dataValues; /* Set for generic chunks. Then only the
+                               * timestamps column is used in addition. */
+
+    UA_Byte *packed; /* Set for packed chunks. Then the columns are NULL. The
+                      * valueType is kept. */
+    size_t packedSize;
+    UA_DateTime lastTimestamp; /* For the binary search over packed chunks */
+} HistoryChunk;
+
+struct HistoryNode;
+typedef struct HistoryNode HistoryNode;
+
+struct HistoryNode {
+    ZIP_ENTRY(HistoryNode) zipfields;
+    UA_UInt32 nodeIdHash;
+    UA_NodeId nodeId;
+    size_t size; /* Number of samples in all chunks */
+    size_t chunksSize;
+    HistoryChunk *chunks; /* Chunks are never empty */
+    UA_DataValue current; /* Returned from getDataValue. Points into the
+                           * columns of a chunk. */
+    HistoryChunk unpacked; /* Decoded columns of the packed chunk */
+    const UA_Byte *unpackedFrom; /* that was read last */
+};
+
+static enum ZIP_CMP
+cmpHistoryNode(const void *a, const void *b) {
+    const HistoryNode *aa = (const HistoryNode*)a;
+    const HistoryNode *bb = (const HistoryNode*)b;
+    if(aa->nodeIdHash < bb->nodeIdHash)
+        return ZIP_CMP_LESS;
+    if(aa->nodeIdHash > bb->nodeIdHash)
+        return ZIP_CMP_MORE;
+    return (enum ZIP_CMP)UA_NodeId_order(&aa->nodeId, &bb->nodeId);
+}
+
+ZIP_HEAD(HistoryNodeTree, HistoryNode);
+typedef struct HistoryNodeTree HistoryNodeTree;
+ZIP_FUNCTIONS(HistoryNodeTree, HistoryNode, zipfields, HistoryNode, zipfields, cmpHistoryNode)
+
+typedef struct {
+    HistoryNodeTree nodes;
+    size_t chunkCapacity;
+    UA_Boolean compress;
+} UA_ColumnarStoreContext;
+
+/*****************/
+/* History Chunk */
+/*****************/
+
+static UA_StatusCode
+HistoryChunk_init(HistoryChunk *chunk, size_t capacity) {
+    memset(chunk, 0, sizeof(HistoryChunk));
+    UA_Byte *mem = (UA_Byte*)
+        UA_malloc(capacity * (2 * sizeof(UA_DateTime) +
+                              sizeof(UA_StatusCode) + sizeof(UA_Byte)));
+    if(!mem)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    chunk->timestamps = (UA_DateTime*)mem;
+    chunk->serverTimestamps = &chunk->timestamps[capacity];
+    chunk->status = (UA_StatusCode*)&chunk->serverTimestamps[capacity];
+    chunk->flags = (UA_Byte*)&chunk->status[capacity];
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+HistoryChunk_clear(HistoryChunk *chunk) {
+    if(chunk->dataValues) {
+        for(size_t i = 0; i < chunk->size; i++)
+            UA_DataValue_clear(&chunk->dataValues[i]);
+        UA_free(chunk->dataValues);
+    }
+    UA_free(chunk->values);
+    UA_free(chunk->timestamps);
+    UA_free(chunk->packed);
+    memset(chunk, 0, sizeof(HistoryChunk));
+}
+
+/* Returns a shallow copy of the sample. The value points into the column. */
+static void
+HistoryChunk_get(const HistoryChunk *chunk, size_t i, UA_DataValue *out) {
+    if(chunk->dataValues) {
+        *out = chunk->dataValues[i];
+        return;
+    }
+    UA_DataValue_init(out);
+    UA_Byte flags = chunk->flags[i];
+    if(flags & SAMPLE_HASSOURCETIMESTAMP) {
+        out->hasSourceTimestamp = true;
+        out->sourceTimestamp = chunk->timestamps[i];
+    }
+    out->hasServerTimestamp = true;
+    out->serverTimestamp = chunk->serverTimestamps[i];
+    if(flags & SAMPLE_HASSTATUS) {
+        out->hasStatus = true;
+        out->status = chunk->status[i];
+    }
+    if(flags & SAMPLE_HASVALUE) {
+        out->hasValue = true;
+        UA_Variant_setScalar(&out->value, (UA_Byte*)chunk->values +
+                             (i * chunk->valueType->memSize), chunk->valueType);
+        out->value.storageType = UA_VARIANT_DATA_NODELETE;
+    }
+}
+
+/* Can the sample be stored in the columns of the chunk? */
+static UA_Boolean
+HistoryChunk_fits(const HistoryChunk *chunk, const UA_DataValue *value) {
+    if(chunk->dataValues)
+        return true;
+    if(value->hasSourcePicoseconds || value->hasServerPicoseconds)
+        return false;
+    if(!value->hasValue)
+        return true;
+    if(!UA_Variant_isScalar(&value->value) || !value->value.type->pointerFree)
+        return false;
+    return (!chunk->valueType || chunk->valueType == value->value.type);
+}
+
+static UA_StatusCode
+HistoryChunk_setType(HistoryChunk *chunk, const UA_DataType *type,
+                     size_t capacity) {
+    chunk->values = UA_malloc(capacity * type->memSize);
+    if(!chunk->values)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    chunk->valueType = type;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Convert the columns to full DataValues */
+static UA_StatusCode
+HistoryChunk_makeGeneric(HistoryChunk *chunk, size_t capacity) {
+    UA_DataValue *dvs = (UA_DataValue*)UA_calloc(capacity, sizeof(UA_DataValue));
+    if(!dvs)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < chunk->size; i++) {
+        UA_DataValue tmp;
+        HistoryChunk_get(chunk, i, &tmp);
+        UA_StatusCode res = UA_DataValue_copy(&tmp, &dvs[i]);
+        if(res != UA_STATUSCODE_GOOD) {
+            for(size_t j = 0; j < i; j++)
+                UA_DataValue_clear(&dvs[j]);
+            UA_free(dvs);
+            return res;
+        }
+    }
+    UA_free(chunk->values);
+    chunk->values = NULL;
+    chunk->valueType = NULL;
+    chunk->dataValues = dvs;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Prepare the layout of the chunk to store the sample */
+static UA_StatusCode
+HistoryChunk_prepare(HistoryChunk *chunk, const UA_DataValue *value,
+                     size_t capacity) {
+    if(!HistoryChunk_fits(chunk, value))
+        return HistoryChunk_makeGeneric(chunk, capacity);
+    if(!chunk->dataValues && value->hasValue && !chunk->valueType)
+        return HistoryChunk_setType(chunk, value->value.type, capacity);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Write the sample into a free slot. The layout was prepared before. */
+static UA_StatusCode
+HistoryChunk_write(HistoryChunk *chunk, size_t i, UA_DateTime timestamp,
+                   const UA_DataValue *value) {
+    chunk->timestamps[i] = timestamp;
+    if(chunk->dataValues) {
+        UA_DataValue *dv = &chunk->dataValues[i];
+        UA_StatusCode res = UA_DataValue_copy(value, dv);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        if(!dv->hasServerTimestamp) {
+            dv->serverTimestamp = timestamp;
+            dv->hasServerTimestamp = true;
+        }
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_Byte flags = 0;
+    if(value->hasSourceTimestamp)
+        flags |= SAMPLE_HASSOURCETIMESTAMP;
+    if(value->hasStatus)
+        flags |= SAMPLE_HASSTATUS;
+    chunk->serverTimestamps[i] = (value->hasServerTimestamp) ?
+        value->serverTimestamp : timestamp;
+    chunk->status[i] = value->status;
+    if(value->hasValue) {
+        flags |= SAMPLE_HASVALUE;
+        size_t memSize = chunk->valueType->memSize;
+        memcpy((UA_Byte*)chunk->values + (i * memSize), value->value.data, memSize);
+    }
+    chunk->flags[i] = flags;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Move samples within or between chunks with the same layout */
+static void
+HistoryChunk_move(HistoryChunk *dst, size_t dstPos,
+                  HistoryChunk *src, size_t srcPos, size_t count) {
+    if(count == 0)
+        return;
+    memmove(&dst->timestamps[dstPos], &src->timestamps[srcPos],
+            count * sizeof(UA_DateTime));
+    if(src->dataValues) {
+        memmove(&dst->dataValues[dstPos], &src->dataValues[srcPos],
+                count * sizeof(UA_DataValue));
+        return;
+    }
+    memmove(&dst->serverTimestamps[dstPos], &src->serverTimestamps[srcPos],
+            count * sizeof(UA_DateTime));
+    memmove(&dst->status[dstPos], &src->status[srcPos],
+            count * sizeof(UA_StatusCode));
+    memmove(&dst->flags[dstPos], &src->flags[srcPos], count);
+    if(src->valueType) {
+        size_t memSize = src->valueType->memSize;
+        memmove((UA_Byte*)dst->values + (dstPos * memSize),
+                (UA_Byte*)src->values + (srcPos * memSize), count * memSize);
+    }
+}
+
+/*****************/
+/* Packed Chunks */
+/*****************/
+
+typedef struct {
+    UA_Byte *data;
+    size_t pos; /* In bits */
+} BitStream;
+
+/* Write the lower bits of the value, most significant bit first. The buffer
+ * is zeroed before. */
+static void
+writeBits(BitStream *bs, UA_UInt64 value, UA_Byte bits) {
+    while(bits > 0) {
+        UA_Byte space = (UA_Byte)(8 - (bs->pos & 7));
+        UA_Byte n = (bits < space) ? bits : space;
+        UA_Byte part = (UA_Byte)((value >> (bits - n)) & ((1u << n) - 1));
+        bs->data[bs->pos >> 3] |= (UA_Byte)(part << (space - n));
+        bs->pos += n;
+        bits -= n;
+    }
+}
+
+static UA_UInt64
+readBits(BitStream *bs, UA_Byte bits) {
+    UA_UInt64 value = 0;
+    while(bits > 0) {
+        UA_Byte avail = (UA_Byte)(8 - (bs->pos & 7));
+        UA_Byte n = (bits < avail) ? bits : avail;
+        UA_Byte part = (UA_Byte)
+            ((bs->data[bs->pos >> 3] >> (avail - n)) & ((1u << n) - 1));
+        value = (value << n) | part;
+        bs->pos += n;
+        bits -= n;
+    }
+    return value;
+}
+
+/* Timestamps with a fixed period have a delta-of-delta of zero. Small jitter
+ * is stored in 7 to 12 bits. The arithmetic wraps around in unsigned integers
+ * so that the decoder arrives at the same values. */
+typedef struct {
+    UA_UInt64 prev;
+    UA_UInt64 prevDelta;
+} TimestampState;
+
+static UA_UInt64
+TimestampState_advance(TimestampState *ts, UA_DateTime t) {
+    UA_UInt64 delta = (UA_UInt64)t - ts->prev;
+    UA_UInt64 dod = delta - ts->prevDelta;
+    ts->prev = (UA_UInt64)t;
+    ts->prevDelta = delta;
+    return dod;
+}
+
+static UA_DateTime
+TimestampState_apply(TimestampState *ts, UA_UInt64 dod) {
+    ts->prevDelta += dod;
+    ts->prev += ts->prevDelta;
+    return (UA_DateTime)ts->prev;
+}
+
+static void
+writeDod(BitStream *bs, UA_UInt64 dod) {
+    UA_Int64 d = (UA_Int64)dod;
+    if(d == 0) {
+        writeBits(bs, 0x0, 1);
+    } else if(d >= -63 && d <= 64) {
+        writeBits(bs, 0x2, 2);
+        writeBits(bs, (UA_UInt64)(d + 63), 7);
+    } else if(d >= -255 && d <= 256) {
+        writeBits(bs, 0x6, 3);
+        writeBits(bs, (UA_UInt64)(d + 255), 9);
+    } else if(d >= -2047 && d <= 2048) {
+        writeBits(bs, 0xe, 4);
+        writeBits(bs, (UA_UInt64)(d + 2047), 12);
+    } else if(d >= -2147483647LL && d <= 2147483648LL) {
+        writeBits(bs, 0x1e, 5);
+        writeBits(bs, (UA_UInt64)(d + 2147483647LL), 32);
+    } else {
+        writeBits(bs, 0x1f, 5);
+        writeBits(bs, dod, 64);
+    }
+}
+
+static UA_UInt64
+readDod(BitStream *bs) {
+    if(!readBits(bs, 1))
+        return 0;
+    if(!readBits(bs, 1))
+        return (UA_UInt64)((UA_Int64)readBits(bs, 7) - 63);
+    if(!readBits(bs, 1))
+        return (UA_UInt64)((UA_Int64)readBits(bs, 9) - 255);
+    if(!readBits(bs, 1))
+        return (UA_UInt64)((UA_Int64)readBits(bs, 12) - 2047);
+    if(!readBits(bs, 1))
+        return (UA_UInt64)((UA_Int64)readBits(bs, 32) - 2147483647LL);
+    return readBits(bs, 64);
+}
+
+/* The value is XOR'ed with the previous value. If the set bits fit into the
+ * window of the previous XOR, only the bits in the window are written.
+ * Otherwise the number of leading zeros and the length of the window come
+ * first. */
+typedef struct {
+    UA_UInt64 prev;
+    UA_Byte leading;
+    UA_Byte trailing;
+    UA_Boolean window;
+} XorState;
+
+static UA_Byte
+leadingZeros(UA_UInt64 x) {
+    UA_Byte n = 0;
+    while(!(x & 0x8000000000000000ULL)) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+}
+
+static UA_Byte
+trailingZeros(UA_UInt64 x) {
+    UA_Byte n = 0;
+    while(!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+static void
+writeXor(BitStream *bs, XorState *xs, UA_UInt64 value) {
+    UA_UInt64 x = value ^ xs->prev;
+    xs->prev = value;
+    if(x == 0) {
+        writeBits(bs, 0x0, 1);
+        return;
+    }
+    UA_Byte lead = leadingZeros(x);
+    UA_Byte trail = trailingZeros(x);
+    if(xs->window && lead >= xs->leading && trail >= xs->trailing) {
+        writeBits(bs, 0x2, 2);
+        writeBits(bs, x >> xs->trailing, (UA_Byte)(64 - xs->leading - xs->trailing));
+        return;
+    }
+    UA_Byte len = (UA_Byte)(64 - lead - trail);
+    writeBits(bs, 0x3, 2);
+    writeBits(bs, lead, 6);
+    writeBits(bs, (UA_UInt64)(len - 1), 6);
+    writeBits(bs, x >> trail, len);
+    xs->window = true;
+    xs->leading = lead;
+    xs->trailing = trail;
+}
+
+static UA_UInt64
+readXor(BitStream *bs, XorState *xs) {
+    if(!readBits(bs, 1))
+        return xs->prev;
+    if(readBits(bs, 1)) {
+        xs->leading = (UA_Byte)readBits(bs, 6);
+        UA_Byte len = (UA_Byte)(readBits(bs, 6) + 1);
+        xs->trailing = (UA_Byte)(64 - xs->leading - len);
+    }
+    UA_Byte len = (UA_Byte)(64 - xs->leading - xs->trailing);
+    xs->prev ^= readBits(bs, len) << xs->trailing;
+    return xs->prev;
+}
+
+/* Upper bound of the bits per sample: timestamp (69), flags (9), status (33),
+ * server timestamp (70) and value (78) */
+#define PACKED_MAXBITS 259
+
+static UA_Boolean
+HistoryChunk_packable(const HistoryChunk *chunk) {
+    return (!chunk->packed && !chunk->dataValues && chunk->size > 0 &&
+            (!chunk->valueType || chunk->valueType->memSize <= sizeof(UA_UInt64)));
+}
+
+/* Replace the columns with the bit stream */
+static UA_StatusCode
+HistoryChunk_pack(HistoryChunk *chunk) {
+    BitStream bs;
+    bs.pos = 0;
+    bs.data = (UA_Byte*)UA_calloc((chunk->size * PACKED_MAXBITS + 7) / 8, 1);
+    if(!bs.data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    TimestampState source = {0, 0};
+    TimestampState server = {0, 0};
+    XorState value;
+    memset(&value, 0, sizeof(XorState));
+    UA_Byte prevFlags = 0;
+    UA_StatusCode prevStatus = UA_STATUSCODE_GOOD;
+    size_t memSize = (chunk->valueType) ? chunk->valueType->memSize : 0;
+    for(size_t i = 0; i < chunk->size; i++) {
+        UA_DateTime t = chunk->timestamps[i];
+        writeDod(&bs, TimestampState_advance(&source, t));
+
+        UA_Byte flags = chunk->flags[i];
+        if(flags == prevFlags) {
+            writeBits(&bs, 0x0, 1);
+        } else {
+            writeBits(&bs, 0x1, 1);
+            writeBits(&bs, flags, 8);
+            prevFlags = flags;
+        }
+
+        if(chunk->status[i] == prevStatus) {
+            writeBits(&bs, 0x0, 1);
+        } else {
+            writeBits(&bs, 0x1, 1);
+            writeBits(&bs, chunk->status[i], 32);
+            prevStatus = chunk->status[i];
+        }
+
+        /* The server timestamp is often equal to the source timestamp. The
+         * state advances in either case. */
+        UA_UInt64 dod = TimestampState_advance(&server, chunk->serverTimestamps[i]);
+        if(chunk->serverTimestamps[i] == t) {
+            writeBits(&bs, 0x0, 1);
+        } else {
+            writeBits(&bs, 0x1, 1);
+            writeDod(&bs, dod);
+        }
+
+        if(flags & SAMPLE_HASVALUE) {
+            UA_UInt64 v = 0;
+            memcpy(&v, (UA_Byte*)chunk->values + (i * memSize), memSize);
+            writeXor(&bs, &value, v);
+        }
+    }
+
+    size_t packedSize = (bs.pos + 7) / 8;
+    UA_Byte *packed = (UA_Byte*)UA_realloc(bs.data, packedSize);
+    chunk->packed = (packed) ? packed : bs.data;
+    chunk->packedSize = packedSize;
+    chunk->lastTimestamp = chunk->timestamps[chunk->size - 1];
+    UA_free(chunk->timestamps);
+    UA_free(chunk->values);
+    chunk->timestamps = NULL;
+    chunk->serverTimestamps = NULL;
+    chunk->status = NULL;
+    chunk->flags = NULL;
+    chunk->values = NULL;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Decode a packed chunk into columns with the given capacity */
+static UA_StatusCode
+HistoryChunk_unpack(const HistoryChunk *chunk, HistoryChunk *dst, size_t capacity) {
+    UA_StatusCode res = HistoryChunk_init(dst, capacity);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    if(chunk->valueType) {
+        res = HistoryChunk_setType(dst, chunk->valueType, capacity);
+        if(res != UA_STATUSCODE_GOOD) {
+            HistoryChunk_clear(dst);
+            return res;
+        }
+    }
+
+    BitStream bs;
+    bs.data = chunk->packed;
+    bs.pos = 0;
+    TimestampState source = {0, 0};
+    TimestampState server = {0, 0};
+    XorState value;
+    memset(&value, 0, sizeof(XorState));
+    UA_Byte flags = 0;
+    UA_StatusCode status = UA_STATUSCODE_GOOD;
+    size_t memSize = (chunk->valueType) ? chunk->valueType->memSize : 0;
+    for(size_t i = 0; i < chunk->size; i++) {
+        UA_DateTime t = TimestampState_apply(&source, readDod(&bs));
+        dst->timestamps[i] = t;
+        if(readBits(&bs, 1))
+            flags = (UA_Byte)readBits(&bs, 8);
+        dst->flags[i] = flags;
+        if(readBits(&bs, 1))
+            status = (UA_StatusCode)readBits(&bs, 32);
+        dst->status[i] = status;
+        if(readBits(&bs, 1)) {
+            dst->serverTimestamps[i] = TimestampState_apply(&server, readDod(&bs));
+        } else {
+            TimestampState_advance(&server, t);
+            dst->serverTimestamps[i] = t;
+        }
+        if(flags & SAMPLE_HASVALUE) {
+            UA_UInt64 v = readXor(&bs, &value);
+            memcpy((UA_Byte*)dst->values + (i * memSize), &v, memSize);
+        }
+    }
+    dst->start = chunk->start;
+    dst->size = chunk->size;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_DateTime
+HistoryChunk_lastTimestamp(const HistoryChunk *chunk) {
+    if(chunk->packed)
+        return chunk->lastTimestamp;
+    return chunk->timestamps[chunk->size - 1];
+}
+
+/****************/
+/* History Node */
+/****************/
+
+static HistoryNode *
+findNode(UA_ColumnarStoreContext *ctx, const UA_NodeId *nodeId) {
+    HistoryNode dummy;
+    dummy.nodeIdHash = UA_NodeId_hash(nodeId);
+    dummy.nodeId = *nodeId;
+    return ZIP_FIND(HistoryNodeTree, &ctx->nodes, &dummy);
+}
+
+static HistoryNode *
+findOrAddNode(UA_ColumnarStoreContext *ctx, const UA_NodeId *nodeId) {
+    HistoryNode *node = findNode(ctx, nodeId);
+    if(node)
+        return node;
+    node = (HistoryNode*)UA_calloc(1, sizeof(HistoryNode));
+    if(!node)
+        return NULL;
+    if(UA_NodeId_copy(nodeId, &node->nodeId) != UA_STATUSCODE_GOOD) {
+        UA_free(node);
+        return NULL;
+    }
+    node->nodeIdHash = UA_NodeId_hash(nodeId);
+    ZIP_INSERT(HistoryNodeTree, &ctx->nodes, node);
+    return node;
+}
+
+static void *
+deleteNodeVisitor(void *context, HistoryNode *node) {
+    for(size_t i = 0; i < node->chunksSize; i++)
+        HistoryChunk_clear(&node->chunks[i]);
+    UA_free(node->chunks);
+    HistoryChunk_clear(&node->unpacked);
+    UA_NodeId_clear(&node->nodeId);
+    UA_free(node);
+    return NULL;
+}
+
+/* Index of the chunk holding the sample. The index must be below node->size. */
+static size_t
+findChunk(const HistoryNode *node, size_t index) {
+    size_t lo = 0;
+    size_t hi = node->chunksSize - 1;
+    while(lo < hi) {
+        size_t mid = (lo + hi + 1) / 2;
+        if(node->chunks[mid].start <= index)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/* Returns the chunk with the columns. Packed chunks are decoded into the cache
+ * of the node. That is valid until the next call. Returns NULL if the memory
+ * for decoding could not be allocated. */
+static const HistoryChunk *
+getChunk(HistoryNode *node, size_t c) {
+    const HistoryChunk *chunk = &node->chunks[c];
+    if(!chunk->packed)
+        return chunk;
+    if(node->unpackedFrom != chunk->packed) {
+        HistoryChunk_clear(&node->unpacked);
+        node->unpackedFrom = NULL;
+        if(HistoryChunk_unpack(chunk, &node->unpacked, chunk->size) != UA_STATUSCODE_GOOD)
+            return NULL;
+        node->unpackedFrom = chunk->packed;
+    }
+    node->unpacked.start = chunk->start; /* Chunks before may have changed */
+    return &node->unpacked;
+}
+
+static void
+dropUnpacked(HistoryNode *node, const HistoryChunk *chunk) {
+    if(!chunk->packed || node->unpackedFrom != chunk->packed)
+        return;
+    HistoryChunk_clear(&node->unpacked);
+    node->unpackedFrom = NULL;
+}
+
+/* Decode a packed chunk before it is modified */
+static UA_StatusCode
+unpackChunk(HistoryNode *node, size_t c, size_t capacity) {
+    HistoryChunk *chunk = &node->chunks[c];
+    if(!chunk->packed)
+        return UA_STATUSCODE_GOOD;
+    HistoryChunk tmp;
+    UA_StatusCode res = HistoryChunk_unpack(chunk, &tmp, capacity);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    dropUnpacked(node, chunk);
+    HistoryChunk_clear(chunk);
+    *chunk = tmp;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Index of the first sample that is not before the timestamp. Returns whether
+ * the timestamp of that sample is equal. */
+static UA_Boolean
+lowerBound(HistoryNode *node, UA_DateTime timestamp, size_t *index) {
+    /* Find the first chunk whose last sample is not before the timestamp */
+    size_t lo = 0;
+    size_t hi = node->chunksSize;
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(HistoryChunk_lastTimestamp(&node->chunks[mid]) < timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo == node->chunksSize) {
+        *index = node->size;
+        return false;
+    }
+
+    /* Search within the chunk */
+    const HistoryChunk *chunk = getChunk(node, lo);
+    if(!chunk) {
+        *index = node->size;
+        return false;
+    }
+    size_t l = 0;
+    size_t h = chunk->size - 1;
+    while(l < h) {
+        size_t mid = (l + h) / 2;
+        if(chunk->timestamps[mid] < timestamp)
+            l = mid + 1;
+        else
+            h = mid;
+    }
+    *index = chunk->start + l;
+    return (chunk->timestamps[l] == timestamp);
+}
+
+static void
+updateChunkStarts(HistoryNode *node, size_t from) {
+    for(size_t i = from; i < node->chunksSize; i++)
+        node->chunks[i].start = (i == 0) ? 0 :
+            node->chunks[i-1].start + node->chunks[i-1].size;
+}
+
+static UA_StatusCode
+addChunk(HistoryNode *node, size_t at, size_t capacity) {
+    HistoryChunk *chunks = (HistoryChunk*)
+        UA_realloc(node->chunks, (node->chunksSize + 1) * sizeof(HistoryChunk));
+    if(!chunks)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->chunks = chunks;
+    HistoryChunk chunk;
+    UA_StatusCode res = HistoryChunk_init(&chunk, capacity);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    memmove(&chunks[at + 1], &chunks[at], (node->chunksSize - at) * sizeof(HistoryChunk));
+    chunks[at] = chunk;
+    node->chunksSize++;
+    updateChunkStarts(node, at);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+removeChunk(HistoryNode *node, size_t at) {
+    dropUnpacked(node, &node->chunks[at]);
+    HistoryChunk_clear(&node->chunks[at]);
+    memmove(&node->chunks[at], &node->chunks[at + 1],
+            (node->chunksSize - at - 1) * sizeof(HistoryChunk));
+    node->chunksSize--;
+    if(node->chunksSize == 0) {
+        UA_free(node->chunks);
+        node->chunks = NULL;
+    }
+}
+
+/* Move the upper half of a full chunk into a new chunk */
+static UA_StatusCode
+splitChunk(HistoryNode *node, size_t at, size_t capacity) {
+    UA_StatusCode res = addChunk(node, at + 1, capacity);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    HistoryChunk *src = &node->chunks[at];
+    HistoryChunk *dst = &node->chunks[at + 1];
+    if(src->dataValues) {
+        dst->dataValues = (UA_DataValue*)UA_calloc(capacity, sizeof(UA_DataValue));
+        if(!dst->dataValues)
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+    } else if(src->valueType) {
+        res = HistoryChunk_setType(dst, src->valueType, capacity);
+    }
+    if(res != UA_STATUSCODE_GOOD) {
+        removeChunk(node, at + 1);
+        return res;
+    }
+    size_t half = src->size / 2;
+    HistoryChunk_move(dst, 0, src, half, src->size - half);
+    dst->size = src->size - half;
+    src->size = half;
+    dst->start = src->start + half;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+HistoryNode_insert(HistoryNode *node, const UA_ColumnarStoreContext *ctx,
+                   UA_DateTime timestamp, const UA_DataValue *value) {
+    size_t capacity = ctx->chunkCapacity;
+    size_t c;
+    size_t pos;
+    UA_StatusCode res;
+    HistoryChunk *last = (node->chunksSize > 0) ?
+        &node->chunks[node->chunksSize - 1] : NULL;
+    if(!last || HistoryChunk_lastTimestamp(last) <= timestamp) {
+        /* Append in time order. Start a new chunk instead of converting the
+         * last chunk to the generic layout. The previous chunk is sealed and
+         * can be packed. */
+        if(!last || last->size == capacity || !HistoryChunk_fits(last, value)) {
+            res = addChunk(node, node->chunksSize, capacity);
+            if(res != UA_STATUSCODE_GOOD)
+                return res;
+            if(last && ctx->compress) {
+                last = &node->chunks[node->chunksSize - 2];
+                if(HistoryChunk_packable(last))
+                    HistoryChunk_pack(last); /* Stays unpacked on failure */
+            }
+        }
+        c = node->chunksSize - 1;
+        pos = node->chunks[c].size;
+    } else {
+        /* Insert into the middle */
+        size_t index;
+        lowerBound(node, timestamp, &index);
+        c = findChunk(node, index);
+        pos = index - node->chunks[c].start;
+    }
+
+    res = unpackChunk(node, c, capacity);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    if(node->chunks[c].size == capacity) {
+        res = splitChunk(node, c, capacity);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        if(pos > node->chunks[c].size) {
+            pos -= node->chunks[c].size;
+            c++;
+        }
+    }
+
+    HistoryChunk *chunk = &node->chunks[c];
+    res = HistoryChunk_prepare(chunk, value, capacity);
+    if(res == UA_STATUSCODE_GOOD) {
+        HistoryChunk_move(chunk, pos + 1, chunk, pos, chunk->size - pos);
+        res = HistoryChunk_write(chunk, pos, timestamp, value);
+        if(res != UA_STATUSCODE_GOOD)
+            HistoryChunk_move(chunk, pos, chunk, pos + 1, chunk->size - pos);
+    }
+    if(res != UA_STATUSCODE_GOOD) {
+        if(chunk->size == 0)
+            removeChunk(node, c);
+        return res;
+    }
+
+    chunk->size++;
+    node->size++;
+    for(size_t i = c + 1; i < node->chunksSize; i++)
+        node->chunks[i].start++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+HistoryNode_replace(HistoryNode *node, size_t capacity, size_t index,
+                    UA_DateTime timestamp, const UA_DataValue *value) {
+    size_t c = findChunk(node, index);
+    UA_StatusCode res = unpackChunk(node, c, capacity);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    HistoryChunk *chunk = &node->chunks[c];
+    size_t pos = index - chunk->start;
+    res = HistoryChunk_prepare(chunk, value, capacity);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    if(!chunk->dataValues)
+        return HistoryChunk_write(chunk, pos, timestamp, value);
+    UA_DataValue old = chunk->dataValues[pos];
+    res = HistoryChunk_write(chunk, pos, timestamp, value);
+    if(res != UA_STATUSCODE_GOOD) {
+        chunk->dataValues[pos] = old;
+        return res;
+    }
+    UA_DataValue_clear(&old);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Remove the samples in [index1, index2) */
+static UA_StatusCode
+HistoryNode_remove(HistoryNode *node, size_t capacity,
+                   size_t index1, size_t index2) {
+    size_t c = findChunk(node, index1);
+    size_t firstChunk = c;
+    size_t from = index1 - node->chunks[c].start;
+    size_t remaining = index2 - index1;
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    while(remaining > 0) {
+        HistoryChunk *chunk = &node->chunks[c];
+        size_t count = chunk->size - from;
+        if(count > remaining)
+            count = remaining;
+        /* Packed chunks are unpacked unless they are removed entirely */
+        if(count < chunk->size) {
+            res = unpackChunk(node, c, capacity);
+            if(res != UA_STATUSCODE_GOOD)
+                break;
+        }
+        if(chunk->dataValues) {
+            for(size_t i = from; i < from + count; i++)
+                UA_DataValue_clear(&chunk->dataValues[i]);
+        }
+        HistoryChunk_move(chunk, from, chunk, from + count,
+                          chunk->size - from - count);
+        chunk->size -= count;
+        node->size -= count;
+        remaining -= count;
+        if(chunk->size == 0)
+            removeChunk(node, c);
+        else
+            c++;
+        from = 0;
+    }
+    updateChunkStarts(node, firstChunk);
+    return res;
+}
+
+static UA_DateTime
+sampleTimestamp(const UA_DataValue *value) {
+    if(value->hasSourceTimestamp)
+        return value->sourceTimestamp;
+    if(value->hasServerTimestamp)
+        return value->serverTimestamp;
+    return UA_DateTime_now();
+}
+
+/***********************/
+/* Backend Entry Points */
+/***********************/
+
+static UA_StatusCode
+serverSetHistoryData_backend_columnar(UA_Server *server,
+                                      void *context,
+                                      const UA_NodeId *sessionId,
+                                      void *sessionContext,
+                                      const UA_NodeId *nodeId,
+                                      UA_Boolean historizing,
+                                      const UA_DataValue *value) {
+    UA_ColumnarStoreContext *ctx = (UA_ColumnarStoreContext*)context;
+    HistoryNode *node = findOrAddNode(ctx, nodeId);
+    if(!node)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    return HistoryNode_insert(node, ctx, sampleTimestamp(value), value);
+}
+
+static size_t
+getEnd_backend_columnar(UA_Server *server,
+                        void *context,
+                        const UA_NodeId *sessionId,
+                        void *sessionContext,
+                        const UA_NodeId *nodeId) {
+    const HistoryNode *node = findNode((UA_ColumnarStoreContext*)context, nodeId);
+    return (node) ? node->size : 0;
+}
+
+static size_t
+lastIndex_backend_columnar(UA_Server *server,
+                           void *context,
+                           const UA_NodeId *sessionId,
+                           void *sessionContext,
+                           const UA_NodeId *nodeId) {
+    const HistoryNode *node = findNode((UA_ColumnarStoreContext*)context, nodeId);
+    if(!node || node->size == 0)
+        return 0;
+    return node->size - 1;
+}
+
+static size_t
+firstIndex_backend_columnar(UA_Server *server,
+                            void *context,
+                            const UA_NodeId *sessionId,
+                            void *sessionContext,
+                            const UA_NodeId *nodeId) {
+    return 0;
+}
+
+static size_t
+resultSize_backend_columnar(UA_Server *server,
+                            void *context,
+                            const UA_NodeId *sessionId,
+                            void *sessionContext,
+                            const UA_NodeId *nodeId,
+                            size_t startIndex,
+                            size_t endIndex) {
+    const HistoryNode *node = findNode((UA_ColumnarStoreContext*)context, nodeId);
+    if(!node || node->size == 0 ||
+       startIndex == node->size || endIndex == node->size)
+        return 0;
+    return endIndex - startIndex + 1;
+}
+
+static size_t
+getDateTimeMatch_backend_columnar(UA_Server *server,
+                                  void *context,
+                                  const UA_NodeId *sessionId,
+                                  void *sessionContext,
+                                  const UA_NodeId *nodeId,
+                                  const UA_DateTime timestamp,
+                                  const MatchStrategy strategy) {
+    HistoryNode *node = findNode((UA_ColumnarStoreContext*)context, nodeId);
+    if(!node)
+        return 0;
+    size_t current;
+    UA_Boolean equal = lowerBound(node, timestamp, &current);
+    switch(strategy) {
+    case MATCH_EQUAL:
+        return (equal) ? current : node->size;
+    case MATCH_AFTER:
+        /* Skip all samples with an equal timestamp */
+        while(equal && current < node->size) {
+            const HistoryChunk *c = getChunk(node, findChunk(node, current));
+            if(!c || c->timestamps[current - c->start] != timestamp)
+                break;
+            current++;
+        }
+        return current;
+    case MATCH_EQUAL_OR_AFTER:
+        return current;
+    case MATCH_EQUAL_OR_BEFORE:
+        if(equal)
+            return current;
+        /* Fall through */
+    case MATCH_BEFORE:
+        return (current > 0) ? current - 1 : node->size;
+    default:
+        break;
+    }
+    return node->size;
+}
+
+static UA_Boolean
+boundSupported_backend_columnar(UA_Server *server,
+                                void *context,
+                                const UA_NodeId *sessionId,
+                                void *sessionContext,
+                                const UA_NodeId *nodeId) {
+    return true;
+}
+
+static UA_Boolean
+timestampsToReturnSupported_backend_columnar(UA_Server *server,
+                                             void *context,
+                                             const UA_NodeId *sessionId,
+                                             void *sessionContext,
+                                             const UA_NodeId *nodeId,
+                                             const UA_TimestampsToReturn timestampsToReturn) {
+    HistoryNode *node = findNode((UA_ColumnarStoreContext*)context, nodeId);
+    if(!node || node->size == 0)
+        return true;
+    const HistoryChunk *chunk = getChunk(node, 0);
+    if(!chunk)
+        return false;
+    UA_DataValue first;
+    HistoryChunk_get(chunk, 0, &first);
+    if(timestampsToReturn == UA_TIMESTAMPSTORETURN_NEITHER ||
+       timestampsToReturn == UA_TIMESTAMPSTORETURN_INVALID ||
+       (timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER &&
+        !first.hasServerTimestamp) ||
+       (timestampsToReturn == UA_TIMESTAMPSTORETURN_SOURCE &&
+        !first.hasSourceTimestamp) ||
+       (timestampsToReturn == UA_TIMESTAMPSTORETURN_BOTH &&
+        !(first.hasSourceTimestamp && first.hasServerTimestamp)))
+        return false;
+    return true;
+}
+
+static const UA_DataValue*
+getDataValue_backend_columnar(UA_Server *server,
+                              void *context,
+                              const UA_NodeId *sessionId,
+                              void *sessionContext,
+                              const UA_NodeId *nodeId,
+                              size_t index) {
+    HistoryNode *node = findNode((UA_ColumnarStoreContext*)context, nodeId);
+    if(!node || index >= node->size)
+        return NULL;
+    const HistoryChunk *chunk = getChunk(node, findChunk(node, index));
+    if(!chunk)
+        return NULL;
+    size_t pos = index - chunk->start;
+    if(chunk->dataValues)
+        return &chunk->dataValues[pos];
+    /* Valid until the next call */
+    HistoryChunk_get(chunk, pos, &node->current);
+    return &node->current;
+}
+
+static UA_StatusCode
+copySample(HistoryNode *node, size_t index,
+           const UA_NumericRange range, UA_DataValue *out) {
+    const HistoryChunk *chunk = getChunk(node, findChunk(node, index));
+    if(!chunk)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_DataValue sample;
+    HistoryChunk_get(chunk, index - chunk->start, &sample);
+    if(range.dimensionsSize == 0)
+        return UA_DataValue_copy(&sample, out);
+    *out = sample;
+    UA_Variant_init(&out->value);
+    if(!sample.hasValue)
+        return UA_STATUSCODE_BADDATAUNAVAILABLE;
+    return UA_Variant_copyRange(&sample.value, &out->value, range);
+}
+
+static UA_StatusCode
+copyDataValues_backend_columnar(UA_Server *server,
+                                void *context,
+                                const UA_NodeId *sessionId,
+                                void *sessionContext,
+                                const UA_NodeId *nodeId,
+                                size_t startIndex,
+                                size_t endIndex,
+                                UA_Boolean reverse,
+                                size_t maxValues,
+                                UA_NumericRange range,
+                                UA_Boolean releaseContinuationPoints,
+                                const UA_ByteString *continuationPoint,
+                                UA_ByteString *outContinuationPoint,
+                                size_t *providedValues,
+                                UA_DataValue *values) {
+    size_t skip = 0;
+    if(continuationPoint->length > 0) {
+        if(continuationPoint->length != sizeof(size_t))
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        skip = *((size_t*)(continuationPoint->data));
+    }
+    HistoryNode *node = findNode((UA_ColumnarStoreContext*)context, nodeId);
+    size_t storeEnd = (node) ? node->size : 0;
+    size_t index = startIndex;
+    size_t counter = 0;
+    size_t skipped = 0;
+    if(reverse) {
+        while(index >= endIndex && index < storeEnd && counter < maxValues) {
+            if(skipped++ >= skip) {
+                copySample(node, index, range, &values[counter]);
+                ++counter;
+            }
+            --index;
+        }
+    } else {
+        while(index <= endIndex && index < storeEnd && counter < maxValues) {
+            if(skipped++ >= skip) {
+                copySample(node, index, range, &values[counter]);
+                ++counter;
+            }
+            ++index;
+        }
+    }
+
+    if(providedValues)
+        *providedValues = counter;
+
+    if((!reverse && (endIndex - startIndex - skip + 1) > counter) ||
+       (reverse && (startIndex - endIndex - skip + 1) > counter)) {
+        outContinuationPoint->data = (UA_Byte*)UA_malloc(sizeof(size_t));
+        if(!outContinuationPoint->data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        outContinuationPoint->length = sizeof(size_t);
+        *((size_t*)(outContinuationPoint->data)) = skip + counter;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+insertDataValue_backend_columnar(UA_Server *server,
+                                 void *hdbContext,
+                                 const UA_NodeId *sessionId,
+                                 void *sessionContext,
+                                 const UA_NodeId *nodeId,
+                                 const UA_DataValue *value) {
+    if(!value->hasSourceTimestamp && !value->hasServerTimestamp)
+        return UA_STATUSCODE_BADINVALIDTIMESTAMP;
+    UA_ColumnarStoreContext *ctx = (UA_ColumnarStoreContext*)hdbContext;
+    HistoryNode *node = findOrAddNode(ctx, nodeId);
+    if(!node)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_DateTime timestamp = sampleTimestamp(value);
+    size_t index;
+    if(lowerBound(node, timestamp, &index))
+        return UA_STATUSCODE_BADENTRYEXISTS;
+    return HistoryNode_insert(node, ctx, timestamp, value);
+}
+
+static UA_StatusCode
+replaceDataValue_backend_columnar(UA_Server *server,
+                                  void *hdbContext,
+                                  const UA_NodeId *sessionId,
+                                  void *sessionContext,
+                                  const UA_NodeId *nodeId,
+                                  const UA_DataValue *value) {
+    if(!value->hasSourceTimestamp && !value->hasServerTimestamp)
+        return UA_STATUSCODE_BADINVALIDTIMESTAMP;
+    UA_ColumnarStoreContext *ctx = (UA_ColumnarStoreContext*)hdbContext;
+    HistoryNode *node = findNode(ctx, nodeId);
+    if(!node)
+        return UA_STATUSCODE_BADNOENTRYEXISTS;
+    UA_DateTime timestamp = sampleTimestamp(value);
+    size_t index;
+    if(!lowerBound(node, timestamp, &index))
+        return UA_STATUSCODE_BADNOENTRYEXISTS;
+    return HistoryNode_replace(node, ctx->chunkCapacity, index, timestamp, value);
+}
+
+static UA_StatusCode
+updateDataValue_backend_columnar(UA_Server *server,
+                                 void *hdbContext,
+                                 const UA_NodeId *sessionId,
+                                 void *sessionContext,
+                                 const UA_NodeId *nodeId,
+                                 const UA_DataValue *value) {
+    UA_StatusCode ret =
+        replaceDataValue_backend_columnar(server, hdbContext, sessionId,
+                                          sessionContext, nodeId, value);
+    if(ret == UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_GOODENTRYREPLACED;
+
+    ret = insertDataValue_backend_columnar(server, hdbContext, sessionId,
+                                           sessionContext, nodeId, value);
+    if(ret == UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_GOODENTRYINSERTED;
+    return ret;
+}
+
+static UA_StatusCode
+removeDataValue_backend_columnar(UA_Server *server,
+                                 void *hdbContext,
+                                 const UA_NodeId *sessionId,
+                                 void *sessionContext,
+                                 const UA_NodeId *nodeId,
+                                 UA_DateTime startTimestamp,
+                                 UA_DateTime endTimestamp) {
+    if(startTimestamp > endTimestamp)
+        return UA_STATUSCODE_BADTIMESTAMPNOTSUPPORTED;
+    UA_ColumnarStoreContext *ctx = (UA_ColumnarStoreContext*)hdbContext;
+    HistoryNode *node = findNode(ctx, nodeId);
+    if(!node)
+        return UA_STATUSCODE_BADNODATA;
+
+    /* The first index which is deleted and the first index which is not */
+    size_t index1;
+    size_t index2;
+    if(startTimestamp == endTimestamp) {
+        if(!lowerBound(node, startTimestamp, &index1))
+            return UA_STATUSCODE_BADNODATA;
+        index2 = index1 + 1;
+    } else {
+        lowerBound(node, startTimestamp, &index1);
+        lowerBound(node, endTimestamp, &index2);
+        if(index1 >= index2)
+            return UA_STATUSCODE_BADNODATA;
+    }
+    return HistoryNode_remove(node, ctx->chunkCapacity, index1, index2);
+}
+
+static void
+deleteMembers_backend_columnar(UA_HistoryDataBackend *backend) {
+    if(backend == NULL || backend->context == NULL)
+        return;
+    UA_ColumnarStoreContext *ctx = (UA_ColumnarStoreContext*)backend->context;
+    ZIP_ITER(HistoryNodeTree, &ctx->nodes, deleteNodeVisitor, NULL);
+    UA_free(ctx);
+    backend->context = NULL;
+}
+
+static UA_HistoryDataBackend
+createBackend(size_t samplesPerChunk, UA_Boolean compress) {
+    UA_HistoryDataBackend result;
+    memset(&result, 0, sizeof(UA_HistoryDataBackend));
+    UA_ColumnarStoreContext *ctx = (UA_ColumnarStoreContext*)
+        UA_calloc(1, sizeof(UA_ColumnarStoreContext));
+    if(!ctx)
+        return result;
+    ZIP_INIT(&ctx->nodes);
+    ctx->chunkCapacity = (samplesPerChunk > 1) ?
+        samplesPerChunk : UA_HISTORYDATABACKEND_COLUMNAR_CHUNKSIZE;
+    ctx->compress = compress;
+    result.serverSetHistoryData = &serverSetHistoryData_backend_columnar;
+    result.resultSize = &resultSize_backend_columnar;
+    result.getEnd = &getEnd_backend_columnar;
+    result.lastIndex = &lastIndex_backend_columnar;
+    result.firstIndex = &firstIndex_backend_columnar;
+    result.getDateTimeMatch = &getDateTimeMatch_backend_columnar;
+    result.copyDataValues = &copyDataValues_backend_columnar;
+    result.getDataValue = &getDataValue_backend_columnar;
+    result.boundSupported = &boundSupported_backend_columnar;
+    result.timestampsToReturnSupported = &timestampsToReturnSupported_backend_columnar;
+    result.insertDataValue = &insertDataValue_backend_columnar;
+    result.updateDataValue = &updateDataValue_backend_columnar;
+    result.replaceDataValue = &replaceDataValue_backend_columnar;
+    result.removeDataValue = &removeDataValue_backend_columnar;
+    result.deleteMembers = &deleteMembers_backend_columnar;
+    result.getHistoryData = NULL;
+    result.context = ctx;
+    return result;
+}
+
+UA_HistoryDataBackend
+UA_HistoryDataBackend_Memory_Columnar(size_t samplesPerChunk) {
+    return createBackend(samplesPerChunk, false);
+}
+
+UA_HistoryDataBackend
+UA_HistoryDataBackend_Memory_Compressed(size_t samplesPerChunk) {
+    return createBackend(samplesPerChunk, true);
+}
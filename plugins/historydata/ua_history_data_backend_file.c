@@ -0,0 +1,1051 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <open62541/plugin/historydata/history_data_backend_file.h>
+
+#include "ziptree.h"
+#include "mp_printf.h"
+
+#ifdef __linux__ /* Linux only so far */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Every NodeId has a directory named after the hash of the NodeId and a
+ * collision counter. The encoded NodeId is stored in the file "nodeid" of the
+ * directory. The segment files are named by their sequence number.
+ *
+ * A segment starts with a header (magic and version). Then follow the records:
+ *
+ * - UInt32 length of the payload
+ * - UInt32 checksum over the timestamp, flags and payload
+ * - DateTime timestamp (the sort key)
+ * - Byte flags
+ * - Payload: the binary encoded DataValue
+ *
+ * Source and server timestamps equal to the key are not repeated in the
+ * payload. This is indicated by the flags.
+ *
+ * New segments are written to a temporary file first and then renamed. So a
+ * segment file is always complete with its header. Records are appended
+ * without syncing. Incomplete records at the end of a segment are detected with
+ * the checksum and truncated when the node is loaded. */
+
+#define SEGMENT_MAGIC 0x53484155 /* UAHS */
+#define SEGMENT_VERSION 1
+#define SEGMENT_HEADERSIZE 8
+#define RECORD_HEADERSIZE 17
+#define RECORD_SOURCE_IS_KEY 0x01
+#define RECORD_SERVER_IS_KEY 0x02
+
+/* Every n-th record is added to the sparse index */
+#define SPARSE_INDEX_STRIDE 64
+
+typedef struct {
+    UA_UInt32 seq;
+    size_t size;  /* Size of the valid content */
+    size_t count; /* Number of records */
+    UA_Byte *map; /* Read-only mapping */
+    size_t mapSize;
+} HistorySegment;
+
+typedef struct {
+    UA_DateTime timestamp;
+    size_t segment;
+    size_t offset;
+} SparseIndexEntry;
+
+typedef struct {
+    size_t segment;
+    size_t offset;
+} RecordCursor;
+
+struct FileHistoryNode;
+typedef struct FileHistoryNode FileHistoryNode;
+
+struct FileHistoryNode {
+    ZIP_ENTRY(FileHistoryNode) zipfields;
+    UA_UInt32 nodeIdHash;
+    UA_NodeId nodeId;
+    char *dir;
+    int fd; /* The last segment is open for appending */
+    HistorySegment *segments;
+    size_t segmentsSize;
+    SparseIndexEntry *index; /* Entry i points to record i * SPARSE_INDEX_STRIDE */
+    size_t indexSize;
+    size_t count;
+    UA_DateTime lastTimestamp;
+    UA_DataValue current; /* Decoded for getDataValue */
+};
+
+static enum ZIP_CMP
+cmpFileHistoryNode(const void *a, const void *b) {
+    const FileHistoryNode *aa = (const FileHistoryNode*)a;
+    const FileHistoryNode *bb = (const FileHistoryNode*)b;
+    if(aa->nodeIdHash < bb->nodeIdHash)
+        return ZIP_CMP_LESS;
+    if(aa->nodeIdHash > bb->nodeIdHash)
+        return ZIP_CMP_MORE;
+    return (enum ZIP_CMP)UA_NodeId_order(&aa->nodeId, &bb->nodeId);
+}
+
+ZIP_HEAD(FileHistoryNodeTree, FileHistoryNode);
+typedef struct FileHistoryNodeTree FileHistoryNodeTree;
+ZIP_FUNCTIONS(FileHistoryNodeTree, FileHistoryNode, zipfields, FileHistoryNode,
+              zipfields, cmpFileHistoryNode)
+
+typedef struct {
+    FileHistoryNodeTree nodes;
+    char *path;
+    size_t segmentSize;
+} UA_FileStoreContext;
+
+/***********/
+/* Records */
+/***********/
+
+static UA_UInt32
+recordChecksum(const UA_Byte *record, UA_UInt32 length) {
+    /* Skip length and checksum */
+    return UA_ByteString_hash(0, &record[8], (RECORD_HEADERSIZE - 8) + length);
+}
+
+static void
+writeRecordHeader(UA_Byte *record, UA_UInt32 length,
+                  UA_DateTime timestamp, UA_Byte flags) {
+    memcpy(record, &length, 4);
+    memcpy(&record[8], &timestamp, 8);
+    record[16] = flags;
+    UA_UInt32 checksum = recordChecksum(record, length);
+    memcpy(&record[4], &checksum, 4);
+}
+
+/* Returns false if the record is incomplete or corrupted */
+static UA_Boolean
+parseRecord(const UA_Byte *seg, size_t offset, size_t limit, UA_Boolean verify,
+            UA_UInt32 *length, UA_DateTime *timestamp) {
+    if(offset + RECORD_HEADERSIZE > limit)
+        return false;
+    const UA_Byte *record = &seg[offset];
+    memcpy(length, record, 4);
+    if(*length > limit - offset - RECORD_HEADERSIZE)
+        return false;
+    memcpy(timestamp, &record[8], 8);
+    if(verify) {
+        UA_UInt32 checksum;
+        memcpy(&checksum, &record[4], 4);
+        if(checksum != recordChecksum(record, *length))
+            return false;
+    }
+    return true;
+}
+
+/*************************/
+/* Segments and Mappings */
+/*************************/
+
+static void
+segmentPath(const FileHistoryNode *node, UA_UInt32 seq, const char *ext,
+            char *buf, size_t bufSize) {
+    mp_snprintf(buf, bufSize, "%s/%010u.%s", node->dir, (unsigned)seq, ext);
+}
+
+static void
+unmapSegment(HistorySegment *seg) {
+    if(seg->map)
+        munmap(seg->map, seg->mapSize);
+    seg->map = NULL;
+    seg->mapSize = 0;
+}
+
+static UA_StatusCode
+mapSegment(HistorySegment *seg, int fd) {
+    unmapSegment(seg);
+    void *map = mmap(NULL, seg->size, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    seg->map = (UA_Byte*)map;
+    seg->mapSize = seg->size;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Map a segment through its own file. The open fd of the node belongs to the
+ * last segment only. */
+static UA_StatusCode
+mapSegmentFile(FileHistoryNode *node, HistorySegment *seg) {
+    char path[PATH_MAX];
+    segmentPath(node, seg->seq, "seg", path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_StatusCode res = mapSegment(seg, fd);
+    close(fd);
+    return res;
+}
+
+/* Only the last segment grows. Remap if records were appended since. Sealed
+ * segments are mapped completely, unless an earlier mapping failed. */
+static const UA_Byte *
+getSegment(FileHistoryNode *node, size_t segment) {
+    HistorySegment *seg = &node->segments[segment];
+    if(seg->mapSize >= seg->size)
+        return seg->map;
+    UA_StatusCode res = (segment + 1 == node->segmentsSize && node->fd >= 0) ?
+        mapSegment(seg, node->fd) : mapSegmentFile(node, seg);
+    return (res == UA_STATUSCODE_GOOD) ? seg->map : NULL;
+}
+
+static UA_StatusCode
+addIndexEntry(FileHistoryNode *node, UA_DateTime timestamp,
+              size_t segment, size_t offset) {
+    SparseIndexEntry *index = (SparseIndexEntry*)
+        UA_realloc(node->index, (node->indexSize + 1) * sizeof(SparseIndexEntry));
+    if(!index)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->index = index;
+    index[node->indexSize].timestamp = timestamp;
+    index[node->indexSize].segment = segment;
+    index[node->indexSize].offset = offset;
+    node->indexSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static int
+cmpSeq(const void *a, const void *b) {
+    UA_UInt32 aa = *(const UA_UInt32*)a;
+    UA_UInt32 bb = *(const UA_UInt32*)b;
+    return (aa > bb) - (aa < bb);
+}
+
+/* Open, verify and index an existing segment. Incomplete records at the end
+ * are truncated. */
+static UA_StatusCode
+loadSegment(FileHistoryNode *node, UA_UInt32 seq, UA_Boolean last) {
+    char path[PATH_MAX];
+    segmentPath(node, seq, "seg", path, sizeof(path));
+    int fd = open(path, O_RDWR | O_APPEND);
+    if(fd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    struct stat st;
+    UA_UInt32 header[2];
+    if(fstat(fd, &st) != 0 || st.st_size < SEGMENT_HEADERSIZE ||
+       pread(fd, header, SEGMENT_HEADERSIZE, 0) != SEGMENT_HEADERSIZE ||
+       header[0] != SEGMENT_MAGIC || header[1] != SEGMENT_VERSION) {
+        close(fd);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+
+    HistorySegment *segments = (HistorySegment*)
+        UA_realloc(node->segments, (node->segmentsSize + 1) * sizeof(HistorySegment));
+    if(!segments) {
+        close(fd);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    node->segments = segments;
+    HistorySegment *seg = &segments[node->segmentsSize];
+    memset(seg, 0, sizeof(HistorySegment));
+    seg->seq = seq;
+    seg->size = (size_t)st.st_size;
+    UA_StatusCode res = mapSegment(seg, fd);
+    if(res != UA_STATUSCODE_GOOD) {
+        close(fd);
+        return res;
+    }
+    node->segmentsSize++;
+
+    /* Scan the records */
+    size_t offset = SEGMENT_HEADERSIZE;
+    UA_UInt32 length;
+    UA_DateTime timestamp;
+    while(parseRecord(seg->map, offset, seg->size, true, &length, &timestamp)) {
+        if(node->count > 0 && timestamp < node->lastTimestamp)
+            break;
+        if(node->count % SPARSE_INDEX_STRIDE == 0) {
+            res = addIndexEntry(node, timestamp, node->segmentsSize - 1, offset);
+            if(res != UA_STATUSCODE_GOOD) {
+                close(fd);
+                return res;
+            }
+        }
+        node->lastTimestamp = timestamp;
+        node->count++;
+        seg->count++;
+        offset += RECORD_HEADERSIZE + length;
+    }
+
+    /* Truncate the incomplete tail */
+    if(offset < seg->size) {
+        if(ftruncate(fd, (off_t)offset) != 0) {
+            close(fd);
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+        seg->size = offset;
+    }
+
+    if(last)
+        node->fd = fd;
+    else
+        close(fd);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+loadSegments(FileHistoryNode *node) {
+    DIR *dir = opendir(node->dir);
+    if(!dir)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_UInt32 *seqs = NULL;
+    size_t seqsSize = 0;
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL) {
+        unsigned seq;
+        char ext[4];
+        if(sscanf(entry->d_name, "%10u.%3s", &seq, ext) != 2)
+            continue;
+        if(strcmp(ext, "tmp") == 0) {
+            /* Left behind by an interrupted rollover */
+            char path[PATH_MAX];
+            segmentPath(node, (UA_UInt32)seq, "tmp", path, sizeof(path));
+            unlink(path);
+            continue;
+        }
+        if(strcmp(ext, "seg") != 0)
+            continue;
+        UA_UInt32 *newSeqs = (UA_UInt32*)UA_realloc(seqs, (seqsSize + 1) * sizeof(UA_UInt32));
+        if(!newSeqs) {
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+            break;
+        }
+        seqs = newSeqs;
+        seqs[seqsSize++] = (UA_UInt32)seq;
+    }
+    closedir(dir);
+
+    if(res == UA_STATUSCODE_GOOD && seqsSize > 0) {
+        qsort(seqs, seqsSize, sizeof(UA_UInt32), cmpSeq);
+        for(size_t i = 0; i < seqsSize && res == UA_STATUSCODE_GOOD; i++)
+            res = loadSegment(node, seqs[i], i == seqsSize - 1);
+    }
+    UA_free(seqs);
+    return res;
+}
+
+static UA_StatusCode
+syncDirectory(const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if(fd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    int err = fsync(fd);
+    close(fd);
+    return (err == 0) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADINTERNALERROR;
+}
+
+/* Seal the last segment and start a new one. If sealing fails, the last
+ * segment stays open for appending. */
+static UA_StatusCode
+addSegment(FileHistoryNode *node) {
+    UA_UInt32 seq = (node->segmentsSize > 0) ?
+        node->segments[node->segmentsSize - 1].seq + 1 : 0;
+    HistorySegment *segments = (HistorySegment*)
+        UA_realloc(node->segments, (node->segmentsSize + 1) * sizeof(HistorySegment));
+    if(!segments)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->segments = segments;
+
+    /* Sync and map the complete previous segment. Its fd is closed only once
+     * the new segment exists. */
+    if(node->fd >= 0) {
+        HistorySegment *prev = &segments[node->segmentsSize - 1];
+        if(fdatasync(node->fd) != 0)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        if(prev->mapSize < prev->size) {
+            UA_StatusCode res = mapSegment(prev, node->fd);
+            if(res != UA_STATUSCODE_GOOD)
+                return res;
+        }
+    }
+
+    /* Write the header to a temporary file and rename */
+    char tmpPath[PATH_MAX];
+    char path[PATH_MAX];
+    segmentPath(node, seq, "tmp", tmpPath, sizeof(tmpPath));
+    segmentPath(node, seq, "seg", path, sizeof(path));
+    int fd = open(tmpPath, O_RDWR | O_APPEND | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_UInt32 header[2] = {SEGMENT_MAGIC, SEGMENT_VERSION};
+    if(write(fd, header, SEGMENT_HEADERSIZE) != SEGMENT_HEADERSIZE ||
+       fdatasync(fd) != 0 || rename(tmpPath, path) != 0) {
+        close(fd);
+        unlink(tmpPath);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    syncDirectory(node->dir);
+
+    if(node->fd >= 0)
+        close(node->fd);
+
+    HistorySegment *seg = &segments[node->segmentsSize];
+    memset(seg, 0, sizeof(HistorySegment));
+    seg->seq = seq;
+    seg->size = SEGMENT_HEADERSIZE;
+    node->segmentsSize++;
+    node->fd = fd;
+    return UA_STATUSCODE_GOOD;
+}
+
+/*********/
+/* Nodes */
+/*********/
+
+static void
+FileHistoryNode_delete(FileHistoryNode *node) {
+    for(size_t i = 0; i < node->segmentsSize; i++)
+        unmapSegment(&node->segments[i]);
+    UA_free(node->segments);
+    if(node->fd >= 0)
+        close(node->fd);
+    UA_free(node->index);
+    UA_free(node->dir);
+    UA_DataValue_clear(&node->current);
+    UA_NodeId_clear(&node->nodeId);
+    UA_free(node);
+}
+
+static void *
+deleteNodeVisitor(void *context, FileHistoryNode *node) {
+    FileHistoryNode_delete(node);
+    return NULL;
+}
+
+static UA_Boolean
+nodeIdFileMatches(const char *dir, const UA_NodeId *nodeId) {
+    char path[PATH_MAX];
+    mp_snprintf(path, sizeof(path), "%s/nodeid", dir);
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    UA_Byte buf[4096];
+    ssize_t len = read(fd, buf, sizeof(buf));
+    close(fd);
+    if(len <= 0)
+        return false;
+    UA_ByteString encoded = {(size_t)len, buf};
+    UA_NodeId stored;
+    if(UA_decodeBinary(&encoded, &stored, &UA_TYPES[UA_TYPES_NODEID], NULL) !=
+       UA_STATUSCODE_GOOD)
+        return false;
+    UA_Boolean match = UA_NodeId_equal(&stored, nodeId);
+    UA_NodeId_clear(&stored);
+    return match;
+}
+
+static UA_StatusCode
+writeNodeIdFile(const char *dir, const UA_NodeId *nodeId) {
+    UA_ByteString encoded = UA_BYTESTRING_NULL;
+    UA_StatusCode res = UA_encodeBinary(nodeId, &UA_TYPES[UA_TYPES_NODEID], &encoded);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    char tmpPath[PATH_MAX];
+    char path[PATH_MAX];
+    mp_snprintf(tmpPath, sizeof(tmpPath), "%s/nodeid.tmp", dir);
+    mp_snprintf(path, sizeof(path), "%s/nodeid", dir);
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        UA_ByteString_clear(&encoded);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    ssize_t written = write(fd, encoded.data, encoded.length);
+    if(written != (ssize_t)encoded.length || fdatasync(fd) != 0 ||
+       rename(tmpPath, path) != 0)
+        res = UA_STATUSCODE_BADINTERNALERROR;
+    close(fd);
+    UA_ByteString_clear(&encoded);
+    return res;
+}
+
+/* Looks up the node in memory first. Then on disk, where it is created if
+ * requested. */
+static FileHistoryNode *
+getNode(UA_FileStoreContext *ctx, const UA_NodeId *nodeId, UA_Boolean create) {
+    FileHistoryNode dummy;
+    dummy.nodeIdHash = UA_NodeId_hash(nodeId);
+    dummy.nodeId = *nodeId;
+    FileHistoryNode *node = ZIP_FIND(FileHistoryNodeTree, &ctx->nodes, &dummy);
+    if(node)
+        return node;
+
+    /* Find the directory. Collisions of the hash get a counter. */
+    char dir[PATH_MAX];
+    UA_Boolean exists = false;
+    for(unsigned i = 0; ; i++) {
+        mp_snprintf(dir, sizeof(dir), "%s/%08x-%u", ctx->path,
+                    (unsigned)dummy.nodeIdHash, i);
+        struct stat st;
+        if(stat(dir, &st) != 0)
+            break;
+        if(nodeIdFileMatches(dir, nodeId)) {
+            exists = true;
+            break;
+        }
+    }
+    if(!exists) {
+        if(!create)
+            return NULL;
+        if(mkdir(dir, 0755) != 0 && errno != EEXIST)
+            return NULL;
+        if(writeNodeIdFile(dir, nodeId) != UA_STATUSCODE_GOOD)
+            return NULL;
+    }
+
+    node = (FileHistoryNode*)UA_calloc(1, sizeof(FileHistoryNode));
+    if(!node)
+        return NULL;
+    node->fd = -1;
+    node->nodeIdHash = dummy.nodeIdHash;
+    size_t dirLen = strlen(dir);
+    node->dir = (char*)UA_malloc(dirLen + 1);
+    if(!node->dir || UA_NodeId_copy(nodeId, &node->nodeId) != UA_STATUSCODE_GOOD) {
+        FileHistoryNode_delete(node);
+        return NULL;
+    }
+    memcpy(node->dir, dir, dirLen + 1);
+    if(exists && loadSegments(node) != UA_STATUSCODE_GOOD) {
+        FileHistoryNode_delete(node);
+        return NULL;
+    }
+    ZIP_INSERT(FileHistoryNodeTree, &ctx->nodes, node);
+    return node;
+}
+
+/* Position the cursor at the indexed record before or at the index */
+static void
+cursorAt(const FileHistoryNode *node, size_t index, RecordCursor *cursor) {
+    const SparseIndexEntry *entry = &node->index[index / SPARSE_INDEX_STRIDE];
+    cursor->segment = entry->segment;
+    cursor->offset = entry->offset;
+}
+
+static UA_Boolean
+cursorNext(FileHistoryNode *node, RecordCursor *cursor) {
+    const UA_Byte *map = getSegment(node, cursor->segment);
+    if(!map)
+        return false;
+    UA_UInt32 length;
+    memcpy(&length, &map[cursor->offset], 4);
+    cursor->offset += RECORD_HEADERSIZE + length;
+    while(cursor->segment < node->segmentsSize &&
+          cursor->offset >= node->segments[cursor->segment].size) {
+        cursor->segment++;
+        cursor->offset = SEGMENT_HEADERSIZE;
+    }
+    return (cursor->segment < node->segmentsSize);
+}
+
+static UA_Boolean
+seek(FileHistoryNode *node, size_t index, RecordCursor *cursor) {
+    if(index >= node->count)
+        return false;
+    cursorAt(node, index, cursor);
+    for(size_t i = 0; i < index % SPARSE_INDEX_STRIDE; i++) {
+        if(!cursorNext(node, cursor))
+            return false;
+    }
+    return true;
+}
+
+static UA_Boolean
+recordTimestamp(FileHistoryNode *node, const RecordCursor *cursor,
+                UA_DateTime *timestamp) {
+    const UA_Byte *map = getSegment(node, cursor->segment);
+    if(!map)
+        return false;
+    memcpy(timestamp, &map[cursor->offset + 8], 8);
+    return true;
+}
+
+static UA_StatusCode
+decodeRecord(FileHistoryNode *node, const RecordCursor *cursor, UA_DataValue *out) {
+    const UA_Byte *map = getSegment(node, cursor->segment);
+    if(!map)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    const UA_Byte *record = &map[cursor->offset];
+    UA_UInt32 length;
+    UA_DateTime timestamp;
+    memcpy(&length, record, 4);
+    memcpy(&timestamp, &record[8], 8);
+    UA_Byte flags = record[16];
+    UA_ByteString payload = {length, (UA_Byte*)(uintptr_t)&record[RECORD_HEADERSIZE]};
+    UA_StatusCode res =
+        UA_decodeBinary(&payload, out, &UA_TYPES[UA_TYPES_DATAVALUE], NULL);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    if(flags & RECORD_SOURCE_IS_KEY) {
+        out->hasSourceTimestamp = true;
+        out->sourceTimestamp = timestamp;
+    }
+    if(flags & RECORD_SERVER_IS_KEY) {
+        out->hasServerTimestamp = true;
+        out->serverTimestamp = timestamp;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Index of the first record that is not before the timestamp. Returns whether
+ * the timestamp of that record is equal. */
+static UA_Boolean
+lowerBound(FileHistoryNode *node, UA_DateTime timestamp, size_t *index) {
+    *index = node->count;
+    if(node->count == 0)
+        return false;
+
+    /* Find the first index entry that is not before the timestamp. Then scan
+     * from the previous index entry. */
+    size_t lo = 0;
+    size_t hi = node->indexSize;
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(node->index[mid].timestamp < timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t i = (lo > 0) ? (lo - 1) * SPARSE_INDEX_STRIDE : 0;
+    RecordCursor cursor;
+    cursorAt(node, i, &cursor);
+    for(; i < node->count; i++) {
+        UA_DateTime ts;
+        if(!recordTimestamp(node, &cursor, &ts))
+            return false;
+        if(ts >= timestamp) {
+            *index = i;
+            return (ts == timestamp);
+        }
+        if(i + 1 < node->count && !cursorNext(node, &cursor))
+            return false;
+    }
+    return false;
+}
+
+static UA_DateTime
+sampleTimestamp(const UA_DataValue *value) {
+    if(value->hasSourceTimestamp)
+        return value->sourceTimestamp;
+    if(value->hasServerTimestamp)
+        return value->serverTimestamp;
+    return UA_DateTime_now();
+}
+
+static UA_StatusCode
+appendRecord(UA_FileStoreContext *ctx, FileHistoryNode *node,
+             UA_DateTime timestamp, const UA_DataValue *value) {
+    if(node->count > 0 && timestamp < node->lastTimestamp)
+        return UA_STATUSCODE_BADINVALIDTIMESTAMP;
+
+    /* Don't repeat the key timestamp in the payload */
+    UA_DataValue dv = *value;
+    UA_Byte flags = 0;
+    if(!dv.hasServerTimestamp) {
+        dv.hasServerTimestamp = true;
+        dv.serverTimestamp = timestamp;
+    }
+    if(dv.hasSourceTimestamp && dv.sourceTimestamp == timestamp) {
+        dv.hasSourceTimestamp = false;
+        flags |= RECORD_SOURCE_IS_KEY;
+    }
+    if(dv.serverTimestamp == timestamp) {
+        dv.hasServerTimestamp = false;
+        flags |= RECORD_SERVER_IS_KEY;
+    }
+
+    size_t length = UA_calcSizeBinary(&dv, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    if(length == 0 || length > UA_UINT32_MAX - RECORD_HEADERSIZE)
+        return UA_STATUSCODE_BADENCODINGERROR;
+    UA_ByteString record;
+    UA_StatusCode res = UA_ByteString_allocBuffer(&record, RECORD_HEADERSIZE + length);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    UA_ByteString payload = {length, &record.data[RECORD_HEADERSIZE]};
+    res = UA_encodeBinary(&dv, &UA_TYPES[UA_TYPES_DATAVALUE], &payload);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_ByteString_clear(&record);
+        return res;
+    }
+    writeRecordHeader(record.data, (UA_UInt32)length, timestamp, flags);
+
+    /* Roll over to a new segment */
+    HistorySegment *seg = (node->segmentsSize > 0) ?
+        &node->segments[node->segmentsSize - 1] : NULL;
+    if(!seg || node->fd < 0 ||
+       (seg->count > 0 && seg->size + record.length > ctx->segmentSize)) {
+        res = addSegment(node);
+        if(res != UA_STATUSCODE_GOOD) {
+            UA_ByteString_clear(&record);
+            return res;
+        }
+        seg = &node->segments[node->segmentsSize - 1];
+    }
+
+    /* Append. Remove partial writes. */
+    size_t offset = seg->size;
+    ssize_t written = write(node->fd, record.data, record.length);
+    UA_ByteString_clear(&record);
+    if(written != (ssize_t)(RECORD_HEADERSIZE + length)) {
+        if(ftruncate(node->fd, (off_t)offset) != 0)
+            return UA_STATUSCODE_BADINTERNALERROR;
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+
+    if(node->count % SPARSE_INDEX_STRIDE == 0) {
+        res = addIndexEntry(node, timestamp, node->segmentsSize - 1, offset);
+        if(res != UA_STATUSCODE_GOOD) {
+            if(ftruncate(node->fd, (off_t)offset) != 0)
+                return UA_STATUSCODE_BADINTERNALERROR;
+            return res;
+        }
+    }
+    seg->size += RECORD_HEADERSIZE + length;
+    seg->count++;
+    node->count++;
+    node->lastTimestamp = timestamp;
+    return UA_STATUSCODE_GOOD;
+}
+
+/************************/
+/* Backend Entry Points */
+/************************/
+
+static UA_StatusCode
+serverSetHistoryData_backend_file(UA_Server *server,
+                                  void *context,
+                                  const UA_NodeId *sessionId,
+                                  void *sessionContext,
+                                  const UA_NodeId *nodeId,
+                                  UA_Boolean historizing,
+                                  const UA_DataValue *value) {
+    UA_FileStoreContext *ctx = (UA_FileStoreContext*)context;
+    FileHistoryNode *node = getNode(ctx, nodeId, true);
+    if(!node)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return appendRecord(ctx, node, sampleTimestamp(value), value);
+}
+
+static size_t
+getEnd_backend_file(UA_Server *server,
+                    void *context,
+                    const UA_NodeId *sessionId,
+                    void *sessionContext,
+                    const UA_NodeId *nodeId) {
+    const FileHistoryNode *node = getNode((UA_FileStoreContext*)context, nodeId, false);
+    return (node) ? node->count : 0;
+}
+
+static size_t
+lastIndex_backend_file(UA_Server *server,
+                       void *context,
+                       const UA_NodeId *sessionId,
+                       void *sessionContext,
+                       const UA_NodeId *nodeId) {
+    const FileHistoryNode *node = getNode((UA_FileStoreContext*)context, nodeId, false);
+    if(!node || node->count == 0)
+        return 0;
+    return node->count - 1;
+}
+
+static size_t
+firstIndex_backend_file(UA_Server *server,
+                        void *context,
+                        const UA_NodeId *sessionId,
+                        void *sessionContext,
+                        const UA_NodeId *nodeId) {
+    return 0;
+}
+
+static size_t
+resultSize_backend_file(UA_Server *server,
+                        void *context,
+                        const UA_NodeId *sessionId,
+                        void *sessionContext,
+                        const UA_NodeId *nodeId,
+                        size_t startIndex,
+                        size_t endIndex) {
+    const FileHistoryNode *node = getNode((UA_FileStoreContext*)context, nodeId, false);
+    if(!node || node->count == 0 ||
+       startIndex == node->count || endIndex == node->count)
+        return 0;
+    return endIndex - startIndex + 1;
+}
+
+static size_t
+getDateTimeMatch_backend_file(UA_Server *server,
+                              void *context,
+                              const UA_NodeId *sessionId,
+                              void *sessionContext,
+                              const UA_NodeId *nodeId,
+                              const UA_DateTime timestamp,
+                              const MatchStrategy strategy) {
+    FileHistoryNode *node = getNode((UA_FileStoreContext*)context, nodeId, false);
+    if(!node)
+        return 0;
+    size_t current;
+    UA_Boolean equal = lowerBound(node, timestamp, &current);
+    switch(strategy) {
+    case MATCH_EQUAL:
+        return (equal) ? current : node->count;
+    case MATCH_AFTER:
+        /* Skip all records with an equal timestamp */
+        if(equal) {
+            RecordCursor cursor;
+            UA_DateTime ts;
+            if(!seek(node, current, &cursor))
+                return node->count;
+            while(recordTimestamp(node, &cursor, &ts) && ts == timestamp) {
+                current++;
+                if(current == node->count || !cursorNext(node, &cursor))
+                    break;
+            }
+        }
+        return current;
+    case MATCH_EQUAL_OR_AFTER:
+        return current;
+    case MATCH_EQUAL_OR_BEFORE:
+        if(equal)
+            return current;
+        /* Fall through */
+    case MATCH_BEFORE:
+        return (current > 0) ? current - 1 : node->count;
+    default:
+        break;
+    }
+    return node->count;
+}
+
+static UA_Boolean
+boundSupported_backend_file(UA_Server *server,
+                            void *context,
+                            const UA_NodeId *sessionId,
+                            void *sessionContext,
+                            const UA_NodeId *nodeId) {
+    return true;
+}
+
+static UA_Boolean
+timestampsToReturnSupported_backend_file(UA_Server *server,
+                                         void *context,
+                                         const UA_NodeId *sessionId,
+                                         void *sessionContext,
+                                         const UA_NodeId *nodeId,
+                                         const UA_TimestampsToReturn timestampsToReturn) {
+    FileHistoryNode *node = getNode((UA_FileStoreContext*)context, nodeId, false);
+    if(!node || node->count == 0)
+        return true;
+    RecordCursor cursor;
+    UA_DataValue first;
+    cursorAt(node, 0, &cursor);
+    if(decodeRecord(node, &cursor, &first) != UA_STATUSCODE_GOOD)
+        return false;
+    UA_Boolean supported =
+        !(timestampsToReturn == UA_TIMESTAMPSTORETURN_NEITHER ||
+          timestampsToReturn == UA_TIMESTAMPSTORETURN_INVALID ||
+          (timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER &&
+           !first.hasServerTimestamp) ||
+          (timestampsToReturn == UA_TIMESTAMPSTORETURN_SOURCE &&
+           !first.hasSourceTimestamp) ||
+          (timestampsToReturn == UA_TIMESTAMPSTORETURN_BOTH &&
+           !(first.hasSourceTimestamp && first.hasServerTimestamp)));
+    UA_DataValue_clear(&first);
+    return supported;
+}
+
+static const UA_DataValue*
+getDataValue_backend_file(UA_Server *server,
+                          void *context,
+                          const UA_NodeId *sessionId,
+                          void *sessionContext,
+                          const UA_NodeId *nodeId,
+                          size_t index) {
+    FileHistoryNode *node = getNode((UA_FileStoreContext*)context, nodeId, false);
+    if(!node)
+        return NULL;
+    RecordCursor cursor;
+    if(!seek(node, index, &cursor))
+        return NULL;
+    /* Valid until the next call */
+    UA_DataValue_clear(&node->current);
+    if(decodeRecord(node, &cursor, &node->current) != UA_STATUSCODE_GOOD)
+        return NULL;
+    return &node->current;
+}
+
+static UA_StatusCode
+copyRecord(FileHistoryNode *node, const RecordCursor *cursor,
+           const UA_NumericRange range, UA_DataValue *out) {
+    UA_StatusCode res = decodeRecord(node, cursor, out);
+    if(res != UA_STATUSCODE_GOOD || range.dimensionsSize == 0)
+        return res;
+    UA_Variant full = out->value;
+    UA_Variant_init(&out->value);
+    if(out->hasValue)
+        res = UA_Variant_copyRange(&full, &out->value, range);
+    else
+        res = UA_STATUSCODE_BADDATAUNAVAILABLE;
+    UA_Variant_clear(&full);
+    return res;
+}
+
+static UA_StatusCode
+copyDataValues_backend_file(UA_Server *server,
+                            void *context,
+                            const UA_NodeId *sessionId,
+                            void *sessionContext,
+                            const UA_NodeId *nodeId,
+                            size_t startIndex,
+                            size_t endIndex,
+                            UA_Boolean reverse,
+                            size_t maxValues,
+                            UA_NumericRange range,
+                            UA_Boolean releaseContinuationPoints,
+                            const UA_ByteString *continuationPoint,
+                            UA_ByteString *outContinuationPoint,
+                            size_t *providedValues,
+                            UA_DataValue *values) {
+    size_t skip = 0;
+    if(continuationPoint->length > 0) {
+        if(continuationPoint->length != sizeof(size_t))
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        skip = *((size_t*)(continuationPoint->data));
+    }
+    FileHistoryNode *node = getNode((UA_FileStoreContext*)context, nodeId, false);
+    size_t storeEnd = (node) ? node->count : 0;
+    size_t counter = 0;
+    RecordCursor cursor;
+    if(reverse) {
+        size_t index = startIndex;
+        if(skip <= startIndex)
+            index -= skip;
+        else
+            index = storeEnd;
+        while(index >= endIndex && index < storeEnd && counter < maxValues) {
+            if(!seek(node, index, &cursor))
+                break;
+            copyRecord(node, &cursor, range, &values[counter]);
+            ++counter;
+            --index;
+        }
+    } else {
+        size_t index = startIndex + skip;
+        /* Walk the records sequentially */
+        UA_Boolean valid = (index <= endIndex && seek(node, index, &cursor));
+        while(valid && index <= endIndex && index < storeEnd && counter < maxValues) {
+            copyRecord(node, &cursor, range, &values[counter]);
+            ++counter;
+            ++index;
+            valid = (index < storeEnd && cursorNext(node, &cursor));
+        }
+    }
+
+    if(providedValues)
+        *providedValues = counter;
+
+    if((!reverse && (endIndex - startIndex - skip + 1) > counter) ||
+       (reverse && (startIndex - endIndex - skip + 1) > counter)) {
+        outContinuationPoint->data = (UA_Byte*)UA_malloc(sizeof(size_t));
+        if(!outContinuationPoint->data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        outContinuationPoint->length = sizeof(size_t);
+        *((size_t*)(outContinuationPoint->data)) = skip + counter;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+insertDataValue_backend_file(UA_Server *server,
+                             void *hdbContext,
+                             const UA_NodeId *sessionId,
+                             void *sessionContext,
+                             const UA_NodeId *nodeId,
+                             const UA_DataValue *value) {
+    if(!value->hasSourceTimestamp && !value->hasServerTimestamp)
+        return UA_STATUSCODE_BADINVALIDTIMESTAMP;
+    UA_FileStoreContext *ctx = (UA_FileStoreContext*)hdbContext;
+    FileHistoryNode *node = getNode(ctx, nodeId, true);
+    if(!node)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_DateTime timestamp = sampleTimestamp(value);
+    if(node->count > 0) {
+        if(timestamp == node->lastTimestamp)
+            return UA_STATUSCODE_BADENTRYEXISTS;
+        /* The log is append-only */
+        if(timestamp < node->lastTimestamp)
+            return UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+    }
+    return appendRecord(ctx, node, timestamp, value);
+}
+
+static void
+deleteMembers_backend_file(UA_HistoryDataBackend *backend) {
+    if(backend == NULL || backend->context == NULL)
+        return;
+    UA_FileStoreContext *ctx = (UA_FileStoreContext*)backend->context;
+    ZIP_ITER(FileHistoryNodeTree, &ctx->nodes, deleteNodeVisitor, NULL);
+    UA_free(ctx->path);
+    UA_free(ctx);
+    backend->context = NULL;
+}
+
+UA_HistoryDataBackend
+UA_HistoryDataBackend_File(const char *path, size_t segmentSize) {
+    UA_HistoryDataBackend result;
+    memset(&result, 0, sizeof(UA_HistoryDataBackend));
+    if(!path)
+        return result;
+    if(mkdir(path, 0755) != 0 && errno != EEXIST)
+        return result;
+    UA_FileStoreContext *ctx = (UA_FileStoreContext*)
+        UA_calloc(1, sizeof(UA_FileStoreContext));
+    if(!ctx)
+        return result;
+    size_t pathLen = strlen(path);
+    ctx->path = (char*)UA_malloc(pathLen + 1);
+    if(!ctx->path) {
+        UA_free(ctx);
+        return result;
+    }
+    memcpy(ctx->path, path, pathLen + 1);
+    ZIP_INIT(&ctx->nodes);
+    ctx->segmentSize = (segmentSize > 0) ?
+        segmentSize : UA_HISTORYDATABACKEND_FILE_SEGMENTSIZE;
+    result.serverSetHistoryData = &serverSetHistoryData_backend_file;
+    result.resultSize = &resultSize_backend_file;
+    result.getEnd = &getEnd_backend_file;
+    result.lastIndex = &lastIndex_backend_file;
+    result.firstIndex = &firstIndex_backend_file;
+    result.getDateTimeMatch = &getDateTimeMatch_backend_file;
+    result.copyDataValues = &copyDataValues_backend_file;
+    result.getDataValue = &getDataValue_backend_file;
+    result.boundSupported = &boundSupported_backend_file;
+    result.timestampsToReturnSupported = &timestampsToReturnSupported_backend_file;
+    result.insertDataValue = &insertDataValue_backend_file;
+    result.deleteMembers = &deleteMembers_backend_file;
+    result.context = ctx;
+    return result;
+}
+
+void
+UA_HistoryDataBackend_File_clear(UA_HistoryDataBackend *backend) {
+    deleteMembers_backend_file(backend);
+    memset(backend, 0, sizeof(UA_HistoryDataBackend));
+}
+
+#endif /* __linux__ */
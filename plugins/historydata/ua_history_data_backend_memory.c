@@ -9,8 +9,11 @@
 #include <open62541/plugin/historydata/history_data_backend_memory.h>
 
 #include <limits.h>
+#include <stddef.h>
 #include <string.h>
 
+#include "history_nodeid_index.h"
+
 typedef struct {
     UA_DateTime timestamp;
     UA_DataValue value;
@@ -46,6 +49,7 @@ typedef struct {
     size_t storeEnd;
     size_t storeSize;
     size_t initialStoreSize;
+    UA_NodeIdIndex index; /* Position in the dataStore by NodeId */
 } UA_MemoryStoreContext;
 
 static void
@@ -54,6 +58,7 @@ UA_MemoryStoreContext_clear(UA_MemoryStoreContext* ctx) {
         UA_NodeIdStoreContextItem_clear(&ctx->dataStore[i]);
     }
     UA_free(ctx->dataStore);
+    UA_NodeIdIndex_clear(&ctx->index);
     memset(ctx, 0, sizeof(UA_MemoryStoreContext));
 }
 
@@ -83,20 +88,36 @@ getNewNodeIdContext_backend_memory(UA_MemoryStoreContext* context,
     item->dataStore = store;
     item->storeSize = ctx->initialStoreSize;
     item->storeEnd = 0;
+    if (UA_NodeIdIndex_add(&ctx->index, nodeId, ctx->storeEnd) != UA_STATUSCODE_GOOD) {
+        UA_NodeIdStoreContextItem_clear(item);
+        return NULL;
+    }
     ++ctx->storeEnd;
     return item;
 }
 
+static UA_NodeIdStoreContextItem_backend_memory *
+findNodeIdStoreContextItem_backend_memory(UA_MemoryStoreContext* context,
+                                          const UA_NodeId *nodeId)
+{
+    size_t pos = UA_NodeIdIndex_find(&context->index, nodeId, context->dataStore,
+                                     sizeof(UA_NodeIdStoreContextItem_backend_memory),
+                                     offsetof(UA_NodeIdStoreContextItem_backend_memory,
+                                              nodeId));
+    if (pos == SIZE_MAX)
+        return NULL;
+    return &context->dataStore[pos];
+}
+
 static UA_NodeIdStoreContextItem_backend_memory *
 getNodeIdStoreContextItem_backend_memory(UA_MemoryStoreContext* context,
                                          UA_Server *server,
                                          const UA_NodeId *nodeId)
 {
-    for (size_t i = 0; i < context->storeEnd; ++i) {
-        if (UA_NodeId_equal(nodeId, &context->dataStore[i].nodeId)) {
-            return &context->dataStore[i];
-        }
-    }
+    UA_NodeIdStoreContextItem_backend_memory *item =
+        findNodeIdStoreContextItem_backend_memory(context, nodeId);
+    if (item)
+        return item;
     return getNewNodeIdContext_backend_memory(context, server, nodeId);
 }
 
@@ -236,12 +257,6 @@ serverSetHistoryData_backend_memory(UA_Server *server,
     return UA_STATUSCODE_GOOD;
 }
 
-static void
-UA_MemoryStoreContext_delete(UA_MemoryStoreContext* ctx) {
-    UA_MemoryStoreContext_clear(ctx);
-    UA_free(ctx);
-}
-
 static size_t
 getEnd_backend_memory(UA_Server *server,
                       void *context,
@@ -615,8 +630,8 @@ UA_HistoryDataBackend_Memory(size_t initialNodeIdStoreSize, size_t initialDataSt
 void
 UA_HistoryDataBackend_Memory_clear(UA_HistoryDataBackend *backend)
 {
-    UA_MemoryStoreContext *ctx = (UA_MemoryStoreContext*)backend->context;
-    UA_MemoryStoreContext_delete(ctx);
+    if(backend->deleteMembers)
+        backend->deleteMembers(backend);
     memset(backend, 0, sizeof(UA_HistoryDataBackend));
 }
 
@@ -640,6 +655,10 @@ getNewNodeIdContext_backend_memory_Circular(UA_MemoryStoreContext *context,
     item->dataStore = store;
     item->storeSize = ctx->initialStoreSize;
     item->storeEnd = 0;
+    if(UA_NodeIdIndex_add(&ctx->index, nodeId, ctx->storeEnd) != UA_STATUSCODE_GOOD) {
+        UA_NodeIdStoreContextItem_clear(item);
+        return NULL;
+    }
     ++ctx->storeEnd;
     return item;
 }
@@ -648,11 +667,10 @@ static UA_NodeIdStoreContextItem_backend_memory *
 getNodeIdStoreContextItem_backend_memory_Circular(UA_MemoryStoreContext *context,
                                                   UA_Server *server,
                                                   const UA_NodeId *nodeId) {
-    for(size_t i = 0; i < context->storeEnd; ++i) {
-        if(UA_NodeId_equal(nodeId, &context->dataStore[i].nodeId)) {
-            return &context->dataStore[i];
-        }
-    }
+    UA_NodeIdStoreContextItem_backend_memory *item =
+        findNodeIdStoreContextItem_backend_memory(context, nodeId);
+    if(item)
+        return item;
     return getNewNodeIdContext_backend_memory_Circular(context, server, nodeId);
 }
 
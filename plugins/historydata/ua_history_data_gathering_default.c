@@ -10,8 +10,11 @@
 #include <open62541/plugin/historydata/history_data_gathering_default.h>
 #include <open62541/plugin/historydata/history_database_default.h>
 
+#include <stddef.h>
 #include <string.h>
 
+#include "history_nodeid_index.h"
+
 typedef struct {
     UA_NodeId nodeId;
     UA_HistorizingNodeIdSettings setting;
@@ -22,8 +25,22 @@ typedef struct {
     UA_NodeIdStoreContextItem_gathering_default *dataStore;
     size_t storeEnd;
     size_t storeSize;
+    UA_NodeIdIndex index; /* Position in the dataStore by NodeId */
 } UA_NodeIdStoreContext;
 
+static UA_NodeIdStoreContextItem_gathering_default*
+getNodeIdStoreContextItem_gathering_default(UA_NodeIdStoreContext *context,
+                                            const UA_NodeId *nodeId)
+{
+    size_t pos = UA_NodeIdIndex_find(&context->index, nodeId, context->dataStore,
+                                     sizeof(UA_NodeIdStoreContextItem_gathering_default),
+                                     offsetof(UA_NodeIdStoreContextItem_gathering_default,
+                                              nodeId));
+    if (pos == SIZE_MAX)
+        return NULL;
+    return &context->dataStore[pos];
+}
+
 static void
 dataChangeCallback_gathering_default(UA_Server *server,
                                      UA_UInt32 monitoredItemId,
@@ -33,7 +50,12 @@ dataChangeCallback_gathering_default(UA_Server *server,
                                      UA_UInt32 attributeId,
                                      const UA_DataValue *value)
 {
-    UA_NodeIdStoreContextItem_gathering_default *context = (UA_NodeIdStoreContextItem_gathering_default*)monitoredItemContext;
+    /* The items are moved when the dataStore grows. Look them up again. */
+    UA_NodeIdStoreContextItem_gathering_default *context =
+        getNodeIdStoreContextItem_gathering_default((UA_NodeIdStoreContext*)monitoredItemContext,
+                                                    nodeId);
+    if (!context)
+        return;
     context->setting.historizingBackend.serverSetHistoryData(server,
                                                              context->setting.historizingBackend.context,
                                                              NULL,
@@ -43,20 +65,9 @@ dataChangeCallback_gathering_default(UA_Server *server,
                                                              value);
 }
 
-static UA_NodeIdStoreContextItem_gathering_default*
-getNodeIdStoreContextItem_gathering_default(UA_NodeIdStoreContext *context,
-                                            const UA_NodeId *nodeId)
-{
-    for (size_t i = 0; i < context->storeEnd; ++i) {
-        if (UA_NodeId_equal(&context->dataStore[i].nodeId, nodeId)) {
-            return &context->dataStore[i];
-        }
-    }
-    return NULL;
-}
-
 static UA_StatusCode
-startPoll(UA_Server *server, UA_NodeIdStoreContextItem_gathering_default *item)
+startPoll(UA_Server *server, UA_NodeIdStoreContext *ctx,
+          UA_NodeIdStoreContextItem_gathering_default *item)
 {
     UA_MonitoredItemCreateRequest monitorRequest =
             UA_MonitoredItemCreateRequest_default(item->nodeId);
@@ -66,7 +77,7 @@ startPoll(UA_Server *server, UA_NodeIdStoreContextItem_gathering_default *item)
             UA_Server_createDataChangeMonitoredItem(server,
                                                     UA_TIMESTAMPSTORETURN_BOTH,
                                                     monitorRequest,
-                                                    item,
+                                                    ctx,
                                                     &dataChangeCallback_gathering_default);
     return item->monitoredResult.statusCode;
 }
@@ -110,7 +121,25 @@ startPoll_gathering_default(UA_Server *server,
         return UA_STATUSCODE_BADNODEIDINVALID;
     if (item->monitoredResult.monitoredItemId > 0)
         return UA_STATUSCODE_BADMONITOREDITEMIDINVALID;
-    return startPoll(server, item);
+    return startPoll(server, ctx, item);
+}
+
+static UA_StatusCode
+addNodeIdStoreContextItem(UA_NodeIdStoreContext *ctx, const UA_NodeId *nodeId,
+                          const UA_HistorizingNodeIdSettings setting)
+{
+    UA_NodeIdStoreContextItem_gathering_default *item = &ctx->dataStore[ctx->storeEnd];
+    UA_StatusCode retval = UA_NodeId_copy(nodeId, &item->nodeId);
+    if (retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = UA_NodeIdIndex_add(&ctx->index, nodeId, ctx->storeEnd);
+    if (retval != UA_STATUSCODE_GOOD) {
+        UA_NodeId_clear(&item->nodeId);
+        return retval;
+    }
+    item->setting = setting;
+    ++ctx->storeEnd;
+    return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
@@ -133,11 +162,7 @@ registerNodeId_gathering_default(UA_Server *server,
         memset(&ctx->dataStore[ctx->storeSize], 0, (newStoreSize - ctx->storeSize) * sizeof(UA_NodeIdStoreContextItem_gathering_default));
         ctx->storeSize = newStoreSize;
     }
-    UA_NodeId_copy(nodeId, &ctx->dataStore[ctx->storeEnd].nodeId);
-    size_t current = ctx->storeEnd;
-    ctx->dataStore[current].setting = setting;
-    ++ctx->storeEnd;
-    return UA_STATUSCODE_GOOD;
+    return addNodeIdStoreContextItem(ctx, nodeId, setting);
 }
 
 static const UA_HistorizingNodeIdSettings*
@@ -166,6 +191,7 @@ deleteMembers_gathering_default(UA_HistoryDataGathering *gathering)
         UA_assert(ctx->dataStore[i].monitoredResult.monitoredItemId == 0);
     }
     UA_free(ctx->dataStore);
+    UA_NodeIdIndex_clear(&ctx->index);
     UA_free(gathering->context);
 }
 
@@ -210,12 +236,28 @@ setValue_gathering_default(UA_Server *server,
     }
 }
 
+static void
+setValues_gathering_default(UA_Server *server,
+                            void *context,
+                            const UA_NodeId *sessionId,
+                            void *sessionContext,
+                            size_t valuesSize,
+                            const UA_NodeId *nodeIds,
+                            const UA_Boolean *historizing,
+                            const UA_DataValue *values)
+{
+    for (size_t i = 0; i < valuesSize; ++i)
+        setValue_gathering_default(server, context, sessionId, sessionContext,
+                                   &nodeIds[i], historizing[i], &values[i]);
+}
+
 UA_HistoryDataGathering
 UA_HistoryDataGathering_Default(size_t initialNodeIdStoreSize)
 {
     UA_HistoryDataGathering gathering;
     memset(&gathering, 0, sizeof(UA_HistoryDataGathering));
     gathering.setValue = &setValue_gathering_default;
+    gathering.setValues = &setValues_gathering_default;
     gathering.getHistorizingSetting = &getHistorizingSetting_gathering_default;
     gathering.registerNodeId = &registerNodeId_gathering_default;
     gathering.startPoll = &startPoll_gathering_default;
@@ -243,11 +285,7 @@ registerNodeId_gathering_circular(UA_Server *server, void *context,
     if(ctx->storeEnd >= ctx->storeSize || !ctx->dataStore) {
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
-    UA_NodeId_copy(nodeId, &ctx->dataStore[ctx->storeEnd].nodeId);
-    size_t current = ctx->storeEnd;
-    ctx->dataStore[current].setting = setting;
-    ++ctx->storeEnd;
-    return UA_STATUSCODE_GOOD;
+    return addNodeIdStoreContextItem(ctx, nodeId, setting);
 }
 
 UA_HistoryDataGathering
@@ -8,10 +8,26 @@
 #include <open62541/plugin/historydata/history_data_gathering_default.h>
 #include <open62541/plugin/historydata/history_database_default.h>
 
+#include "ziptree.h"
+
 #include <limits.h>
 
+typedef struct EventNotifierHistory EventNotifierHistory;
+ZIP_HEAD(EventNotifierTree, EventNotifierHistory);
+ZIP_HEAD(EventOldestTree, EventNotifierHistory);
+
 typedef struct {
     UA_HistoryDataGathering gathering;
+
+    /* Event history */
+    struct EventNotifierTree notifiers;
+    struct EventOldestTree oldest; /* Notifiers with events, ordered by the time
+                                    * of their oldest event */
+    size_t eventsSize;
+    size_t encodedSize;
+    size_t maxEvents;
+    size_t maxEncodedSize;
+    UA_Duration maxAge;
 } UA_HistoryDatabaseContext_default;
 
 static size_t
@@ -578,6 +594,1087 @@ readRaw_service_default(UA_Server *server,
     return;
 }
 
+/**************/
+/* Aggregates */
+/**************/
+
+/* The aggregates are computed while stepping through the samples of the
+ * backend with getDataValue. Raw values are not copied into an intermediate
+ * array. Only scalar numeric values are aggregated. Samples with a bad status
+ * (and with an uncertain status if treatUncertainAsBad is set) are skipped.
+ * Interpolation is sloped between the usable samples around a timestamp and
+ * stepped after the last usable sample. */
+
+#define HISTORIAN_CALCULATED   (UA_STATUSCODE_INFOTYPE_DATAVALUE | 0x01)
+#define HISTORIAN_INTERPOLATED (UA_STATUSCODE_INFOTYPE_DATAVALUE | 0x02)
+
+typedef enum {
+    AGGREGATE_INTERPOLATIVE,
+    AGGREGATE_AVERAGE,
+    AGGREGATE_TIMEAVERAGE,
+    AGGREGATE_TOTAL,
+    AGGREGATE_MINIMUM,
+    AGGREGATE_MAXIMUM,
+    AGGREGATE_COUNT,
+    AGGREGATE_START,
+    AGGREGATE_END
+} Aggregate;
+
+static const struct {
+    UA_UInt32 id;
+    Aggregate aggregate;
+} supportedAggregates[] = {
+    {UA_NS0ID_AGGREGATEFUNCTION_INTERPOLATIVE, AGGREGATE_INTERPOLATIVE},
+    {UA_NS0ID_AGGREGATEFUNCTION_AVERAGE, AGGREGATE_AVERAGE},
+    {UA_NS0ID_AGGREGATEFUNCTION_TIMEAVERAGE, AGGREGATE_TIMEAVERAGE},
+    {UA_NS0ID_AGGREGATEFUNCTION_TOTAL, AGGREGATE_TOTAL},
+    {UA_NS0ID_AGGREGATEFUNCTION_MINIMUM, AGGREGATE_MINIMUM},
+    {UA_NS0ID_AGGREGATEFUNCTION_MAXIMUM, AGGREGATE_MAXIMUM},
+    {UA_NS0ID_AGGREGATEFUNCTION_COUNT, AGGREGATE_COUNT},
+    {UA_NS0ID_AGGREGATEFUNCTION_START, AGGREGATE_START},
+    {UA_NS0ID_AGGREGATEFUNCTION_END, AGGREGATE_END}
+};
+
+static UA_Boolean
+getAggregate(const UA_NodeId *aggregateType, Aggregate *aggregate) {
+    if(aggregateType->namespaceIndex != 0 ||
+       aggregateType->identifierType != UA_NODEIDTYPE_NUMERIC)
+        return false;
+    for(size_t i = 0; i < sizeof(supportedAggregates) / sizeof(supportedAggregates[0]); i++) {
+        if(supportedAggregates[i].id == aggregateType->identifier.numeric) {
+            *aggregate = supportedAggregates[i].aggregate;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    UA_Server *server;
+    const UA_HistoryDataBackend *backend;
+    const UA_NodeId *sessionId;
+    void *sessionContext;
+    const UA_NodeId *nodeId;
+    size_t firstIndex;
+    size_t storeEnd;
+    UA_AggregateConfiguration config;
+} AggregateContext;
+
+static const UA_DataValue *
+getSample(const AggregateContext *ac, size_t index) {
+    return ac->backend->getDataValue(ac->server, ac->backend->context, ac->sessionId,
+                                     ac->sessionContext, ac->nodeId, index);
+}
+
+static size_t
+matchSample(const AggregateContext *ac, UA_DateTime timestamp,
+            MatchStrategy strategy) {
+    return ac->backend->getDateTimeMatch(ac->server, ac->backend->context,
+                                         ac->sessionId, ac->sessionContext,
+                                         ac->nodeId, timestamp, strategy);
+}
+
+static UA_DateTime
+sampleTime(const UA_DataValue *dv) {
+    return (dv->hasSourceTimestamp) ? dv->sourceTimestamp : dv->serverTimestamp;
+}
+
+/* Returns whether the sample is used for the aggregates */
+static UA_Boolean
+usableSample(const AggregateContext *ac, const UA_DataValue *dv, UA_Double *value) {
+    if(!dv)
+        return false;
+    if(dv->hasStatus && (UA_StatusCode_isBad(dv->status) ||
+                         (UA_StatusCode_isUncertain(dv->status) &&
+                          ac->config.treatUncertainAsBad)))
+        return false;
+    if(!dv->hasValue || !UA_Variant_isScalar(&dv->value))
+        return false;
+    const void *data = dv->value.data;
+    switch(dv->value.type->typeKind) {
+    case UA_DATATYPEKIND_SBYTE: *value = *(const UA_SByte*)data; return true;
+    case UA_DATATYPEKIND_BYTE: *value = *(const UA_Byte*)data; return true;
+    case UA_DATATYPEKIND_INT16: *value = *(const UA_Int16*)data; return true;
+    case UA_DATATYPEKIND_UINT16: *value = *(const UA_UInt16*)data; return true;
+    case UA_DATATYPEKIND_INT32: *value = *(const UA_Int32*)data; return true;
+    case UA_DATATYPEKIND_UINT32: *value = *(const UA_UInt32*)data; return true;
+    case UA_DATATYPEKIND_INT64: *value = (UA_Double)*(const UA_Int64*)data; return true;
+    case UA_DATATYPEKIND_UINT64: *value = (UA_Double)*(const UA_UInt64*)data; return true;
+    case UA_DATATYPEKIND_FLOAT: *value = *(const UA_Float*)data; return true;
+    case UA_DATATYPEKIND_DOUBLE: *value = *(const UA_Double*)data; return true;
+    default: return false;
+    }
+}
+
+/* The value at the timestamp. Returns the raw index if there is a usable
+ * sample exactly at the timestamp. Otherwise storeEnd. */
+static UA_StatusCode
+interpolate(const AggregateContext *ac, UA_DateTime timestamp,
+            UA_Double *value, size_t *rawIndex) {
+    *rawIndex = ac->storeEnd;
+
+    /* The last usable sample up to the timestamp */
+    UA_Double v1 = 0.0;
+    UA_DateTime t1 = 0;
+    size_t index = matchSample(ac, timestamp, MATCH_EQUAL_OR_BEFORE);
+    while(index != ac->storeEnd) {
+        const UA_DataValue *dv = getSample(ac, index);
+        if(usableSample(ac, dv, &v1)) {
+            t1 = sampleTime(dv);
+            break;
+        }
+        index = (index == ac->firstIndex) ? ac->storeEnd : index - 1;
+    }
+    if(index == ac->storeEnd)
+        return UA_STATUSCODE_BADNODATA;
+    if(t1 == timestamp) {
+        *value = v1;
+        *rawIndex = index;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* The first usable sample after the timestamp */
+    UA_Double v2 = 0.0;
+    UA_DateTime t2 = 0;
+    for(index = matchSample(ac, timestamp, MATCH_AFTER);
+        index < ac->storeEnd; index++) {
+        const UA_DataValue *dv = getSample(ac, index);
+        if(usableSample(ac, dv, &v2)) {
+            t2 = sampleTime(dv);
+            break;
+        }
+    }
+
+    /* Stepped extrapolation after the last sample */
+    if(index >= ac->storeEnd) {
+        *value = v1;
+        return UA_STATUSCODE_UNCERTAINDATASUBNORMAL;
+    }
+    *value = v1 + (v2 - v1) * ((UA_Double)(timestamp - t1) / (UA_Double)(t2 - t1));
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Status of a calculated value from the share of usable samples. A
+ * percentDataBad of zero is not used. */
+static UA_StatusCode
+calculatedStatus(const AggregateContext *ac, size_t good, size_t total) {
+    if(good == 0)
+        return UA_STATUSCODE_BADNODATA;
+    size_t percentGood = (good * 100) / total;
+    if(ac->config.percentDataBad > 0 && 100 - percentGood >= ac->config.percentDataBad)
+        return UA_STATUSCODE_BADNODATA;
+    if(percentGood < ac->config.percentDataGood)
+        return UA_STATUSCODE_UNCERTAINDATASUBNORMAL | HISTORIAN_CALCULATED;
+    return UA_STATUSCODE_GOOD | HISTORIAN_CALCULATED;
+}
+
+static void
+setDouble(UA_DataValue *result, UA_Double value) {
+    UA_Variant_setScalarCopy(&result->value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    result->hasValue = true;
+}
+
+/* Compute the aggregate over [start, end). The timestamp of the result is
+ * the start of the interval, except for Start and End. */
+static void
+aggregateInterval(const AggregateContext *ac, Aggregate aggregate,
+                  UA_DateTime start, UA_DateTime end, UA_DataValue *result) {
+    result->hasStatus = true;
+    result->hasSourceTimestamp = true;
+    result->sourceTimestamp = start;
+
+    UA_Double value;
+    size_t rawIndex;
+    if(aggregate == AGGREGATE_INTERPOLATIVE) {
+        result->status = interpolate(ac, start, &value, &rawIndex);
+        if(UA_StatusCode_isBad(result->status))
+            return;
+        setDouble(result, value);
+        if(rawIndex == ac->storeEnd)
+            result->status |= HISTORIAN_INTERPOLATED;
+        return;
+    }
+
+    /* The time-weighted aggregates integrate from the interpolated value at
+     * the start of the interval */
+    UA_Boolean timeWeighted =
+        (aggregate == AGGREGATE_TIMEAVERAGE || aggregate == AGGREGATE_TOTAL);
+    UA_Boolean uncertain = false;
+    UA_Boolean hasPrev = false;
+    UA_DateTime prevTime = start;
+    UA_Double prevValue = 0.0;
+    UA_Double area = 0.0;
+    UA_DateTime covered = 0;
+    if(timeWeighted) {
+        UA_StatusCode res = interpolate(ac, start, &prevValue, &rawIndex);
+        hasPrev = !UA_StatusCode_isBad(res);
+        uncertain |= UA_StatusCode_isUncertain(res);
+    }
+
+    /* Stream over the samples in the interval */
+    size_t good = 0;
+    size_t total = 0;
+    UA_Double sum = 0.0;
+    UA_Double min = 0.0;
+    UA_Double max = 0.0;
+    size_t minIndex = ac->storeEnd;
+    size_t maxIndex = ac->storeEnd;
+    size_t firstIndex = ac->storeEnd;
+    size_t lastIndex = ac->storeEnd;
+    for(size_t index = matchSample(ac, start, MATCH_EQUAL_OR_AFTER);
+        index < ac->storeEnd; index++) {
+        const UA_DataValue *dv = getSample(ac, index);
+        if(!dv)
+            break;
+        UA_DateTime t = sampleTime(dv);
+        if(t >= end)
+            break;
+        total++;
+        if(!usableSample(ac, dv, &value))
+            continue;
+        good++;
+        sum += value;
+        if(minIndex == ac->storeEnd || value < min) {
+            min = value;
+            minIndex = index;
+        }
+        if(maxIndex == ac->storeEnd || value > max) {
+            max = value;
+            maxIndex = index;
+        }
+        if(firstIndex == ac->storeEnd)
+            firstIndex = index;
+        lastIndex = index;
+        if(timeWeighted) {
+            if(hasPrev) {
+                area += (UA_Double)(t - prevTime) * (prevValue + value) / 2.0;
+                covered += t - prevTime;
+            }
+            hasPrev = true;
+            prevTime = t;
+            prevValue = value;
+        }
+    }
+
+    switch(aggregate) {
+    case AGGREGATE_COUNT: {
+        UA_Int32 count = (UA_Int32)good;
+        UA_Variant_setScalarCopy(&result->value, &count, &UA_TYPES[UA_TYPES_INT32]);
+        result->hasValue = true;
+        result->status = (good == total) ? UA_STATUSCODE_GOOD :
+            UA_STATUSCODE_UNCERTAINDATASUBNORMAL;
+        result->status |= HISTORIAN_CALCULATED;
+        return;
+    }
+    case AGGREGATE_AVERAGE:
+        result->status = calculatedStatus(ac, good, total);
+        if(good > 0)
+            setDouble(result, sum / (UA_Double)good);
+        return;
+    case AGGREGATE_MINIMUM:
+    case AGGREGATE_MAXIMUM: {
+        result->status = calculatedStatus(ac, good, total);
+        if(good == 0)
+            return;
+        const UA_DataValue *dv = getSample(ac, (aggregate == AGGREGATE_MINIMUM) ?
+                                           minIndex : maxIndex);
+        if(!dv || UA_Variant_copy(&dv->value, &result->value) != UA_STATUSCODE_GOOD) {
+            result->status = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        result->hasValue = true;
+        return;
+    }
+    case AGGREGATE_START:
+    case AGGREGATE_END: {
+        if(good == 0) {
+            result->status = UA_STATUSCODE_BADNODATA;
+            return;
+        }
+        /* The raw sample with its own timestamp and status */
+        const UA_DataValue *dv = getSample(ac, (aggregate == AGGREGATE_START) ?
+                                           firstIndex : lastIndex);
+        if(!dv || UA_Variant_copy(&dv->value, &result->value) != UA_STATUSCODE_GOOD) {
+            result->status = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        result->hasValue = true;
+        result->sourceTimestamp = sampleTime(dv);
+        result->status = (dv->hasStatus) ? dv->status : UA_STATUSCODE_GOOD;
+        return;
+    }
+    default:
+        break;
+    }
+
+    /* Close the integral at the end of the interval */
+    if(hasPrev) {
+        UA_StatusCode res = interpolate(ac, end, &value, &rawIndex);
+        if(!UA_StatusCode_isBad(res)) {
+            area += (UA_Double)(end - prevTime) * (prevValue + value) / 2.0;
+            covered += end - prevTime;
+            uncertain |= UA_StatusCode_isUncertain(res);
+        }
+    }
+    if(covered == 0) {
+        result->status = UA_STATUSCODE_BADNODATA;
+        return;
+    }
+    UA_Double timeAverage = area / (UA_Double)covered;
+    if(covered < end - start || good < total)
+        uncertain = true;
+    result->status = (uncertain) ? UA_STATUSCODE_UNCERTAINDATASUBNORMAL : UA_STATUSCODE_GOOD;
+    result->status |= HISTORIAN_CALCULATED;
+    if(aggregate == AGGREGATE_TIMEAVERAGE)
+        setDouble(result, timeAverage);
+    else
+        setDouble(result, timeAverage * (UA_Double)(end - start) / (UA_Double)UA_DATETIME_SEC);
+}
+
+static void
+setResultTimestamps(UA_DataValue *result, UA_TimestampsToReturn timestampsToReturn) {
+    if(timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER ||
+       timestampsToReturn == UA_TIMESTAMPSTORETURN_BOTH) {
+        result->hasServerTimestamp = true;
+        result->serverTimestamp = result->sourceTimestamp;
+    }
+    if(timestampsToReturn == UA_TIMESTAMPSTORETURN_SERVER ||
+       timestampsToReturn == UA_TIMESTAMPSTORETURN_NEITHER) {
+        result->hasSourceTimestamp = false;
+        result->sourceTimestamp = 0;
+    }
+}
+
+/* Checks the access to the history of the node */
+static const UA_HistorizingNodeIdSettings *
+getReadSetting(UA_Server *server, UA_HistoryDatabaseContext_default *ctx,
+               const UA_NodeId *nodeId, UA_StatusCode *status) {
+    UA_Byte accessLevel = 0;
+    UA_Server_readAccessLevel(server, *nodeId, &accessLevel);
+    if(!(accessLevel & UA_ACCESSLEVELMASK_HISTORYREAD)) {
+        *status = UA_STATUSCODE_BADUSERACCESSDENIED;
+        return NULL;
+    }
+    UA_Boolean historizing = false;
+    UA_Server_readHistorizing(server, *nodeId, &historizing);
+    const UA_HistorizingNodeIdSettings *setting = (historizing) ?
+        ctx->gathering.getHistorizingSetting(server, ctx->gathering.context, nodeId) : NULL;
+    if(!setting)
+        *status = UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+    return setting;
+}
+
+static void
+initAggregateContext(AggregateContext *ac, UA_Server *server,
+                     const UA_HistorizingNodeIdSettings *setting,
+                     const UA_NodeId *sessionId, void *sessionContext,
+                     const UA_NodeId *nodeId) {
+    memset(ac, 0, sizeof(AggregateContext));
+    ac->server = server;
+    ac->backend = &setting->historizingBackend;
+    ac->sessionId = sessionId;
+    ac->sessionContext = sessionContext;
+    ac->nodeId = nodeId;
+    ac->storeEnd = ac->backend->getEnd(server, ac->backend->context, sessionId,
+                                       sessionContext, nodeId);
+    ac->firstIndex = ac->backend->firstIndex(server, ac->backend->context, sessionId,
+                                             sessionContext, nodeId);
+    ac->config.treatUncertainAsBad = true;
+    ac->config.percentDataBad = 100;
+    ac->config.percentDataGood = 100;
+}
+
+/* The continuation point holds the number of results already returned. The
+ * results of a request are limited to maxHistoryDataResponseSize. */
+static UA_StatusCode
+getResultRange(const UA_ByteString *continuationPoint, size_t resultsSize,
+               size_t maxSize, size_t *first, size_t *count) {
+    *first = 0;
+    if(continuationPoint->length > 0) {
+        if(continuationPoint->length != sizeof(size_t))
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        *first = *((size_t*)continuationPoint->data);
+        if(*first > resultsSize)
+            return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    }
+    *count = resultsSize - *first;
+    if(*count > maxSize)
+        *count = maxSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+setContinuationPoint(UA_ByteString *continuationPoint, size_t next) {
+    UA_StatusCode res = UA_ByteString_allocBuffer(continuationPoint, sizeof(size_t));
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    *((size_t*)continuationPoint->data) = next;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+readProcessed_service_default(UA_Server *server,
+                              void *context,
+                              const UA_NodeId *sessionId,
+                              void *sessionContext,
+                              const UA_RequestHeader *requestHeader,
+                              const UA_ReadProcessedDetails *historyReadDetails,
+                              UA_TimestampsToReturn timestampsToReturn,
+                              UA_Boolean releaseContinuationPoints,
+                              size_t nodesToReadSize,
+                              const UA_HistoryReadValueId *nodesToRead,
+                              UA_HistoryReadResponse *response,
+                              UA_HistoryData * const * const historyData)
+{
+    if(historyReadDetails->aggregateTypeSize != nodesToReadSize) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADAGGREGATELISTMISMATCH;
+        return;
+    }
+    response->responseHeader.serviceResult = UA_STATUSCODE_GOOD;
+    if(releaseContinuationPoints)
+        return; /* The continuation points hold no state */
+
+    /* The processing intervals. Without a processing interval, there is a
+     * single interval. With the end time before the start time, the intervals
+     * go backwards from the start time. */
+    UA_DateTime startTime = historyReadDetails->startTime;
+    UA_DateTime endTime = historyReadDetails->endTime;
+    UA_Boolean reverse = (endTime < startTime);
+    UA_DateTime span = (reverse) ? startTime - endTime : endTime - startTime;
+    UA_DateTime interval = (UA_DateTime)
+        (historyReadDetails->processingInterval * UA_DATETIME_MSEC);
+    if(historyReadDetails->processingInterval == 0.0)
+        interval = span;
+    UA_StatusCode intervalRes = UA_STATUSCODE_GOOD;
+    if(span == 0 || !(historyReadDetails->processingInterval >= 0.0) || interval <= 0)
+        intervalRes = UA_STATUSCODE_BADINVALIDARGUMENT;
+    size_t intervalsSize = (intervalRes == UA_STATUSCODE_GOOD) ?
+        (size_t)((span + interval - 1) / interval) : 0;
+
+    UA_HistoryDatabaseContext_default *ctx = (UA_HistoryDatabaseContext_default*)context;
+    for(size_t i = 0; i < nodesToReadSize; ++i) {
+        UA_HistoryReadResult *result = &response->results[i];
+        if(intervalRes != UA_STATUSCODE_GOOD) {
+            result->statusCode = intervalRes;
+            continue;
+        }
+
+        Aggregate aggregate;
+        if(!getAggregate(&historyReadDetails->aggregateType[i], &aggregate)) {
+            result->statusCode = UA_STATUSCODE_BADAGGREGATENOTSUPPORTED;
+            continue;
+        }
+
+        const UA_HistorizingNodeIdSettings *setting =
+            getReadSetting(server, ctx, &nodesToRead[i].nodeId, &result->statusCode);
+        if(!setting)
+            continue;
+
+        size_t first;
+        size_t count;
+        result->statusCode =
+            getResultRange(&nodesToRead[i].continuationPoint, intervalsSize,
+                           setting->maxHistoryDataResponseSize, &first, &count);
+        if(result->statusCode != UA_STATUSCODE_GOOD)
+            continue;
+
+        UA_DataValue *values = (UA_DataValue*)
+            UA_Array_new(count, &UA_TYPES[UA_TYPES_DATAVALUE]);
+        if(!values) {
+            result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+            continue;
+        }
+        historyData[i]->dataValues = values;
+        historyData[i]->dataValuesSize = count;
+
+        AggregateContext ac;
+        initAggregateContext(&ac, server, setting, sessionId, sessionContext,
+                             &nodesToRead[i].nodeId);
+        if(!historyReadDetails->aggregateConfiguration.useServerCapabilitiesDefaults)
+            ac.config = historyReadDetails->aggregateConfiguration;
+
+        for(size_t j = 0; j < count; j++) {
+            UA_DateTime offset = (UA_DateTime)(first + j) * interval;
+            UA_DateTime lo, hi;
+            if(!reverse) {
+                lo = startTime + offset;
+                hi = (span - offset > interval) ? lo + interval : endTime;
+            } else {
+                hi = startTime - offset;
+                lo = (span - offset > interval) ? hi - interval : endTime;
+            }
+            aggregateInterval(&ac, aggregate, lo, hi, &values[j]);
+            setResultTimestamps(&values[j], timestampsToReturn);
+        }
+
+        if(first + count < intervalsSize)
+            result->statusCode = setContinuationPoint(&result->continuationPoint,
+                                                      first + count);
+    }
+}
+
+static void
+readAtTime_service_default(UA_Server *server,
+                           void *context,
+                           const UA_NodeId *sessionId,
+                           void *sessionContext,
+                           const UA_RequestHeader *requestHeader,
+                           const UA_ReadAtTimeDetails *historyReadDetails,
+                           UA_TimestampsToReturn timestampsToReturn,
+                           UA_Boolean releaseContinuationPoints,
+                           size_t nodesToReadSize,
+                           const UA_HistoryReadValueId *nodesToRead,
+                           UA_HistoryReadResponse *response,
+                           UA_HistoryData * const * const historyData)
+{
+    response->responseHeader.serviceResult = UA_STATUSCODE_GOOD;
+    if(releaseContinuationPoints)
+        return;
+
+    UA_HistoryDatabaseContext_default *ctx = (UA_HistoryDatabaseContext_default*)context;
+    for(size_t i = 0; i < nodesToReadSize; ++i) {
+        UA_HistoryReadResult *result = &response->results[i];
+        const UA_HistorizingNodeIdSettings *setting =
+            getReadSetting(server, ctx, &nodesToRead[i].nodeId, &result->statusCode);
+        if(!setting)
+            continue;
+
+        size_t first;
+        size_t count;
+        result->statusCode =
+            getResultRange(&nodesToRead[i].continuationPoint,
+                           historyReadDetails->reqTimesSize,
+                           setting->maxHistoryDataResponseSize, &first, &count);
+        if(result->statusCode != UA_STATUSCODE_GOOD)
+            continue;
+
+        UA_DataValue *values = (UA_DataValue*)
+            UA_Array_new(count, &UA_TYPES[UA_TYPES_DATAVALUE]);
+        if(!values) {
+            result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+            continue;
+        }
+        historyData[i]->dataValues = values;
+        historyData[i]->dataValuesSize = count;
+
+        /* Raw values are returned as they are. Values in between are
+         * interpolated from the usable samples around them. */
+        AggregateContext ac;
+        initAggregateContext(&ac, server, setting, sessionId, sessionContext,
+                             &nodesToRead[i].nodeId);
+        for(size_t j = 0; j < count; j++) {
+            UA_DateTime t = historyReadDetails->reqTimes[first + j];
+            UA_DataValue *value = &values[j];
+            UA_Double d;
+            size_t rawIndex;
+            UA_StatusCode res = interpolate(&ac, t, &d, &rawIndex);
+            if(rawIndex != ac.storeEnd) {
+                const UA_DataValue *dv = getSample(&ac, rawIndex);
+                if(dv)
+                    UA_DataValue_copy(dv, value);
+                value->serverTimestamp = 0;
+                value->hasServerTimestamp = false;
+            } else {
+                value->hasStatus = true;
+                value->status = res;
+                if(!UA_StatusCode_isBad(res)) {
+                    value->status |= HISTORIAN_INTERPOLATED;
+                    setDouble(value, d);
+                }
+            }
+            value->hasSourceTimestamp = true;
+            value->sourceTimestamp = t;
+            setResultTimestamps(value, timestampsToReturn);
+        }
+
+        if(first + count < historyReadDetails->reqTimesSize)
+            result->statusCode = setContinuationPoint(&result->continuationPoint,
+                                                      first + count);
+    }
+}
+
+/*****************/
+/* Event History */
+/*****************/
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+
+/* The events are stored for each notifier node in the order of their Time
+ * field. The fields selected by the HistoricalEventFilter of the notifier are
+ * kept as a binary-encoded EventFieldList. The select-clauses are stored once
+ * per notifier, so that the fields can still be interpreted after the
+ * HistoricalEventFilter was changed. */
+
+typedef struct {
+    size_t selectSize;
+    UA_SimpleAttributeOperand *select;
+} EventLayout;
+
+typedef struct {
+    UA_DateTime time;
+    size_t layout;         /* Index in the layouts of the notifier */
+    UA_ByteString encoded; /* Binary-encoded EventFieldList */
+} StoredEvent;
+
+struct EventNotifierHistory {
+    ZIP_ENTRY(EventNotifierHistory) zipfields;
+    ZIP_ENTRY(EventNotifierHistory) oldestfields;
+    UA_DateTime oldestTime; /* Time of the first event */
+    UA_UInt32 nodeIdHash;
+    UA_NodeId nodeId;
+    size_t layoutsSize;
+    EventLayout *layouts;
+    size_t first; /* The events are at [first, first + eventsSize) */
+    size_t eventsSize;
+    size_t eventsCapacity;
+    StoredEvent *events;
+};
+
+static enum ZIP_CMP
+cmpEventNotifier(const void *a, const void *b) {
+    const EventNotifierHistory *aa = (const EventNotifierHistory*)a;
+    const EventNotifierHistory *bb = (const EventNotifierHistory*)b;
+    if(aa->nodeIdHash < bb->nodeIdHash)
+        return ZIP_CMP_LESS;
+    if(aa->nodeIdHash > bb->nodeIdHash)
+        return ZIP_CMP_MORE;
+    return (enum ZIP_CMP)UA_NodeId_order(&aa->nodeId, &bb->nodeId);
+}
+
+ZIP_FUNCTIONS(EventNotifierTree, EventNotifierHistory, zipfields,
+              EventNotifierHistory, zipfields, cmpEventNotifier)
+
+static enum ZIP_CMP
+cmpEventTime(const void *a, const void *b) {
+    const UA_DateTime aa = *(const UA_DateTime*)a;
+    const UA_DateTime bb = *(const UA_DateTime*)b;
+    if(aa < bb)
+        return ZIP_CMP_LESS;
+    if(aa > bb)
+        return ZIP_CMP_MORE;
+    return ZIP_CMP_EQ;
+}
+
+ZIP_FUNCTIONS(EventOldestTree, EventNotifierHistory, oldestfields,
+              UA_DateTime, oldestTime, cmpEventTime)
+
+static EventNotifierHistory *
+findNotifier(UA_HistoryDatabaseContext_default *ctx, const UA_NodeId *nodeId) {
+    EventNotifierHistory dummy;
+    dummy.nodeIdHash = UA_NodeId_hash(nodeId);
+    dummy.nodeId = *nodeId;
+    return ZIP_FIND(EventNotifierTree, &ctx->notifiers, &dummy);
+}
+
+static EventNotifierHistory *
+findOrAddNotifier(UA_HistoryDatabaseContext_default *ctx, const UA_NodeId *nodeId) {
+    EventNotifierHistory *notifier = findNotifier(ctx, nodeId);
+    if(notifier)
+        return notifier;
+    notifier = (EventNotifierHistory*)UA_calloc(1, sizeof(EventNotifierHistory));
+    if(!notifier)
+        return NULL;
+    if(UA_NodeId_copy(nodeId, &notifier->nodeId) != UA_STATUSCODE_GOOD) {
+        UA_free(notifier);
+        return NULL;
+    }
+    notifier->nodeIdHash = UA_NodeId_hash(nodeId);
+    ZIP_INSERT(EventNotifierTree, &ctx->notifiers, notifier);
+    return notifier;
+}
+
+static void *
+deleteNotifierVisitor(void *context, EventNotifierHistory *notifier) {
+    for(size_t i = 0; i < notifier->eventsSize; i++)
+        UA_ByteString_clear(&notifier->events[notifier->first + i].encoded);
+    UA_free(notifier->events);
+    for(size_t i = 0; i < notifier->layoutsSize; i++)
+        UA_Array_delete(notifier->layouts[i].select, notifier->layouts[i].selectSize,
+                        &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]);
+    UA_free(notifier->layouts);
+    UA_NodeId_clear(&notifier->nodeId);
+    UA_free(notifier);
+    return NULL;
+}
+
+/* Returns the index of the layout for the select-clauses or SIZE_MAX */
+static size_t
+getLayout(EventNotifierHistory *notifier, const UA_EventFilter *filter) {
+    /* Search backwards. Usually the last layout is used. */
+    for(size_t i = notifier->layoutsSize; i > 0; i--) {
+        const EventLayout *layout = &notifier->layouts[i - 1];
+        if(layout->selectSize != filter->selectClausesSize)
+            continue;
+        size_t j = 0;
+        for(; j < layout->selectSize; j++) {
+            if(UA_order(&layout->select[j], &filter->selectClauses[j],
+                        &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]) != UA_ORDER_EQ)
+                break;
+        }
+        if(j == layout->selectSize)
+            return i - 1;
+    }
+
+    EventLayout *layouts = (EventLayout*)
+        UA_realloc(notifier->layouts, sizeof(EventLayout) * (notifier->layoutsSize + 1));
+    if(!layouts)
+        return SIZE_MAX;
+    notifier->layouts = layouts;
+    EventLayout *layout = &layouts[notifier->layoutsSize];
+    UA_StatusCode res =
+        UA_Array_copy(filter->selectClauses, filter->selectClausesSize,
+                      (void**)&layout->select,
+                      &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]);
+    if(res != UA_STATUSCODE_GOOD)
+        return SIZE_MAX;
+    layout->selectSize = filter->selectClausesSize;
+    return notifier->layoutsSize++;
+}
+
+static const UA_QualifiedName timeName = {0, {4, (UA_Byte*)"Time"}};
+
+/* The events are ordered by their Time field. Events without the field are
+ * stored with the time they are recorded. */
+static UA_DateTime
+getEventTime(const EventLayout *layout, const UA_EventFieldList *fieldList) {
+    for(size_t i = 0; i < layout->selectSize && i < fieldList->eventFieldsSize; i++) {
+        const UA_SimpleAttributeOperand *sao = &layout->select[i];
+        if(sao->attributeId == UA_ATTRIBUTEID_VALUE && sao->browsePathSize == 1 &&
+           UA_QualifiedName_equal(&sao->browsePath[0], &timeName) &&
+           UA_Variant_isScalar(&fieldList->eventFields[i]) &&
+           fieldList->eventFields[i].type->typeKind == UA_DATATYPEKIND_DATETIME)
+            return *(UA_DateTime*)fieldList->eventFields[i].data; /* Also UtcTime */
+    }
+    return UA_DateTime_now();
+}
+
+/* Index of the first event with a time >= (or > for upper) the timestamp.
+ * Relative to notifier->first. */
+static size_t
+eventBound(const EventNotifierHistory *notifier, UA_DateTime time, UA_Boolean upper) {
+    const StoredEvent *events = &notifier->events[notifier->first];
+    size_t lo = 0, hi = notifier->eventsSize;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(events[mid].time < time || (upper && events[mid].time == time))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static UA_StatusCode
+insertEvent(EventNotifierHistory *notifier, const StoredEvent *event) {
+    /* Make room at the end */
+    if(notifier->first + notifier->eventsSize == notifier->eventsCapacity) {
+        if(notifier->first > notifier->eventsSize) {
+            memmove(notifier->events, &notifier->events[notifier->first],
+                    sizeof(StoredEvent) * notifier->eventsSize);
+            notifier->first = 0;
+        } else {
+            size_t capacity = (notifier->eventsCapacity > 0) ?
+                notifier->eventsCapacity * 2 : 16;
+            StoredEvent *events = (StoredEvent*)
+                UA_realloc(notifier->events, sizeof(StoredEvent) * capacity);
+            if(!events)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            notifier->events = events;
+            notifier->eventsCapacity = capacity;
+        }
+    }
+
+    /* Events usually arrive in time order and are appended */
+    size_t pos = notifier->eventsSize;
+    StoredEvent *events = &notifier->events[notifier->first];
+    if(pos > 0 && events[pos - 1].time > event->time) {
+        pos = eventBound(notifier, event->time, true);
+        memmove(&events[pos + 1], &events[pos],
+                sizeof(StoredEvent) * (notifier->eventsSize - pos));
+    }
+    events[pos] = *event;
+    notifier->eventsSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Remove the oldest events over all notifiers until the store is within its
+ * limits again. The notifier with the oldest event is the minimum of the
+ * oldest-tree. */
+static void
+enforceEventLimits(UA_HistoryDatabaseContext_default *ctx) {
+    UA_DateTime minTime = (ctx->maxAge > 0.0) ?
+        UA_DateTime_now() - (UA_DateTime)(ctx->maxAge * UA_DATETIME_MSEC) : 0;
+    while(ctx->eventsSize > 0) {
+        UA_Boolean withinSize =
+            (ctx->maxEvents == 0 || ctx->eventsSize <= ctx->maxEvents) &&
+            (ctx->maxEncodedSize == 0 || ctx->encodedSize <= ctx->maxEncodedSize);
+        if(withinSize && ctx->maxAge <= 0.0)
+            break;
+        EventNotifierHistory *oldest = ZIP_MIN(EventOldestTree, &ctx->oldest);
+        if(withinSize && oldest->oldestTime >= minTime)
+            break;
+
+        /* Remove the event and reinsert the notifier with its next event */
+        ZIP_REMOVE(EventOldestTree, &ctx->oldest, oldest);
+        StoredEvent *event = &oldest->events[oldest->first];
+        ctx->eventsSize--;
+        ctx->encodedSize -= event->encoded.length;
+        UA_ByteString_clear(&event->encoded);
+        oldest->first++;
+        oldest->eventsSize--;
+        if(oldest->eventsSize == 0) {
+            oldest->first = 0;
+            continue;
+        }
+        oldest->oldestTime = oldest->events[oldest->first].time;
+        ZIP_INSERT(EventOldestTree, &ctx->oldest, oldest);
+    }
+}
+
+static void
+setEvent_service_default(UA_Server *server,
+                         void *context,
+                         const UA_NodeId *originId,
+                         const UA_NodeId *emitterId,
+                         const UA_EventFilter *historicalEventFilter,
+                         UA_EventFieldList *fieldList)
+{
+    UA_HistoryDatabaseContext_default *ctx = (UA_HistoryDatabaseContext_default*)context;
+    if(!historicalEventFilter)
+        return;
+    EventNotifierHistory *notifier = findOrAddNotifier(ctx, emitterId);
+    if(!notifier)
+        return;
+
+    StoredEvent event;
+    event.layout = getLayout(notifier, historicalEventFilter);
+    if(event.layout == SIZE_MAX)
+        return;
+    event.time = getEventTime(&notifier->layouts[event.layout], fieldList);
+
+    /* The ClientHandle is not used for the history */
+    UA_EventFieldList efl = *fieldList;
+    efl.clientHandle = 0;
+    UA_ByteString_init(&event.encoded);
+    UA_StatusCode res = UA_encodeBinary(&efl, &UA_TYPES[UA_TYPES_EVENTFIELDLIST],
+                                        &event.encoded);
+    if(res != UA_STATUSCODE_GOOD)
+        return;
+    UA_Boolean hadEvents = (notifier->eventsSize > 0);
+    res = insertEvent(notifier, &event);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_ByteString_clear(&event.encoded);
+        return;
+    }
+
+    /* Reposition the notifier in the oldest-tree if the event is its oldest */
+    if(!hadEvents || event.time < notifier->oldestTime) {
+        if(hadEvents)
+            ZIP_REMOVE(EventOldestTree, &ctx->oldest, notifier);
+        notifier->oldestTime = event.time;
+        ZIP_INSERT(EventOldestTree, &ctx->oldest, notifier);
+    }
+    ctx->eventsSize++;
+    ctx->encodedSize += event.encoded.length;
+    enforceEventLimits(ctx);
+}
+
+#define EVENT_BATCHSIZE 64
+
+/* The continuation point holds the time of the next event to be read and the
+ * number of events with the same time that were already read. This remains
+ * valid when older events are removed from the store. */
+typedef struct {
+    UA_DateTime time;
+    size_t skip;
+} EventContinuationPoint;
+
+/* Filters the events between the indices [begin, end) (forward or reverse) and
+ * appends the matching events to the result. Returns the index of the next
+ * event that was not read. */
+static UA_StatusCode
+readEvents(UA_Server *server, EventNotifierHistory *notifier,
+           const UA_EventFilter *filter, UA_Boolean reverse,
+           size_t begin, size_t end, size_t maxEvents,
+           UA_HistoryEvent *historyEvent, size_t *next) {
+    StoredEvent *events = &notifier->events[notifier->first];
+    UA_EventFieldList decoded[EVENT_BATCHSIZE];
+    UA_EventFieldList filtered[EVENT_BATCHSIZE];
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    *next = (reverse) ? end : begin;
+    while(begin < end && res == UA_STATUSCODE_GOOD) {
+        /* Decode a batch of events recorded with the same layout */
+        size_t batchSize = 0;
+        size_t layout = events[(reverse) ? end - 1 : begin].layout;
+        while(batchSize < EVENT_BATCHSIZE && begin < end) {
+            StoredEvent *event = &events[(reverse) ? end - 1 : begin];
+            if(event->layout != layout)
+                break;
+            res = UA_decodeBinary(&event->encoded, &decoded[batchSize],
+                                  &UA_TYPES[UA_TYPES_EVENTFIELDLIST], NULL);
+            if(res != UA_STATUSCODE_GOOD)
+                break;
+            batchSize++;
+            if(reverse)
+                end--;
+            else
+                begin++;
+        }
+
+        /* Filter the batch. The results are initialized also if the
+         * filtering fails. */
+        if(res != UA_STATUSCODE_GOOD) {
+            for(size_t j = 0; j < batchSize; j++)
+                UA_EventFieldList_clear(&decoded[j]);
+            break;
+        }
+        res = UA_Server_filterStoredEvents(server, filter,
+                                           notifier->layouts[layout].selectSize,
+                                           notifier->layouts[layout].select,
+                                           batchSize, decoded, filtered);
+
+        /* Move the matching events to the result */
+        size_t i = 0;
+        for(; i < batchSize && res == UA_STATUSCODE_GOOD; i++) {
+            if(maxEvents > 0 && historyEvent->eventsSize == maxEvents)
+                break;
+            if(filtered[i].eventFieldsSize == 0)
+                continue;
+            UA_HistoryEventFieldList *hefl = (UA_HistoryEventFieldList*)
+                UA_realloc(historyEvent->events, sizeof(UA_HistoryEventFieldList) *
+                           (historyEvent->eventsSize + 1));
+            if(!hefl) {
+                res = UA_STATUSCODE_BADOUTOFMEMORY;
+                break;
+            }
+            historyEvent->events = hefl;
+            hefl = &historyEvent->events[historyEvent->eventsSize++];
+            hefl->eventFieldsSize = filtered[i].eventFieldsSize;
+            hefl->eventFields = filtered[i].eventFields;
+            UA_EventFieldList_init(&filtered[i]);
+        }
+        *next = (reverse) ? end + (batchSize - i) : begin - (batchSize - i);
+        for(size_t j = 0; j < batchSize; j++) {
+            UA_EventFieldList_clear(&decoded[j]);
+            UA_EventFieldList_clear(&filtered[j]);
+        }
+        if(maxEvents > 0 && historyEvent->eventsSize == maxEvents)
+            break;
+    }
+    return res;
+}
+
+static void
+readEvent_service_default(UA_Server *server,
+                          void *context,
+                          const UA_NodeId *sessionId,
+                          void *sessionContext,
+                          const UA_RequestHeader *requestHeader,
+                          const UA_ReadEventDetails *historyReadDetails,
+                          UA_TimestampsToReturn timestampsToReturn,
+                          UA_Boolean releaseContinuationPoints,
+                          size_t nodesToReadSize,
+                          const UA_HistoryReadValueId *nodesToRead,
+                          UA_HistoryReadResponse *response,
+                          UA_HistoryEvent * const * const historyData)
+{
+    response->responseHeader.serviceResult = UA_STATUSCODE_GOOD;
+    if(releaseContinuationPoints)
+        return; /* The continuation points hold no state */
+
+    /* The startTime is included, the endTime is not. Without a startTime or
+     * with the endTime before the startTime, the events are returned in
+     * reverse order. Without one of the times, numValuesPerNode must be set. */
+    UA_DateTime startTime = historyReadDetails->startTime;
+    UA_DateTime endTime = historyReadDetails->endTime;
+    UA_Boolean reverse = (startTime == 0 || (endTime != 0 && endTime < startTime));
+    UA_StatusCode timeRes = UA_STATUSCODE_GOOD;
+    if((startTime == 0 && endTime == 0) ||
+       ((startTime == 0 || endTime == 0) && historyReadDetails->numValuesPerNode == 0))
+        timeRes = UA_STATUSCODE_BADINVALIDTIMESTAMPARGUMENT;
+
+    UA_HistoryDatabaseContext_default *ctx = (UA_HistoryDatabaseContext_default*)context;
+    for(size_t i = 0; i < nodesToReadSize; ++i) {
+        UA_HistoryReadResult *result = &response->results[i];
+        if(timeRes != UA_STATUSCODE_GOOD) {
+            result->statusCode = timeRes;
+            continue;
+        }
+
+        UA_Byte eventNotifier = 0;
+        UA_Server_readEventNotifier(server, nodesToRead[i].nodeId, &eventNotifier);
+        if(!(eventNotifier & UA_EVENTNOTIFIER_HISTORY_READ)) {
+            result->statusCode = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+            continue;
+        }
+
+        /* No events recorded */
+        EventNotifierHistory *notifier = findNotifier(ctx, &nodesToRead[i].nodeId);
+        if(!notifier)
+            continue;
+
+        /* The range of events */
+        size_t begin = 0, end = notifier->eventsSize;
+        if(!reverse) {
+            begin = eventBound(notifier, startTime, false);
+            if(endTime != 0)
+                end = eventBound(notifier, endTime, false);
+        } else if(startTime != 0) {
+            begin = eventBound(notifier, endTime, true);
+            end = eventBound(notifier, startTime, true);
+        } else {
+            end = eventBound(notifier, endTime, false);
+        }
+
+        /* Continue from the continuation point */
+        const UA_ByteString *cp = &nodesToRead[i].continuationPoint;
+        if(cp->length > 0) {
+            if(cp->length != sizeof(EventContinuationPoint)) {
+                result->statusCode = UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+                continue;
+            }
+            EventContinuationPoint ecp;
+            memcpy(&ecp, cp->data, sizeof(EventContinuationPoint));
+            if(!reverse) {
+                size_t pos = eventBound(notifier, ecp.time, false) + ecp.skip;
+                if(pos > begin)
+                    begin = pos;
+            } else {
+                size_t pos = eventBound(notifier, ecp.time, true);
+                pos = (pos > ecp.skip) ? pos - ecp.skip : 0;
+                if(pos < end)
+                    end = pos;
+            }
+        }
+
+        size_t next = begin;
+        if(begin < end)
+            result->statusCode =
+                readEvents(server, notifier, &historyReadDetails->filter, reverse,
+                           begin, end, historyReadDetails->numValuesPerNode,
+                           historyData[i], &next);
+        if(result->statusCode != UA_STATUSCODE_GOOD)
+            continue;
+
+        /* More events to read */
+        if((!reverse && next < end) || (reverse && next > begin)) {
+            const StoredEvent *events = &notifier->events[notifier->first];
+            EventContinuationPoint ecp;
+            if(!reverse) {
+                ecp.time = events[next].time;
+                ecp.skip = next - eventBound(notifier, ecp.time, false);
+            } else {
+                ecp.time = events[next - 1].time;
+                ecp.skip = eventBound(notifier, ecp.time, true) - next;
+            }
+            UA_ByteString ecpBuf = {sizeof(EventContinuationPoint), (UA_Byte*)&ecp};
+            result->statusCode = UA_ByteString_copy(&ecpBuf, &result->continuationPoint);
+        }
+    }
+}
+
+#endif /* UA_ENABLE_SUBSCRIPTIONS_EVENTS */
+
 static void
 setValue_service_default(UA_Server *server,
                          void *context,
@@ -598,6 +1695,28 @@ setValue_service_default(UA_Server *server,
                                 value);
 }
 
+static void
+setValues_service_default(UA_Server *server,
+                          void *context,
+                          const UA_NodeId *sessionId,
+                          void *sessionContext,
+                          size_t valuesSize,
+                          const UA_NodeId *nodeIds,
+                          const UA_Boolean *historizing,
+                          const UA_DataValue *values)
+{
+    UA_HistoryDatabaseContext_default *ctx = (UA_HistoryDatabaseContext_default*)context;
+    if (ctx->gathering.setValues) {
+        ctx->gathering.setValues(server, ctx->gathering.context, sessionId,
+                                 sessionContext, valuesSize, nodeIds,
+                                 historizing, values);
+        return;
+    }
+    for (size_t i = 0; i < valuesSize; ++i)
+        setValue_service_default(server, context, sessionId, sessionContext,
+                                 &nodeIds[i], historizing[i], &values[i]);
+}
+
 static void
 clear_service_default(UA_HistoryDatabase *hdb)
 {
@@ -605,6 +1724,9 @@ clear_service_default(UA_HistoryDatabase *hdb)
         return;
     UA_HistoryDatabaseContext_default *ctx = (UA_HistoryDatabaseContext_default*)hdb->context;
     ctx->gathering.deleteMembers(&ctx->gathering);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    ZIP_ITER(EventNotifierTree, &ctx->notifiers, deleteNotifierVisitor, NULL);
+#endif
     UA_free(ctx);
 }
 
@@ -617,11 +1739,34 @@ UA_HistoryDatabase_default(UA_HistoryDataGathering gathering)
             (UA_HistoryDatabaseContext_default*)
             UA_calloc(1, sizeof(UA_HistoryDatabaseContext_default));
     context->gathering = gathering;
+    ZIP_INIT(&context->notifiers);
+    ZIP_INIT(&context->oldest);
     hdb.context = context;
     hdb.readRaw = &readRaw_service_default;
+    hdb.readProcessed = &readProcessed_service_default;
+    hdb.readAtTime = &readAtTime_service_default;
     hdb.setValue = &setValue_service_default;
+    hdb.setValues = &setValues_service_default;
     hdb.updateData = &updateData_service_default;
     hdb.deleteRawModified = &deleteRawModified_service_default;
     hdb.clear = clear_service_default;
     return hdb;
 }
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+UA_HistoryDatabase
+UA_HistoryDatabase_defaultWithEvents(UA_HistoryDataGathering gathering,
+                                     size_t maxEvents, size_t maxEncodedSize,
+                                     UA_Duration maxAge)
+{
+    UA_HistoryDatabase hdb = UA_HistoryDatabase_default(gathering);
+    UA_HistoryDatabaseContext_default *context =
+        (UA_HistoryDatabaseContext_default*)hdb.context;
+    context->maxEvents = maxEvents;
+    context->maxEncodedSize = maxEncodedSize;
+    context->maxAge = maxAge;
+    hdb.setEvent = &setEvent_service_default;
+    hdb.readEvent = &readEvent_service_default;
+    return hdb;
+}
+#endif
@@ -0,0 +1,42 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef UA_HISTORYDATABACKEND_FILE_H_
+#define UA_HISTORYDATABACKEND_FILE_H_
+
+#include "history_data_backend.h"
+
+_UA_BEGIN_DECLS
+
+#ifdef __linux__ /* Linux only so far */
+
+#define UA_HISTORYDATABACKEND_FILE_SEGMENTSIZE (4 * 1024 * 1024)
+
+/* This function constructs a UA_HistoryDataBackend that persists the samples
+ * in append-only segment files. Every NodeId gets a subdirectory below path.
+ * When a segment reaches segmentSize bytes, a new segment is started. Segments
+ * are memory-mapped for reading. A sparse index of the timestamps is kept in
+ * memory and rebuilt when a node is first accessed after a restart. Records
+ * that were only partially written before a crash are truncated at that time.
+ *
+ * Samples are appended in time order. Samples with a timestamp before the
+ * last stored sample are rejected. Replacing and deleting stored samples is
+ * not supported.
+ *
+ * path is the directory of the store. It is created if it does not exist.
+ * segmentSize is the maximum size of a segment file in bytes. Use 0 for the
+ * default of UA_HISTORYDATABACKEND_FILE_SEGMENTSIZE. */
+UA_HistoryDataBackend UA_EXPORT
+UA_HistoryDataBackend_File(const char *path, size_t segmentSize);
+
+/* Closes the files and frees the memory. The stored data is kept. */
+void UA_EXPORT
+UA_HistoryDataBackend_File_clear(UA_HistoryDataBackend *backend);
+
+#endif
+
+_UA_END_DECLS
+
+#endif /* UA_HISTORYDATABACKEND_FILE_H_ */
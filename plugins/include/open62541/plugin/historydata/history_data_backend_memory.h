@@ -27,6 +27,32 @@ UA_HistoryDataBackend_Memory(size_t initialNodeIdStoreSize, size_t initialDataSt
 UA_HistoryDataBackend UA_EXPORT
 UA_HistoryDataBackend_Memory_Circular(size_t initialNodeIdStoreSize, size_t initialDataStoreSize);
 
+#define UA_HISTORYDATABACKEND_COLUMNAR_CHUNKSIZE 512
+
+/* This function constructs a UA_HistoryDataBackend that keeps the samples of
+ * each NodeId in time-ordered chunks. Inside a chunk, the timestamps, status
+ * codes and values are stored in separate columns. Scalar values of a
+ * fixed-size type (numbers, DateTime, ...) need no allocation per sample.
+ * Other values are stored as full DataValues. Samples that arrive in time
+ * order are appended to the last chunk. NodeIds are looked up in a tree
+ * ordered by their hash.
+ *
+ * samplesPerChunk is the capacity of a chunk. Use 0 for the default of
+ * UA_HISTORYDATABACKEND_COLUMNAR_CHUNKSIZE. */
+UA_HistoryDataBackend UA_EXPORT
+UA_HistoryDataBackend_Memory_Columnar(size_t samplesPerChunk);
+
+/* Same as UA_HistoryDataBackend_Memory_Columnar, but full chunks of scalar
+ * values with up to 8 bytes (Double, Float, integers, DateTime, ...) are
+ * compressed when the next chunk is started. The timestamps are stored as
+ * delta-of-deltas and the values XOR'ed with the previous value (the "Gorilla"
+ * encoding). Samples with a fixed period and slowly changing values then take
+ * a few bits each. Compressed chunks are decoded when they are read and
+ * decompressed when they are modified. */
+UA_HistoryDataBackend UA_EXPORT
+UA_HistoryDataBackend_Memory_Compressed(size_t samplesPerChunk);
+
+/* Clears all backends constructed by the functions above */
 void UA_EXPORT
 UA_HistoryDataBackend_Memory_clear(UA_HistoryDataBackend *backend);
 
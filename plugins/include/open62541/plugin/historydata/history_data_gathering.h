@@ -113,6 +113,19 @@ struct UA_HistoryDataGathering {
                 const UA_NodeId *nodeId,
                 UA_Boolean historizing,
                 const UA_DataValue *value);
+
+    /* Sets DataValues for several nodes at once. The arguments are the same
+     * as for setValue, with an array entry in nodeIds, historizing and values
+     * for each value. Can be NULL, then setValue is used for each value. */
+    void
+    (*setValues)(UA_Server *server,
+                 void *hdgContext,
+                 const UA_NodeId *sessionId,
+                 void *sessionContext,
+                 size_t valuesSize,
+                 const UA_NodeId *nodeIds,
+                 const UA_Boolean *historizing,
+                 const UA_DataValue *values);
 };
 
 _UA_END_DECLS
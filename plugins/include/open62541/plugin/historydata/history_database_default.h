@@ -17,6 +17,24 @@ _UA_BEGIN_DECLS
 UA_HistoryDatabase UA_EXPORT
 UA_HistoryDatabase_default(UA_HistoryDataGathering gathering);
 
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+/* Same as UA_HistoryDatabase_default, but additionally records the events
+ * of all nodes with a HistoricalEventFilter property. The fields selected by
+ * the HistoricalEventFilter are stored binary-encoded for each emitting node
+ * and ordered by the Time field. ReadEvent applies the EventFilter of the
+ * request to the stored fields. Nodes need the HistoryRead bit in their
+ * EventNotifier attribute for their events to be read.
+ *
+ * The oldest events (over all nodes) are removed when a limit is exceeded.
+ * maxEvents is the maximum number of events, maxEncodedSize the maximum size
+ * of all encoded events in bytes and maxAge the maximum age of the events in
+ * milliseconds. Use 0 for no limit. */
+UA_HistoryDatabase UA_EXPORT
+UA_HistoryDatabase_defaultWithEvents(UA_HistoryDataGathering gathering,
+                                     size_t maxEvents, size_t maxEncodedSize,
+                                     UA_Duration maxAge);
+#endif
+
 _UA_END_DECLS
 
 #endif /* UA_HISTORYDATASERVICE_DEFAULT_H_ */
@@ -14,7 +14,12 @@ _UA_BEGIN_DECLS
 typedef void UA_NodeSetLoaderOptions;
 
 /* Load the typemodel at runtime, without the need to statically compile the model.
- * This is an alternative to the Python nodeset compiler approach. */
+ * This is an alternative to the Python nodeset compiler approach.
+ *
+ * The XML file is parsed and the nodes are added on the calling thread. For
+ * faster restarts, the loaded information model can be saved with
+ * UA_Server_snapshotNodestore and restored with UA_Server_restoreNodestore
+ * instead of parsing the nodesets again. */
 UA_EXPORT UA_StatusCode
 UA_Server_loadNodeset(UA_Server *server, const char *nodeset2XmlFilePath,
                       UA_NodeSetLoaderOptions *options);
@@ -18,6 +18,35 @@ _UA_BEGIN_DECLS
 UA_EXPORT UA_StatusCode
 UA_Nodestore_HashMap(UA_Nodestore *ns);
 
+/* Options for the HashMap Nodestore. They can be ORed together.
+ *
+ * - DirectPointers: Local reference targets are replaced with direct pointers
+ *   to the target node once both nodes are in the Nodestore. Following a
+ *   reference (e.g. during Browse and TranslateBrowsePathsToNodeIds) then
+ *   requires no hash-map lookup. The direct pointers are fixed up when a node
+ *   is replaced or removed. This costs additional memory for the bookkeeping
+ *   and makes adding and removing nodes slower.
+ *
+ * - InternStrings: The BrowseName and the locales and texts of the DisplayName
+ *   and Description are kept once in a table of reference-counted strings and
+ *   shared between the nodes. Editing a node gives it private copies of the
+ *   strings until the node is released.
+ *
+ * - SortedReferences: Many references of the same type and direction are kept
+ *   in an array sorted by the target NodeId, with an index of the BrowseName
+ *   hashes, instead of a tree. This uses less memory and keeps the targets
+ *   contiguous. Recommended for folders with tens of thousands of children. */
+#define UA_NODESTORE_HASHMAP_DIRECTPOINTERS 0x01
+#define UA_NODESTORE_HASHMAP_INTERNSTRINGS 0x02
+#define UA_NODESTORE_HASHMAP_SORTEDREFERENCES 0x04
+
+UA_EXPORT UA_StatusCode
+UA_Nodestore_HashMapWithOptions(UA_Nodestore *ns, UA_UInt32 options);
+
+/* Shorthand for the HashMap Nodestore with direct pointers */
+UA_EXPORT UA_StatusCode
+UA_Nodestore_HashMapDirect(UA_Nodestore *ns);
+
 /* The ZipTree Nodestore holds all nodes in RAM in a tree structure. The lookup
  * time is about O(log n). Adding/removing nodes does not require resizing of
  * the underlying array with the linear overhead.
@@ -8,6 +8,7 @@
 
 #include <open62541/util.h>
 #include <open62541/plugin/nodestore_default.h>
+#include "ziptree.h"
 
 #ifndef container_of
 #define container_of(ptr, type, member) \
@@ -21,16 +22,51 @@
  * - Matching NodeId: Return the entry
  * - NULL: Abort the search */
 
+/* State for the direct pointer and string interning modes. Only allocated
+ * (behind the node) if one of the modes is enabled. */
+typedef struct {
+    UA_Boolean edited; /* Opened for editing since the last cleanup */
+
+    /* Direct pointer mode */
+    UA_Boolean pinned; /* A direct pointer to the node could not be reverted.
+                        * Keep the memory until the nodestore is deleted. */
+    UA_UInt32 scannedTargets; /* Reference targets at the last full scan */
+    UA_UInt32 referrersSize;
+    UA_UInt32 referrersCapacity;
+    UA_NodePointer *referrers; /* Nodes that (might) have a direct pointer to
+                                * this node. Can contain stale entries. */
+
+    /* String interning mode */
+    UA_Boolean interned; /* The strings of the node are interned */
+    UA_UInt32 retainedSize;
+    UA_String *retained; /* Strings from before the edit. Released when the
+                          * node is interned again. */
+} UA_NodeMapEntryExt;
+
 typedef struct UA_NodeMapEntry {
     struct UA_NodeMapEntry *orig; /* the version this is a copy from (or NULL) */
     UA_UInt16 refCount; /* How many consumers have a reference to the node? */
     UA_Boolean deleted; /* Node was marked as deleted and can be deleted when refCount == 0 */
+    UA_NodeMapEntryExt *ext; /* NULL if no mode is enabled */
     UA_Node node;
 } UA_NodeMapEntry;
 
 #define UA_NODEMAP_MINSIZE 64
 #define UA_NODEMAP_TOMBSTONE ((UA_NodeMapEntry*)0x01)
 
+/* Immutable string shared between nodes */
+struct UA_InternedString;
+typedef struct UA_InternedString UA_InternedString;
+struct UA_InternedString {
+    ZIP_ENTRY(UA_InternedString) zipfields;
+    UA_UInt32 hash;
+    UA_UInt32 refCount;
+    UA_String str;
+};
+
+ZIP_HEAD(UA_InternTree, UA_InternedString);
+typedef struct UA_InternTree UA_InternTree;
+
 typedef struct {
     UA_NodeMapEntry *entry;
     UA_UInt32 nodeIdHash;
@@ -45,8 +81,195 @@ typedef struct {
     /* Maps ReferenceTypeIndex to the NodeId of the ReferenceType */
     UA_NodeId referenceTypeIds[UA_REFERENCETYPESET_MAX];
     UA_Byte referenceTypeCounter;
+
+    /* Swizzle local reference targets into direct pointers */
+    UA_Boolean directPointers;
+
+    /* Removed nodes that are still the target of a direct pointer */
+    UA_NodeMapEntry **pinned;
+    size_t pinnedSize;
+
+    /* Share the strings of the node attributes */
+    UA_Boolean internStrings;
+    UA_InternTree interned;
+
+    /* Use sorted arrays instead of trees for many reference targets */
+    UA_Boolean sortedReferences;
 } UA_NodeMap;
 
+/********************/
+/* Interned Strings */
+/********************/
+
+/* In the string interning mode, the BrowseName and the locales and texts of
+ * the DisplayName and Description are shared between the nodes. The node
+ * points to the immutable string in the intern table. The interned strings are
+ * reference-counted.
+ *
+ * Editing would free or overwrite the shared strings in-situ. So getEditNode
+ * gives the node private copies of its strings. The strings from before the
+ * edit are retained until the node is released and interned again. Then the
+ * unchanged strings are shared again and only the modified strings remain as
+ * new entries in the table. */
+
+static enum ZIP_CMP
+cmpInterned(const void *a, const void *b) {
+    const UA_InternedString *aa = (const UA_InternedString*)a;
+    const UA_InternedString *bb = (const UA_InternedString*)b;
+    if(aa->hash != bb->hash)
+        return (aa->hash < bb->hash) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    if(aa->str.length != bb->str.length)
+        return (aa->str.length < bb->str.length) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    int cmp = memcmp(aa->str.data, bb->str.data, aa->str.length);
+    if(cmp == 0)
+        return ZIP_CMP_EQ;
+    return (cmp < 0) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+ZIP_FUNCTIONS(UA_InternTree, UA_InternedString, zipfields,
+              UA_InternedString, zipfields, cmpInterned)
+
+typedef void (*UA_NodeStringCallback)(void *context, UA_String *s);
+
+/* Call for all strings of the node that can be interned */
+static void
+forEachNodeString(UA_NodeHead *head, UA_NodeStringCallback cb, void *context) {
+    cb(context, &head->browseName.name);
+    for(UA_LocalizedTextListEntry *lt = head->displayName; lt; lt = lt->next) {
+        cb(context, &lt->localizedText.locale);
+        cb(context, &lt->localizedText.text);
+    }
+    for(UA_LocalizedTextListEntry *lt = head->description; lt; lt = lt->next) {
+        cb(context, &lt->localizedText.locale);
+        cb(context, &lt->localizedText.text);
+    }
+}
+
+static UA_InternedString *
+findInterned(UA_NodeMap *ns, const UA_String *s) {
+    UA_InternedString dummy;
+    dummy.hash = UA_ByteString_hash(0, s->data, s->length);
+    dummy.str = *s;
+    return ZIP_FIND(UA_InternTree, &ns->interned, &dummy);
+}
+
+/* Replace a heap string with the interned version. Keeps the heap string if
+ * the table entry cannot be allocated. */
+static void
+internString(void *context, UA_String *s) {
+    UA_NodeMap *ns = (UA_NodeMap*)context;
+    if(s->length == 0)
+        return;
+    UA_InternedString *is = findInterned(ns, s);
+    if(is) {
+        if(is->str.data == s->data)
+            return; /* Already interned */
+        is->refCount++;
+        UA_String_clear(s);
+        *s = is->str;
+        return;
+    }
+
+    /* Take over the heap string */
+    is = (UA_InternedString*)UA_malloc(sizeof(UA_InternedString));
+    if(!is)
+        return;
+    is->hash = UA_ByteString_hash(0, s->data, s->length);
+    is->refCount = 1;
+    is->str = *s;
+    ZIP_INSERT(UA_InternTree, &ns->interned, is);
+}
+
+/* Release an interned string or free a heap string */
+static void
+releaseString(void *context, UA_String *s) {
+    UA_NodeMap *ns = (UA_NodeMap*)context;
+    if(s->length > 0) {
+        UA_InternedString *is = findInterned(ns, s);
+        if(is && is->str.data == s->data) {
+            if(--is->refCount == 0) {
+                ZIP_REMOVE(UA_InternTree, &ns->interned, is);
+                UA_String_clear(&is->str);
+                UA_free(is);
+            }
+            UA_String_init(s);
+            return;
+        }
+    }
+    UA_String_clear(s);
+}
+
+static void
+releaseRetained(UA_NodeMap *ns, UA_NodeMapEntry *entry) {
+    UA_NodeMapEntryExt *ext = entry->ext;
+    for(UA_UInt32 i = 0; i < ext->retainedSize; i++)
+        releaseString(ns, &ext->retained[i]);
+    UA_free(ext->retained);
+    ext->retained = NULL;
+    ext->retainedSize = 0;
+}
+
+static void
+internNode(UA_NodeMap *ns, UA_NodeMapEntry *entry) {
+    forEachNodeString(&entry->node.head, internString, ns);
+    entry->ext->interned = true;
+    releaseRetained(ns, entry);
+}
+
+typedef struct {
+    UA_String *strings;
+    UA_UInt32 size;
+    UA_StatusCode res;
+} UA_MaterializeContext;
+
+static void
+countString(void *context, UA_String *s) {
+    (void)s;
+    ((UA_MaterializeContext*)context)->size++;
+}
+
+static void
+copyString(void *context, UA_String *s) {
+    UA_MaterializeContext *mc = (UA_MaterializeContext*)context;
+    mc->res |= UA_String_copy(s, &mc->strings[mc->size++]);
+}
+
+static void
+swapString(void *context, UA_String *s) {
+    UA_MaterializeContext *mc = (UA_MaterializeContext*)context;
+    UA_String tmp = *s;
+    *s = mc->strings[mc->size];
+    mc->strings[mc->size++] = tmp;
+}
+
+/* Give the node private copies of its strings before an edit */
+static UA_StatusCode
+materializeNode(UA_NodeMapEntry *entry) {
+    UA_MaterializeContext mc;
+    memset(&mc, 0, sizeof(UA_MaterializeContext));
+    forEachNodeString(&entry->node.head, countString, &mc);
+    mc.strings = (UA_String*)UA_calloc(mc.size, sizeof(UA_String));
+    if(!mc.strings)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Copy first, so that the node is unchanged if that fails */
+    UA_UInt32 size = mc.size;
+    mc.size = 0;
+    forEachNodeString(&entry->node.head, copyString, &mc);
+    if(mc.res != UA_STATUSCODE_GOOD) {
+        UA_Array_delete(mc.strings, size, &UA_TYPES[UA_TYPES_STRING]);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    /* Swap in the copies. Retain the originals. */
+    mc.size = 0;
+    forEachNodeString(&entry->node.head, swapString, &mc);
+    entry->ext->retained = mc.strings;
+    entry->ext->retainedSize = mc.size;
+    entry->ext->interned = false;
+    return UA_STATUSCODE_GOOD;
+}
+
 /*********************/
 /* HashMap Utilities */
 /*********************/
@@ -113,18 +336,12 @@ findFreeSlot(const UA_NodeMap *ns, const UA_NodeId *nodeid) {
     return candidate;
 }
 
-/* The occupancy of the table after the call will be about 50% */
+/* Rehash all entries into a table with the size primes[nindex] */
 static UA_StatusCode
-expand(UA_NodeMap *ns) {
+resize(UA_NodeMap *ns, UA_UInt32 nindex) {
     UA_UInt32 osize = ns->size;
     UA_UInt32 count = ns->count;
-    /* Resize only when table after removal of unused elements is either too
-       full or too empty */
-    if(count * 2 < osize && (count * 8 > osize || osize <= UA_NODEMAP_MINSIZE))
-        return UA_STATUSCODE_GOOD;
-
     UA_NodeMapSlot *oslots = ns->slots;
-    UA_UInt32 nindex = higher_prime_index(count * 2);
     UA_UInt32 nsize = primes[nindex];
     UA_NodeMapSlot *nslots= (UA_NodeMapSlot*)UA_calloc(nsize, sizeof(UA_NodeMapSlot));
     if(!nslots)
@@ -148,8 +365,20 @@ expand(UA_NodeMap *ns) {
     return UA_STATUSCODE_GOOD;
 }
 
+/* The occupancy of the table after the call will be about 50% */
+static UA_StatusCode
+expand(UA_NodeMap *ns) {
+    UA_UInt32 osize = ns->size;
+    UA_UInt32 count = ns->count;
+    /* Resize only when table after removal of unused elements is either too
+       full or too empty */
+    if(count * 2 < osize && (count * 8 > osize || osize <= UA_NODEMAP_MINSIZE))
+        return UA_STATUSCODE_GOOD;
+    return resize(ns, higher_prime_index(count * 2));
+}
+
 static UA_NodeMapEntry *
-createEntry(UA_NodeClass nodeClass) {
+createEntry(const UA_NodeMap *ns, UA_NodeClass nodeClass) {
     size_t size = sizeof(UA_NodeMapEntry) - sizeof(UA_Node);
     switch(nodeClass) {
     case UA_NODECLASS_OBJECT:
@@ -179,34 +408,39 @@ createEntry(UA_NodeClass nodeClass) {
     default:
         return NULL;
     }
+
+    /* Append the state of the enabled modes in the same allocation */
+    size_t extOffset = 0;
+    if(ns->directPointers || ns->internStrings) {
+        extOffset = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+        size = extOffset + sizeof(UA_NodeMapEntryExt);
+    }
+
     UA_NodeMapEntry *entry = (UA_NodeMapEntry*)UA_calloc(1, size);
     if(!entry)
         return NULL;
+    if(extOffset > 0)
+        entry->ext = (UA_NodeMapEntryExt*)((uintptr_t)entry + extOffset);
     entry->node.head.nodeClass = nodeClass;
     return entry;
 }
 
 static void
-deleteNodeMapEntry(UA_NodeMapEntry *entry) {
+deleteNodeMapEntry(UA_NodeMap *ns, UA_NodeMapEntry *entry) {
+    UA_NodeMapEntryExt *ext = entry->ext;
+    if(ext) {
+        if(ext->interned || ext->retained) {
+            forEachNodeString(&entry->node.head, releaseString, ns);
+            releaseRetained(ns, entry);
+        }
+        for(UA_UInt32 i = 0; i < ext->referrersSize; i++)
+            UA_NodePointer_clear(&ext->referrers[i]);
+        UA_free(ext->referrers);
+    }
     UA_Node_clear(&entry->node);
     UA_free(entry);
 }
 
-static void
-cleanupNodeMapEntry(UA_NodeMapEntry *entry) {
-    if(entry->refCount > 0)
-        return;
-    if(entry->deleted) {
-        deleteNodeMapEntry(entry);
-        return;
-    }
-    for(size_t i = 0; i < entry->node.head.referencesSize; i++) {
-        UA_NodeReferenceKind *rk = &entry->node.head.references[i];
-        if(rk->targetsSize > 16 && !rk->hasRefTree)
-            UA_NodeReferenceKind_switch(rk);
-    }
-}
-
 static UA_NodeMapSlot *
 findOccupiedSlot(const UA_NodeMap *ns, const UA_NodeId *nodeid) {
     UA_UInt32 h = UA_NodeId_hash(nodeid);
@@ -234,13 +468,298 @@ findOccupiedSlot(const UA_NodeMap *ns, const UA_NodeId *nodeid) {
     return NULL;
 }
 
+/*******************/
+/* Direct Pointers */
+/*******************/
+
+/* In the direct pointer mode, local reference targets are "swizzled" into
+ * direct pointers to the target node once both nodes are in the nodestore.
+ * Following such a reference is a pointer dereference instead of a lookup in
+ * the hash-map.
+ *
+ * Every node keeps the NodeIds of the nodes that might have a direct pointer to
+ * it. The direct pointers are fixed up from that list when the node is replaced
+ * or removed. References can be removed in-situ without the nodestore noticing.
+ * So the list can contain stale entries. They are pruned when the list grows.
+ *
+ * Nodes are swizzled when they are inserted and when they were edited. Large
+ * nodes are scanned again only after their number of reference targets has
+ * doubled. Until then, their new targets get swizzled from the (usually small)
+ * other side of the reference, which has the inverse reference. */
+
+#define UA_NODEMAP_SWIZZLE_MINSCAN 64
+#define UA_NODEMAP_REFERRERS_MINSIZE 4
+
+static UA_ExpandedNodeId
+localTarget(const UA_NodeId *id) {
+    UA_ExpandedNodeId en;
+    UA_ExpandedNodeId_init(&en);
+    en.nodeId = *id;
+    return en;
+}
+
+static size_t
+countTargets(const UA_NodeHead *head) {
+    size_t total = 0;
+    for(size_t i = 0; i < head->referencesSize; i++)
+        total += head->references[i].targetsSize;
+    return total;
+}
+
+/* Cast out the const qualifier. The target is modified in-situ. This does not
+ * change the position in the reference tree, as direct pointers are ordered
+ * according to the NodeId of the node. */
+static UA_ReferenceTarget *
+findDirectTarget(UA_NodeReferenceKind *rk, const UA_ExpandedNodeId *targetId) {
+    return (UA_ReferenceTarget*)(uintptr_t)
+        UA_NodeReferenceKind_findTarget(rk, targetId);
+}
+
+static UA_Boolean
+hasDirectPointer(UA_NodeHead *head, const UA_NodeMapEntry *target) {
+    UA_ExpandedNodeId en = localTarget(&target->node.head.nodeId);
+    for(size_t i = 0; i < head->referencesSize; i++) {
+        UA_ReferenceTarget *t = findDirectTarget(&head->references[i], &en);
+        if(t && UA_NodePointer_getNode(t->targetId) == &target->node.head)
+            return true;
+    }
+    return false;
+}
+
+static void
+pruneReferrers(UA_NodeMap *ns, UA_NodeMapEntry *entry) {
+    UA_NodeMapEntryExt *ext = entry->ext;
+    UA_UInt32 j = 0;
+    for(UA_UInt32 i = 0; i < ext->referrersSize; i++) {
+        UA_NodeId id = UA_NodePointer_toNodeId(ext->referrers[i]);
+        UA_NodeMapSlot *slot = findOccupiedSlot(ns, &id);
+        if(slot && hasDirectPointer(&slot->entry->node.head, entry)) {
+            ext->referrers[j++] = ext->referrers[i];
+            continue;
+        }
+        UA_NodePointer_clear(&ext->referrers[i]);
+    }
+    ext->referrersSize = j;
+}
+
+static UA_StatusCode
+addReferrer(UA_NodeMap *ns, UA_NodeMapEntry *entry, const UA_NodeId *referrer) {
+    /* Multiple references between the same nodes are usually swizzled in
+     * sequence. Don't add the referrer again. */
+    UA_NodeMapEntryExt *ext = entry->ext;
+    UA_NodePointer rp = UA_NodePointer_fromNodeId(referrer);
+    if(ext->referrersSize > 0 &&
+       UA_NodePointer_equal(ext->referrers[ext->referrersSize - 1], rp))
+        return UA_STATUSCODE_GOOD;
+
+    /* Prune stale entries before growing the list */
+    if(ext->referrersSize == ext->referrersCapacity) {
+        pruneReferrers(ns, entry);
+        if(ext->referrersSize >= ext->referrersCapacity / 2) {
+            UA_UInt32 newCapacity = (ext->referrersCapacity > 0) ?
+                ext->referrersCapacity * 2 : UA_NODEMAP_REFERRERS_MINSIZE;
+            UA_NodePointer *referrers = (UA_NodePointer*)
+                UA_realloc(ext->referrers, sizeof(UA_NodePointer) * newCapacity);
+            if(!referrers)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            ext->referrers = referrers;
+            ext->referrersCapacity = newCapacity;
+        }
+    }
+
+    UA_StatusCode res =
+        UA_NodePointer_copy(rp, &ext->referrers[ext->referrersSize]);
+    if(res == UA_STATUSCODE_GOOD)
+        ext->referrersSize++;
+    return res;
+}
+
+static void
+swizzleTarget(UA_NodeMap *ns, UA_NodeMapEntry *entry, UA_ReferenceTarget *t,
+              UA_NodeMapEntry *target) {
+    /* Without the referrer entry the pointer could not be fixed up. Keep the
+     * NodeId in that case. */
+    if(addReferrer(ns, target, &entry->node.head.nodeId) != UA_STATUSCODE_GOOD)
+        return;
+    UA_NodePointer_clear(&t->targetId);
+    t->targetId = UA_NodePointer_fromNode(&target->node.head);
+}
+
+/* Swizzle the inverse reference in the target node */
+static void
+swizzleInverse(UA_NodeMap *ns, UA_NodeMapEntry *target,
+               const UA_NodeReferenceKind *rk, UA_NodeMapEntry *entry) {
+    UA_ExpandedNodeId en = localTarget(&entry->node.head.nodeId);
+    UA_NodeHead *head = &target->node.head;
+    for(size_t i = 0; i < head->referencesSize; i++) {
+        UA_NodeReferenceKind *trk = &head->references[i];
+        if(trk->referenceTypeIndex != rk->referenceTypeIndex ||
+           trk->isInverse == rk->isInverse)
+            continue;
+        UA_ReferenceTarget *t = findDirectTarget(trk, &en);
+        if(t && !UA_NodePointer_getNode(t->targetId))
+            swizzleTarget(ns, target, t, entry);
+        return;
+    }
+}
+
+typedef struct {
+    UA_NodeMap *ns;
+    UA_NodeMapEntry *entry;
+    const UA_NodeReferenceKind *rk;
+} UA_SwizzleContext;
+
+static void *
+swizzleTargetCallback(void *context, UA_ReferenceTarget *t) {
+    UA_SwizzleContext *sc = (UA_SwizzleContext*)context;
+    if(UA_NodePointer_getNode(t->targetId) || !UA_NodePointer_isLocal(t->targetId))
+        return NULL;
+    UA_NodeId id = UA_NodePointer_toNodeId(t->targetId);
+    UA_NodeMapSlot *slot = findOccupiedSlot(sc->ns, &id);
+    if(!slot)
+        return NULL; /* The target does not exist (yet) */
+    swizzleTarget(sc->ns, sc->entry, t, slot->entry);
+    swizzleInverse(sc->ns, slot->entry, sc->rk, sc->entry);
+    return NULL;
+}
+
+static void
+swizzleNode(UA_NodeMap *ns, UA_NodeMapEntry *entry) {
+    UA_SwizzleContext sc = {ns, entry, NULL};
+    UA_NodeHead *head = &entry->node.head;
+    for(size_t i = 0; i < head->referencesSize; i++) {
+        sc.rk = &head->references[i];
+        UA_NodeReferenceKind_iterate(&head->references[i],
+                                     swizzleTargetCallback, &sc);
+    }
+    entry->ext->scannedTargets = (UA_UInt32)countTargets(head);
+}
+
+/* Revert a direct pointer to the NodeId */
+static void
+unswizzleTarget(UA_ReferenceTarget *t, UA_NodeMapEntry *target) {
+    UA_NodePointer np;
+    if(UA_NodePointer_copy(t->targetId, &np) != UA_STATUSCODE_GOOD) {
+        target->ext->pinned = true;
+        return;
+    }
+    t->targetId = np;
+}
+
+static void *
+unswizzleTargetCallback(void *context, UA_ReferenceTarget *t) {
+    const UA_NodeHead *target = UA_NodePointer_getNode(t->targetId);
+    if(target)
+        unswizzleTarget(t, container_of(target, UA_NodeMapEntry, node));
+    return NULL;
+}
+
+/* Revert the direct pointers of a node that is no longer in the hash-map but
+ * still used */
+static void
+unswizzleNode(UA_NodeMapEntry *entry) {
+    UA_NodeHead *head = &entry->node.head;
+    for(size_t i = 0; i < head->referencesSize; i++)
+        UA_NodeReferenceKind_iterate(&head->references[i],
+                                     unswizzleTargetCallback, NULL);
+}
+
+/* Redirect the direct pointers to the node to the replacement. Or revert them
+ * to the NodeId if the replacement is NULL. */
+static void
+fixReferrers(UA_NodeMap *ns, UA_NodeMapEntry *entry,
+             UA_NodeMapEntry *replacement) {
+    UA_NodeMapEntryExt *ext = entry->ext;
+    UA_ExpandedNodeId en = localTarget(&entry->node.head.nodeId);
+    for(UA_UInt32 i = 0; i < ext->referrersSize; i++) {
+        UA_NodeId id = UA_NodePointer_toNodeId(ext->referrers[i]);
+        UA_NodeMapSlot *slot = findOccupiedSlot(ns, &id);
+        if(!slot)
+            continue;
+        UA_NodeHead *head = &slot->entry->node.head;
+        for(size_t j = 0; j < head->referencesSize; j++) {
+            UA_ReferenceTarget *t = findDirectTarget(&head->references[j], &en);
+            if(!t || UA_NodePointer_getNode(t->targetId) != &entry->node.head)
+                continue;
+            if(replacement)
+                t->targetId = UA_NodePointer_fromNode(&replacement->node.head);
+            else
+                unswizzleTarget(t, entry);
+        }
+    }
+
+    if(!replacement)
+        return;
+
+    /* Move the referrers to the replacement */
+    UA_NodeMapEntryExt *rext = replacement->ext;
+    rext->referrers = ext->referrers;
+    rext->referrersSize = ext->referrersSize;
+    rext->referrersCapacity = ext->referrersCapacity;
+    ext->referrers = NULL;
+    ext->referrersSize = 0;
+    ext->referrersCapacity = 0;
+}
+
+/* Switch to a tree or a sorted array for many targets. The sorted array
+ * merges its tail by itself. Does nothing upon error. */
+static void
+organizeReferenceKind(UA_NodeMap *ns, UA_NodeReferenceKind *rk) {
+    if(rk->targetsSize <= 16 || rk->hasRefTree || rk->hasSortedArray)
+        return;
+    if(ns->sortedReferences)
+        UA_NodeReferenceKind_sort(rk);
+    else
+        UA_NodeReferenceKind_switch(rk);
+}
+
+static void
+cleanupNodeMapEntry(UA_NodeMap *ns, UA_NodeMapEntry *entry) {
+    if(entry->refCount > 0)
+        return;
+    if(entry->deleted) {
+        if(!entry->ext || !entry->ext->pinned) {
+            deleteNodeMapEntry(ns, entry);
+            return;
+        }
+        /* Keep the memory until the nodestore is deleted. If the array
+         * cannot grow, the entry leaks instead of leaving a dangling
+         * pointer. */
+        UA_NodeMapEntry **pinned = (UA_NodeMapEntry**)
+            UA_realloc(ns->pinned, sizeof(UA_NodeMapEntry*) * (ns->pinnedSize + 1));
+        if(pinned) {
+            ns->pinned = pinned;
+            ns->pinned[ns->pinnedSize++] = entry;
+        }
+        return;
+    }
+    for(size_t i = 0; i < entry->node.head.referencesSize; i++)
+        organizeReferenceKind(ns, &entry->node.head.references[i]);
+
+    if(!entry->ext || !entry->ext->edited)
+        return;
+    entry->ext->edited = false;
+
+    /* Share the unchanged strings again */
+    if(ns->internStrings)
+        internNode(ns, entry);
+
+    /* Swizzle the references that were added during the edit */
+    if(ns->directPointers) {
+        size_t total = countTargets(&entry->node.head);
+        if(total <= UA_NODEMAP_SWIZZLE_MINSCAN ||
+           total >= 2 * (size_t)entry->ext->scannedTargets)
+            swizzleNode(ns, entry);
+    }
+}
+
 /***********************/
 /* Interface functions */
 /***********************/
 
 static UA_Node *
 UA_NodeMap_newNode(void *context, UA_NodeClass nodeClass) {
-    UA_NodeMapEntry *entry = createEntry(nodeClass);
+    UA_NodeMapEntry *entry = createEntry((UA_NodeMap*)context, nodeClass);
     if(!entry)
         return NULL;
     return &entry->node;
@@ -248,9 +767,10 @@ UA_NodeMap_newNode(void *context, UA_NodeClass nodeClass) {
 
 static void
 UA_NodeMap_deleteNode(void *context, UA_Node *node) {
+    UA_NodeMap *ns = (UA_NodeMap*)context;
     UA_NodeMapEntry *entry = container_of(node, UA_NodeMapEntry, node);
     UA_assert(&entry->node == node);
-    deleteNodeMapEntry(entry);
+    deleteNodeMapEntry(ns, entry);
 }
 
 static const UA_Node *
@@ -273,6 +793,18 @@ UA_NodeMap_getNodeFromPtr(void *context, UA_NodePointer ptr,
                           UA_BrowseDirection referenceDirections) {
     if(!UA_NodePointer_isLocal(ptr))
         return NULL;
+
+    /* Direct pointer. Only pinned nodes can be deleted and still be pointed
+     * to. Then look up the current node with that NodeId. */
+    const UA_NodeHead *head = UA_NodePointer_getNode(ptr);
+    if(head) {
+        UA_NodeMapEntry *entry = container_of(head, UA_NodeMapEntry, node);
+        if(!entry->deleted) {
+            ++entry->refCount;
+            return &entry->node;
+        }
+    }
+
     UA_NodeId id = UA_NodePointer_toNodeId(ptr);
     return UA_NodeMap_getNode(context, &id, attributeMask, references, referenceDirections);
 }
@@ -285,7 +817,50 @@ UA_NodeMap_releaseNode(void *context, const UA_Node *node) {
     UA_assert(&entry->node == node);
     UA_assert(entry->refCount > 0);
     --entry->refCount;
-    cleanupNodeMapEntry(entry);
+    cleanupNodeMapEntry((UA_NodeMap*)context, entry);
+}
+
+/* Only used in the direct pointer and string interning modes. Marks the node
+ * to be swizzled and interned again after the edit. An edit of only the value
+ * touches neither the strings nor the references. */
+static UA_Node *
+prepareEdit(UA_NodeMap *ns, const UA_Node *node, UA_UInt32 attributeMask,
+            UA_ReferenceTypeSet references) {
+    if(!node)
+        return NULL;
+    UA_NodeMapEntry *entry = container_of(node, UA_NodeMapEntry, node);
+    if(attributeMask == UA_NODEATTRIBUTESMASK_VALUE &&
+       memcmp(&references, &UA_REFERENCETYPESET_NONE,
+              sizeof(UA_ReferenceTypeSet)) == 0)
+        return &entry->node;
+    if(entry->ext->interned && materializeNode(entry) != UA_STATUSCODE_GOOD) {
+        UA_NodeMap_releaseNode(ns, node);
+        return NULL;
+    }
+    entry->ext->edited = true;
+    return &entry->node;
+}
+
+static UA_Node *
+UA_NodeMap_getEditNode(void *context, const UA_NodeId *nodeid,
+                       UA_UInt32 attributeMask,
+                       UA_ReferenceTypeSet references,
+                       UA_BrowseDirection referenceDirections) {
+    return prepareEdit((UA_NodeMap*)context,
+                       UA_NodeMap_getNode(context, nodeid, attributeMask,
+                                          references, referenceDirections),
+                       attributeMask, references);
+}
+
+static UA_Node *
+UA_NodeMap_getEditNodeFromPtr(void *context, UA_NodePointer ptr,
+                              UA_UInt32 attributeMask,
+                              UA_ReferenceTypeSet references,
+                              UA_BrowseDirection referenceDirections) {
+    return prepareEdit((UA_NodeMap*)context,
+                       UA_NodeMap_getNodeFromPtr(context, ptr, attributeMask,
+                                                 references, referenceDirections),
+                       attributeMask, references);
 }
 
 static UA_StatusCode
@@ -296,7 +871,7 @@ UA_NodeMap_getNodeCopy(void *context, const UA_NodeId *nodeid,
     if(!slot)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
     UA_NodeMapEntry *entry = slot->entry;
-    UA_NodeMapEntry *newItem = createEntry(entry->node.head.nodeClass);
+    UA_NodeMapEntry *newItem = createEntry(ns, entry->node.head.nodeClass);
     if(!newItem)
         return UA_STATUSCODE_BADOUTOFMEMORY;
     UA_StatusCode retval = UA_Node_copy(&entry->node, &newItem->node);
@@ -304,7 +879,7 @@ UA_NodeMap_getNodeCopy(void *context, const UA_NodeId *nodeid,
         newItem->orig = entry; /* Store the pointer to the original */
         *outNode = &newItem->node;
     } else {
-        deleteNodeMapEntry(newItem);
+        deleteNodeMapEntry(ns, newItem);
     }
     return retval;
 }
@@ -318,8 +893,15 @@ UA_NodeMap_removeNode(void *context, const UA_NodeId *nodeid) {
 
     UA_NodeMapEntry *entry = slot->entry;
     slot->entry = UA_NODEMAP_TOMBSTONE;
+    if(ns->directPointers) {
+        fixReferrers(ns, entry, NULL);
+        /* The node is still used. Its direct pointers become stale once the
+         * targets are removed. */
+        if(entry->refCount > 0 || entry->ext->pinned)
+            unswizzleNode(entry);
+    }
     entry->deleted = true;
-    cleanupNodeMapEntry(entry);
+    cleanupNodeMapEntry(ns, entry);
     --ns->count;
     /* Downsize the hashmap if it is very empty */
     if(ns->count * 8 < ns->size && ns->size > UA_NODEMAP_MINSIZE)
@@ -327,6 +909,19 @@ UA_NodeMap_removeNode(void *context, const UA_NodeId *nodeid) {
     return UA_STATUSCODE_GOOD;
 }
 
+/* Resize once for the expected number of nodes. So that the table is not
+ * rehashed repeatedly during the insertion. */
+static UA_StatusCode
+UA_NodeMap_reserve(void *context, size_t additionalNodes) {
+    UA_NodeMap *ns = (UA_NodeMap*)context;
+    if(additionalNodes > UA_UINT32_MAX / 4 - ns->count)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_UInt32 count = ns->count + (UA_UInt32)additionalNodes;
+    if(ns->size * 3 > count * 4)
+        return UA_STATUSCODE_GOOD;
+    return resize(ns, higher_prime_index(count * 2));
+}
+
 /*
  * If this function fails in any way, the node parameter is deleted here,
  * so the caller function does not need to take care of it anymore
@@ -337,7 +932,7 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
     UA_NodeMap *ns = (UA_NodeMap*)context;
     if(ns->size * 3 <= ns->count * 4) {
         if(expand(ns) != UA_STATUSCODE_GOOD){
-            deleteNodeMapEntry(container_of(node, UA_NodeMapEntry, node));
+            deleteNodeMapEntry(ns, container_of(node, UA_NodeMapEntry, node));
             return UA_STATUSCODE_BADINTERNALERROR;
         }
     }
@@ -380,7 +975,7 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
     }
 
     if(!slot) {
-        deleteNodeMapEntry(container_of(node, UA_NodeMapEntry, node));
+        deleteNodeMapEntry(ns, container_of(node, UA_NodeMapEntry, node));
         return UA_STATUSCODE_BADNODEIDEXISTS;
     }
 
@@ -389,7 +984,7 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
     if(addedNodeId) {
         retval = UA_NodeId_copy(&node->head.nodeId, addedNodeId);
         if(retval != UA_STATUSCODE_GOOD) {
-            deleteNodeMapEntry(container_of(node, UA_NodeMapEntry, node));
+            deleteNodeMapEntry(ns, container_of(node, UA_NodeMapEntry, node));
             return retval;
         }
     }
@@ -398,13 +993,13 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
     if(node->head.nodeClass == UA_NODECLASS_REFERENCETYPE) {
         UA_ReferenceTypeNode *refNode = &node->referenceTypeNode;
         if(ns->referenceTypeCounter >= UA_REFERENCETYPESET_MAX) {
-            deleteNodeMapEntry(container_of(node, UA_NodeMapEntry, node));
+            deleteNodeMapEntry(ns, container_of(node, UA_NodeMapEntry, node));
             return UA_STATUSCODE_BADINTERNALERROR;
         }
 
         retval = UA_NodeId_copy(&node->head.nodeId, &ns->referenceTypeIds[ns->referenceTypeCounter]);
         if(retval != UA_STATUSCODE_GOOD) {
-            deleteNodeMapEntry(container_of(node, UA_NodeMapEntry, node));
+            deleteNodeMapEntry(ns, container_of(node, UA_NodeMapEntry, node));
             return UA_STATUSCODE_BADINTERNALERROR;
         }
 
@@ -420,6 +1015,10 @@ UA_NodeMap_insertNode(void *context, UA_Node *node,
     slot->nodeIdHash = UA_NodeId_hash(&node->head.nodeId);
     slot->entry = newEntry;
     ++ns->count;
+    if(ns->internStrings)
+        internNode(ns, newEntry);
+    if(ns->directPointers)
+        swizzleNode(ns, newEntry);
     return retval;
 }
 
@@ -431,21 +1030,30 @@ UA_NodeMap_replaceNode(void *context, UA_Node *node) {
     /* Find the node */
     UA_NodeMapSlot *slot = findOccupiedSlot(ns, &node->head.nodeId);
     if(!slot) {
-        deleteNodeMapEntry(newEntry);
+        deleteNodeMapEntry(ns, newEntry);
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
     }
 
     /* The node was already updated since the copy was made? */
     UA_NodeMapEntry *oldEntry = slot->entry;
     if(oldEntry != newEntry->orig) {
-        deleteNodeMapEntry(newEntry);
+        deleteNodeMapEntry(ns, newEntry);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
 
     /* Replace the entry */
     slot->entry = newEntry;
+    if(ns->directPointers) {
+        fixReferrers(ns, oldEntry, newEntry);
+        if(oldEntry->refCount > 0 || oldEntry->ext->pinned)
+            unswizzleNode(oldEntry);
+    }
     oldEntry->deleted = true;
-    cleanupNodeMapEntry(oldEntry);
+    cleanupNodeMapEntry(ns, oldEntry);
+    if(ns->internStrings)
+        internNode(ns, newEntry);
+    if(ns->directPointers)
+        swizzleNode(ns, newEntry);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -468,11 +1076,807 @@ UA_NodeMap_iterate(void *context, UA_NodestoreVisitor visitor,
             slot->entry->refCount++;
             visitor(visitorContext, &slot->entry->node);
             slot->entry->refCount--;
-            cleanupNodeMapEntry(slot->entry);
+            cleanupNodeMapEntry(ns, slot->entry);
         }
     }
 }
 
+/************/
+/* Snapshot */
+/************/
+
+/* The snapshot begins with a header (magic number, version, number of nodes).
+ * Then follows one record per node: the encoded length of the record, the
+ * NodeId and a Variant with an array of Variants for the remaining fields of
+ * the node. The ReferenceTypes come first. So the ReferenceTypeIndex of the
+ * references can be mapped to the ReferenceTypes of the restoring Nodestore.
+ *
+ * The restore decodes only the NodeIds in a first pass to size the hash-map
+ * once for the new nodes. */
+
+#define UA_NODEMAP_SNAPSHOT_MAGIC 0x534e4155 /* "UANS" */
+#define UA_NODEMAP_SNAPSHOT_VERSION 1
+#define UA_NODEMAP_SNAPSHOT_HEADERSIZE 12
+
+/* Fields of all NodeClasses. The fields specific to the NodeClass follow. */
+enum {
+    UA_SNAPSHOT_NODECLASS,     /* Int32 */
+    UA_SNAPSHOT_BROWSENAME,
+    UA_SNAPSHOT_DISPLAYNAME,   /* LocalizedText[] */
+    UA_SNAPSHOT_DESCRIPTION,   /* LocalizedText[] */
+    UA_SNAPSHOT_WRITEMASK,
+    UA_SNAPSHOT_CONSTRUCTED,
+    UA_SNAPSHOT_REFTYPES,      /* Byte[] ReferenceTypeIndex of each kind */
+    UA_SNAPSHOT_REFINVERSE,    /* Boolean[] direction of each kind */
+    UA_SNAPSHOT_REFSIZES,      /* UInt32[] number of targets of each kind */
+    UA_SNAPSHOT_REFTARGETS,    /* ExpandedNodeId[] targets of all kinds */
+    UA_SNAPSHOT_REFNAMEHASHES, /* UInt32[] target BrowseName hashes */
+    UA_SNAPSHOT_HEADFIELDS
+};
+
+/* ReferenceTypes: IsAbstract, Symmetric, InverseName, ReferenceTypeIndex,
+ * SubTypes (UInt32[]) */
+#define UA_SNAPSHOT_REFTYPEINDEX (UA_SNAPSHOT_HEADFIELDS + 3)
+#define UA_SNAPSHOT_SUBTYPES (UA_SNAPSHOT_HEADFIELDS + 4)
+
+#define UA_SNAPSHOT_MAXFIELDS (UA_SNAPSHOT_HEADFIELDS + 8)
+
+typedef struct {
+    UA_Variant fields[UA_SNAPSHOT_MAXFIELDS];
+    size_t fieldsSize;
+
+    /* Temporary arrays that the fields point into */
+    UA_LocalizedText *displayName;
+    UA_LocalizedText *description;
+    UA_Byte *refTypes;
+    UA_Boolean *refInverse;
+    UA_UInt32 *refSizes;
+    UA_ExpandedNodeId *refTargets;
+    UA_UInt32 *refNameHashes;
+    size_t refTargetsSize;
+} UA_SnapshotRecord;
+
+typedef struct {
+    UA_ByteString buf;
+    size_t pos;
+} UA_SnapshotBuffer;
+
+/* The fields point to the memory of the node. They are not cleaned up. */
+static void
+setScalarField(UA_SnapshotRecord *r, const void *p, const UA_DataType *type) {
+    UA_Variant_setScalar(&r->fields[r->fieldsSize++], (void*)(uintptr_t)p, type);
+}
+
+static void
+setArrayField(UA_SnapshotRecord *r, const void *p, size_t size,
+              const UA_DataType *type) {
+    UA_Variant_setArray(&r->fields[r->fieldsSize++], (void*)(uintptr_t)p,
+                        size, type);
+}
+
+static UA_StatusCode
+setLocalizedTextsField(UA_SnapshotRecord *r, const UA_LocalizedTextListEntry *lt,
+                       UA_LocalizedText **texts) {
+    size_t size = 0;
+    for(const UA_LocalizedTextListEntry *e = lt; e; e = e->next)
+        size++;
+    if(size > 0) {
+        *texts = (UA_LocalizedText*)UA_malloc(size * sizeof(UA_LocalizedText));
+        if(!*texts)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        size = 0;
+        for(const UA_LocalizedTextListEntry *e = lt; e; e = e->next)
+            (*texts)[size++] = e->localizedText; /* Shallow copy */
+    }
+    setArrayField(r, *texts, size, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void *
+snapshotTargetCallback(void *context, UA_ReferenceTarget *t) {
+    UA_SnapshotRecord *r = (UA_SnapshotRecord*)context;
+    r->refTargets[r->refTargetsSize] = UA_NodePointer_toExpandedNodeId(t->targetId);
+    r->refNameHashes[r->refTargetsSize] = t->targetNameHash;
+    r->refTargetsSize++;
+    return NULL;
+}
+
+static UA_StatusCode
+setReferenceFields(UA_SnapshotRecord *r, const UA_NodeHead *head) {
+    size_t kinds = head->referencesSize;
+    size_t total = countTargets(head);
+    if(kinds > 0) {
+        r->refTypes = (UA_Byte*)UA_malloc(kinds * sizeof(UA_Byte));
+        r->refInverse = (UA_Boolean*)UA_malloc(kinds * sizeof(UA_Boolean));
+        r->refSizes = (UA_UInt32*)UA_malloc(kinds * sizeof(UA_UInt32));
+        if(!r->refTypes || !r->refInverse || !r->refSizes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(total > 0) {
+        r->refTargets = (UA_ExpandedNodeId*)
+            UA_malloc(total * sizeof(UA_ExpandedNodeId));
+        r->refNameHashes = (UA_UInt32*)UA_malloc(total * sizeof(UA_UInt32));
+        if(!r->refTargets || !r->refNameHashes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    for(size_t i = 0; i < kinds; i++) {
+        UA_NodeReferenceKind *rk = &head->references[i];
+        r->refTypes[i] = rk->referenceTypeIndex;
+        r->refInverse[i] = rk->isInverse;
+        r->refSizes[i] = (UA_UInt32)rk->targetsSize;
+        UA_NodeReferenceKind_iterate(rk, snapshotTargetCallback, r);
+    }
+
+    setArrayField(r, r->refTypes, kinds, &UA_TYPES[UA_TYPES_BYTE]);
+    setArrayField(r, r->refInverse, kinds, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    setArrayField(r, r->refSizes, kinds, &UA_TYPES[UA_TYPES_UINT32]);
+    setArrayField(r, r->refTargets, r->refTargetsSize,
+                  &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+    setArrayField(r, r->refNameHashes, r->refTargetsSize,
+                  &UA_TYPES[UA_TYPES_UINT32]);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* DataType, ValueRank, ArrayDimensions and the value. The value is only
+ * included if it is held in the node. */
+static void
+setVariableFields(UA_SnapshotRecord *r, const UA_NodeId *dataType,
+                  const UA_Int32 *valueRank, const UA_UInt32 *arrayDimensions,
+                  size_t arrayDimensionsSize, UA_ValueSource valueSource,
+                  const UA_DataValue *value) {
+    setScalarField(r, dataType, &UA_TYPES[UA_TYPES_NODEID]);
+    setScalarField(r, valueRank, &UA_TYPES[UA_TYPES_INT32]);
+    setArrayField(r, arrayDimensions, arrayDimensionsSize,
+                  &UA_TYPES[UA_TYPES_UINT32]);
+    if(valueSource == UA_VALUESOURCE_DATA)
+        setScalarField(r, value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    else
+        UA_Variant_init(&r->fields[r->fieldsSize++]);
+}
+
+static UA_StatusCode
+setRecordFields(UA_SnapshotRecord *r, const UA_Node *node) {
+    const UA_NodeHead *head = &node->head;
+    /* Enumerations are decoded as Int32 from a Variant */
+    setScalarField(r, &head->nodeClass, &UA_TYPES[UA_TYPES_INT32]);
+    setScalarField(r, &head->browseName, &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    UA_StatusCode res =
+        setLocalizedTextsField(r, head->displayName, &r->displayName);
+    res |= setLocalizedTextsField(r, head->description, &r->description);
+    setScalarField(r, &head->writeMask, &UA_TYPES[UA_TYPES_UINT32]);
+    setScalarField(r, &head->constructed, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    res |= setReferenceFields(r, head);
+    if(res != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    switch(head->nodeClass) {
+    case UA_NODECLASS_VARIABLE: {
+        const UA_VariableNode *vn = &node->variableNode;
+        setVariableFields(r, &vn->dataType, &vn->valueRank, vn->arrayDimensions,
+                          vn->arrayDimensionsSize, vn->valueSource,
+                          &vn->value.data.value);
+        setScalarField(r, &vn->accessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        setScalarField(r, &vn->minimumSamplingInterval, &UA_TYPES[UA_TYPES_DOUBLE]);
+        setScalarField(r, &vn->historizing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        setScalarField(r, &vn->isDynamic, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLETYPE: {
+        const UA_VariableTypeNode *vtn = &node->variableTypeNode;
+        setVariableFields(r, &vtn->dataType, &vtn->valueRank, vtn->arrayDimensions,
+                          vtn->arrayDimensionsSize, vtn->valueSource,
+                          &vtn->value.data.value);
+        setScalarField(r, &vtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_METHOD:
+        setScalarField(r, &node->methodNode.executable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    case UA_NODECLASS_OBJECT:
+        setScalarField(r, &node->objectNode.eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    case UA_NODECLASS_OBJECTTYPE:
+        setScalarField(r, &node->objectTypeNode.isAbstract,
+                       &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    case UA_NODECLASS_REFERENCETYPE: {
+        const UA_ReferenceTypeNode *rtn = &node->referenceTypeNode;
+        setScalarField(r, &rtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        setScalarField(r, &rtn->symmetric, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        setScalarField(r, &rtn->inverseName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+        setScalarField(r, &rtn->referenceTypeIndex, &UA_TYPES[UA_TYPES_BYTE]);
+        setArrayField(r, rtn->subTypes.bits, UA_REFERENCETYPESET_MAX / 32,
+                      &UA_TYPES[UA_TYPES_UINT32]);
+        break;
+    }
+    case UA_NODECLASS_DATATYPE:
+        setScalarField(r, &node->dataTypeNode.isAbstract,
+                       &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    case UA_NODECLASS_VIEW:
+        setScalarField(r, &node->viewNode.eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        setScalarField(r, &node->viewNode.containsNoLoops,
+                       &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    default:
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+clearRecord(UA_SnapshotRecord *r) {
+    UA_free(r->displayName);
+    UA_free(r->description);
+    UA_free(r->refTypes);
+    UA_free(r->refInverse);
+    UA_free(r->refSizes);
+    UA_free(r->refTargets);
+    UA_free(r->refNameHashes);
+}
+
+static UA_StatusCode
+growSnapshotBuffer(UA_SnapshotBuffer *sb, size_t len) {
+    if(sb->buf.length - sb->pos >= len)
+        return UA_STATUSCODE_GOOD;
+    size_t newLength = (sb->buf.length > 0) ? sb->buf.length : 4096;
+    while(newLength - sb->pos < len)
+        newLength *= 2;
+    UA_Byte *data = (UA_Byte*)UA_realloc(sb->buf.data, newLength);
+    if(!data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    sb->buf.data = data;
+    sb->buf.length = newLength;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Encode into the space that was reserved in the buffer */
+static UA_StatusCode
+encodeAt(UA_SnapshotBuffer *sb, size_t pos, size_t len,
+         const void *p, const UA_DataType *type) {
+    UA_ByteString dst = {len, &sb->buf.data[pos]};
+    return UA_encodeBinary(p, type, &dst);
+}
+
+static UA_StatusCode
+writeRecord(UA_SnapshotBuffer *sb, const UA_Node *node) {
+    UA_SnapshotRecord r;
+    memset(&r, 0, sizeof(UA_SnapshotRecord));
+    UA_Variant fields;
+    size_t idLen, fieldsLen;
+    UA_UInt32 len;
+    UA_StatusCode res = setRecordFields(&r, node);
+    if(res != UA_STATUSCODE_GOOD)
+        goto cleanup;
+
+    UA_Variant_setArray(&fields, r.fields, r.fieldsSize,
+                        &UA_TYPES[UA_TYPES_VARIANT]);
+    idLen = UA_calcSizeBinary(&node->head.nodeId, &UA_TYPES[UA_TYPES_NODEID]);
+    fieldsLen = UA_calcSizeBinary(&fields, &UA_TYPES[UA_TYPES_VARIANT]);
+    if(idLen == 0 || fieldsLen == 0 || idLen + fieldsLen > UA_UINT32_MAX) {
+        res = UA_STATUSCODE_BADENCODINGERROR;
+        goto cleanup;
+    }
+
+    len = (UA_UInt32)(idLen + fieldsLen);
+    res = growSnapshotBuffer(sb, 4 + (size_t)len);
+    if(res != UA_STATUSCODE_GOOD)
+        goto cleanup;
+    res = encodeAt(sb, sb->pos, 4, &len, &UA_TYPES[UA_TYPES_UINT32]);
+    res |= encodeAt(sb, sb->pos + 4, idLen, &node->head.nodeId,
+                    &UA_TYPES[UA_TYPES_NODEID]);
+    res |= encodeAt(sb, sb->pos + 4 + idLen, fieldsLen, &fields,
+                    &UA_TYPES[UA_TYPES_VARIANT]);
+    if(res == UA_STATUSCODE_GOOD)
+        sb->pos += 4 + (size_t)len;
+
+ cleanup:
+    clearRecord(&r);
+    return res;
+}
+
+static UA_StatusCode
+UA_NodeMap_snapshot(void *context, UA_ByteString *snapshot) {
+    UA_NodeMap *ns = (UA_NodeMap*)context;
+    UA_SnapshotBuffer sb;
+    memset(&sb, 0, sizeof(UA_SnapshotBuffer));
+    UA_StatusCode res = growSnapshotBuffer(&sb, UA_NODEMAP_SNAPSHOT_HEADERSIZE);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    sb.pos = UA_NODEMAP_SNAPSHOT_HEADERSIZE;
+
+    /* Write the ReferenceTypes in the first pass and all other nodes in the
+     * second pass */
+    UA_UInt32 nodesSize = 0;
+    for(size_t pass = 0; pass < 2; pass++) {
+        for(UA_UInt32 i = 0; i < ns->size; ++i) {
+            UA_NodeMapSlot *slot = &ns->slots[i];
+            if(slot->entry <= UA_NODEMAP_TOMBSTONE)
+                continue;
+            const UA_Node *node = &slot->entry->node;
+            if((node->head.nodeClass == UA_NODECLASS_REFERENCETYPE) != (pass == 0))
+                continue;
+            res = writeRecord(&sb, node);
+            if(res != UA_STATUSCODE_GOOD) {
+                UA_ByteString_clear(&sb.buf);
+                return res;
+            }
+            nodesSize++;
+        }
+    }
+
+    UA_UInt32 header[3] = {UA_NODEMAP_SNAPSHOT_MAGIC,
+                           UA_NODEMAP_SNAPSHOT_VERSION, nodesSize};
+    for(size_t i = 0; i < 3; i++)
+        res |= encodeAt(&sb, i * 4, 4, &header[i], &UA_TYPES[UA_TYPES_UINT32]);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_ByteString_clear(&sb.buf);
+        return res;
+    }
+
+    /* Release the unused space at the end. Keep the buffer if that fails. */
+    UA_Byte *data = (UA_Byte*)UA_realloc(sb.buf.data, sb.pos);
+    snapshot->data = (data) ? data : sb.buf.data;
+    snapshot->length = sb.pos;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Restore */
+
+typedef struct {
+    const UA_ByteString *snapshot;
+    size_t pos;
+    const UA_DecodeBinaryOptions *options;
+    UA_Byte refTypeMap[UA_REFERENCETYPESET_MAX]; /* Old to new index */
+} UA_SnapshotReader;
+
+#define UA_SNAPSHOT_UNMAPPED UA_REFERENCETYPESET_MAX
+
+/* Decode the next record. The fields are only decoded if the pointer is
+ * non-NULL. */
+static UA_StatusCode
+readRecord(UA_SnapshotReader *sr, UA_NodeId *nodeId, UA_Variant *fields) {
+    const UA_ByteString *s = sr->snapshot;
+    if(s->length - sr->pos < 4)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_ByteString buf = {4, &s->data[sr->pos]};
+    UA_UInt32 len;
+    UA_StatusCode res = UA_decodeBinary(&buf, &len, &UA_TYPES[UA_TYPES_UINT32], NULL);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    if(s->length - sr->pos - 4 < len)
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    buf.length = len;
+    buf.data = &s->data[sr->pos + 4];
+    res = UA_decodeBinary(&buf, nodeId, &UA_TYPES[UA_TYPES_NODEID], NULL);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+
+    if(fields) {
+        size_t idLen = UA_calcSizeBinary(nodeId, &UA_TYPES[UA_TYPES_NODEID]);
+        buf.length = len - idLen;
+        buf.data = &s->data[sr->pos + 4 + idLen];
+        res = UA_decodeBinary(&buf, fields, &UA_TYPES[UA_TYPES_VARIANT], sr->options);
+        if(res == UA_STATUSCODE_GOOD && !UA_Variant_hasArrayType(fields,
+                                                 &UA_TYPES[UA_TYPES_VARIANT])) {
+            UA_Variant_clear(fields);
+            res = UA_STATUSCODE_BADDECODINGERROR;
+        }
+        if(res != UA_STATUSCODE_GOOD) {
+            UA_NodeId_clear(nodeId);
+            return res;
+        }
+    }
+
+    sr->pos += 4 + (size_t)len;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_Variant *
+getField(UA_Variant *fields, size_t i, const UA_DataType *type, UA_Boolean array) {
+    if(i >= fields->arrayLength)
+        return NULL;
+    UA_Variant *f = &((UA_Variant*)fields->data)[i];
+    if(array)
+        return (UA_Variant_hasArrayType(f, type)) ? f : NULL;
+    return (UA_Variant_hasScalarType(f, type)) ? f : NULL;
+}
+
+/* Move the decoded scalar into the (initialized) target */
+static UA_StatusCode
+moveScalar(UA_Variant *fields, size_t i, void *dst, const UA_DataType *type) {
+    UA_Variant *f = getField(fields, i, type, false);
+    if(!f)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    memcpy(dst, f->data, type->memSize);
+    UA_init(f->data, type);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+moveLocalizedTexts(UA_Variant *fields, size_t i, UA_LocalizedTextListEntry **lt) {
+    UA_Variant *f = getField(fields, i, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], true);
+    if(!f)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    /* Prepend in reverse order to keep the order of the locales */
+    UA_LocalizedText *texts = (UA_LocalizedText*)f->data;
+    for(size_t j = f->arrayLength; j > 0; j--) {
+        UA_LocalizedTextListEntry *e = (UA_LocalizedTextListEntry*)
+            UA_malloc(sizeof(UA_LocalizedTextListEntry));
+        if(!e)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        e->localizedText = texts[j-1];
+        UA_LocalizedText_init(&texts[j-1]);
+        e->next = *lt;
+        *lt = e;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+moveVariableFields(UA_Variant *fields, size_t *i, UA_NodeId *dataType,
+                   UA_Int32 *valueRank, UA_UInt32 **arrayDimensions,
+                   size_t *arrayDimensionsSize, UA_DataValue *value) {
+    UA_StatusCode res =
+        moveScalar(fields, (*i)++, dataType, &UA_TYPES[UA_TYPES_NODEID]);
+    res |= moveScalar(fields, (*i)++, valueRank, &UA_TYPES[UA_TYPES_INT32]);
+    UA_Variant *f = getField(fields, (*i)++, &UA_TYPES[UA_TYPES_UINT32], true);
+    if(!f)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    *arrayDimensions = (UA_UInt32*)f->data;
+    *arrayDimensionsSize = f->arrayLength;
+    f->data = NULL;
+    f->arrayLength = 0;
+    /* The value is empty for variables with a DataSource */
+    if(*i < fields->arrayLength &&
+       UA_Variant_isEmpty(&((UA_Variant*)fields->data)[*i])) {
+        (*i)++;
+        return res;
+    }
+    return res | moveScalar(fields, (*i)++, value, &UA_TYPES[UA_TYPES_DATAVALUE]);
+}
+
+/* Move the attributes from the decoded record into the new node */
+static UA_StatusCode
+moveAttributes(UA_Node *node, UA_Variant *fields) {
+    UA_NodeHead *head = &node->head;
+    UA_StatusCode res = moveScalar(fields, UA_SNAPSHOT_BROWSENAME, &head->browseName,
+                                   &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    res |= moveLocalizedTexts(fields, UA_SNAPSHOT_DISPLAYNAME, &head->displayName);
+    res |= moveLocalizedTexts(fields, UA_SNAPSHOT_DESCRIPTION, &head->description);
+    res |= moveScalar(fields, UA_SNAPSHOT_WRITEMASK, &head->writeMask,
+                      &UA_TYPES[UA_TYPES_UINT32]);
+    res |= moveScalar(fields, UA_SNAPSHOT_CONSTRUCTED, &head->constructed,
+                      &UA_TYPES[UA_TYPES_BOOLEAN]);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+
+    size_t i = UA_SNAPSHOT_HEADFIELDS;
+    switch(head->nodeClass) {
+    case UA_NODECLASS_VARIABLE: {
+        UA_VariableNode *vn = &node->variableNode;
+        res = moveVariableFields(fields, &i, &vn->dataType, &vn->valueRank,
+                                 &vn->arrayDimensions, &vn->arrayDimensionsSize,
+                                 &vn->value.data.value);
+        res |= moveScalar(fields, i++, &vn->accessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        res |= moveScalar(fields, i++, &vn->minimumSamplingInterval,
+                          &UA_TYPES[UA_TYPES_DOUBLE]);
+        res |= moveScalar(fields, i++, &vn->historizing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        res |= moveScalar(fields, i++, &vn->isDynamic, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLETYPE: {
+        UA_VariableTypeNode *vtn = &node->variableTypeNode;
+        res = moveVariableFields(fields, &i, &vtn->dataType, &vtn->valueRank,
+                                 &vtn->arrayDimensions, &vtn->arrayDimensionsSize,
+                                 &vtn->value.data.value);
+        res |= moveScalar(fields, i++, &vtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_METHOD:
+        res = moveScalar(fields, i++, &node->methodNode.executable,
+                         &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    case UA_NODECLASS_OBJECT:
+        res = moveScalar(fields, i++, &node->objectNode.eventNotifier,
+                         &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    case UA_NODECLASS_OBJECTTYPE:
+        res = moveScalar(fields, i++, &node->objectTypeNode.isAbstract,
+                         &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    case UA_NODECLASS_REFERENCETYPE: {
+        /* The ReferenceTypeIndex is assigned during the insert */
+        UA_ReferenceTypeNode *rtn = &node->referenceTypeNode;
+        res = moveScalar(fields, i++, &rtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        res |= moveScalar(fields, i++, &rtn->symmetric, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        res |= moveScalar(fields, i++, &rtn->inverseName,
+                          &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+        break;
+    }
+    case UA_NODECLASS_DATATYPE:
+        res = moveScalar(fields, i++, &node->dataTypeNode.isAbstract,
+                         &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    case UA_NODECLASS_VIEW:
+        res = moveScalar(fields, i++, &node->viewNode.eventNotifier,
+                         &UA_TYPES[UA_TYPES_BYTE]);
+        res |= moveScalar(fields, i++, &node->viewNode.containsNoLoops,
+                          &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    default:
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    return res;
+}
+
+/* Add the references from the record that are not yet in the node. Returns
+ * the number of added references. */
+static UA_StatusCode
+restoreReferences(UA_NodeMap *ns, UA_SnapshotReader *sr, UA_Node *node,
+                  UA_Variant *fields, size_t *added) {
+    UA_Variant *types = getField(fields, UA_SNAPSHOT_REFTYPES,
+                                 &UA_TYPES[UA_TYPES_BYTE], true);
+    UA_Variant *inverse = getField(fields, UA_SNAPSHOT_REFINVERSE,
+                                   &UA_TYPES[UA_TYPES_BOOLEAN], true);
+    UA_Variant *sizes = getField(fields, UA_SNAPSHOT_REFSIZES,
+                                 &UA_TYPES[UA_TYPES_UINT32], true);
+    UA_Variant *targets = getField(fields, UA_SNAPSHOT_REFTARGETS,
+                                   &UA_TYPES[UA_TYPES_EXPANDEDNODEID], true);
+    UA_Variant *hashes = getField(fields, UA_SNAPSHOT_REFNAMEHASHES,
+                                  &UA_TYPES[UA_TYPES_UINT32], true);
+    if(!types || !inverse || !sizes || !targets || !hashes ||
+       inverse->arrayLength != types->arrayLength ||
+       sizes->arrayLength != types->arrayLength ||
+       hashes->arrayLength != targets->arrayLength)
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    size_t pos = 0;
+    for(size_t i = 0; i < types->arrayLength; i++) {
+        UA_Byte oldIndex = ((UA_Byte*)types->data)[i];
+        UA_Boolean isInverse = ((UA_Boolean*)inverse->data)[i];
+        size_t size = ((UA_UInt32*)sizes->data)[i];
+        if(oldIndex >= UA_REFERENCETYPESET_MAX ||
+           sr->refTypeMap[oldIndex] == UA_SNAPSHOT_UNMAPPED)
+            return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+        if(targets->arrayLength - pos < size)
+            return UA_STATUSCODE_BADDECODINGERROR;
+
+        UA_Byte refTypeIndex = sr->refTypeMap[oldIndex];
+        const UA_ExpandedNodeId *ids = &((UA_ExpandedNodeId*)targets->data)[pos];
+        const UA_UInt32 *nameHashes = &((UA_UInt32*)hashes->data)[pos];
+        pos += size;
+        for(size_t j = 0; j < size; j++) {
+            UA_StatusCode res =
+                UA_Node_addReference(node, refTypeIndex, !isInverse,
+                                     &ids[j], nameHashes[j]);
+            if(res == UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED)
+                continue;
+            if(res != UA_STATUSCODE_GOOD)
+                return res;
+            (*added)++;
+
+            /* Add many targets to a tree or sorted array and not to the
+             * (linear) array */
+            if(j > 0 || size <= 16)
+                continue;
+            UA_NodeReferenceKind *rk = NULL;
+            for(size_t k = 0; k < node->head.referencesSize; k++) {
+                rk = &node->head.references[k];
+                if(rk->referenceTypeIndex == refTypeIndex &&
+                   rk->isInverse == isInverse)
+                    break;
+            }
+            organizeReferenceKind(ns, rk);
+
+            /* The sorted array takes the remaining targets in one batch */
+            if(!rk->hasSortedArray)
+                continue;
+            size_t batchAdded = 0;
+            res = UA_Node_addReferences(node, refTypeIndex, !isInverse, size - 1,
+                                        &ids[1], &nameHashes[1], &batchAdded);
+            *added += batchAdded;
+            if(res != UA_STATUSCODE_GOOD)
+                return res;
+            break;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Map the ReferenceTypeIndex from the snapshot to the ReferenceType in the
+ * Nodestore. Adds the ReferenceType (without references) if it does not
+ * exist. */
+static UA_StatusCode
+restoreReferenceType(UA_NodeMap *ns, UA_SnapshotReader *sr,
+                     const UA_NodeId *nodeId, UA_Variant *fields) {
+    UA_Variant *f = getField(fields, UA_SNAPSHOT_REFTYPEINDEX,
+                             &UA_TYPES[UA_TYPES_BYTE], false);
+    if(!f || *(UA_Byte*)f->data >= UA_REFERENCETYPESET_MAX)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_Byte oldIndex = *(UA_Byte*)f->data;
+
+    UA_NodeMapSlot *slot = findOccupiedSlot(ns, nodeId);
+    if(slot) {
+        const UA_Node *node = &slot->entry->node;
+        if(node->head.nodeClass != UA_NODECLASS_REFERENCETYPE)
+            return UA_STATUSCODE_BADNODECLASSINVALID;
+        sr->refTypeMap[oldIndex] = node->referenceTypeNode.referenceTypeIndex;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_NodeMapEntry *entry = createEntry(ns, UA_NODECLASS_REFERENCETYPE);
+    if(!entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_Node *node = &entry->node;
+    UA_StatusCode res = UA_NodeId_copy(nodeId, &node->head.nodeId);
+    res |= moveAttributes(node, fields);
+    if(res != UA_STATUSCODE_GOOD) {
+        deleteNodeMapEntry(ns, entry);
+        return res;
+    }
+    res = UA_NodeMap_insertNode(ns, node, NULL);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+    sr->refTypeMap[oldIndex] = node->referenceTypeNode.referenceTypeIndex;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Add the SubTypes from the snapshot to the ReferenceType */
+static UA_StatusCode
+restoreSubTypes(UA_SnapshotReader *sr, UA_ReferenceTypeNode *node,
+                UA_Variant *fields) {
+    UA_Variant *f = getField(fields, UA_SNAPSHOT_SUBTYPES,
+                             &UA_TYPES[UA_TYPES_UINT32], true);
+    if(!f || f->arrayLength != UA_REFERENCETYPESET_MAX / 32)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_ReferenceTypeSet subTypes;
+    memcpy(subTypes.bits, f->data, sizeof(subTypes.bits));
+    for(UA_Byte i = 0; i < UA_REFERENCETYPESET_MAX; i++) {
+        if(!UA_ReferenceTypeSet_contains(&subTypes, i))
+            continue;
+        if(sr->refTypeMap[i] == UA_SNAPSHOT_UNMAPPED)
+            return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+        node->subTypes = UA_ReferenceTypeSet_union(node->subTypes,
+                                                   UA_REFTYPESET(sr->refTypeMap[i]));
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+restoreNode(UA_NodeMap *ns, UA_SnapshotReader *sr,
+            const UA_NodeId *nodeId, UA_Variant *fields) {
+    UA_Variant *f = getField(fields, UA_SNAPSHOT_NODECLASS,
+                             &UA_TYPES[UA_TYPES_INT32], false);
+    if(!f)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_NodeClass nodeClass = (UA_NodeClass)*(UA_Int32*)f->data;
+
+    /* Merge the references into the existing node. Only the references are
+     * changed, so the strings of the node don't need to be materialized. */
+    size_t added = 0;
+    UA_StatusCode res;
+    UA_NodeMapSlot *slot = findOccupiedSlot(ns, nodeId);
+    if(slot) {
+        UA_NodeMapEntry *entry = slot->entry;
+        UA_Node *node = &entry->node;
+        if(node->head.nodeClass != nodeClass)
+            return UA_STATUSCODE_BADNODECLASSINVALID;
+        res = restoreReferences(ns, sr, node, fields, &added);
+        if(res == UA_STATUSCODE_GOOD && nodeClass == UA_NODECLASS_REFERENCETYPE)
+            res = restoreSubTypes(sr, &node->referenceTypeNode, fields);
+        if(added > 0 && ns->directPointers)
+            swizzleNode(ns, entry);
+        return res;
+    }
+
+    /* Add a new node */
+    UA_NodeMapEntry *entry = createEntry(ns, nodeClass);
+    if(!entry)
+        return UA_STATUSCODE_BADDECODINGERROR; /* Unknown NodeClass */
+    UA_Node *node = &entry->node;
+    res = UA_NodeId_copy(nodeId, &node->head.nodeId);
+    res |= moveAttributes(node, fields);
+    if(res == UA_STATUSCODE_GOOD)
+        res = restoreReferences(ns, sr, node, fields, &added);
+    if(res != UA_STATUSCODE_GOOD) {
+        deleteNodeMapEntry(ns, entry);
+        return res;
+    }
+    return UA_NodeMap_insertNode(ns, node, NULL);
+}
+
+static UA_StatusCode
+UA_NodeMap_restore(void *context, const UA_ByteString *snapshot,
+                   const UA_DataTypeArray *customTypes) {
+    UA_NodeMap *ns = (UA_NodeMap*)context;
+
+    /* Decode the header */
+    if(snapshot->length < UA_NODEMAP_SNAPSHOT_HEADERSIZE)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_UInt32 header[3];
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < 3; i++) {
+        UA_ByteString buf = {4, &snapshot->data[i * 4]};
+        res |= UA_decodeBinary(&buf, &header[i], &UA_TYPES[UA_TYPES_UINT32], NULL);
+    }
+    if(res != UA_STATUSCODE_GOOD || header[0] != UA_NODEMAP_SNAPSHOT_MAGIC ||
+       header[1] != UA_NODEMAP_SNAPSHOT_VERSION)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_UInt32 nodesSize = header[2];
+
+    UA_DecodeBinaryOptions options;
+    memset(&options, 0, sizeof(UA_DecodeBinaryOptions));
+    options.customTypes = customTypes;
+
+    UA_SnapshotReader sr;
+    sr.snapshot = snapshot;
+    sr.options = &options;
+    memset(sr.refTypeMap, UA_SNAPSHOT_UNMAPPED, sizeof(sr.refTypeMap));
+
+    /* Count the new nodes and resize the hash-map once */
+    UA_NodeId nodeId;
+    size_t newNodes = 0;
+    sr.pos = UA_NODEMAP_SNAPSHOT_HEADERSIZE;
+    for(UA_UInt32 i = 0; i < nodesSize; i++) {
+        res = readRecord(&sr, &nodeId, NULL);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        if(!findOccupiedSlot(ns, &nodeId))
+            newNodes++;
+        UA_NodeId_clear(&nodeId);
+    }
+    if(sr.pos != snapshot->length)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    res = UA_NodeMap_reserve(ns, newNodes);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+
+    /* Map the ReferenceTypes. They are at the beginning of the snapshot. */
+    UA_Variant fields;
+    sr.pos = UA_NODEMAP_SNAPSHOT_HEADERSIZE;
+    for(UA_UInt32 i = 0; i < nodesSize; i++) {
+        res = readRecord(&sr, &nodeId, &fields);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        UA_Variant *f = getField(&fields, UA_SNAPSHOT_NODECLASS,
+                                 &UA_TYPES[UA_TYPES_INT32], false);
+        UA_Boolean isRefType = (f &&
+            *(UA_Int32*)f->data == UA_NODECLASS_REFERENCETYPE);
+        if(isRefType)
+            res = restoreReferenceType(ns, &sr, &nodeId, &fields);
+        UA_NodeId_clear(&nodeId);
+        UA_Variant_clear(&fields);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        if(!isRefType)
+            break;
+    }
+
+    /* Add the nodes and references */
+    sr.pos = UA_NODEMAP_SNAPSHOT_HEADERSIZE;
+    for(UA_UInt32 i = 0; i < nodesSize; i++) {
+        res = readRecord(&sr, &nodeId, &fields);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        res = restoreNode(ns, &sr, &nodeId, &fields);
+        UA_NodeId_clear(&nodeId);
+        UA_Variant_clear(&fields);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void *
+deleteInternedVisitor(void *context, UA_InternedString *is) {
+    UA_String_clear(&is->str);
+    UA_free(is);
+    return NULL;
+}
+
 static void
 UA_NodeMap_delete(void *context) {
     /* Already cleaned up? */
@@ -487,11 +1891,19 @@ UA_NodeMap_delete(void *context) {
             /* On debugging builds, check that all nodes were release */
             UA_assert(slots[i].entry->refCount == 0);
             /* Delete the node */
-            deleteNodeMapEntry(slots[i].entry);
+            deleteNodeMapEntry(ns, slots[i].entry);
         }
     }
     UA_free(ns->slots);
 
+    /* Delete the pinned nodes after all direct pointers are gone */
+    for(size_t i = 0; i < ns->pinnedSize; i++)
+        deleteNodeMapEntry(ns, ns->pinned[i]);
+    UA_free(ns->pinned);
+
+    /* Interned strings of nodes that were not released */
+    ZIP_ITER(UA_InternTree, &ns->interned, deleteInternedVisitor, NULL);
+
     /* Clean up the ReferenceTypes index array */
     for(size_t i = 0; i < ns->referenceTypeCounter; i++)
         UA_NodeId_clear(&ns->referenceTypeIds[i]);
@@ -516,6 +1928,12 @@ UA_Nodestore_HashMap(UA_Nodestore *ns) {
     }
 
     nodemap->referenceTypeCounter = 0;
+    nodemap->directPointers = false;
+    nodemap->pinned = NULL;
+    nodemap->pinnedSize = 0;
+    nodemap->internStrings = false;
+    nodemap->sortedReferences = false;
+    ZIP_INIT(&nodemap->interned);
 
     /* Populate the nodestore */
     ns->context = nodemap;
@@ -531,6 +1949,9 @@ UA_Nodestore_HashMap(UA_Nodestore *ns) {
     ns->removeNode = UA_NodeMap_removeNode;
     ns->getReferenceTypeId = UA_NodeMap_getReferenceTypeId;
     ns->iterate = UA_NodeMap_iterate;
+    ns->reserve = UA_NodeMap_reserve;
+    ns->snapshot = UA_NodeMap_snapshot;
+    ns->restore = UA_NodeMap_restore;
 
     /* All nodes are stored in RAM. Changes are made in-situ. GetEditNode is
      * identical to GetNode -- but the Node pointer is non-const. */
@@ -547,3 +1968,27 @@ UA_Nodestore_HashMap(UA_Nodestore *ns) {
 
     return UA_STATUSCODE_GOOD;
 }
+
+UA_StatusCode
+UA_Nodestore_HashMapWithOptions(UA_Nodestore *ns, UA_UInt32 options) {
+    UA_StatusCode res = UA_Nodestore_HashMap(ns);
+    if(res != UA_STATUSCODE_GOOD || options == 0)
+        return res;
+    UA_NodeMap *nodemap = (UA_NodeMap*)ns->context;
+    nodemap->directPointers =
+        ((options & UA_NODESTORE_HASHMAP_DIRECTPOINTERS) != 0);
+    nodemap->internStrings =
+        ((options & UA_NODESTORE_HASHMAP_INTERNSTRINGS) != 0);
+    nodemap->sortedReferences =
+        ((options & UA_NODESTORE_HASHMAP_SORTEDREFERENCES) != 0);
+    if(nodemap->directPointers || nodemap->internStrings) {
+        ns->getEditNode = UA_NodeMap_getEditNode;
+        ns->getEditNodeFromPtr = UA_NodeMap_getEditNodeFromPtr;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Nodestore_HashMapDirect(UA_Nodestore *ns) {
+    return UA_Nodestore_HashMapWithOptions(ns, UA_NODESTORE_HASHMAP_DIRECTPOINTERS);
+}
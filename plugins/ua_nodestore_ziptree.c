@@ -114,7 +114,7 @@ cleanupEntry(NodeEntry *entry) {
     UA_NodeHead *head = (UA_NodeHead*)&entry->nodeId;
     for(size_t i = 0; i < head->referencesSize; i++) {
         UA_NodeReferenceKind *rk = &head->references[i];
-        if(rk->targetsSize > 16 && !rk->hasRefTree)
+        if(rk->targetsSize > 16 && !rk->hasRefTree && !rk->hasSortedArray)
             UA_NodeReferenceKind_switch(rk);
     }
 }
@@ -402,6 +402,9 @@ UA_Nodestore_ZipTree(UA_Nodestore *ns) {
     ns->removeNode = zipNsRemoveNode;
     ns->getReferenceTypeId = zipNsGetReferenceTypeId;
     ns->iterate = zipNsIterate;
+    ns->reserve = NULL; /* The tree does not need to be resized */
+    ns->snapshot = NULL;
+    ns->restore = NULL;
 
     /* All nodes are stored in RAM. Changes are made in-situ. GetEditNode is
      * identical to GetNode -- but the Node pointer is non-const. */
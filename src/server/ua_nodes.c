@@ -79,10 +79,11 @@ UA_NodePointer_copy(UA_NodePointer in, UA_NodePointer *out) {
     in.immediate &= ~(uintptr_t)UA_NODEPOINTER_MASK;
     switch(tag) {
     case UA_NODEPOINTER_TAG_NODE:
-        in.id = &in.node->nodeId;
-        goto nodeid; /* fallthrough */
+        /* Copy the NodeId of the node. Use the same (possibly immediate)
+         * encoding as UA_NodePointer_fromNodeId. Otherwise the copy is not
+         * ordered like the original in the reference trees. */
+        return UA_NodePointer_copy(UA_NodePointer_fromNodeId(&in.node->nodeId), out);
     case UA_NODEPOINTER_TAG_NODEID:
-    nodeid:
         out->id = UA_NodeId_new();
         if(!out->id)
             return UA_STATUSCODE_BADOUTOFMEMORY;
@@ -130,11 +131,13 @@ UA_NodePointer_order(UA_NodePointer p1, UA_NodePointer p2) {
     /* Extract the tag and resolve pointers to nodes */
     UA_Byte tag1 = p1.immediate & UA_NODEPOINTER_MASK;
     if(tag1 == UA_NODEPOINTER_TAG_NODE) {
+        p1.immediate &= ~(uintptr_t)UA_NODEPOINTER_MASK;
         p1 = UA_NodePointer_fromNodeId(&p1.node->nodeId);
         tag1 = p1.immediate & UA_NODEPOINTER_MASK;
     }
     UA_Byte tag2 = p2.immediate & UA_NODEPOINTER_MASK;
     if(tag2 == UA_NODEPOINTER_TAG_NODE) {
+        p2.immediate &= ~(uintptr_t)UA_NODEPOINTER_MASK;
         p2 = UA_NodePointer_fromNodeId(&p2.node->nodeId);
         tag2 = p2.immediate & UA_NODEPOINTER_MASK;
     }
@@ -143,10 +146,13 @@ UA_NodePointer_order(UA_NodePointer p1, UA_NodePointer p2) {
     if(tag1 != tag2)
         return (tag1 > tag2) ? UA_ORDER_MORE : UA_ORDER_LESS;
 
-    /* Immediate */
-    if(UA_LIKELY(tag1 == UA_NODEPOINTER_TAG_IMMEDIATE))
+    /* Immediate. Can be equal after resolving the pointers to nodes. */
+    if(UA_LIKELY(tag1 == UA_NODEPOINTER_TAG_IMMEDIATE)) {
+        if(p1.immediate == p2.immediate)
+            return UA_ORDER_EQ;
         return (p1.immediate > p2.immediate) ?
             UA_ORDER_MORE : UA_ORDER_LESS;
+    }
 
     /* Compare from pointers */
     p1.immediate &= ~(uintptr_t)UA_NODEPOINTER_MASK;
@@ -185,6 +191,22 @@ UA_NodePointer_fromNodeId(const UA_NodeId *id) {
     return np;
 }
 
+UA_NodePointer
+UA_NodePointer_fromNode(const UA_NodeHead *node) {
+    UA_NodePointer np;
+    np.node = node;
+    np.immediate |= UA_NODEPOINTER_TAG_NODE;
+    return np;
+}
+
+const UA_NodeHead *
+UA_NodePointer_getNode(UA_NodePointer np) {
+    if((np.immediate & UA_NODEPOINTER_MASK) != UA_NODEPOINTER_TAG_NODE)
+        return NULL;
+    np.immediate &= ~(uintptr_t)UA_NODEPOINTER_MASK;
+    return np.node;
+}
+
 UA_NodeId
 UA_NodePointer_toNodeId(UA_NodePointer np) {
     UA_Byte tag = np.immediate & UA_NODEPOINTER_MASK;
@@ -229,6 +251,7 @@ UA_NodePointer_toExpandedNodeId(UA_NodePointer np) {
     /* Resolve node pointer to get the NodeId */
     UA_Byte tag = np.immediate & UA_NODEPOINTER_MASK;
     if(tag == UA_NODEPOINTER_TAG_NODE) {
+        np.immediate &= ~(uintptr_t)UA_NODEPOINTER_MASK;
         np = UA_NodePointer_fromNodeId(&np.node->nodeId);
         tag = np.immediate & UA_NODEPOINTER_MASK;
     }
@@ -301,6 +324,286 @@ removeTreeEntry(void *context, UA_ReferenceTargetTreeElem *elem) {
     return NULL;
 }
 
+/* Sorted array of reference targets. The first idx->sortedSize targets are
+ * ordered by UA_NodePointer_order. That resolves direct pointers to the NodeId
+ * of the target node. So the order is not affected when the Nodestore swizzles
+ * the pointers. New targets are appended to an unsorted tail that is merged
+ * into the sorted part once it grows beyond 1/64th of the sorted part. */
+
+#define UA_SORTEDTARGETS_MINTAIL 16
+
+typedef struct {
+    UA_UInt32 hash;
+    UA_UInt32 pos;
+} UA_ReferenceTargetName;
+
+static int
+cmpSortedTarget(const void *a, const void *b) {
+    const UA_ReferenceTarget *aa = (const UA_ReferenceTarget*)a;
+    const UA_ReferenceTarget *bb = (const UA_ReferenceTarget*)b;
+    return (int)UA_NodePointer_order(aa->targetId, bb->targetId);
+}
+
+static int
+cmpSortedTargetName(const void *a, const void *b) {
+    const UA_ReferenceTargetName *aa = (const UA_ReferenceTargetName*)a;
+    const UA_ReferenceTargetName *bb = (const UA_ReferenceTargetName*)b;
+    if(aa->hash == bb->hash)
+        return 0;
+    return (aa->hash < bb->hash) ? -1 : 1;
+}
+
+static void
+deleteSortedIndex(UA_ReferenceTargetIndex *idx) {
+    if(!idx)
+        return;
+    UA_free(idx->nameHashes);
+    UA_free(idx->namePositions);
+    UA_free(idx);
+}
+
+/* Binary search for the first target in [lo, hi) that is not smaller */
+static size_t
+sortedLowerBound(const UA_ReferenceTarget *array, size_t lo, size_t hi,
+                 UA_NodePointer target) {
+    while(lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if(UA_NodePointer_order(array[mid].targetId, target) == UA_ORDER_LESS)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Galloping search from the back for the first target in [0, hi) that is not
+ * smaller. The step size doubles until the target is overtaken. Then binary
+ * search within the last step. Takes O(log d) comparisons where d is the
+ * distance from hi. */
+static size_t
+sortedGallopBack(const UA_ReferenceTarget *array, size_t hi,
+                 UA_NodePointer target) {
+    size_t step = 1;
+    while(hi > 0) {
+        size_t probe = (hi > step) ? hi - step : 0;
+        if(UA_NodePointer_order(array[probe].targetId, target) == UA_ORDER_LESS)
+            return sortedLowerBound(array, probe + 1, hi, target);
+        hi = probe;
+        step <<= 1;
+    }
+    return 0;
+}
+
+/* Galloping search forward for the first target in [lo, hi) that is not
+ * smaller. Used to look up an ascending sequence of targets. */
+static size_t
+sortedGallopForward(const UA_ReferenceTarget *array, size_t lo, size_t hi,
+                    UA_NodePointer target) {
+    size_t step = 1;
+    while(lo < hi) {
+        size_t probe = (hi - lo > step) ? lo + step - 1 : hi - 1;
+        if(UA_NodePointer_order(array[probe].targetId, target) != UA_ORDER_LESS)
+            return sortedLowerBound(array, lo, probe + 1, target);
+        lo = probe + 1;
+        step <<= 1;
+    }
+    return hi;
+}
+
+/* Binary search for the first name index entry with the hash */
+static size_t
+sortedNameLowerBound(const UA_ReferenceTargetIndex *idx, UA_UInt32 hash) {
+    size_t lo = 0, hi = idx->sortedSize;
+    while(lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if(idx->nameHashes[mid] < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Ensure that the array and the index can hold the number of targets. The
+ * capacity is doubled to amortize the cost of appending. */
+static UA_StatusCode
+growSortedTargets(UA_NodeReferenceKind *rk, size_t size) {
+    UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+    if(size <= idx->capacity)
+        return UA_STATUSCODE_GOOD;
+    size_t capacity = idx->capacity * 2;
+    if(capacity < size)
+        capacity = size;
+    if(capacity > UA_UINT32_MAX)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    UA_ReferenceTarget *array = (UA_ReferenceTarget*)
+        UA_realloc(rk->targets.sorted.array, sizeof(UA_ReferenceTarget) * capacity);
+    if(!array)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    rk->targets.sorted.array = array;
+
+    UA_UInt32 *hashes = (UA_UInt32*)
+        UA_realloc(idx->nameHashes, sizeof(UA_UInt32) * capacity);
+    if(!hashes)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    idx->nameHashes = hashes;
+
+    UA_UInt32 *positions = (UA_UInt32*)
+        UA_realloc(idx->namePositions, sizeof(UA_UInt32) * capacity);
+    if(!positions)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    idx->namePositions = positions;
+
+    idx->capacity = capacity;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Merge the unsorted tail into the sorted part. The tail is sorted and merged
+ * from the back. The insertion point of every tail element is found with a
+ * galloping search from the previous insertion point. Then the block of the
+ * sorted part in between is moved in one piece. The name index is updated with
+ * the new positions and the names of the tail are merged in. The targets are
+ * unchanged if the temporary buffers cannot be allocated. */
+static UA_StatusCode
+mergeSortedTail(UA_NodeReferenceKind *rk) {
+    UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+    UA_ReferenceTarget *array = rk->targets.sorted.array;
+    size_t sortedSize = idx->sortedSize;
+    size_t tailSize = rk->targetsSize - sortedSize;
+    if(tailSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    UA_ReferenceTarget *tail = (UA_ReferenceTarget*)
+        UA_malloc(sizeof(UA_ReferenceTarget) * tailSize);
+    size_t *insert = (size_t*)UA_malloc(sizeof(size_t) * tailSize);
+    UA_ReferenceTargetName *names = (UA_ReferenceTargetName*)
+        UA_malloc(sizeof(UA_ReferenceTargetName) * tailSize);
+    if(!tail || !insert || !names) {
+        UA_free(tail);
+        UA_free(insert);
+        UA_free(names);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    /* Sort the tail */
+    memcpy(tail, &array[sortedSize], sizeof(UA_ReferenceTarget) * tailSize);
+    qsort(tail, tailSize, sizeof(UA_ReferenceTarget), cmpSortedTarget);
+
+    /* Merge from the back. The targets in [lo, hi) are larger than the current
+     * tail element and move up by the number of tail elements not yet
+     * placed. */
+    size_t hi = sortedSize;
+    for(size_t j = tailSize; j > 0; j--) {
+        size_t lo = sortedGallopBack(array, hi, tail[j-1].targetId);
+        if(lo < hi)
+            memmove(&array[lo + j], &array[lo],
+                    sizeof(UA_ReferenceTarget) * (hi - lo));
+        array[lo + j - 1] = tail[j-1];
+        insert[j-1] = lo;
+        names[j-1].hash = tail[j-1].targetNameHash;
+        names[j-1].pos = (UA_UInt32)(lo + j - 1);
+        hi = lo;
+    }
+
+    /* Update the positions in the name index. A target moves up by the number
+     * of tail elements inserted before it. */
+    for(size_t i = 0; i < sortedSize; i++) {
+        size_t pos = idx->namePositions[i];
+        size_t lo = 0, up = tailSize;
+        while(lo < up) {
+            size_t mid = lo + ((up - lo) / 2);
+            if(insert[mid] <= pos)
+                lo = mid + 1;
+            else
+                up = mid;
+        }
+        idx->namePositions[i] = (UA_UInt32)(pos + lo);
+    }
+
+    /* Merge the names of the tail into the name index from the back */
+    qsort(names, tailSize, sizeof(UA_ReferenceTargetName), cmpSortedTargetName);
+    size_t a = sortedSize, b = tailSize, out = sortedSize + tailSize;
+    while(b > 0) {
+        out--;
+        if(a > 0 && idx->nameHashes[a-1] > names[b-1].hash) {
+            a--;
+            idx->nameHashes[out] = idx->nameHashes[a];
+            idx->namePositions[out] = idx->namePositions[a];
+        } else {
+            b--;
+            idx->nameHashes[out] = names[b].hash;
+            idx->namePositions[out] = names[b].pos;
+        }
+    }
+    idx->sortedSize = sortedSize + tailSize;
+
+    UA_free(tail);
+    UA_free(insert);
+    UA_free(names);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_Boolean
+sortedTailFull(const UA_NodeReferenceKind *rk) {
+    const UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+    size_t maxTail = idx->sortedSize / 64;
+    if(maxTail < UA_SORTEDTARGETS_MINTAIL)
+        maxTail = UA_SORTEDTARGETS_MINTAIL;
+    return (rk->targetsSize - idx->sortedSize > maxTail);
+}
+
+static const UA_ReferenceTarget *
+findSortedTarget(const UA_NodeReferenceKind *rk, UA_NodePointer target) {
+    const UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+    const UA_ReferenceTarget *array = rk->targets.sorted.array;
+    size_t pos = sortedLowerBound(array, 0, idx->sortedSize, target);
+    if(pos < idx->sortedSize && UA_NodePointer_equal(target, array[pos].targetId))
+        return &array[pos];
+    for(size_t i = idx->sortedSize; i < rk->targetsSize; i++) {
+        if(UA_NodePointer_equal(target, array[i].targetId))
+            return &array[i];
+    }
+    return NULL;
+}
+
+/* Remove the target from the sorted array. Does not free the array and the
+ * index if the last target is removed. */
+static void
+removeSortedTarget(UA_NodeReferenceKind *rk, UA_ReferenceTarget *target) {
+    UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+    UA_ReferenceTarget *array = rk->targets.sorted.array;
+    size_t pos = (size_t)(target - array);
+    UA_NodePointer_clear(&target->targetId);
+    rk->targetsSize--;
+
+    /* Remove from the tail. Move the last target into the gap. */
+    if(pos >= idx->sortedSize) {
+        if(pos != rk->targetsSize)
+            *target = array[rk->targetsSize];
+        return;
+    }
+
+    /* Remove from the name index */
+    size_t n = sortedNameLowerBound(idx, target->targetNameHash);
+    while(n < idx->sortedSize && idx->namePositions[n] != pos)
+        n++;
+    UA_assert(n < idx->sortedSize);
+    idx->sortedSize--;
+    memmove(&idx->nameHashes[n], &idx->nameHashes[n+1],
+            sizeof(UA_UInt32) * (idx->sortedSize - n));
+    memmove(&idx->namePositions[n], &idx->namePositions[n+1],
+            sizeof(UA_UInt32) * (idx->sortedSize - n));
+    for(size_t i = 0; i < idx->sortedSize; i++) {
+        if(idx->namePositions[i] > pos)
+            idx->namePositions[i]--;
+    }
+
+    /* Close the gap in the array (including the tail) */
+    memmove(&array[pos], &array[pos+1],
+            sizeof(UA_ReferenceTarget) * (rk->targetsSize - pos));
+}
+
 UA_StatusCode
 UA_NodeReferenceKind_switch(UA_NodeReferenceKind *rk) {
     UA_assert(rk->targetsSize > 0);
@@ -338,10 +641,53 @@ UA_NodeReferenceKind_switch(UA_NodeReferenceKind *rk) {
     for(size_t i = 0; i < rk->targetsSize; i++)
         UA_NodePointer_clear(&rk->targets.array[i].targetId);
     UA_free(rk->targets.array);
+    if(rk->hasSortedArray)
+        deleteSortedIndex(rk->targets.sorted.index);
+    newRk.hasSortedArray = false;
     *rk = newRk;
     return UA_STATUSCODE_GOOD;
 }
 
+UA_StatusCode
+UA_NodeReferenceKind_sort(UA_NodeReferenceKind *rk) {
+    UA_assert(rk->targetsSize > 0);
+
+    /* Already sorted. Merge the tail. */
+    if(rk->hasSortedArray)
+        return mergeSortedTail(rk);
+
+    /* From tree to array first */
+    if(rk->hasRefTree) {
+        UA_StatusCode res = UA_NodeReferenceKind_switch(rk);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+    }
+
+    /* From array to sorted array. All targets form the initial tail. */
+    if(rk->targetsSize > UA_UINT32_MAX)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_ReferenceTargetIndex *idx = (UA_ReferenceTargetIndex*)
+        UA_calloc(1, sizeof(UA_ReferenceTargetIndex));
+    if(!idx)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    idx->capacity = rk->targetsSize;
+    idx->nameHashes = (UA_UInt32*)UA_malloc(sizeof(UA_UInt32) * rk->targetsSize);
+    idx->namePositions = (UA_UInt32*)UA_malloc(sizeof(UA_UInt32) * rk->targetsSize);
+    if(!idx->nameHashes || !idx->namePositions) {
+        deleteSortedIndex(idx);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    rk->targets.sorted.index = idx;
+    rk->hasSortedArray = true;
+    UA_StatusCode res = mergeSortedTail(rk);
+    if(res != UA_STATUSCODE_GOOD) {
+        deleteSortedIndex(idx);
+        rk->targets.sorted.index = NULL;
+        rk->hasSortedArray = false;
+    }
+    return res;
+}
+
 void *
 UA_NodeReferenceKind_iterate(UA_NodeReferenceKind *rk,
                              UA_NodeReferenceKind_iterateCallback callback,
@@ -358,11 +704,75 @@ UA_NodeReferenceKind_iterate(UA_NodeReferenceKind *rk,
     return NULL;
 }
 
+static int
+cmpSortedTargetPtr(const void *a, const void *b) {
+    const UA_ReferenceTarget *aa = *(const UA_ReferenceTarget* const*)a;
+    const UA_ReferenceTarget *bb = *(const UA_ReferenceTarget* const*)b;
+    return (int)UA_NodePointer_order(aa->targetId, bb->targetId);
+}
+
+UA_StatusCode
+UA_NodeReferenceKind_iterateSorted(UA_NodeReferenceKind *rk,
+                                   const UA_NodePointer *after,
+                                   UA_NodeReferenceKind_iterateCallback callback,
+                                   void *context, void **result) {
+    UA_assert(rk->hasSortedArray);
+    *result = NULL;
+    UA_ReferenceTarget *array = rk->targets.sorted.array;
+    size_t sortedSize = rk->targets.sorted.index->sortedSize;
+
+    /* Sort pointers to the tail targets after the start */
+    UA_ReferenceTarget **tail = NULL;
+    size_t tailSize = 0;
+    if(rk->targetsSize > sortedSize) {
+        tail = (UA_ReferenceTarget**)
+            UA_malloc(sizeof(UA_ReferenceTarget*) * (rk->targetsSize - sortedSize));
+        if(!tail)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(size_t i = sortedSize; i < rk->targetsSize; i++) {
+            if(after &&
+               UA_NodePointer_order(array[i].targetId, *after) != UA_ORDER_MORE)
+                continue;
+            tail[tailSize++] = &array[i];
+        }
+        qsort(tail, tailSize, sizeof(UA_ReferenceTarget*), cmpSortedTargetPtr);
+    }
+
+    /* Skip the sorted targets up to the start */
+    size_t i = 0;
+    if(after) {
+        i = sortedLowerBound(array, 0, sortedSize, *after);
+        if(i < sortedSize &&
+           UA_NodePointer_order(array[i].targetId, *after) == UA_ORDER_EQ)
+            i++;
+    }
+
+    /* Merge the sorted part and the tail */
+    size_t j = 0;
+    while(i < sortedSize || j < tailSize) {
+        UA_ReferenceTarget *t;
+        if(j == tailSize ||
+           (i < sortedSize &&
+            UA_NodePointer_order(array[i].targetId,
+                                 tail[j]->targetId) == UA_ORDER_LESS))
+            t = &array[i++];
+        else
+            t = tail[j++];
+        *result = callback(context, t);
+        if(*result)
+            break;
+    }
+    UA_free(tail);
+    return UA_STATUSCODE_GOOD;
+}
+
 const UA_ReferenceTarget *
 UA_NodeReferenceKind_findTarget(const UA_NodeReferenceKind *rk,
                                 const UA_ExpandedNodeId *targetId) {
     UA_NodePointer targetP = UA_NodePointer_fromExpandedNodeId(targetId);
-    if(rk->hasRefTree) {
+    if(rk->hasSortedArray) {
+        return findSortedTarget(rk, targetP);
+    } else if(rk->hasRefTree) {
         /* Return from the tree */
         UA_ReferenceTargetTreeElem tmpTarget;
         tmpTarget.target.targetId = targetP;
@@ -382,6 +792,41 @@ UA_NodeReferenceKind_findTarget(const UA_NodeReferenceKind *rk,
     return NULL;
 }
 
+void *
+UA_NodeReferenceKind_iterateName(UA_NodeReferenceKind *rk, UA_UInt32 targetNameHash,
+                                 UA_NodeReferenceKind_iterateCallback callback,
+                                 void *context) {
+    if(rk->hasRefTree) {
+        UA_ReferenceTarget key;
+        key.targetNameHash = targetNameHash;
+        return ZIP_ITER_KEY(UA_ReferenceNameTree,
+                            (UA_ReferenceNameTree*)&rk->targets.tree.nameRoot,
+                            &key, (UA_ReferenceNameTree_cb)callback, context);
+    }
+
+    /* Lookup in the name index of the sorted array. Then search the tail. */
+    size_t tailStart = 0;
+    if(rk->hasSortedArray) {
+        const UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+        for(size_t i = sortedNameLowerBound(idx, targetNameHash);
+            i < idx->sortedSize && idx->nameHashes[i] == targetNameHash; i++) {
+            void *res = callback(context, &rk->targets.array[idx->namePositions[i]]);
+            if(res)
+                return res;
+        }
+        tailStart = idx->sortedSize;
+    }
+
+    for(size_t i = tailStart; i < rk->targetsSize; i++) {
+        if(rk->targets.array[i].targetNameHash != targetNameHash)
+            continue;
+        void *res = callback(context, &rk->targets.array[i]);
+        if(res)
+            return res;
+    }
+    return NULL;
+}
+
 /* General node handling methods. There is no UA_Node_new() method here.
  * Creating nodes is part of the Nodestore layer */
 
@@ -535,6 +980,27 @@ copyTarget(void *context, UA_ReferenceTargetTreeElem *elm) {
                                  elm->target.targetNameHash);
 }
 
+/* The copy of the index has no spare capacity */
+static UA_StatusCode
+copySortedIndex(const UA_NodeReferenceKind *src, UA_NodeReferenceKind *dst) {
+    const UA_ReferenceTargetIndex *sidx = src->targets.sorted.index;
+    UA_ReferenceTargetIndex *didx = (UA_ReferenceTargetIndex*)
+        UA_calloc(1, sizeof(UA_ReferenceTargetIndex));
+    if(!didx)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    dst->targets.sorted.index = didx;
+    didx->nameHashes = (UA_UInt32*)UA_malloc(sizeof(UA_UInt32) * src->targetsSize);
+    didx->namePositions = (UA_UInt32*)UA_malloc(sizeof(UA_UInt32) * src->targetsSize);
+    if(!didx->nameHashes || !didx->namePositions)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memcpy(didx->nameHashes, sidx->nameHashes, sizeof(UA_UInt32) * sidx->sortedSize);
+    memcpy(didx->namePositions, sidx->namePositions,
+           sizeof(UA_UInt32) * sidx->sortedSize);
+    didx->capacity = src->targetsSize;
+    didx->sortedSize = sidx->sortedSize;
+    return UA_STATUSCODE_GOOD;
+}
+
 UA_StatusCode
 UA_Node_copy(const UA_Node *src, UA_Node *dst) {
     const UA_NodeHead *srchead = &src->head;
@@ -604,6 +1070,7 @@ UA_Node_copy(const UA_Node *src, UA_Node *dst) {
             drefs->referenceTypeIndex = srefs->referenceTypeIndex;
             drefs->isInverse = srefs->isInverse;
             drefs->hasRefTree = srefs->hasRefTree; /* initially empty */
+            drefs->hasSortedArray = srefs->hasSortedArray;
 
             /* Copy all the targets */
             if(!srefs->hasRefTree) {
@@ -613,6 +1080,13 @@ UA_Node_copy(const UA_Node *src, UA_Node *dst) {
                     UA_Node_clear(dst);
                     return UA_STATUSCODE_BADOUTOFMEMORY;
                 }
+                if(srefs->hasSortedArray) {
+                    retval = copySortedIndex(srefs, drefs);
+                    if(retval != UA_STATUSCODE_GOOD) {
+                        UA_Node_clear(dst);
+                        return retval;
+                    }
+                }
                 for(size_t j = 0; j < srefs->targetsSize; j++) {
                     drefs->targets.array[j].targetNameHash =
                         srefs->targets.array[j].targetNameHash;
@@ -929,6 +1403,23 @@ addReferenceTarget(UA_NodeReferenceKind *rk, UA_NodePointer targetId,
                                         targetNameHash);
     }
 
+    /* Append to the tail of the sorted array. Merge if the tail is full.
+     * Merging is allowed to fail, the tail remains valid. */
+    if(rk->hasSortedArray) {
+        UA_StatusCode res = growSortedTargets(rk, rk->targetsSize + 1);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        UA_ReferenceTarget *t = &rk->targets.sorted.array[rk->targetsSize];
+        res = UA_NodePointer_copy(targetId, &t->targetId);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        t->targetNameHash = targetNameHash;
+        rk->targetsSize++;
+        if(sortedTailFull(rk))
+            mergeSortedTail(rk);
+        return UA_STATUSCODE_GOOD;
+    }
+
     /* Insert to the array */
     UA_ReferenceTarget *newRefs = (UA_ReferenceTarget*)
         UA_realloc(rk->targets.array,
@@ -1014,6 +1505,107 @@ UA_Node_addReference(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForward,
 
 }
 
+/* Add the batch to the sorted array. The tail is merged first. Then the batch
+ * is sorted and the existing targets are found with a galloping search. The new
+ * targets are appended and merged in one pass. */
+static UA_StatusCode
+addSortedTargets(UA_NodeReferenceKind *rk, size_t targetsSize,
+                 const UA_ExpandedNodeId *targetNodeIds,
+                 const UA_UInt32 *targetBrowseNameHashes, size_t *added) {
+    UA_ReferenceTarget *batch = (UA_ReferenceTarget*)
+        UA_malloc(sizeof(UA_ReferenceTarget) * targetsSize);
+    if(!batch)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode res = growSortedTargets(rk, rk->targetsSize + targetsSize);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_free(batch);
+        return res;
+    }
+    mergeSortedTail(rk); /* Allowed to fail */
+
+    /* Sort the batch. The NodePointers are shallow. */
+    for(size_t i = 0; i < targetsSize; i++) {
+        batch[i].targetId = UA_NodePointer_fromExpandedNodeId(&targetNodeIds[i]);
+        batch[i].targetNameHash = targetBrowseNameHashes[i];
+    }
+    qsort(batch, targetsSize, sizeof(UA_ReferenceTarget), cmpSortedTarget);
+
+    UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+    UA_ReferenceTarget *array = rk->targets.sorted.array;
+    size_t oldSize = rk->targetsSize;
+    size_t cursor = 0;
+    for(size_t i = 0; i < targetsSize; i++) {
+        /* Duplicate within the batch */
+        if(i > 0 && UA_NodePointer_equal(batch[i].targetId, batch[i-1].targetId))
+            continue;
+
+        /* Already contained in the sorted part or in the tail */
+        cursor = sortedGallopForward(array, cursor, idx->sortedSize,
+                                     batch[i].targetId);
+        if(cursor < idx->sortedSize &&
+           UA_NodePointer_equal(batch[i].targetId, array[cursor].targetId))
+            continue;
+        size_t j = idx->sortedSize;
+        for(; j < oldSize; j++) {
+            if(UA_NodePointer_equal(batch[i].targetId, array[j].targetId))
+                break;
+        }
+        if(j < oldSize)
+            continue;
+
+        /* Append to the tail */
+        UA_ReferenceTarget *t = &array[rk->targetsSize];
+        res = UA_NodePointer_copy(batch[i].targetId, &t->targetId);
+        if(res != UA_STATUSCODE_GOOD)
+            break;
+        t->targetNameHash = batch[i].targetNameHash;
+        rk->targetsSize++;
+    }
+    UA_free(batch);
+
+    if(added)
+        *added = rk->targetsSize - oldSize;
+    mergeSortedTail(rk); /* Allowed to fail */
+    return res;
+}
+
+UA_StatusCode
+UA_Node_addReferences(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForward,
+                      size_t targetsSize, const UA_ExpandedNodeId *targetNodeIds,
+                      const UA_UInt32 *targetBrowseNameHashes, size_t *added) {
+    if(added)
+        *added = 0;
+    if(targetsSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    /* Batch insert into a matching sorted ReferenceKind */
+    for(size_t i = 0; i < node->head.referencesSize; ++i) {
+        UA_NodeReferenceKind *refs = &node->head.references[i];
+        if(refs->isInverse == isForward || refs->referenceTypeIndex != refTypeIndex)
+            continue;
+        if(refs->hasSortedArray)
+            return addSortedTargets(refs, targetsSize, targetNodeIds,
+                                    targetBrowseNameHashes, added);
+        break;
+    }
+
+    /* Add the targets one by one. Skip the existing targets. */
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < targetsSize; i++) {
+        res = UA_Node_addReference(node, refTypeIndex, isForward, &targetNodeIds[i],
+                                   targetBrowseNameHashes[i]);
+        if(res == UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED) {
+            res = UA_STATUSCODE_GOOD;
+            continue;
+        }
+        if(res != UA_STATUSCODE_GOOD)
+            break;
+        if(added)
+            (*added)++;
+    }
+    return res;
+}
+
 UA_StatusCode
 UA_Node_deleteReference(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForward,
                         const UA_ExpandedNodeId *targetNodeId) {
@@ -1032,10 +1624,18 @@ UA_Node_deleteReference(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForwar
             continue;
 
         /* Ok, delete the reference. Cannot fail */
-        refs->targetsSize--;
+        if(refs->hasSortedArray) {
+            /* Remove from the sorted array. The capacity is kept. */
+            removeSortedTarget(refs, target);
+            if(refs->targetsSize > 0)
+                return UA_STATUSCODE_GOOD;
 
-        if(!refs->hasRefTree) {
+            /* Remove the last target. Remove the ReferenceKind below */
+            UA_free(refs->targets.sorted.array);
+            deleteSortedIndex(refs->targets.sorted.index);
+        } else if(!refs->hasRefTree) {
             /* Remove from array */
+            refs->targetsSize--;
             UA_NodePointer_clear(&target->targetId);
 
             /* Elements remaining. Realloc. */
@@ -1053,6 +1653,7 @@ UA_Node_deleteReference(UA_Node *node, UA_Byte refTypeIndex, UA_Boolean isForwar
             /* Remove the last target. Remove the ReferenceKind below */
             UA_free(refs->targets.array);
         } else {
+            refs->targetsSize--;
             UA_ReferenceTargetTreeElem *elem = (UA_ReferenceTargetTreeElem*)target;
             ZIP_REMOVE(UA_ReferenceIdTree,
                        (UA_ReferenceIdTree*)&refs->targets.tree.idRoot, elem);
@@ -1102,6 +1703,8 @@ UA_Node_deleteReferencesSubset(UA_Node *node, const UA_ReferenceTypeSet *keepSet
             for(size_t j = 0; j < refs->targetsSize; j++)
                 UA_NodePointer_clear(&refs->targets.array[j].targetId);
             UA_free(refs->targets.array);
+            if(refs->hasSortedArray)
+                deleteSortedIndex(refs->targets.sorted.index);
         } else {
             ZIP_ITER(UA_ReferenceIdTree,
                      (UA_ReferenceIdTree*)&refs->targets.tree.idRoot,
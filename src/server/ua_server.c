@@ -434,14 +434,28 @@ UA_Server_delete(UA_Server *server) {
     UA_ConditionList_delete(server);
 #endif
 
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    UA_EventPathCache_clear(&server->eventPaths);
+#endif
+
 #endif
 
 #if UA_MULTITHREADING >= 100
     UA_AsyncManager_clear(&server->asyncManager, server);
 #endif
 
+    /* Release values that were borrowed outside of processing a message */
+    UA_Server_releaseBorrowedValues(server);
+
     /* Clean up the Admin Session */
     UA_Session_clear(&server->adminSession, server);
+
+    /* Clean up the cached BrowsePaths, type hierarchies and instantiation
+     * plans */
+    UA_BrowsePathCache_clear(&server->browsePaths);
+    UA_TypeHierarchy_clear(&server->typeHierarchy);
+    UA_InstantiationCache_clear(&server->instantiation);
+
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     server->adminSubscription = NULL;
     UA_assert(server->monitoredItemsSize == 0);
@@ -475,6 +475,18 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
     UA_LOCK(&server->serviceMutex);
     UA_Boolean async =
         UA_Server_processRequest(server, channel, requestId, sd, &request, &response);
+
+    /* The response points into pinned nodes or borrowed values. Encode before
+     * they are released and while the nodes cannot be edited from another
+     * thread. */
+    if(server->pinnedNodes.size > 0 || server->borrowedValues.size > 0) {
+        if(!async)
+            retval = sendResponse(server, channel, requestId, &response, sd->responseType);
+        UA_Server_releasePinnedNodes(server, sd->responseType, &response);
+        UA_Server_releaseBorrowedValues(server);
+        UA_UNLOCK(&server->serviceMutex);
+        goto cleanup;
+    }
     UA_UNLOCK(&server->serviceMutex);
 
     /* Send response if not async */
@@ -482,6 +494,8 @@ processMSG(UA_Server *server, UA_SecureChannel *channel,
         retval = sendResponse(server, channel, requestId, &response, sd->responseType);
     }
 
+ cleanup:
+
     /* Clean up */
     UA_clear(&request, sd->requestType);
     UA_clear(&response, sd->responseType);
@@ -165,6 +165,158 @@ getServerComponentByName(UA_Server *server, UA_String name);
 /* Server Structure */
 /********************/
 
+/* Nodes that are referenced (shallow) from the response of the service that is
+ * currently processed. They are released from the Nodestore after the response
+ * has been encoded. */
+typedef struct {
+    size_t size;
+    size_t capacity;
+    const UA_Node **nodes;
+} UA_PinnedNodes;
+
+/* Values from a borrowed data source that are referenced (shallow) from the
+ * response of the service that is currently processed. They are released to the
+ * data source after the response has been encoded. The list in the server is
+ * only filled while the service mutex is held continuously until the release.
+ * Reading (with the mutex unlocked in the data source callback) uses a separate
+ * list. */
+typedef struct {
+    UA_DataSourceReleaseCallback release;
+    UA_NodeId nodeId;
+    void *nodeContext;
+    UA_DataValue value; /* As returned by the data source */
+} UA_BorrowedValue;
+
+typedef struct {
+    size_t size;
+    size_t capacity;
+    UA_BorrowedValue *values;
+} UA_BorrowedValues;
+
+/* Cache of the type hierarchies (HasSubtype). For every type node that was
+ * looked up, the transitive set of supertypes is kept. Subtype checks are then
+ * a lookup in the tree plus a scan of the (short) supertype array. Adding a new
+ * subtype (the common case when loading a nodeset) leaves the cached entries
+ * valid. Changes to the supertypes of a cached type increase the generation
+ * counter. Entries of an older generation are recomputed. */
+typedef struct UA_TypeHierarchyEntry {
+    ZIP_ENTRY(UA_TypeHierarchyEntry) treeEntry;
+    UA_NodeId typeId;
+    UA_UInt64 generation;
+    UA_Boolean computing; /* Cycle detection */
+    size_t supertypesSize;
+    UA_NodeId *supertypes;
+} UA_TypeHierarchyEntry;
+
+typedef ZIP_HEAD(UA_TypeHierarchyTree, UA_TypeHierarchyEntry)
+    UA_TypeHierarchyTree;
+
+#define UA_TYPEHIERARCHY_MAXSIZE 16384 /* Max cached type nodes */
+
+typedef struct {
+    UA_TypeHierarchyTree entries;
+    size_t entriesSize;
+    UA_UInt64 generation;
+} UA_TypeHierarchy;
+
+void
+UA_TypeHierarchy_clear(UA_TypeHierarchy *th);
+
+/* Call when a HasSubtype reference to the subtype was added or removed, or when
+ * a node is removed. */
+void
+UA_TypeHierarchy_changed(UA_TypeHierarchy *th, const UA_NodeId *subtype);
+
+/* Cache for the results of the TranslateBrowsePathsToNodeIds service. The
+ * entries are indexed by a hash of the BrowsePath. Every change of the
+ * references or adding/removing nodes increases the generation counter. Entries
+ * of an older generation are not used. */
+typedef struct UA_BrowsePathCacheEntry {
+    ZIP_ENTRY(UA_BrowsePathCacheEntry) treeEntry;
+    UA_UInt32 hash;
+    UA_UInt64 generation;
+    UA_BrowsePath path;
+    UA_BrowsePathResult result;
+} UA_BrowsePathCacheEntry;
+
+typedef ZIP_HEAD(UA_BrowsePathCacheTree, UA_BrowsePathCacheEntry)
+    UA_BrowsePathCacheTree;
+
+#define UA_BROWSEPATHCACHE_MAXSIZE 4096 /* Max cached BrowsePaths */
+
+typedef struct {
+    UA_BrowsePathCacheTree entries;
+    size_t entriesSize;
+    UA_UInt64 generation;
+} UA_BrowsePathCache;
+
+void
+UA_BrowsePathCache_clear(UA_BrowsePathCache *cache);
+
+/* Cache of instantiation plans. A plan lists the children (instance
+ * declarations) that are copied into a new instance, in the order in which the
+ * type and its supertypes are visited. It replaces the browsing of the type
+ * hierarchy and of the children for every new instance. The plans are keyed by
+ * the source NodeId and whether the supertypes and interfaces are included (for
+ * the children from the TypeDefinition).
+ *
+ * All nodes that were visited to compile the plans are registered as
+ * dependencies. Changing the references of a dependency, or removing it,
+ * increases the generation counter. Plans of an older generation are compiled
+ * again on the next use. */
+typedef struct {
+    UA_NodeId declarationId;
+    UA_NodeId referenceTypeId;
+    UA_NodeId typeDefinitionId;
+    UA_QualifiedName browseName;
+    UA_NodeClass nodeClass;
+    UA_Boolean mandatory;
+    size_t sameName; /* Index of the previous step with the same BrowseName.
+                      * SIZE_MAX if there is none. */
+} UA_InstantiationStep;
+
+typedef struct {
+    UA_NodeId sourceId;
+    UA_Boolean hierarchy;
+} UA_InstantiationPlanKey;
+
+typedef struct UA_InstantiationPlan {
+    ZIP_ENTRY(UA_InstantiationPlan) treeEntry;
+    UA_InstantiationPlanKey key;
+    UA_Boolean cached; /* Temporary plans are deleted after the replay */
+    UA_UInt32 inUse;   /* Not recompiled while a replay is ongoing */
+    UA_UInt64 generation;
+    size_t stepsSize;
+    UA_InstantiationStep *steps;
+} UA_InstantiationPlan;
+
+typedef ZIP_HEAD(UA_InstantiationPlanTree, UA_InstantiationPlan)
+    UA_InstantiationPlanTree;
+
+typedef struct UA_InstantiationDependency {
+    ZIP_ENTRY(UA_InstantiationDependency) treeEntry;
+    UA_NodeId nodeId;
+} UA_InstantiationDependency;
+
+typedef ZIP_HEAD(UA_InstantiationDependencyTree, UA_InstantiationDependency)
+    UA_InstantiationDependencyTree;
+
+#define UA_INSTANTIATIONCACHE_MAXSIZE 4096 /* Max cached plans */
+
+typedef struct {
+    UA_InstantiationPlanTree plans;
+    size_t plansSize;
+    UA_InstantiationDependencyTree dependencies;
+    UA_UInt64 generation;
+} UA_InstantiationCache;
+
+void
+UA_InstantiationCache_clear(UA_InstantiationCache *cache);
+
+/* Call when the references of the node change or when it is removed */
+void
+UA_InstantiationCache_changed(UA_InstantiationCache *cache, const UA_NodeId *nodeId);
+
 typedef struct session_list_entry {
     UA_DelayedCallback cleanupCallback;
     LIST_ENTRY(session_list_entry) pointers;
@@ -199,6 +351,20 @@ struct UA_Server {
      * equipped with all possible access rights (Session Id: 1). */
     UA_Session adminSession;
 
+    /* Pins and borrowed values of the service response that is currently
+     * processed */
+    UA_PinnedNodes pinnedNodes;
+    UA_BorrowedValues borrowedValues;
+
+    /* Resolved BrowsePaths */
+    UA_BrowsePathCache browsePaths;
+
+    /* Supertypes of the type nodes */
+    UA_TypeHierarchy typeHierarchy;
+
+    /* Children to copy when instantiating a type */
+    UA_InstantiationCache instantiation;
+
     /* SecureChannels */
     TAILQ_HEAD(, UA_SecureChannel) channels;
     UA_UInt32 lastChannelId;
@@ -226,6 +392,10 @@ struct UA_Server {
                                                  * from a session. */
     UA_UInt32 lastSubscriptionId; /* To generate unique SubscriptionIds */
 
+# ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    UA_EventPathCache eventPaths;
+# endif
+
 # ifdef UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS
     LIST_HEAD(, UA_ConditionSource) conditionSources;
     UA_NodeId refreshEvents[2];
@@ -348,6 +518,8 @@ UA_UInt16 addNamespace(UA_Server *server, const UA_String name);
 UA_Boolean
 UA_Node_hasSubTypeOrInstances(const UA_NodeHead *head);
 
+#define UA_MAX_TREE_RECURSE 50 /* How deep up/down the tree do we recurse at most? */
+
 /* Recursively searches "upwards" in the tree following specific reference types */
 UA_Boolean
 isNodeInTree(UA_Server *server, const UA_NodeId *leafNode,
@@ -415,6 +587,22 @@ UA_StatusCode
 sendResponse(UA_Server *server, UA_SecureChannel *channel, UA_UInt32 requestId,
              UA_Response *response, const UA_DataType *responseType);
 
+/* Detach the shallow results from the response and release the pinned nodes.
+ * Call after the response was encoded. */
+void
+UA_Server_releasePinnedNodes(UA_Server *server, const UA_DataType *responseType,
+                             UA_Response *response);
+
+/* Release the borrowed values of the response to their data source. Call after
+ * the response was encoded. */
+void
+UA_Server_releaseBorrowedValues(UA_Server *server);
+
+/* Call the release callbacks and reset the list. The service mutex is unlocked
+ * during the callbacks. */
+void
+UA_BorrowedValues_release(UA_Server *server, UA_BorrowedValues *bv);
+
 /* Many services come as an array of operations. This function generalizes the
  * processing of the operations. */
 typedef void (*UA_ServiceOperation)(UA_Server *server, UA_Session *session,
@@ -516,6 +704,14 @@ readWithSession(UA_Server *server, UA_Session *session,
                 const UA_ReadValueId *item,
                 UA_TimestampsToReturn timestampsToReturn);
 
+/* Same as readWithSession. But values from a borrowed data source are not
+ * copied. They are added to the list and have to be released from there. */
+UA_DataValue
+readWithSessionBorrowed(UA_Server *server, UA_Session *session,
+                        const UA_ReadValueId *item,
+                        UA_TimestampsToReturn timestampsToReturn,
+                        UA_BorrowedValues *borrowed);
+
 UA_StatusCode
 readWithReadValue(UA_Server *server, const UA_NodeId *nodeId,
                   const UA_AttributeId attributeId, void *v);
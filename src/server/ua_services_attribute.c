@@ -218,10 +218,104 @@ readValueAttributeFromDataSource(UA_Server *server, UA_Session *session,
     return retval;
 }
 
+static UA_StatusCode
+addBorrowedValue(UA_BorrowedValues *bv, const UA_VariableNode *vn,
+                 const UA_DataValue *value) {
+    if(bv->size >= bv->capacity) {
+        size_t newCapacity = (bv->capacity == 0) ? 8 : bv->capacity * 2;
+        UA_BorrowedValue *values = (UA_BorrowedValue*)
+            UA_realloc(bv->values, newCapacity * sizeof(UA_BorrowedValue));
+        if(!values)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        bv->values = values;
+        bv->capacity = newCapacity;
+    }
+    UA_BorrowedValue *b = &bv->values[bv->size];
+    UA_StatusCode retval = UA_NodeId_copy(&vn->head.nodeId, &b->nodeId);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    b->release = vn->valueBackend.backend.borrowed.release;
+    b->nodeContext = vn->head.context;
+    b->value = *value;
+    bv->size++;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_BorrowedValues_release(UA_Server *server, UA_BorrowedValues *bv) {
+    UA_LOCK_ASSERT(&server->serviceMutex);
+    UA_BorrowedValue *values = bv->values;
+    size_t size = bv->size;
+    memset(bv, 0, sizeof(UA_BorrowedValues));
+    if(size == 0) {
+        UA_free(values);
+        return;
+    }
+    UA_UNLOCK(&server->serviceMutex);
+    for(size_t i = 0; i < size; i++) {
+        values[i].release(server, &values[i].nodeId,
+                          values[i].nodeContext, &values[i].value);
+        UA_NodeId_clear(&values[i].nodeId);
+    }
+    UA_LOCK(&server->serviceMutex);
+    UA_free(values);
+}
+
+void
+UA_Server_releaseBorrowedValues(UA_Server *server) {
+    UA_BorrowedValues_release(server, &server->borrowedValues);
+}
+
+/* The value from the data source is returned without a copy if it is borrowed
+ * (UA_VARIANT_DATA_NODELETE) and the caller takes care of the release. */
+static UA_StatusCode
+readValueAttributeFromBorrowedDataSource(UA_Server *server, UA_Session *session,
+                                         const UA_VariableNode *vn, UA_DataValue *v,
+                                         UA_TimestampsToReturn timestamps,
+                                         UA_NumericRange *rangeptr,
+                                         UA_BorrowedValues *borrowed) {
+    UA_LOCK_ASSERT(&server->serviceMutex);
+    const UA_DataSource *ds = &vn->valueBackend.backend.borrowed.dataSource;
+    UA_DataSourceReleaseCallback release = vn->valueBackend.backend.borrowed.release;
+    if(!ds->read || !release)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Boolean sourceTimeStamp = (timestamps == UA_TIMESTAMPSTORETURN_SOURCE ||
+                                  timestamps == UA_TIMESTAMPSTORETURN_BOTH);
+    UA_DataValue v2;
+    UA_DataValue_init(&v2);
+    UA_UNLOCK(&server->serviceMutex);
+    UA_StatusCode retval =
+        ds->read(server, session ? &session->sessionId : NULL,
+                 session ? session->context : NULL,
+                 &vn->head.nodeId, vn->head.context,
+                 sourceTimeStamp, rangeptr, &v2);
+    UA_LOCK(&server->serviceMutex);
+
+    /* The value is owned by the server */
+    if(!v2.hasValue || v2.value.storageType != UA_VARIANT_DATA_NODELETE) {
+        *v = v2;
+        return retval;
+    }
+
+    /* Keep the view until the caller releases it */
+    if(borrowed && addBorrowedValue(borrowed, vn, &v2) == UA_STATUSCODE_GOOD) {
+        *v = v2;
+        return retval;
+    }
+
+    /* Copy and release right away */
+    UA_StatusCode res = UA_DataValue_copy(&v2, v);
+    UA_UNLOCK(&server->serviceMutex);
+    release(server, &vn->head.nodeId, vn->head.context, &v2);
+    UA_LOCK(&server->serviceMutex);
+    return (retval != UA_STATUSCODE_GOOD) ? retval : res;
+}
+
 static UA_StatusCode
 readValueAttributeComplete(UA_Server *server, UA_Session *session,
                            const UA_VariableNode *vn, UA_TimestampsToReturn timestamps,
-                           const UA_String *indexRange, UA_DataValue *v) {
+                           const UA_String *indexRange, UA_DataValue *v,
+                           UA_BorrowedValues *borrowed) {
     UA_EventLoop *el = server->config.eventLoop;
 
     /* Compute the index range */
@@ -265,6 +359,11 @@ readValueAttributeComplete(UA_Server *server, UA_Session *session,
             else
                 retval = UA_DataValue_copy(*vn->valueBackend.backend.external.value, v);
             break;
+        case UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED:
+            retval = readValueAttributeFromBorrowedDataSource(server, session, vn, v,
+                                                              timestamps, rangeptr,
+                                                              borrowed);
+            break;
         case UA_VALUEBACKENDTYPE_NONE:
             /* Read the value */
             if(vn->valueSource == UA_VALUESOURCE_DATA)
@@ -293,7 +392,7 @@ UA_StatusCode
 readValueAttribute(UA_Server *server, UA_Session *session,
                    const UA_VariableNode *vn, UA_DataValue *v) {
     return readValueAttributeComplete(server, session, vn,
-                                      UA_TIMESTAMPSTORETURN_NEITHER, NULL, v);
+                                      UA_TIMESTAMPSTORETURN_NEITHER, NULL, v, NULL);
 }
 
 static const UA_String binEncoding = {sizeof("Default Binary")-1, (UA_Byte*)"Default Binary"};
@@ -375,10 +474,11 @@ getStructureDefinition(const UA_DataType *type, UA_StructureDefinition *def) {
 /* Returns a datavalue that may point into the node via the
  * UA_VARIANT_DATA_NODELETE tag. Don't access the returned DataValue once the
  * node has been released! */
-void
-ReadWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
+static void
+readWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
              UA_TimestampsToReturn timestampsToReturn,
-             const UA_ReadValueId *id, UA_DataValue *v) {
+             const UA_ReadValueId *id, UA_DataValue *v,
+             UA_BorrowedValues *borrowed) {
     UA_LOG_TRACE_SESSION(server->config.logging, session,
                          "Read attribute %"PRIi32 " of Node %N",
                          id->attributeId, node->head.nodeId);
@@ -485,7 +585,8 @@ ReadWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
             }
         }
         retval = readValueAttributeComplete(server, session, &node->variableNode,
-                                            timestampsToReturn, &id->indexRange, v);
+                                            timestampsToReturn, &id->indexRange, v,
+                                            borrowed);
         break;
     }
     case UA_ATTRIBUTEID_DATATYPE:
@@ -615,8 +716,16 @@ ReadWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
 }
 
 void
-Operation_Read(UA_Server *server, UA_Session *session, UA_TimestampsToReturn *ttr,
-               const UA_ReadValueId *rvi, UA_DataValue *dv) {
+ReadWithNode(const UA_Node *node, UA_Server *server, UA_Session *session,
+             UA_TimestampsToReturn timestampsToReturn,
+             const UA_ReadValueId *id, UA_DataValue *v) {
+    readWithNode(node, server, session, timestampsToReturn, id, v, NULL);
+}
+
+static void
+readOperation(UA_Server *server, UA_Session *session, UA_TimestampsToReturn ttr,
+              const UA_ReadValueId *rvi, UA_DataValue *dv,
+              UA_BorrowedValues *borrowed) {
     /* Get the node (with only the selected attribute if the NodeStore supports that) */
     const UA_Node *node =
         UA_NODESTORE_GET_SELECTIVE(server, &rvi->nodeId,
@@ -630,10 +739,28 @@ Operation_Read(UA_Server *server, UA_Session *session, UA_TimestampsToReturn *tt
     }
 
     /* Perform the read operation */
-    ReadWithNode(node, server, session, *ttr, rvi, dv);
+    readWithNode(node, server, session, ttr, rvi, dv, borrowed);
     UA_NODESTORE_RELEASE(server, node);
 }
 
+void
+Operation_Read(UA_Server *server, UA_Session *session, UA_TimestampsToReturn *ttr,
+               const UA_ReadValueId *rvi, UA_DataValue *dv) {
+    readOperation(server, session, *ttr, rvi, dv, NULL);
+}
+
+struct ReadContext {
+    UA_TimestampsToReturn timestampsToReturn;
+    UA_BorrowedValues borrowed;
+};
+
+static void
+Operation_ReadBorrowed(UA_Server *server, UA_Session *session,
+                       struct ReadContext *ctx, const UA_ReadValueId *rvi,
+                       UA_DataValue *dv) {
+    readOperation(server, session, ctx->timestampsToReturn, rvi, dv, &ctx->borrowed);
+}
+
 void
 Service_Read(UA_Server *server, UA_Session *session,
              const UA_ReadRequest *request, UA_ReadResponse *response) {
@@ -661,20 +788,63 @@ Service_Read(UA_Server *server, UA_Session *session,
 
     UA_LOCK_ASSERT(&server->serviceMutex);
 
+    /* Values from borrowed data sources are collected during the operations
+     * (the service mutex is unlocked in the data source callbacks) */
+    struct ReadContext ctx;
+    memset(&ctx, 0, sizeof(struct ReadContext));
+    ctx.timestampsToReturn = request->timestampsToReturn;
     response->responseHeader.serviceResult =
         UA_Server_processServiceOperations(server, session,
-                                           (UA_ServiceOperation)Operation_Read,
-                                           &request->timestampsToReturn,
-                                           &request->nodesToReadSize,
+                                           (UA_ServiceOperation)Operation_ReadBorrowed,
+                                           &ctx, &request->nodesToReadSize,
                                            &UA_TYPES[UA_TYPES_READVALUEID],
                                            &response->resultsSize,
                                            &UA_TYPES[UA_TYPES_DATAVALUE]);
+    if(ctx.borrowed.size == 0) {
+        UA_free(ctx.borrowed.values);
+        return;
+    }
+
+    /* Hand the borrowed values over to be released after the response was
+     * encoded */
+    UA_BorrowedValues *bv = &server->borrowedValues;
+    if(bv->size == 0) {
+        UA_free(bv->values);
+        *bv = ctx.borrowed;
+        return;
+    }
+    UA_BorrowedValue *values = (UA_BorrowedValue*)
+        UA_realloc(bv->values, (bv->size + ctx.borrowed.size) * sizeof(UA_BorrowedValue));
+    if(!values) {
+        /* The results point into the released values */
+        UA_Array_delete(response->results, response->resultsSize,
+                        &UA_TYPES[UA_TYPES_DATAVALUE]);
+        response->results = NULL;
+        response->resultsSize = 0;
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_BorrowedValues_release(server, &ctx.borrowed);
+        return;
+    }
+    memcpy(&values[bv->size], ctx.borrowed.values,
+           ctx.borrowed.size * sizeof(UA_BorrowedValue));
+    bv->values = values;
+    bv->size += ctx.borrowed.size;
+    bv->capacity = bv->size;
+    UA_free(ctx.borrowed.values);
 }
 
 UA_DataValue
 readWithSession(UA_Server *server, UA_Session *session,
                 const UA_ReadValueId *item,
                 UA_TimestampsToReturn timestampsToReturn) {
+    return readWithSessionBorrowed(server, session, item, timestampsToReturn, NULL);
+}
+
+UA_DataValue
+readWithSessionBorrowed(UA_Server *server, UA_Session *session,
+                        const UA_ReadValueId *item,
+                        UA_TimestampsToReturn timestampsToReturn,
+                        UA_BorrowedValues *borrowed) {
     UA_LOCK_ASSERT(&server->serviceMutex);
 
     UA_DataValue dv;
@@ -688,7 +858,7 @@ readWithSession(UA_Server *server, UA_Session *session,
         return dv;
     }
 
-    Operation_Read(server, session, &timestampsToReturn, item, &dv);
+    readOperation(server, session, timestampsToReturn, item, &dv, borrowed);
     return dv;
 }
 
@@ -1515,6 +1685,17 @@ writeNodeValueAttribute(UA_Server *server, UA_Session *session,
         }
         break;
 
+    case UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED:
+        if(node->valueBackend.backend.borrowed.dataSource.write) {
+            UA_UNLOCK(&server->serviceMutex);
+            retval = node->valueBackend.backend.borrowed.dataSource.
+                write(server, &session->sessionId, session->context,
+                      &node->head.nodeId, node->head.context,
+                      rangeptr, &adjustedValue);
+            UA_LOCK(&server->serviceMutex);
+        }
+        break;
+
     case UA_VALUEBACKENDTYPE_INTERNAL:
     case UA_VALUEBACKENDTYPE_DATA_SOURCE_CALLBACK:
     default:
@@ -1807,10 +1988,105 @@ copyAttributeIntoNode(UA_Server *server, UA_Session *session,
     return UA_STATUSCODE_GOOD;
 }
 
+/* Fast path to write the Value attribute of a Variable that holds its value in
+ * the node. The current value was checked against the DataType, ValueRank and
+ * ArrayDimensions when it was written. Writing these attributes checks the
+ * current value again. So a new scalar value of the identical pointer-free type
+ * is compatible as well. It is copied over the current value in-place. */
+static UA_Boolean
+fastValueWritePossible(const UA_VariableNode *node, const UA_WriteValue *wv) {
+    const UA_DataValue *cur = &node->value.data.value;
+    return (node->head.nodeClass == UA_NODECLASS_VARIABLE &&
+            node->valueBackend.backendType == UA_VALUEBACKENDTYPE_NONE &&
+            node->valueSource == UA_VALUESOURCE_DATA &&
+            cur->hasValue && cur->value.type == wv->value.value.type &&
+            UA_Variant_isScalar(&cur->value) && cur->value.data != NULL);
+}
+
+static UA_StatusCode
+writeValueFast(UA_Server *server, UA_Session *session,
+               UA_VariableNode *node, const UA_WriteValue *wv) {
+    UA_Byte accessLevel = getUserAccessLevel(server, session, node);
+    if(!(accessLevel & (UA_ACCESSLEVELMASK_WRITE))) {
+        UA_LOG_INFO_SESSION(server->config.logging, session,
+                            "WriteRequest returned status code %s",
+                            UA_StatusCode_name(UA_STATUSCODE_BADUSERACCESSDENIED));
+        return UA_STATUSCODE_BADUSERACCESSDENIED;
+    }
+
+    /* Keep the memory of the current value. Ignore the source timestamp for
+     * non-dynamic variables (see writeNodeValueAttribute). */
+    UA_DataValue *cur = &node->value.data.value;
+    UA_DataValue adjustedValue = wv->value;
+    if(!node->isDynamic) {
+        adjustedValue.hasSourceTimestamp = false;
+        adjustedValue.hasSourcePicoseconds = false;
+    }
+    memcpy(cur->value.data, wv->value.value.data, cur->value.type->memSize);
+    adjustedValue.value = cur->value;
+    *cur = adjustedValue;
+
+    /* Callback after writing */
+    if(node->value.data.callback.onWrite) {
+        UA_UNLOCK(&server->serviceMutex);
+        node->value.data.callback.
+            onWrite(server, &session->sessionId, session->context,
+                    &node->head.nodeId, node->head.context, NULL, &adjustedValue);
+        UA_LOCK(&server->serviceMutex);
+    }
+
+#ifdef UA_ENABLE_HISTORIZING
+    if(server->config.historyDatabase.setValue) {
+        UA_UNLOCK(&server->serviceMutex);
+        server->config.historyDatabase.
+            setValue(server, server->config.historyDatabase.context,
+                     &session->sessionId, session->context,
+                     &node->head.nodeId, node->historizing, &adjustedValue);
+        UA_LOCK(&server->serviceMutex);
+    }
+#endif
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    triggerImmediateDataChange(server, session, (UA_Node*)node, wv);
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Writes to the Value attribute only edit the value of the node. This is
+ * signaled to the Nodestore with the attribute mask. */
+static void
+writeValue(UA_Server *server, UA_Session *session,
+           const UA_WriteValue *wv, UA_StatusCode *result) {
+    UA_Node *node =
+        UA_NODESTORE_GET_EDIT_SELECTIVE(server, &wv->nodeId,
+                                        UA_NODEATTRIBUTESMASK_VALUE,
+                                        UA_REFERENCETYPESET_NONE,
+                                        UA_BROWSEDIRECTION_INVALID);
+    if(!node) {
+        *result = UA_STATUSCODE_BADNODEIDUNKNOWN;
+        return;
+    }
+    if(fastValueWritePossible(&node->variableNode, wv))
+        *result = writeValueFast(server, session, &node->variableNode, wv);
+    else
+        *result = copyAttributeIntoNode(server, session, node, wv);
+    UA_NODESTORE_RELEASE(server, node);
+}
+
 void
 Operation_Write(UA_Server *server, UA_Session *session, void *context,
                 const UA_WriteValue *wv, UA_StatusCode *result) {
     UA_assert(session != NULL);
+
+    /* Scalar values of a pointer-free type without an IndexRange */
+    if(wv->attributeId == UA_ATTRIBUTEID_VALUE && wv->indexRange.length == 0 &&
+       wv->value.hasValue && wv->value.value.type &&
+       wv->value.value.type->pointerFree &&
+       UA_Variant_isScalar(&wv->value.value)) {
+        writeValue(server, session, wv, result);
+        return;
+    }
+
     *result = UA_Server_editNode(server, session, &wv->nodeId, wv->attributeId,
                                  UA_REFERENCETYPESET_NONE, UA_BROWSEDIRECTION_INVALID,
                                  (UA_EditNodeCallback)copyAttributeIntoNode,
@@ -461,6 +461,11 @@ Operation_CreateMonitoredItem(UA_Server *server, UA_Session *session,
     result->statusCode |= checkAdjustMonitoredItemParams(server, session, newMon,
                                                          valueType, &newMon->parameters,
                                                          &result->filterResult);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    if(result->statusCode == UA_STATUSCODE_GOOD &&
+       newMon->itemToMonitor.attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER)
+        result->statusCode = UA_MonitoredItem_compileEventFilter(server, newMon);
+#endif
     if(result->statusCode != UA_STATUSCODE_GOOD) {
         UA_LOG_INFO_SUBSCRIPTION(server->config.logging, cmc->sub,
                                  "Could not create a MonitoredItem "
@@ -725,6 +730,28 @@ Operation_ModifyMonitoredItem(UA_Server *server, UA_Session *session, UA_Subscri
         return;
     }
 
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    /* Compile the new EventFilter. The program points into the decoded filter
+     * of the new parameters. That memory is kept when the parameters are moved
+     * into the MonitoredItem. Upon failure, the old parameters and the old
+     * program remain in place. */
+    UA_EventFilterProgram *program = NULL;
+    if(mon->itemToMonitor.attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER) {
+        if(params.filter.content.decoded.type != &UA_TYPES[UA_TYPES_EVENTFILTER]) {
+            result->statusCode = UA_STATUSCODE_BADFILTERNOTALLOWED;
+        } else {
+            result->statusCode =
+                UA_EventFilterProgram_compile(server, (const UA_EventFilter*)
+                                              params.filter.content.decoded.data,
+                                              &program);
+        }
+        if(result->statusCode != UA_STATUSCODE_GOOD) {
+            UA_MonitoringParameters_clear(&params);
+            return;
+        }
+    }
+#endif
+
     /* Store the old sampling interval */
     UA_Double oldSamplingInterval = mon->parameters.samplingInterval;
 
@@ -732,6 +759,14 @@ Operation_ModifyMonitoredItem(UA_Server *server, UA_Session *session, UA_Subscri
     UA_MonitoringParameters_clear(&mon->parameters);
     mon->parameters = params;
 
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    /* Swap in the new EventFilter program */
+    if(mon->itemToMonitor.attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER) {
+        UA_EventFilterProgram_delete(mon->eventFilterProgram);
+        mon->eventFilterProgram = program;
+    }
+#endif
+
     /* Re-register the callback if necessary */
     if(oldSamplingInterval != mon->parameters.samplingInterval) {
         UA_MonitoredItem_unregisterSampling(server, mon);
@@ -750,7 +785,9 @@ Operation_ModifyMonitoredItem(UA_Server *server, UA_Session *session, UA_Subscri
     if(result->revisedSamplingInterval < 0.0 && mon->subscription)
         result->revisedSamplingInterval = mon->subscription->publishingInterval;
 
-    /* Remove some notifications if the queue is now too small */
+    /* Remove some notifications if the queue is now too small. The samples in
+     * the ring are converted to individual notifications for this. */
+    UA_MonitoredItem_spillRing(mon);
     UA_MonitoredItem_ensureQueueSpace(server, mon);
 
     /* Remove the overflow bits if the queue has now a size of 1 */
@@ -461,44 +461,6 @@ useVariableTypeAttributes(UA_Server *server, UA_Session *session,
     return retval;
 }
 
-/* Search for an instance of "browseName" in node searchInstance. Used during
- * copyChildNodes to find overwritable/mergable nodes. Does not touch
- * outInstanceNodeId if no child is found. */
-static UA_StatusCode
-findChildByBrowsename(UA_Server *server, UA_Session *session,
-                      const UA_NodeId *searchInstance,
-                      const UA_QualifiedName *browseName,
-                      UA_NodeId *outInstanceNodeId) {
-    UA_BrowseDescription bd;
-    UA_BrowseDescription_init(&bd);
-    bd.nodeId = *searchInstance;
-    bd.referenceTypeId = UA_NS0ID(AGGREGATES);
-    bd.includeSubtypes = true;
-    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
-    bd.nodeClassMask = UA_NODECLASS_OBJECT | UA_NODECLASS_VARIABLE | UA_NODECLASS_METHOD;
-    bd.resultMask = UA_BROWSERESULTMASK_BROWSENAME;
-
-    UA_BrowseResult br;
-    UA_BrowseResult_init(&br);
-    UA_UInt32 maxrefs = 0;
-    Operation_Browse(server, session, &maxrefs, &bd, &br);
-    if(br.statusCode != UA_STATUSCODE_GOOD)
-        return br.statusCode;
-
-    UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    for(size_t i = 0; i < br.referencesSize; ++i) {
-        UA_ReferenceDescription *rd = &br.references[i];
-        if(rd->browseName.namespaceIndex == browseName->namespaceIndex &&
-           UA_String_equal(&rd->browseName.name, &browseName->name)) {
-            retval = UA_NodeId_copy(&rd->nodeId.nodeId, outInstanceNodeId);
-            break;
-        }
-    }
-
-    UA_BrowseResult_clear(&br);
-    return retval;
-}
-
 static const UA_ExpandedNodeId mandatoryId =
     {{0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_MODELLINGRULE_MANDATORY}}, {0, NULL}, 0};
 
@@ -597,62 +559,356 @@ addInterfaceChildren(UA_Server *server, UA_Session *session,
     return retval;
 }
 
+/***********************/
+/* Instantiation Plans */
+/***********************/
+
+static enum ZIP_CMP
+cmpInstantiationPlanKey(const UA_InstantiationPlanKey *a,
+                        const UA_InstantiationPlanKey *b) {
+    if(a->hierarchy != b->hierarchy)
+        return (a->hierarchy < b->hierarchy) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+    return (enum ZIP_CMP)UA_NodeId_order(&a->sourceId, &b->sourceId);
+}
+
+ZIP_FUNCTIONS(UA_InstantiationPlanTree, UA_InstantiationPlan, treeEntry,
+              UA_InstantiationPlanKey, key, cmpInstantiationPlanKey)
+
+static enum ZIP_CMP
+cmpInstantiationDependency(const UA_NodeId *a, const UA_NodeId *b) {
+    return (enum ZIP_CMP)UA_NodeId_order(a, b);
+}
+
+ZIP_FUNCTIONS(UA_InstantiationDependencyTree, UA_InstantiationDependency,
+              treeEntry, UA_NodeId, nodeId, cmpInstantiationDependency)
+
+static void
+clearInstantiationSteps(UA_InstantiationPlan *plan) {
+    for(size_t i = 0; i < plan->stepsSize; i++) {
+        UA_InstantiationStep *step = &plan->steps[i];
+        UA_NodeId_clear(&step->declarationId);
+        UA_NodeId_clear(&step->referenceTypeId);
+        UA_NodeId_clear(&step->typeDefinitionId);
+        UA_QualifiedName_clear(&step->browseName);
+    }
+    UA_free(plan->steps);
+    plan->steps = NULL;
+    plan->stepsSize = 0;
+}
+
+static void *
+deleteInstantiationPlan(void *context, UA_InstantiationPlan *plan) {
+    clearInstantiationSteps(plan);
+    UA_NodeId_clear(&plan->key.sourceId);
+    UA_free(plan);
+    return NULL;
+}
+
+static void *
+deleteInstantiationDependency(void *context, UA_InstantiationDependency *dep) {
+    UA_NodeId_clear(&dep->nodeId);
+    UA_free(dep);
+    return NULL;
+}
+
+static void
+clearInstantiationDependencies(UA_InstantiationCache *cache) {
+    ZIP_ITER(UA_InstantiationDependencyTree, &cache->dependencies,
+             deleteInstantiationDependency, NULL);
+    ZIP_INIT(&cache->dependencies);
+}
+
+void
+UA_InstantiationCache_clear(UA_InstantiationCache *cache) {
+    ZIP_ITER(UA_InstantiationPlanTree, &cache->plans,
+             deleteInstantiationPlan, NULL);
+    ZIP_INIT(&cache->plans);
+    cache->plansSize = 0;
+    clearInstantiationDependencies(cache);
+}
+
+void
+UA_InstantiationCache_changed(UA_InstantiationCache *cache,
+                              const UA_NodeId *nodeId) {
+    if(!ZIP_FIND(UA_InstantiationDependencyTree, &cache->dependencies, nodeId))
+        return;
+    /* All plans are outdated. The dependencies are registered again when the
+     * plans are compiled. */
+    cache->generation++;
+    clearInstantiationDependencies(cache);
+}
+
+/* The children of a node are the targets of its forward references. Changes to
+ * the supertypes are also detected at the subtype. References from instances
+ * (e.g. HasTypeDefinition to the type) do not affect the plans. */
+static void
+instantiationReferenceChanged(UA_Server *server, const UA_NodeId *sourceId,
+                              const UA_NodeId *targetId, UA_Boolean isForward,
+                              UA_Byte refTypeIndex) {
+    const UA_NodeId *forwardSource = (isForward) ? sourceId : targetId;
+    const UA_NodeId *forwardTarget = (isForward) ? targetId : sourceId;
+    UA_InstantiationCache_changed(&server->instantiation, forwardSource);
+    if(refTypeIndex == UA_REFERENCETYPEINDEX_HASSUBTYPE)
+        UA_InstantiationCache_changed(&server->instantiation, forwardTarget);
+}
+
 static UA_StatusCode
-copyChild(UA_Server *server, UA_Session *session,
-          const UA_NodeId *destinationNodeId,
-          const UA_ReferenceDescription *rd) {
-    UA_assert(session);
-    UA_LOCK_ASSERT(&server->serviceMutex);
+addInstantiationDependency(UA_InstantiationCache *cache, const UA_NodeId *nodeId) {
+    if(ZIP_FIND(UA_InstantiationDependencyTree, &cache->dependencies, nodeId))
+        return UA_STATUSCODE_GOOD;
+    UA_InstantiationDependency *dep = (UA_InstantiationDependency*)
+        UA_calloc(1, sizeof(UA_InstantiationDependency));
+    if(!dep)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode res = UA_NodeId_copy(nodeId, &dep->nodeId);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_free(dep);
+        return res;
+    }
+    ZIP_INSERT(UA_InstantiationDependencyTree, &cache->dependencies, dep);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Append the children of the source node to the plan. The fields of the
+ * ReferenceDescriptions are moved into the steps. */
+static UA_StatusCode
+addInstantiationSteps(UA_Server *server, UA_Session *session,
+                      UA_InstantiationPlan *plan, size_t *stepsCapacity,
+                      const UA_NodeId *source) {
+    /* Browse to get all children of the source */
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = *source;
+    bd.referenceTypeId = UA_NS0ID(AGGREGATES);
+    bd.includeSubtypes = true;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.nodeClassMask = UA_NODECLASS_OBJECT | UA_NODECLASS_VARIABLE | UA_NODECLASS_METHOD;
+    bd.resultMask = UA_BROWSERESULTMASK_REFERENCETYPEID | UA_BROWSERESULTMASK_NODECLASS |
+        UA_BROWSERESULTMASK_BROWSENAME | UA_BROWSERESULTMASK_TYPEDEFINITION;
+
+    UA_BrowseResult br;
+    UA_BrowseResult_init(&br);
+    UA_UInt32 maxrefs = 0;
+    Operation_Browse(server, session, &maxrefs, &bd, &br);
+    if(br.statusCode != UA_STATUSCODE_GOOD)
+        return br.statusCode;
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < br.referencesSize; ++i) {
+        UA_ReferenceDescription *rd = &br.references[i];
+        if(plan->cached) {
+            retval = addInstantiationDependency(&server->instantiation,
+                                                &rd->nodeId.nodeId);
+            if(retval != UA_STATUSCODE_GOOD)
+                break;
+        }
+
+        /* Grow the steps array */
+        if(plan->stepsSize == *stepsCapacity) {
+            size_t newCapacity = (*stepsCapacity > 0) ? *stepsCapacity * 2 : 8;
+            UA_InstantiationStep *steps = (UA_InstantiationStep*)
+                UA_realloc(plan->steps, newCapacity * sizeof(UA_InstantiationStep));
+            if(!steps) {
+                retval = UA_STATUSCODE_BADOUTOFMEMORY;
+                break;
+            }
+            plan->steps = steps;
+            *stepsCapacity = newCapacity;
+        }
 
-    /* Is there an existing child with the browsename? */
-    UA_NodeId existingChild = UA_NODEID_NULL;
-    UA_StatusCode retval = findChildByBrowsename(server, session, destinationNodeId,
-                                                 &rd->browseName, &existingChild);
+        /* Move the fields into the new step */
+        UA_InstantiationStep *step = &plan->steps[plan->stepsSize];
+        step->declarationId = rd->nodeId.nodeId;
+        step->referenceTypeId = rd->referenceTypeId;
+        step->typeDefinitionId = rd->typeDefinition.nodeId;
+        step->browseName = rd->browseName;
+        step->nodeClass = rd->nodeClass;
+        UA_NodeId_init(&rd->nodeId.nodeId);
+        UA_NodeId_init(&rd->referenceTypeId);
+        UA_NodeId_init(&rd->typeDefinition.nodeId);
+        UA_QualifiedName_init(&rd->browseName);
+        step->mandatory = isMandatoryChild(server, session, &step->declarationId);
+
+        /* Link to the previous step with the same BrowseName. The later step
+         * is then merged into the child created for the earlier step. */
+        step->sameName = SIZE_MAX;
+        for(size_t j = plan->stepsSize; j > 0; j--) {
+            if(UA_QualifiedName_equal(&plan->steps[j-1].browseName,
+                                      &step->browseName)) {
+                step->sameName = j-1;
+                break;
+            }
+        }
+        plan->stepsSize++;
+    }
+
+    UA_BrowseResult_clear(&br);
+    return retval;
+}
+
+/* Collect the children of the source node. With the hierarchy option, also the
+ * children of the supertypes and interfaces. The type itself comes first, so
+ * that its children override those of the supertypes. */
+static UA_StatusCode
+compileInstantiationPlan(UA_Server *server, UA_Session *session,
+                         UA_InstantiationPlan *plan) {
+    UA_NodeId *hierarchy = NULL;
+    size_t hierarchySize = 0;
+    UA_StatusCode retval;
+    if(plan->key.hierarchy) {
+        retval = getParentTypeAndInterfaceHierarchy(server, &plan->key.sourceId,
+                                                    &hierarchy, &hierarchySize);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        UA_assert(hierarchySize < 1000);
+    } else {
+        hierarchy = &plan->key.sourceId;
+        hierarchySize = 1;
+    }
+
+    size_t stepsCapacity = 0;
+    for(size_t i = 0; i < hierarchySize; ++i) {
+        if(plan->cached) {
+            retval = addInstantiationDependency(&server->instantiation, &hierarchy[i]);
+            if(retval != UA_STATUSCODE_GOOD)
+                break;
+        }
+        retval = addInstantiationSteps(server, session, plan,
+                                       &stepsCapacity, &hierarchy[i]);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
+    }
+
+    if(plan->key.hierarchy)
+        UA_Array_delete(hierarchy, hierarchySize, &UA_TYPES[UA_TYPES_NODEID]);
     if(retval != UA_STATUSCODE_GOOD)
-        return retval;
+        clearInstantiationSteps(plan);
+    return retval;
+}
 
-    /* Have a child with that browseName. Deep-copy missing members. */
-    if(!UA_NodeId_isNull(&existingChild)) {
-        if(rd->nodeClass == UA_NODECLASS_VARIABLE ||
-           rd->nodeClass == UA_NODECLASS_OBJECT)
-            retval = copyAllChildren(server, session, &rd->nodeId.nodeId, &existingChild);
-        UA_NodeId_clear(&existingChild);
+/* Returns a plan from the cache or compiles a temporary plan. The plan has to
+ * be released after the replay. */
+static UA_StatusCode
+getInstantiationPlan(UA_Server *server, UA_Session *session,
+                     const UA_NodeId *sourceId, UA_Boolean hierarchy,
+                     UA_InstantiationPlan **outPlan) {
+    UA_InstantiationCache *cache = &server->instantiation;
+    UA_InstantiationPlanKey key;
+    key.sourceId = *sourceId;
+    key.hierarchy = hierarchy;
+
+    /* Cached plan from the current generation */
+    UA_InstantiationPlan *plan =
+        ZIP_FIND(UA_InstantiationPlanTree, &cache->plans, &key);
+    if(plan && plan->generation == cache->generation) {
+        plan->inUse++;
+        *outPlan = plan;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Compile an outdated plan again. Unless it is replayed right now. */
+    UA_StatusCode retval;
+    if(plan && plan->inUse == 0) {
+        clearInstantiationSteps(plan);
+        plan->generation = cache->generation;
+        retval = compileInstantiationPlan(server, session, plan);
+        if(retval != UA_STATUSCODE_GOOD) {
+            ZIP_REMOVE(UA_InstantiationPlanTree, &cache->plans, plan);
+            deleteInstantiationPlan(NULL, plan);
+            cache->plansSize--;
+            return retval;
+        }
+        plan->inUse++;
+        *outPlan = plan;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Create a new plan. It is temporary if the cache is full or if an
+     * outdated plan for the same source is replayed right now. */
+    UA_Boolean cached = (!plan && cache->plansSize < UA_INSTANTIATIONCACHE_MAXSIZE);
+    plan = (UA_InstantiationPlan*)UA_calloc(1, sizeof(UA_InstantiationPlan));
+    if(!plan)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    retval = UA_NodeId_copy(sourceId, &plan->key.sourceId);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(plan);
+        return retval;
+    }
+    plan->key.hierarchy = hierarchy;
+    plan->cached = cached;
+    plan->generation = cache->generation;
+    retval = compileInstantiationPlan(server, session, plan);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteInstantiationPlan(NULL, plan);
         return retval;
     }
+    if(cached) {
+        ZIP_INSERT(UA_InstantiationPlanTree, &cache->plans, plan);
+        cache->plansSize++;
+    }
+    plan->inUse++;
+    *outPlan = plan;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+releaseInstantiationPlan(UA_InstantiationPlan *plan) {
+    plan->inUse--;
+    if(!plan->cached)
+        deleteInstantiationPlan(NULL, plan);
+}
+
+static UA_StatusCode
+copyChildren(UA_Server *server, UA_Session *session, const UA_NodeId *source,
+             UA_Boolean hierarchy, const UA_NodeId *destination);
+
+/* Create a new child from the instance declaration */
+static UA_StatusCode
+copyChild(UA_Server *server, UA_Session *session,
+          const UA_NodeId *destinationNodeId,
+          const UA_InstantiationStep *step,
+          const UA_ReferenceTypeSet *reftypes_skipped,
+          UA_NodeId *outNewNodeId) {
+    UA_assert(session);
+    UA_LOCK_ASSERT(&server->serviceMutex);
 
     /* Is the child mandatory? If not, ask callback whether child should be instantiated.
      * If not, skip. */
-    if(!isMandatoryChild(server, session, &rd->nodeId.nodeId)) {
+    if(!step->mandatory) {
         if(!server->config.nodeLifecycle.createOptionalChild)
             return UA_STATUSCODE_GOOD;
         UA_UNLOCK(&server->serviceMutex);
         UA_Boolean createChild = server->config.nodeLifecycle.
             createOptionalChild(server, &session->sessionId, session->context,
-                                &rd->nodeId.nodeId, destinationNodeId, &rd->referenceTypeId);
+                                &step->declarationId, destinationNodeId,
+                                &step->referenceTypeId);
         UA_LOCK(&server->serviceMutex);
         if(!createChild)
             return UA_STATUSCODE_GOOD;
     }
 
     /* Child is a method -> create a reference */
-    if(rd->nodeClass == UA_NODECLASS_METHOD) {
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(step->nodeClass == UA_NODECLASS_METHOD) {
         UA_AddReferencesItem newItem;
         UA_AddReferencesItem_init(&newItem);
         newItem.sourceNodeId = *destinationNodeId;
-        newItem.referenceTypeId = rd->referenceTypeId;
+        newItem.referenceTypeId = step->referenceTypeId;
         newItem.isForward = true;
-        newItem.targetNodeId = rd->nodeId;
+        newItem.targetNodeId.nodeId = step->declarationId;
         newItem.targetNodeClass = UA_NODECLASS_METHOD;
         Operation_addReference(server, session, NULL, &newItem, &retval);
-        return retval;
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        return UA_NodeId_copy(&step->declarationId, outNewNodeId);
     }
 
     /* Child is a variable or object */
-    if(rd->nodeClass == UA_NODECLASS_VARIABLE ||
-       rd->nodeClass == UA_NODECLASS_OBJECT) {
+    if(step->nodeClass == UA_NODECLASS_VARIABLE ||
+       step->nodeClass == UA_NODECLASS_OBJECT) {
         /* Make a copy of the node */
         UA_Node *node;
-        retval = UA_NODESTORE_GETCOPY(server, &rd->nodeId.nodeId, &node);
+        retval = UA_NODESTORE_GETCOPY(server, &step->declarationId, &node);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
 
@@ -681,8 +937,8 @@ copyChild(UA_Server *server, UA_Session *session,
             UA_UNLOCK(&server->serviceMutex);
             retval = server->config.nodeLifecycle.
                 generateChildNodeId(server, &session->sessionId, session->context,
-                                    &rd->nodeId.nodeId, destinationNodeId,
-                                    &rd->referenceTypeId, &node->head.nodeId);
+                                    &step->declarationId, destinationNodeId,
+                                    &step->referenceTypeId, &node->head.nodeId);
             UA_LOCK(&server->serviceMutex);
             if(retval != UA_STATUSCODE_GOOD) {
                 UA_NODESTORE_DELETE(server, node);
@@ -695,21 +951,7 @@ copyChild(UA_Server *server, UA_Session *session,
          * addnode_finish. That way, we can call addnode_finish also on children that were
          * manually added by the user during addnode_begin and addnode_finish. */
         /* For now we keep all the modelling rule references and delete all others */
-        const UA_NodeId nodeId_typesFolder= UA_NS0ID(TYPESFOLDER);
-        const UA_ReferenceTypeSet reftypes_aggregates =
-            UA_REFTYPESET(UA_REFERENCETYPEINDEX_AGGREGATES);
-        UA_ReferenceTypeSet reftypes_skipped;
-        /* Check if the hasModellingRule-reference is required (configured or node in an
-            instance declaration) */
-        if(server->config.modellingRulesOnInstances ||
-           isNodeInTree(server, destinationNodeId,
-                        &nodeId_typesFolder, &reftypes_aggregates)) {
-            reftypes_skipped = UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASMODELLINGRULE);
-        } else {
-            UA_ReferenceTypeSet_init(&reftypes_skipped);
-        }
-        reftypes_skipped = UA_ReferenceTypeSet_union(reftypes_skipped, UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASINTERFACE));
-        UA_Node_deleteReferencesSubset(node, &reftypes_skipped);
+        UA_Node_deleteReferencesSubset(node, reftypes_skipped);
 
         /* Add the node to the nodestore */
         UA_NodeId newNodeId = UA_NODEID_NULL;
@@ -717,21 +959,23 @@ copyChild(UA_Server *server, UA_Session *session,
         /* node = NULL; The pointer is no longer valid */
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
+        server->browsePaths.generation++; /* Invalidate the cached BrowsePaths */
 
         /* Add the node references */
         retval = addNode_addRefs(server, session, &newNodeId, destinationNodeId,
-                                 &rd->referenceTypeId, &rd->typeDefinition.nodeId);
+                                 &step->referenceTypeId, &step->typeDefinitionId);
         if(retval != UA_STATUSCODE_GOOD) {
             UA_NODESTORE_REMOVE(server, &newNodeId);
             UA_NodeId_clear(&newNodeId);
             return retval;
         }
 
-        if (rd->nodeClass == UA_NODECLASS_VARIABLE) {
+        if(step->nodeClass == UA_NODECLASS_VARIABLE) {
             retval = checkSetIsDynamicVariable(server, session, &newNodeId);
 
             if(retval != UA_STATUSCODE_GOOD) {
                 UA_NODESTORE_REMOVE(server, &newNodeId);
+                UA_NodeId_clear(&newNodeId);
                 return retval;
             }
         }
@@ -739,9 +983,10 @@ copyChild(UA_Server *server, UA_Session *session,
         /* For the new child, recursively copy the members of the original. No
          * typechecking is performed here. Assuming that the original is
          * consistent. */
-        retval = copyAllChildren(server, session, &rd->nodeId.nodeId, &newNodeId);
+        retval = copyChildren(server, session, &step->declarationId, false, &newNodeId);
         if(retval != UA_STATUSCODE_GOOD) {
             deleteNode(server, newNodeId, true);
+            UA_NodeId_clear(&newNodeId);
             return retval;
         }
 
@@ -750,72 +995,138 @@ copyChild(UA_Server *server, UA_Session *session,
         retval = addNode_finish(server, session, &newNodeId);
         if(retval != UA_STATUSCODE_GOOD) {
             deleteNode(server, newNodeId, true);
+            UA_NodeId_clear(&newNodeId);
             return retval;
         }
 
-        /* Clean up.  Because it can happen that a string is assigned as ID at
+        /* Return the NodeId. It can be a string assigned by
          * generateChildNodeId. */
-        UA_NodeId_clear(&newNodeId);
+        *outNewNodeId = newNodeId;
     }
 
     return retval;
 }
 
-/* Copy any children of Node sourceNodeId to another node destinationNodeId. */
+static const UA_NodeId *
+findChildByBrowsename(const UA_BrowseResult *br,
+                      const UA_QualifiedName *browseName) {
+    for(size_t i = 0; i < br->referencesSize; ++i) {
+        const UA_ReferenceDescription *rd = &br->references[i];
+        if(rd->browseName.namespaceIndex == browseName->namespaceIndex &&
+           UA_String_equal(&rd->browseName.name, &browseName->name))
+            return &rd->nodeId.nodeId;
+    }
+    return NULL;
+}
+
+/* Copy the children from the instantiation plan of the source node to the
+ * destination. Children that exist already (matching BrowseName) are not
+ * replaced. Instead, their missing members are copied recursively. */
 static UA_StatusCode
-copyAllChildren(UA_Server *server, UA_Session *session,
-                const UA_NodeId *source, const UA_NodeId *destination) {
-    /* Browse to get all children of the source */
+copyChildren(UA_Server *server, UA_Session *session, const UA_NodeId *source,
+             UA_Boolean hierarchy, const UA_NodeId *destination) {
+    UA_InstantiationPlan *plan = NULL;
+    UA_StatusCode retval =
+        getInstantiationPlan(server, session, source, hierarchy, &plan);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(plan->stepsSize == 0) {
+        releaseInstantiationPlan(plan);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Browse the children that exist already in the destination. Used to find
+     * overwritable/mergable nodes. Children created from the plan are
+     * tracked separately. */
     UA_BrowseDescription bd;
     UA_BrowseDescription_init(&bd);
-    bd.nodeId = *source;
+    bd.nodeId = *destination;
     bd.referenceTypeId = UA_NS0ID(AGGREGATES);
     bd.includeSubtypes = true;
     bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
     bd.nodeClassMask = UA_NODECLASS_OBJECT | UA_NODECLASS_VARIABLE | UA_NODECLASS_METHOD;
-    bd.resultMask = UA_BROWSERESULTMASK_REFERENCETYPEID | UA_BROWSERESULTMASK_NODECLASS |
-        UA_BROWSERESULTMASK_BROWSENAME | UA_BROWSERESULTMASK_TYPEDEFINITION;
+    bd.resultMask = UA_BROWSERESULTMASK_BROWSENAME;
 
-    UA_BrowseResult br;
-    UA_BrowseResult_init(&br);
+    UA_BrowseResult existing;
+    UA_BrowseResult_init(&existing);
     UA_UInt32 maxrefs = 0;
-    Operation_Browse(server, session, &maxrefs, &bd, &br);
-    if(br.statusCode != UA_STATUSCODE_GOOD)
-        return br.statusCode;
+    Operation_Browse(server, session, &maxrefs, &bd, &existing);
+    if(existing.statusCode != UA_STATUSCODE_GOOD) {
+        retval = existing.statusCode;
+        releaseInstantiationPlan(plan);
+        return retval;
+    }
 
-    UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    for(size_t i = 0; i < br.referencesSize; ++i) {
-        UA_ReferenceDescription *rd = &br.references[i];
-        retval = copyChild(server, session, destination, rd);
+    UA_NodeId *created = (UA_NodeId*)
+        UA_Array_new(plan->stepsSize, &UA_TYPES[UA_TYPES_NODEID]);
+    if(!created) {
+        UA_BrowseResult_clear(&existing);
+        releaseInstantiationPlan(plan);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    /* Check if the hasModellingRule-reference is required (configured or node
+     * in an instance declaration). The other references of the copied nodes
+     * are removed. */
+    const UA_NodeId nodeId_typesFolder= UA_NS0ID(TYPESFOLDER);
+    const UA_ReferenceTypeSet reftypes_aggregates =
+        UA_REFTYPESET(UA_REFERENCETYPEINDEX_AGGREGATES);
+    UA_ReferenceTypeSet reftypes_skipped;
+    if(server->config.modellingRulesOnInstances ||
+       isNodeInTree(server, destination, &nodeId_typesFolder, &reftypes_aggregates)) {
+        reftypes_skipped = UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASMODELLINGRULE);
+    } else {
+        UA_ReferenceTypeSet_init(&reftypes_skipped);
+    }
+    reftypes_skipped = UA_ReferenceTypeSet_union(reftypes_skipped,
+                                                 UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASINTERFACE));
+
+    for(size_t i = 0; i < plan->stepsSize; ++i) {
+        const UA_InstantiationStep *step = &plan->steps[i];
+
+        /* Is there an existing child with the browsename? */
+        const UA_NodeId *existingChild = NULL;
+        for(size_t j = step->sameName; j != SIZE_MAX; j = plan->steps[j].sameName) {
+            if(!UA_NodeId_isNull(&created[j])) {
+                existingChild = &created[j];
+                break;
+            }
+        }
+        if(!existingChild)
+            existingChild = findChildByBrowsename(&existing, &step->browseName);
+
+        /* Have a child with that browseName. Deep-copy missing members. */
+        if(existingChild) {
+            if(step->nodeClass == UA_NODECLASS_VARIABLE ||
+               step->nodeClass == UA_NODECLASS_OBJECT)
+                retval = copyChildren(server, session, &step->declarationId,
+                                      false, existingChild);
+        } else {
+            retval = copyChild(server, session, destination, step,
+                               &reftypes_skipped, &created[i]);
+        }
         if(retval != UA_STATUSCODE_GOOD)
             break;
     }
 
-    UA_BrowseResult_clear(&br);
+    UA_Array_delete(created, plan->stepsSize, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_BrowseResult_clear(&existing);
+    releaseInstantiationPlan(plan);
     return retval;
 }
 
+/* Copy any children of Node sourceNodeId to another node destinationNodeId. */
+static UA_StatusCode
+copyAllChildren(UA_Server *server, UA_Session *session,
+                const UA_NodeId *source, const UA_NodeId *destination) {
+    return copyChildren(server, session, source, false, destination);
+}
+
+/* Copy the members of the type and supertypes (and instantiate them) */
 static UA_StatusCode
 addTypeChildren(UA_Server *server, UA_Session *session,
                 const UA_NodeId *nodeId, const UA_NodeId *typeId) {
-    /* Get the hierarchy of the type and all its supertypes */
-    UA_NodeId *hierarchy = NULL;
-    size_t hierarchySize = 0;
-    UA_StatusCode retval = getParentTypeAndInterfaceHierarchy(server, typeId,
-                                                              &hierarchy, &hierarchySize);
-    if(retval != UA_STATUSCODE_GOOD)
-        return retval;
-    UA_assert(hierarchySize < 1000);
-
-    /* Copy members of the type and supertypes (and instantiate them) */
-    for(size_t i = 0; i < hierarchySize; ++i) {
-        retval = copyAllChildren(server, session, &hierarchy[i], nodeId);
-        if(retval != UA_STATUSCODE_GOOD)
-            break;
-    }
-
-    UA_Array_delete(hierarchy, hierarchySize, &UA_TYPES[UA_TYPES_NODEID]);
-    return retval;
+    return copyChildren(server, session, typeId, true, nodeId);
 }
 
 /************/
@@ -1099,6 +1410,7 @@ addNode_raw(UA_Server *server, UA_Session *session, void *nodeContext,
                             UA_StatusCode_name(retval));
         return retval;
     }
+    server->browsePaths.generation++; /* Invalidate the cached BrowsePaths */
 
     if(outNewNodeId == &tmpOutId)
         UA_NodeId_clear(&tmpOutId);
@@ -1675,6 +1987,57 @@ __UA_Server_addNode(UA_Server *server, const UA_NodeClass nodeClass,
     return reval;
 }
 
+UA_StatusCode
+UA_Server_addObjectNodes(UA_Server *server, size_t count,
+                         const UA_NodeId *requestedNewNodeIds,
+                         const UA_NodeId parentNodeId,
+                         const UA_NodeId referenceTypeId,
+                         const UA_QualifiedName *browseNames,
+                         const UA_NodeId typeDefinition,
+                         const UA_ObjectAttributes attr,
+                         void *nodeContext, UA_NodeId *outNewNodeIds) {
+    if(count == 0)
+        return UA_STATUSCODE_GOOD;
+    if(!browseNames)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    UA_NodeId *newNodeIds = (UA_NodeId*)
+        UA_Array_new(count, &UA_TYPES[UA_TYPES_NODEID]);
+    if(!newNodeIds)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* The instantiation plan of the type is compiled for the first instance
+     * and reused for the following ones */
+    UA_LOCK(&server->serviceMutex);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    size_t added = 0;
+    for(; added < count; added++) {
+        const UA_NodeId requestedId = (requestedNewNodeIds) ?
+            requestedNewNodeIds[added] : UA_NODEID_NULL;
+        retval = addNode(server, UA_NODECLASS_OBJECT, requestedId, parentNodeId,
+                         referenceTypeId, browseNames[added], typeDefinition,
+                         &attr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES],
+                         nodeContext, &newNodeIds[added]);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
+    }
+
+    /* Remove the instances added so far */
+    if(retval != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < added; i++)
+            deleteNode(server, newNodeIds[i], true);
+    }
+    UA_UNLOCK(&server->serviceMutex);
+
+    if(retval == UA_STATUSCODE_GOOD && outNewNodeIds) {
+        memcpy(outNewNodeIds, newNodeIds, count * sizeof(UA_NodeId));
+        UA_free(newNodeIds);
+    } else {
+        UA_Array_delete(newNodeIds, count, &UA_TYPES[UA_TYPES_NODEID]);
+    }
+    return retval;
+}
+
 UA_StatusCode
 addNode_begin(UA_Server *server, const UA_NodeClass nodeClass,
               const UA_NodeId requestedNewNodeId, const UA_NodeId parentNodeId,
@@ -1718,6 +2081,197 @@ UA_Server_addNode_finish(UA_Server *server, const UA_NodeId nodeId) {
     return retval;
 }
 
+/*************/
+/* Bulk Load */
+/*************/
+
+typedef struct {
+    const UA_NodeId *parentNodeId;
+    size_t index;
+} BulkItemOrder;
+
+/* Sort by the parent. Keep the order of the items for the same parent. */
+static int
+cmpBulkItemOrder(const void *a, const void *b) {
+    const BulkItemOrder *aa = (const BulkItemOrder*)a;
+    const BulkItemOrder *bb = (const BulkItemOrder*)b;
+    UA_Order o = UA_NodeId_order(aa->parentNodeId, bb->parentNodeId);
+    if(o != UA_ORDER_EQ)
+        return (int)o;
+    if(aa->index == bb->index)
+        return 0;
+    return (aa->index < bb->index) ? -1 : 1;
+}
+
+/* Add the references of the nodes and finish them. Either for the
+ * ReferenceTypes or for all other NodeClasses. */
+static UA_StatusCode
+addNodesBulk_finish(UA_Server *server, size_t itemsSize,
+                    const UA_AddNodesItem *items, const UA_NodeId *newNodeIds,
+                    BulkItemOrder *order, UA_Boolean referenceTypes,
+                    size_t *failedIndex) {
+    /* Sort the nodes by their parent */
+    size_t orderSize = 0;
+    for(size_t i = 0; i < itemsSize; i++) {
+        if((items[i].nodeClass == UA_NODECLASS_REFERENCETYPE) != referenceTypes)
+            continue;
+        order[orderSize].parentNodeId = &items[i].parentNodeId.nodeId;
+        order[orderSize].index = i;
+        orderSize++;
+    }
+    qsort(order, orderSize, sizeof(BulkItemOrder), cmpBulkItemOrder);
+
+    /* Typecheck and add references to parent and type definition */
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < orderSize; i++) {
+        const UA_AddNodesItem *item = &items[order[i].index];
+        retval = addNode_addRefs(server, &server->adminSession,
+                                 &newNodeIds[order[i].index],
+                                 &item->parentNodeId.nodeId, &item->referenceTypeId,
+                                 &item->typeDefinition.nodeId);
+        if(retval != UA_STATUSCODE_GOOD) {
+            *failedIndex = order[i].index;
+            return retval;
+        }
+    }
+
+    /* Instantiate the children and call the constructors. In the order of the
+     * items. */
+    for(size_t i = 0; i < itemsSize; i++) {
+        if((items[i].nodeClass == UA_NODECLASS_REFERENCETYPE) != referenceTypes)
+            continue;
+        retval = addNode_finish(server, &server->adminSession, &newNodeIds[i]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            *failedIndex = i;
+            return retval;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_addNodesBulk(UA_Server *server, size_t itemsSize,
+                       const UA_AddNodesItem *items, void **nodeContexts,
+                       UA_NodeId *outNewNodeIds, size_t *failedIndex) {
+    size_t failed = SIZE_MAX;
+    if(failedIndex)
+        *failedIndex = failed;
+    if(itemsSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    UA_NodeId *newNodeIds = (UA_NodeId*)
+        UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_NODEID]);
+    BulkItemOrder *order = (BulkItemOrder*)
+        UA_malloc(itemsSize * sizeof(BulkItemOrder));
+    if(!newNodeIds || !order) {
+        UA_Array_delete(newNodeIds, itemsSize, &UA_TYPES[UA_TYPES_NODEID]);
+        UA_free(order);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    UA_LOCK(&server->serviceMutex);
+    UA_Session *session = &server->adminSession;
+
+    /* Resize the Nodestore only once */
+    UA_Nodestore *ns = &server->config.nodestore;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(ns->reserve) {
+        retval = ns->reserve(ns->context, itemsSize);
+        if(retval != UA_STATUSCODE_GOOD)
+            goto cleanup;
+    }
+
+    /* Create all nodes and add them to the Nodestore */
+    for(size_t i = 0; i < itemsSize; i++) {
+        /* Work on a shallow copy. The BrowseName can be set from the type. */
+        UA_AddNodesItem item = items[i];
+        UA_Boolean noBrowseName = UA_QualifiedName_isNull(&item.browseName);
+        retval = checkSetBrowseName(server, session, &item);
+        if(retval == UA_STATUSCODE_GOOD) {
+            void *nodeContext = (nodeContexts) ? nodeContexts[i] : NULL;
+            retval = addNode_raw(server, session, nodeContext, &item, &newNodeIds[i]);
+        }
+        if(noBrowseName)
+            UA_QualifiedName_clear(&item.browseName);
+        if(retval != UA_STATUSCODE_GOOD) {
+            failed = i;
+            goto cleanup;
+        }
+    }
+
+    /* The ReferenceTypes are complete before they are used for the other
+     * references */
+    retval = addNodesBulk_finish(server, itemsSize, items, newNodeIds,
+                                 order, true, &failed);
+    if(retval != UA_STATUSCODE_GOOD)
+        goto cleanup;
+    retval = addNodesBulk_finish(server, itemsSize, items, newNodeIds,
+                                 order, false, &failed);
+
+ cleanup:
+    /* Remove all new nodes if one item failed. Nodes that have been removed
+     * already (e.g. as children of another new node) are ignored. */
+    if(retval != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < itemsSize; i++) {
+            if(!UA_NodeId_isNull(&newNodeIds[i]))
+                deleteNode(server, newNodeIds[i], true);
+        }
+    }
+    UA_UNLOCK(&server->serviceMutex);
+
+    if(retval == UA_STATUSCODE_GOOD && outNewNodeIds) {
+        memcpy(outNewNodeIds, newNodeIds, itemsSize * sizeof(UA_NodeId));
+        UA_free(newNodeIds);
+    } else {
+        UA_Array_delete(newNodeIds, itemsSize, &UA_TYPES[UA_TYPES_NODEID]);
+    }
+    UA_free(order);
+    if(failedIndex)
+        *failedIndex = failed;
+    return retval;
+}
+
+/**********************/
+/* Nodestore Snapshot */
+/**********************/
+
+UA_StatusCode
+UA_Server_snapshotNodestore(UA_Server *server, UA_ByteString *snapshot) {
+    UA_Nodestore *ns = &server->config.nodestore;
+    if(!ns->snapshot)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    UA_LOCK(&server->serviceMutex);
+    UA_StatusCode retval = ns->snapshot(ns->context, snapshot);
+    UA_UNLOCK(&server->serviceMutex);
+    return retval;
+}
+
+UA_StatusCode
+UA_Server_restoreNodestore(UA_Server *server, const UA_ByteString *snapshot) {
+    UA_Nodestore *ns = &server->config.nodestore;
+    if(!ns->restore)
+        return UA_STATUSCODE_BADNOTSUPPORTED;
+    UA_LOCK(&server->serviceMutex);
+    UA_StatusCode retval =
+        ns->restore(ns->context, snapshot, server->config.customDataTypes);
+
+    /* The nodes and references were added behind the back of the caches. Also
+     * if the restore failed half-way. */
+    server->typeHierarchy.generation++;
+    server->browsePaths.generation++;
+    server->instantiation.generation++;
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    UA_EventPathCache_clear(&server->eventPaths);
+#endif
+    UA_UNLOCK(&server->serviceMutex);
+
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
+                       "Restoring the Nodestore snapshot failed with StatusCode %s",
+                       UA_StatusCode_name(retval));
+    return retval;
+}
+
 /****************/
 /* Delete Nodes */
 /****************/
@@ -1944,7 +2498,15 @@ deleteNodeSet(UA_Server *server, UA_Session *session,
         UA_NODESTORE_RELEASE(server, member);
         if(removeTargetRefs)
             removeIncomingReferences(server, session, &member->head);
+        UA_TypeHierarchy_changed(&server->typeHierarchy, &member->head.nodeId);
+        UA_InstantiationCache_changed(&server->instantiation, &member->head.nodeId);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+        /* The node might be on cached propagation paths of events. Also if
+         * the references pointing to it are not removed. */
+        UA_EventPathCache_nodeRemoved(&server->eventPaths, &member->head.nodeId);
+#endif
         UA_NODESTORE_REMOVE(server, &member->head.nodeId);
+        server->browsePaths.generation++; /* Invalidate the cached BrowsePaths */
     }
 }
 
@@ -2192,6 +2754,22 @@ Operation_addReference(UA_Server *server, UA_Session *session, void *context,
     }
 
  cleanup:
+    /* Invalidate the cached BrowsePaths */
+    server->browsePaths.generation++;
+    if(refTypeIndex == UA_REFERENCETYPEINDEX_HASSUBTYPE) {
+        const UA_NodeId *subtype = (item->isForward) ?
+            &item->targetNodeId.nodeId : &item->sourceNodeId;
+        UA_TypeHierarchy_changed(&server->typeHierarchy, subtype);
+    }
+    instantiationReferenceChanged(server, &item->sourceNodeId,
+                                  &item->targetNodeId.nodeId,
+                                  item->isForward, refTypeIndex);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    /* The cached propagation paths of events might have changed */
+    UA_EventPathCache_referenceChanged(&server->eventPaths, refTypeIndex,
+                                       &item->sourceNodeId,
+                                       &item->targetNodeId.nodeId);
+#endif
     if(targetNode)
         UA_NODESTORE_RELEASE(server, targetNode);
     UA_NODESTORE_RELEASE(server, sourceNode);
@@ -2297,6 +2875,24 @@ Operation_deleteReference(UA_Server *server, UA_Session *session, void *context,
     if(*retval != UA_STATUSCODE_GOOD)
         return;
 
+    /* Invalidate the cached BrowsePaths */
+    server->browsePaths.generation++;
+    if(refTypeIndex == UA_REFERENCETYPEINDEX_HASSUBTYPE) {
+        const UA_NodeId *subtype = (item->isForward) ?
+            &item->targetNodeId.nodeId : &item->sourceNodeId;
+        UA_TypeHierarchy_changed(&server->typeHierarchy, subtype);
+    }
+    instantiationReferenceChanged(server, &item->sourceNodeId,
+                                  &item->targetNodeId.nodeId,
+                                  item->isForward, refTypeIndex);
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    /* The cached propagation paths of events might have changed */
+    UA_EventPathCache_referenceChanged(&server->eventPaths, refTypeIndex,
+                                       &item->sourceNodeId,
+                                       &item->targetNodeId.nodeId);
+#endif
+
     if(!item->deleteBidirectional || item->targetNodeId.serverIndex != 0)
         return;
 
@@ -2534,6 +3130,24 @@ setDataSourceCallback(UA_Server *server, UA_Session *session,
     return UA_STATUSCODE_GOOD;
 }
 
+/******************************/
+/* Set Borrowed Data Source   */
+/******************************/
+static UA_StatusCode
+setBorrowedDataSource(UA_Server *server, UA_Session *session,
+                      UA_VariableNode *node, const UA_ValueBackend *valueBackend) {
+    if(node->head.nodeClass != UA_NODECLASS_VARIABLE)
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    node->valueBackend.backendType = UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED;
+    node->valueBackend.backend.borrowed.dataSource.read =
+        valueBackend->backend.borrowed.dataSource.read;
+    node->valueBackend.backend.borrowed.dataSource.write =
+        valueBackend->backend.borrowed.dataSource.write;
+    node->valueBackend.backend.borrowed.release =
+        valueBackend->backend.borrowed.release;
+    return UA_STATUSCODE_GOOD;
+}
+
 /**********************/
 /* Set Value Backend  */
 /**********************/
@@ -2564,6 +3178,18 @@ UA_Server_setVariableNode_valueBackend(UA_Server *server, const UA_NodeId nodeId
                 /* cast away const because callback uses const anyway */
                                         (UA_ValueCallback *)(uintptr_t) &valueBackend);
             break;
+        case UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED:
+            if(!valueBackend.backend.borrowed.dataSource.read ||
+               !valueBackend.backend.borrowed.release) {
+                retval = UA_STATUSCODE_BADCONFIGURATIONERROR;
+                break;
+            }
+            retval = UA_Server_editNode(server, &server->adminSession, &nodeId,
+                                        UA_NODEATTRIBUTESMASK_VALUE, UA_REFERENCETYPESET_NONE,
+                                        UA_BROWSEDIRECTION_INVALID,
+                                        (UA_EditNodeCallback) setBorrowedDataSource,
+                                        (UA_ValueBackend *)(uintptr_t) &valueBackend);
+            break;
     }
 
 
@@ -404,7 +404,7 @@ Service_Republish(UA_Server *server, UA_Session *session,
     /* Find the notification in the retransmission queue  */
     UA_NotificationMessageEntry *entry;
     TAILQ_FOREACH(entry, &sub->retransmissionQueue, listEntry) {
-        if(entry->message.sequenceNumber == request->retransmitSequenceNumber)
+        if(entry->sequenceNumber == request->retransmitSequenceNumber)
             break;
     }
     if(!entry) {
@@ -412,8 +412,10 @@ Service_Republish(UA_Server *server, UA_Session *session,
         return;
     }
 
+    /* The retransmission queue retains only the encoded message */
     response->responseHeader.serviceResult =
-        UA_NotificationMessage_copy(&entry->message, &response->notificationMessage);
+        UA_decodeBinary(&entry->encoded, &response->notificationMessage,
+                        &UA_TYPES[UA_TYPES_NOTIFICATIONMESSAGE], NULL);
 
     /* Update the subscription statistics for the case where we return a message */
 #ifdef UA_ENABLE_DIAGNOSTICS
@@ -434,7 +436,7 @@ setTransferredSequenceNumbers(const UA_Subscription *sub, UA_TransferResult *res
     UA_NotificationMessageEntry *entry;
     size_t i = 0;
     TAILQ_FOREACH(entry, &sub->retransmissionQueue, listEntry) {
-        result->availableSequenceNumbers[i] = entry->message.sequenceNumber;
+        result->availableSequenceNumbers[i] = entry->sequenceNumber;
         i++;
     }
 
@@ -552,6 +554,10 @@ Operation_TransferSubscription(UA_Server *server, UA_Session *session,
     sub->dataChangeNotifications = 0;
     sub->eventNotifications = 0;
 
+    /* The memory of the Notifications is now owned by the new Subscription */
+    sub->notificationSlabs = NULL;
+    sub->notificationFreeList = NULL;
+
     TAILQ_INIT(&newSub->retransmissionQueue);
     UA_NotificationMessageEntry *nme, *nme_tmp;
     TAILQ_FOREACH_SAFE(nme, &sub->retransmissionQueue, listEntry, nme_tmp) {
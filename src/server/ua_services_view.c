@@ -20,8 +20,6 @@
 #include "ua_services.h"
 #include "ziptree.h"
 
-#define UA_MAX_TREE_RECURSE 50 /* How deep up/down the tree do we recurse at most? */
-
 static UA_UInt32
 resultMask2AttributesMask(UA_UInt32 resultMask) {
     UA_UInt32 result = 0;
@@ -162,10 +160,186 @@ isNodeInTreeIterateCallback(void *context, UA_ReferenceTarget *t) {
     return res;
 }
 
+/******************/
+/* Type Hierarchy */
+/******************/
+
+static enum ZIP_CMP
+cmpTypeHierarchyEntry(const UA_NodeId *a, const UA_NodeId *b) {
+    return (enum ZIP_CMP)UA_NodeId_order(a, b);
+}
+
+ZIP_FUNCTIONS(UA_TypeHierarchyTree, UA_TypeHierarchyEntry, treeEntry,
+              UA_NodeId, typeId, cmpTypeHierarchyEntry)
+
+static void *
+deleteTypeHierarchyEntry(void *context, UA_TypeHierarchyEntry *entry) {
+    UA_NodeId_clear(&entry->typeId);
+    UA_Array_delete(entry->supertypes, entry->supertypesSize,
+                    &UA_TYPES[UA_TYPES_NODEID]);
+    UA_free(entry);
+    return NULL;
+}
+
+void
+UA_TypeHierarchy_clear(UA_TypeHierarchy *th) {
+    ZIP_ITER(UA_TypeHierarchyTree, &th->entries, deleteTypeHierarchyEntry, NULL);
+    ZIP_INIT(&th->entries);
+    th->entriesSize = 0;
+}
+
+void
+UA_TypeHierarchy_changed(UA_TypeHierarchy *th, const UA_NodeId *subtype) {
+    /* Every supertype of a cached entry has an entry as well. If the node is
+     * not in the cache, then no cached supertypes depend on it. */
+    if(ZIP_FIND(UA_TypeHierarchyTree, &th->entries, subtype))
+        th->generation++;
+}
+
+static UA_StatusCode
+addSupertype(UA_TypeHierarchyEntry *entry, const UA_NodeId *supertype) {
+    for(size_t i = 0; i < entry->supertypesSize; i++) {
+        if(UA_NodeId_equal(&entry->supertypes[i], supertype))
+            return UA_STATUSCODE_GOOD;
+    }
+    return UA_Array_appendCopy((void**)&entry->supertypes, &entry->supertypesSize,
+                               supertype, &UA_TYPES[UA_TYPES_NODEID]);
+}
+
+static UA_TypeHierarchyEntry *
+getTypeHierarchyEntry(UA_Server *server, const UA_NodeId *typeId, UA_UInt16 depth);
+
+struct TypeHierarchyContext {
+    UA_Server *server;
+    UA_TypeHierarchyEntry *entry;
+    UA_UInt16 depth;
+};
+
+static void *
+addSupertypesCallback(void *context, UA_ReferenceTarget *t) {
+    struct TypeHierarchyContext *thc = (struct TypeHierarchyContext*)context;
+
+    /* Don't follow remote targets */
+    if(!UA_NodePointer_isLocal(t->targetId))
+        return NULL;
+
+    /* Add the direct supertype */
+    UA_NodeId supertypeId = UA_NodePointer_toNodeId(t->targetId);
+    if(addSupertype(thc->entry, &supertypeId) != UA_STATUSCODE_GOOD)
+        return (void*)0x01;
+
+    /* Prevent pathological recursion depth. The supertypes would be
+     * incomplete. Fail so that the entry is not used and the uncached lookup
+     * is done instead. */
+    if(thc->depth >= UA_MAX_TREE_RECURSE)
+        return (void*)0x01;
+
+    /* Add the supertypes of the supertype. They are incomplete if the
+     * supertype is still computed (cycle in the hierarchy). */
+    UA_TypeHierarchyEntry *super =
+        getTypeHierarchyEntry(thc->server, &supertypeId, (UA_UInt16)(thc->depth + 1));
+    if(!super)
+        return (void*)0x01;
+    for(size_t i = 0; i < super->supertypesSize; i++) {
+        if(addSupertype(thc->entry, &super->supertypes[i]) != UA_STATUSCODE_GOOD)
+            return (void*)0x01;
+    }
+    return NULL;
+}
+
+/* Returns NULL if the entry could not be computed */
+static UA_TypeHierarchyEntry *
+getTypeHierarchyEntry(UA_Server *server, const UA_NodeId *typeId, UA_UInt16 depth) {
+    UA_TypeHierarchy *th = &server->typeHierarchy;
+
+    /* The entry is up-to-date or currently computed */
+    UA_TypeHierarchyEntry *entry =
+        ZIP_FIND(UA_TypeHierarchyTree, &th->entries, typeId);
+    if(entry && (entry->generation == th->generation || entry->computing))
+        return entry;
+
+    /* Create a new entry. Also for nodes that don't exist (yet). Then adding
+     * the node later on (with its supertypes) is detected. */
+    if(!entry) {
+        entry = (UA_TypeHierarchyEntry*)UA_calloc(1, sizeof(UA_TypeHierarchyEntry));
+        if(!entry)
+            return NULL;
+        if(UA_NodeId_copy(typeId, &entry->typeId) != UA_STATUSCODE_GOOD) {
+            UA_free(entry);
+            return NULL;
+        }
+        ZIP_INSERT(UA_TypeHierarchyTree, &th->entries, entry);
+        th->entriesSize++;
+    }
+
+    /* (Re)compute the supertypes */
+    UA_Array_delete(entry->supertypes, entry->supertypesSize,
+                    &UA_TYPES[UA_TYPES_NODEID]);
+    entry->supertypes = NULL;
+    entry->supertypesSize = 0;
+    entry->generation = th->generation;
+    entry->computing = true;
+
+    /* Get the node with only the inverse HasSubtype references */
+    void *res = NULL;
+    const UA_Node *node =
+        UA_NODESTORE_GET_SELECTIVE(server, typeId, UA_NODEATTRIBUTESMASK_NONE,
+                                   UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASSUBTYPE),
+                                   UA_BROWSEDIRECTION_INVERSE);
+    if(node) {
+        struct TypeHierarchyContext thc = {server, entry, depth};
+        for(size_t i = 0; i < node->head.referencesSize && !res; i++) {
+            UA_NodeReferenceKind *rk = &node->head.references[i];
+            if(!rk->isInverse ||
+               rk->referenceTypeIndex != UA_REFERENCETYPEINDEX_HASSUBTYPE)
+                continue;
+            res = UA_NodeReferenceKind_iterate(rk, addSupertypesCallback, &thc);
+        }
+        UA_NODESTORE_RELEASE(server, node);
+    }
+    entry->computing = false;
+
+    /* Out of memory or too deep. Recompute the next time. */
+    if(res) {
+        entry->generation = th->generation - 1;
+        return NULL;
+    }
+    return entry;
+}
+
+/* Returns -1 if the type hierarchy cannot be used */
+static int
+isSubtypeCached(UA_Server *server, const UA_NodeId *type, const UA_NodeId *supertype) {
+    if(UA_NodeId_equal(type, supertype))
+        return 1;
+
+    /* Bound the memory use. Start over if the cache is full. */
+    UA_TypeHierarchy *th = &server->typeHierarchy;
+    if(th->entriesSize >= UA_TYPEHIERARCHY_MAXSIZE)
+        UA_TypeHierarchy_clear(th);
+
+    UA_TypeHierarchyEntry *entry = getTypeHierarchyEntry(server, type, 0);
+    if(!entry)
+        return -1;
+    for(size_t i = 0; i < entry->supertypesSize; i++) {
+        if(UA_NodeId_equal(&entry->supertypes[i], supertype))
+            return 1;
+    }
+    return 0;
+}
+
 UA_Boolean
 isNodeInTree(UA_Server *server, const UA_NodeId *leafNode,
              const UA_NodeId *nodeToFind,
              const UA_ReferenceTypeSet *relevantRefs) {
+    /* Use the cached type hierarchy for HasSubtype */
+    UA_ReferenceTypeSet hasSubtype = UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASSUBTYPE);
+    if(memcmp(relevantRefs, &hasSubtype, sizeof(UA_ReferenceTypeSet)) == 0) {
+        int res = isSubtypeCached(server, leafNode, nodeToFind);
+        if(res >= 0)
+            return (res == 1);
+    }
+
     struct IsNodeInTreeContext ctx;
     memset(&ctx, 0, sizeof(struct IsNodeInTreeContext));
     ctx.server = server;
@@ -486,14 +660,66 @@ RefResult_double(RefResult *rr) {
     return UA_STATUSCODE_GOOD;
 }
 
+/* Shallow results point into pinned nodes and are not cleaned up */
 static void
-RefResult_clear(RefResult *rr) {
+RefResult_clear(RefResult *rr, UA_Boolean shallow) {
     UA_assert(rr->descr != NULL);
-    for(size_t i = 0; i < rr->size; i++)
+    for(size_t i = 0; i < rr->size && !shallow; i++)
         UA_ReferenceDescription_clear(&rr->descr[i]);
     UA_free(rr->descr);
 }
 
+/* Reset the shallow ReferenceDescriptions before the BrowseResult is cleaned
+ * up */
+static void
+detachBrowseResult(UA_BrowseResult *br) {
+    for(size_t i = 0; i < br->referencesSize; i++)
+        UA_ReferenceDescription_init(&br->references[i]);
+}
+
+static UA_StatusCode
+pinNode(UA_Server *server, const UA_Node *node) {
+    UA_PinnedNodes *pn = &server->pinnedNodes;
+    if(pn->size >= pn->capacity) {
+        size_t newCapacity = (pn->capacity == 0) ?
+            UA_REFTREE_INITIAL_SIZE : pn->capacity * 2;
+        const UA_Node **nodes = (const UA_Node**)
+            UA_realloc((void*)pn->nodes, newCapacity * sizeof(const UA_Node*));
+        if(!nodes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        pn->nodes = nodes;
+        pn->capacity = newCapacity;
+    }
+    pn->nodes[pn->size++] = node;
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+UA_Server_releasePinnedNodes(UA_Server *server, const UA_DataType *responseType,
+                             UA_Response *response) {
+    UA_LOCK_ASSERT(&server->serviceMutex);
+
+    /* Detach the shallow results from the response */
+    size_t resultsSize = 0;
+    UA_BrowseResult *results = NULL;
+    if(responseType == &UA_TYPES[UA_TYPES_BROWSERESPONSE]) {
+        resultsSize = response->browseResponse.resultsSize;
+        results = response->browseResponse.results;
+    } else if(responseType == &UA_TYPES[UA_TYPES_BROWSENEXTRESPONSE]) {
+        resultsSize = response->browseNextResponse.resultsSize;
+        results = response->browseNextResponse.results;
+    }
+    for(size_t i = 0; i < resultsSize; i++)
+        detachBrowseResult(&results[i]);
+
+    /* Release the nodes */
+    UA_PinnedNodes *pn = &server->pinnedNodes;
+    for(size_t i = 0; i < pn->size; i++)
+        UA_NODESTORE_RELEASE(server, pn->nodes[i]);
+    UA_free((void*)pn->nodes);
+    memset(pn, 0, sizeof(UA_PinnedNodes));
+}
+
 struct ContinuationPoint {
     ContinuationPoint *next;
     UA_ByteString identifier;
@@ -509,6 +735,10 @@ struct ContinuationPoint {
     UA_NodePointer lastTarget;
     UA_Byte lastRefKindIndex;
     UA_Boolean lastRefInverse;
+
+    /* Cursor position of the last target if the ReferenceKind uses an array.
+     * The tree representation is unzipped at the last target instead. */
+    size_t lastTargetIndex;
 };
 
 ContinuationPoint *
@@ -529,6 +759,10 @@ struct BrowseContext {
                                      * lookups */
     UA_Boolean activeCP; /* true during "forwarding" to the position of the last
                           * reference target */
+    UA_Boolean shallow; /* Results point into pinned nodes. Only used where the
+                         * response is encoded before the pins are released. */
+    size_t targetIndexOffset; /* The array of targets is iterated starting from
+                               * this offset */
 
     /* Results */
     RefResult rr;
@@ -536,10 +770,34 @@ struct BrowseContext {
     UA_Boolean done;
 };
 
-/* Target node on top of the stack */
+static void *
+returnFirstLocalTarget(void *context, UA_ReferenceTarget *t) {
+    if(!UA_NodePointer_isLocal(t->targetId))
+        return NULL;
+    return t;
+}
+
+/* Take the TypeDefinition from the HasTypeDefinition reference. Without a
+ * lookup of the type node. */
+static UA_NodeId
+getTypeDefinitionId(const UA_NodeHead *head) {
+    for(size_t i = 0; i < head->referencesSize; ++i) {
+        UA_NodeReferenceKind *rk = &head->references[i];
+        if(rk->isInverse ||
+           rk->referenceTypeIndex != UA_REFERENCETYPEINDEX_HASTYPEDEFINITION)
+            continue;
+        UA_ReferenceTarget *t = (UA_ReferenceTarget*)
+            UA_NodeReferenceKind_iterate(rk, returnFirstLocalTarget, NULL);
+        if(t)
+            return UA_NodePointer_toNodeId(t->targetId);
+    }
+    return UA_NODEID_NULL;
+}
+
+/* Target node on top of the stack. In shallow mode the node is pinned if the
+ * ReferenceDescription was added. */
 static UA_StatusCode
-addReferenceDescription(struct BrowseContext *bc, UA_NodePointer nodeP,
-                        const UA_Node *curr) {
+addReferenceDescription(struct BrowseContext *bc, const UA_Node *curr) {
     UA_assert(curr);
     UA_BrowseDescription *bd = &bc->cp->browseDescription;
 
@@ -551,49 +809,37 @@ addReferenceDescription(struct BrowseContext *bc, UA_NodePointer nodeP,
            return res;
     }
 
-    UA_ReferenceDescription *descr = &bc->rr.descr[bc->rr.size];
-
-    /* Fields without access to the actual node */
-    UA_ExpandedNodeId en = UA_NodePointer_toExpandedNodeId(nodeP);
-    res = UA_ExpandedNodeId_copy(&en, &descr->nodeId);
-    if(bd->resultMask & UA_BROWSERESULTMASK_REFERENCETYPEID) {
-        const UA_NodeId *refTypeId =
-            UA_NODESTORE_GETREFERENCETYPEID(bc->server, bc->rk->referenceTypeIndex);
-        res |= UA_NodeId_copy(refTypeId, &descr->referenceTypeId);
-    }
+    /* Fill a ReferenceDescription that points into the node (and the
+     * ReferenceType table of the Nodestore) */
+    UA_ReferenceDescription tmp;
+    UA_ReferenceDescription_init(&tmp);
+    tmp.nodeId.nodeId = curr->head.nodeId;
+    if(bd->resultMask & UA_BROWSERESULTMASK_REFERENCETYPEID)
+        tmp.referenceTypeId =
+            *UA_NODESTORE_GETREFERENCETYPEID(bc->server, bc->rk->referenceTypeIndex);
     if(bd->resultMask & UA_BROWSERESULTMASK_ISFORWARD)
-        descr->isForward = !bc->rk->isInverse;
-
-    /* Create fields that require access to the actual node */
+        tmp.isForward = !bc->rk->isInverse;
     if(bd->resultMask & UA_BROWSERESULTMASK_NODECLASS)
-        descr->nodeClass = curr->head.nodeClass;
-
+        tmp.nodeClass = curr->head.nodeClass;
     if(bd->resultMask & UA_BROWSERESULTMASK_BROWSENAME)
-        res |= UA_QualifiedName_copy(&curr->head.browseName,
-                                     &descr->browseName);
-
-    if(bd->resultMask & UA_BROWSERESULTMASK_DISPLAYNAME) {
-        UA_LocalizedText displayname =
-            UA_Session_getNodeDisplayName(bc->session, &curr->head);
-        res |= UA_LocalizedText_copy(&displayname, &descr->displayName);
-    }
-
-    if(bd->resultMask & UA_BROWSERESULTMASK_TYPEDEFINITION) {
-        if(curr->head.nodeClass == UA_NODECLASS_OBJECT ||
-           curr->head.nodeClass == UA_NODECLASS_VARIABLE) {
-            const UA_Node *type = getNodeType(bc->server, &curr->head);
-            if(type) {
-                res |= UA_NodeId_copy(&type->head.nodeId,
-                                      &descr->typeDefinition.nodeId);
-                UA_NODESTORE_RELEASE(bc->server, type);
-            }
-        }
-    }
+        tmp.browseName = curr->head.browseName;
+    if(bd->resultMask & UA_BROWSERESULTMASK_DISPLAYNAME)
+        tmp.displayName = UA_Session_getNodeDisplayName(bc->session, &curr->head);
+    if(bd->resultMask & UA_BROWSERESULTMASK_TYPEDEFINITION &&
+       (curr->head.nodeClass == UA_NODECLASS_OBJECT ||
+        curr->head.nodeClass == UA_NODECLASS_VARIABLE))
+        tmp.typeDefinition.nodeId = getTypeDefinitionId(&curr->head);
 
-    /* Clean up and return */
-    if(res != UA_STATUSCODE_GOOD) {
-        UA_ReferenceDescription_clear(descr);
-        return res;
+    UA_ReferenceDescription *descr = &bc->rr.descr[bc->rr.size];
+    if(bc->shallow) {
+        res = pinNode(bc->server, curr);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+        *descr = tmp;
+    } else {
+        res = UA_ReferenceDescription_copy(&tmp, descr);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
     }
     bc->rr.size++;
     return UA_STATUSCODE_GOOD;
@@ -632,15 +878,19 @@ browseReferencTargetCallback(void *context, UA_ReferenceTarget *t) {
     }
 
     /* Create the reference description */
-    bc->status = addReferenceDescription(bc, t->targetId, target);
+    bc->status = addReferenceDescription(bc, target);
 
-    /* Release the node */
-    UA_NODESTORE_RELEASE(bc->server, target);
+    /* Release the node (unless pinned for a shallow result) */
+    if(!bc->shallow || bc->status != UA_STATUSCODE_GOOD)
+        UA_NODESTORE_RELEASE(bc->server, target);
 
     /* Store as last target. The itarget-id is a shallow copy for now. */
     cp->lastTarget = t->targetId;
     cp->lastRefKindIndex = bc->rk->referenceTypeIndex;
     cp->lastRefInverse = bc->rk->isInverse;
+    if(!bc->rk->hasRefTree && !bc->rk->hasSortedArray)
+        cp->lastTargetIndex =
+            bc->targetIndexOffset + (size_t)(t - bc->rk->targets.array);
 
     /* Abort if the status is not good. Also doesn't make a deep-copy of
      * cp->lastTarget after returning from here. */
@@ -684,8 +934,16 @@ browseWithNode(struct BrowseContext *bc, const UA_NodeHead *head ) {
          * This temporarily modifies rk. */
         UA_ReferenceIdTree left = {NULL}, right = {NULL};
         size_t nextTargetIndex = 0;
+        UA_NodePointer lastTarget;
+        UA_NodePointer_init(&lastTarget);
         if(bc->activeCP) {
-            if(rk->hasRefTree) {
+            if(rk->hasSortedArray) {
+                /* Resume after the last target in the order of the NodeIds.
+                 * Merging the tail can move targets before the position of
+                 * the last target. Take over the last target as the start. */
+                lastTarget = cp->lastTarget;
+                UA_NodePointer_init(&cp->lastTarget);
+            } else if(rk->hasRefTree) {
                 /* Unzip the tree until the continuation point. All NodeIds
                  * larger than the last target are guaranteed to sit on the
                  * right-hand side. */
@@ -699,18 +957,30 @@ browseWithNode(struct BrowseContext *bc, const UA_NodeHead *head ) {
                           &key, &left, &right);
                 rk->targets.tree.idRoot = right.root;
             } else {
-                /* Iterate over the array to find the match */
-                for(; nextTargetIndex < rk->targetsSize; nextTargetIndex++) {
-                    UA_ReferenceTarget *t = &rk->targets.array[nextTargetIndex];
-                    if(UA_NodePointer_equal(cp->lastTarget, t->targetId))
-                        break;
-                }
-                if(nextTargetIndex == rk->targetsSize) {
-                    /* Not found - assume that this reference kind is done */
-                    bc->activeCP = false;
-                    continue;
+                /* Resume after the cursor position. Search for the last target
+                 * only if the array was modified in the meantime. */
+                size_t pos = cp->lastTargetIndex;
+                if(pos < rk->targetsSize &&
+                   UA_NodePointer_equal(cp->lastTarget, rk->targets.array[pos].targetId)) {
+                    nextTargetIndex = pos + 1;
+                } else {
+                    for(; nextTargetIndex < rk->targetsSize; nextTargetIndex++) {
+                        UA_ReferenceTarget *t = &rk->targets.array[nextTargetIndex];
+                        if(UA_NodePointer_equal(cp->lastTarget, t->targetId))
+                            break;
+                    }
+                    if(nextTargetIndex < rk->targetsSize) {
+                        nextTargetIndex++; /* From the last index to the next index */
+                    } else if(pos < rk->targetsSize) {
+                        /* The last target was removed. Its position now holds
+                         * the previously last element of the array. */
+                        nextTargetIndex = pos;
+                    } else {
+                        /* Not found - assume that this reference kind is done */
+                        bc->activeCP = false;
+                        continue;
+                    }
                 }
-                nextTargetIndex++; /* From the last index to the next index */
                 rk->targets.array = &rk->targets.array[nextTargetIndex];
                 rk->targetsSize -= nextTargetIndex;
             }
@@ -720,16 +990,30 @@ browseWithNode(struct BrowseContext *bc, const UA_NodeHead *head ) {
             UA_NodePointer_clear(&cp->lastTarget);
         }
 
-        /* Iterate over all reference targets */
+        /* Iterate over all reference targets. Sorted arrays are iterated in
+         * the order of the NodeIds. */
         bc->rk = rk;
-        void *res = UA_NodeReferenceKind_iterate(rk, browseReferencTargetCallback, bc);
+        bc->targetIndexOffset = nextTargetIndex;
+        void *res;
+        if(rk->hasSortedArray) {
+            UA_StatusCode iterRes =
+                UA_NodeReferenceKind_iterateSorted(rk, bc->activeCP ? &lastTarget : NULL,
+                                                   browseReferencTargetCallback, bc, &res);
+            UA_NodePointer_clear(&lastTarget);
+            if(iterRes != UA_STATUSCODE_GOOD) {
+                bc->status = iterRes;
+                return;
+            }
+        } else {
+            res = UA_NodeReferenceKind_iterate(rk, browseReferencTargetCallback, bc);
+        }
 
         /* Undo the "skipping ahead" for the continuation point */
         if(bc->activeCP) {
             if(rk->hasRefTree) {
                 rk->targets.tree.idRoot =
                     ZIP_ZIP(UA_ReferenceIdTree, left.root, right.root);
-            } else {
+            } else if(!rk->hasSortedArray) {
                 /* rk->targets.array = rk->targets.array[-nextTargetIndex]; */
                 rk->targets.array = rk->targets.array - nextTargetIndex;
                 rk->targetsSize += nextTargetIndex;
@@ -827,9 +1111,10 @@ browse(struct BrowseContext *bc) {
 }
 
 /* Start to browse with no previous cp */
-void
-Operation_Browse(UA_Server *server, UA_Session *session, const UA_UInt32 *maxrefs,
-                 const UA_BrowseDescription *descr, UA_BrowseResult *result) {
+static void
+startBrowse(UA_Server *server, UA_Session *session, const UA_UInt32 *maxrefs,
+            const UA_BrowseDescription *descr, UA_BrowseResult *result,
+            UA_Boolean shallow) {
     /* Stack-allocate a temporary cp */
     ContinuationPoint cp;
     memset(&cp, 0, sizeof(ContinuationPoint));
@@ -865,13 +1150,13 @@ Operation_Browse(UA_Server *server, UA_Session *session, const UA_UInt32 *maxref
     bc.status = UA_STATUSCODE_GOOD;
     bc.done = false;
     bc.activeCP = false;
+    bc.shallow = shallow;
     bc.resultRefs = cp.relevantReferences;
     if(cp.browseDescription.resultMask & UA_BROWSERESULTMASK_TYPEDEFINITION) {
-        /* Get the node with additional reference types if we need to lookup the
-         * TypeDefinition */
+        /* Get the node with the HasTypeDefinition references if we need to
+         * return the TypeDefinition */
         bc.resultRefs = UA_ReferenceTypeSet_union(bc.resultRefs,
-              UA_ReferenceTypeSet_union(UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASTYPEDEFINITION),
-                                        UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASSUBTYPE)));
+              UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASTYPEDEFINITION));
     }
     result->statusCode = RefResult_init(&bc.rr);
     if(result->statusCode != UA_STATUSCODE_GOOD)
@@ -882,7 +1167,7 @@ Operation_Browse(UA_Server *server, UA_Session *session, const UA_UInt32 *maxref
 
     if(bc.status != UA_STATUSCODE_GOOD || bc.rr.size == 0) {
         /* No relevant references, return array of length zero */
-        RefResult_clear(&bc.rr);
+        RefResult_clear(&bc.rr, shallow);
         result->references = (UA_ReferenceDescription*)UA_EMPTY_ARRAY_SENTINEL;
         result->statusCode = bc.status;
         return;
@@ -925,6 +1210,7 @@ Operation_Browse(UA_Server *server, UA_Session *session, const UA_UInt32 *maxref
     UA_NodePointer_init(&cp.lastTarget); /* No longer clear below (cleanup) */
     cp2->lastRefKindIndex = cp.lastRefKindIndex;
     cp2->lastRefInverse = cp.lastRefInverse;
+    cp2->lastTargetIndex = cp.lastTargetIndex;
 
     /* Create a random bytestring via a Guid */
     ident = UA_Guid_new();
@@ -953,10 +1239,27 @@ Operation_Browse(UA_Server *server, UA_Session *session, const UA_UInt32 *maxref
         UA_free(cp2);
     }
     UA_NodePointer_clear(&cp.lastTarget);
+    if(shallow)
+        detachBrowseResult(result);
     UA_BrowseResult_clear(result);
     result->statusCode = retval;
 }
 
+void
+Operation_Browse(UA_Server *server, UA_Session *session, const UA_UInt32 *maxrefs,
+                 const UA_BrowseDescription *descr, UA_BrowseResult *result) {
+    startBrowse(server, session, maxrefs, descr, result, false);
+}
+
+/* The results of the Browse and BrowseNext services point into the pinned
+ * target nodes. The pins are released after the response is encoded. */
+static void
+Operation_BrowseShallow(UA_Server *server, UA_Session *session,
+                        const UA_UInt32 *maxrefs, const UA_BrowseDescription *descr,
+                        UA_BrowseResult *result) {
+    startBrowse(server, session, maxrefs, descr, result, true);
+}
+
 void Service_Browse(UA_Server *server, UA_Session *session,
                     const UA_BrowseRequest *request, UA_BrowseResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logging, session, "Processing BrowseRequest");
@@ -977,7 +1280,7 @@ void Service_Browse(UA_Server *server, UA_Session *session,
 
     response->responseHeader.serviceResult =
         UA_Server_processServiceOperations(server, session,
-                                           (UA_ServiceOperation)Operation_Browse,
+                                           (UA_ServiceOperation)Operation_BrowseShallow,
                                            &request->requestedMaxReferencesPerNode,
                                            &request->nodesToBrowseSize,
                                            &UA_TYPES[UA_TYPES_BROWSEDESCRIPTION],
@@ -997,9 +1300,10 @@ UA_Server_browse(UA_Server *server, UA_UInt32 maxReferences,
 }
 
 static void
-Operation_BrowseNext(UA_Server *server, UA_Session *session,
-                     const UA_Boolean *releaseContinuationPoints,
-                     const UA_ByteString *continuationPoint, UA_BrowseResult *result) {
+continueBrowse(UA_Server *server, UA_Session *session,
+               const UA_Boolean *releaseContinuationPoints,
+               const UA_ByteString *continuationPoint, UA_BrowseResult *result,
+               UA_Boolean shallow) {
     /* Find the continuation point */
     ContinuationPoint **prev = &session->continuationPoints;
     ContinuationPoint *cp;
@@ -1029,13 +1333,13 @@ Operation_BrowseNext(UA_Server *server, UA_Session *session,
     bc.status = UA_STATUSCODE_GOOD;
     bc.done = false;
     bc.activeCP = true;
+    bc.shallow = shallow;
     bc.resultRefs = cp->relevantReferences;
     if(cp->browseDescription.resultMask & UA_BROWSERESULTMASK_TYPEDEFINITION) {
-        /* Get the node with additional reference types if we need to lookup the
-         * TypeDefinition */
+        /* Get the node with the HasTypeDefinition references if we need to
+         * return the TypeDefinition */
         bc.resultRefs = UA_ReferenceTypeSet_union(bc.resultRefs,
-              UA_ReferenceTypeSet_union(UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASTYPEDEFINITION),
-                                        UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASSUBTYPE)));
+              UA_REFTYPESET(UA_REFERENCETYPEINDEX_HASTYPEDEFINITION));
     }
     result->statusCode = RefResult_init(&bc.rr);
     if(result->statusCode != UA_STATUSCODE_GOOD)
@@ -1046,7 +1350,7 @@ Operation_BrowseNext(UA_Server *server, UA_Session *session,
 
     if(bc.status != UA_STATUSCODE_GOOD || bc.rr.size == 0) {
         /* No relevant references, return array of length zero */
-        RefResult_clear(&bc.rr);
+        RefResult_clear(&bc.rr, shallow);
         result->references = (UA_ReferenceDescription*)UA_EMPTY_ARRAY_SENTINEL;
         result->statusCode = bc.status;
         goto remove_cp;
@@ -1062,6 +1366,8 @@ Operation_BrowseNext(UA_Server *server, UA_Session *session,
     /* Return the cp identifier to signal that there are references left */
     bc.status = UA_ByteString_copy(&cp->identifier, &result->continuationPoint);
     if(bc.status != UA_STATUSCODE_GOOD) {
+        if(shallow)
+            detachBrowseResult(result);
         UA_BrowseResult_clear(result);
         result->statusCode = bc.status;
     }
@@ -1074,6 +1380,23 @@ Operation_BrowseNext(UA_Server *server, UA_Session *session,
     ++session->availableContinuationPoints;
 }
 
+static void
+Operation_BrowseNext(UA_Server *server, UA_Session *session,
+                     const UA_Boolean *releaseContinuationPoints,
+                     const UA_ByteString *continuationPoint, UA_BrowseResult *result) {
+    continueBrowse(server, session, releaseContinuationPoints,
+                   continuationPoint, result, false);
+}
+
+static void
+Operation_BrowseNextShallow(UA_Server *server, UA_Session *session,
+                            const UA_Boolean *releaseContinuationPoints,
+                            const UA_ByteString *continuationPoint,
+                            UA_BrowseResult *result) {
+    continueBrowse(server, session, releaseContinuationPoints,
+                   continuationPoint, result, true);
+}
+
 void
 Service_BrowseNext(UA_Server *server, UA_Session *session,
                    const UA_BrowseNextRequest *request,
@@ -1086,7 +1409,7 @@ Service_BrowseNext(UA_Server *server, UA_Session *session,
         request->releaseContinuationPoints; /* request is const */
     response->responseHeader.serviceResult =
         UA_Server_processServiceOperations(server, session,
-                                           (UA_ServiceOperation)Operation_BrowseNext,
+                                           (UA_ServiceOperation)Operation_BrowseNextShallow,
                                            &releaseContinuationPoints,
                                            &request->continuationPointsSize,
                                            &UA_TYPES[UA_TYPES_BYTESTRING],
@@ -1113,9 +1436,9 @@ UA_Server_browseNext(UA_Server *server, UA_Boolean releaseContinuationPoint,
 /* Add all entries for the hash. There are possible duplicates due to hash
  * collisions. The full browsename is checked afterwards. */
 static void *
-addBrowseHashTarget(void *context, UA_ReferenceTargetTreeElem *elem) {
+addBrowseHashTarget(void *context, UA_ReferenceTarget *t) {
     RefTree *next = (RefTree*)context;
-    return (void*)(uintptr_t)RefTree_add(next, elem->target.targetId, NULL);
+    return (void*)(uintptr_t)RefTree_add(next, t->targetId, NULL);
 }
 
 static UA_StatusCode
@@ -1185,8 +1508,6 @@ walkBrowsePathElement(UA_Server *server, UA_Session *session,
         }
 
         /* Loop over the ReferenceKinds */
-        UA_ReferenceTarget targetHashKey;
-        targetHashKey.targetNameHash = browseNameHash;
         for(size_t j = 0; j < node->head.referencesSize; j++) {
             UA_NodeReferenceKind *rk = &node->head.references[j];
 
@@ -1203,27 +1524,11 @@ walkBrowsePathElement(UA_Server *server, UA_Session *session,
              * next iteration of the outer loop. So we only have to retrieve
              * every node just once. */
 
-            if(rk->hasRefTree) {
-                res = (UA_StatusCode)(uintptr_t)
-                    ZIP_ITER_KEY(UA_ReferenceNameTree,
-                                 (UA_ReferenceNameTree*)&rk->targets.tree.nameRoot,
-                                 &targetHashKey, addBrowseHashTarget, next);
-                if(res != UA_STATUSCODE_GOOD)
-                    break;
-            } else {
-                /* The array entries don't have a BrowseName hash. Add all of
-                 * them at this level to be checked with a full string
-                 * comparison. */
-                for(size_t k = 0; k < rk->targetsSize; k++) {
-                    if(rk->targets.array[k].targetNameHash != browseNameHash)
-                        continue;
-                    res = RefTree_add(next, rk->targets.array[k].targetId, NULL);
-                    if(res != UA_STATUSCODE_GOOD)
-                        break;
-                }
-                if(res != UA_STATUSCODE_GOOD)
-                    break;
-            }
+            res = (UA_StatusCode)(uintptr_t)
+                UA_NodeReferenceKind_iterateName(rk, browseNameHash,
+                                                 addBrowseHashTarget, next);
+            if(res != UA_STATUSCODE_GOOD)
+                break;
         }
 
         UA_NODESTORE_RELEASE(server, node);
@@ -1360,6 +1665,109 @@ Operation_TranslateBrowsePathToNodeIds(UA_Server *server, UA_Session *session,
     }
 }
 
+/*********************/
+/* Browse Path Cache */
+/*********************/
+
+static enum ZIP_CMP
+cmpBrowsePathHash(const UA_UInt32 *a, const UA_UInt32 *b) {
+    if(*a == *b)
+        return ZIP_CMP_EQ;
+    return (*a < *b) ? ZIP_CMP_LESS : ZIP_CMP_MORE;
+}
+
+ZIP_FUNCTIONS(UA_BrowsePathCacheTree, UA_BrowsePathCacheEntry, treeEntry,
+              UA_UInt32, hash, cmpBrowsePathHash)
+
+static void *
+deleteBrowsePathCacheEntry(void *context, UA_BrowsePathCacheEntry *entry) {
+    UA_BrowsePath_clear(&entry->path);
+    UA_BrowsePathResult_clear(&entry->result);
+    UA_free(entry);
+    return NULL;
+}
+
+void
+UA_BrowsePathCache_clear(UA_BrowsePathCache *cache) {
+    ZIP_ITER(UA_BrowsePathCacheTree, &cache->entries,
+             deleteBrowsePathCacheEntry, NULL);
+    ZIP_INIT(&cache->entries);
+    cache->entriesSize = 0;
+}
+
+static UA_UInt32
+hashBrowsePath(const UA_BrowsePath *path) {
+    UA_UInt32 h = UA_NodeId_hash(&path->startingNode);
+    for(size_t i = 0; i < path->relativePath.elementsSize; i++) {
+        const UA_RelativePathElement *elem = &path->relativePath.elements[i];
+        UA_UInt32 fields[3];
+        fields[0] = UA_NodeId_hash(&elem->referenceTypeId);
+        fields[1] = UA_QualifiedName_hash(&elem->targetName);
+        fields[2] = (UA_UInt32)elem->isInverse | ((UA_UInt32)elem->includeSubtypes << 1);
+        h = UA_ByteString_hash(h, (const UA_Byte*)fields, sizeof(fields));
+    }
+    return h;
+}
+
+/* Only deterministic results are cached. Not if we ran out of memory, etc. */
+static UA_Boolean
+isCacheableResult(const UA_BrowsePathResult *result) {
+    return (result->statusCode == UA_STATUSCODE_GOOD ||
+            result->statusCode == UA_STATUSCODE_BADNOMATCH ||
+            result->statusCode == UA_STATUSCODE_BADNODEIDUNKNOWN);
+}
+
+static void
+Operation_TranslateBrowsePathToNodeIdsCached(UA_Server *server, UA_Session *session,
+                                             const UA_UInt32 *nodeClassMask,
+                                             const UA_BrowsePath *path,
+                                             UA_BrowsePathResult *result) {
+    UA_BrowsePathCache *cache = &server->browsePaths;
+    UA_UInt32 hash = hashBrowsePath(path);
+
+    /* Cache hit from the current generation */
+    UA_BrowsePathCacheEntry *entry =
+        ZIP_FIND(UA_BrowsePathCacheTree, &cache->entries, &hash);
+    if(entry && entry->generation == cache->generation &&
+       UA_order(&entry->path, path, &UA_TYPES[UA_TYPES_BROWSEPATH]) == UA_ORDER_EQ) {
+        UA_StatusCode res = UA_BrowsePathResult_copy(&entry->result, result);
+        if(res != UA_STATUSCODE_GOOD)
+            result->statusCode = res;
+        return;
+    }
+
+    /* Resolve the BrowsePath */
+    Operation_TranslateBrowsePathToNodeIds(server, session, nodeClassMask, path, result);
+    if(!isCacheableResult(result))
+        return;
+
+    /* Remove the outdated entry (or one with a hash collision) */
+    if(entry) {
+        ZIP_REMOVE(UA_BrowsePathCacheTree, &cache->entries, entry);
+        deleteBrowsePathCacheEntry(NULL, entry);
+        cache->entriesSize--;
+    }
+
+    /* Bound the memory use. Start over if the cache is full. */
+    if(cache->entriesSize >= UA_BROWSEPATHCACHE_MAXSIZE)
+        UA_BrowsePathCache_clear(cache);
+
+    /* Add the cache entry. Ignore if that fails. */
+    entry = (UA_BrowsePathCacheEntry*)UA_calloc(1, sizeof(UA_BrowsePathCacheEntry));
+    if(!entry)
+        return;
+    UA_StatusCode res = UA_BrowsePath_copy(path, &entry->path);
+    res |= UA_BrowsePathResult_copy(result, &entry->result);
+    if(res != UA_STATUSCODE_GOOD) {
+        deleteBrowsePathCacheEntry(NULL, entry);
+        return;
+    }
+    entry->hash = hash;
+    entry->generation = cache->generation;
+    ZIP_INSERT(UA_BrowsePathCacheTree, &cache->entries, entry);
+    cache->entriesSize++;
+}
+
 UA_BrowsePathResult
 translateBrowsePathToNodeIds(UA_Server *server,
                              const UA_BrowsePath *browsePath) {
@@ -1399,7 +1807,7 @@ Service_TranslateBrowsePathsToNodeIds(UA_Server *server, UA_Session *session,
     UA_UInt32 nodeClassMask = 0; /* All node classes */
     response->responseHeader.serviceResult =
         UA_Server_processServiceOperations(server, session,
-                                           (UA_ServiceOperation)Operation_TranslateBrowsePathToNodeIds,
+                                           (UA_ServiceOperation)Operation_TranslateBrowsePathToNodeIdsCached,
                                            &nodeClassMask,
                                            &request->browsePathsSize, &UA_TYPES[UA_TYPES_BROWSEPATH],
                                            &response->resultsSize, &UA_TYPES[UA_TYPES_BROWSEPATHRESULT]);
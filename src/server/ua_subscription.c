@@ -22,6 +22,7 @@
 #include "ua_server_internal.h"
 #include "ua_subscription.h"
 #include "itoa.h"
+#include "../ua_types_encoding_binary.h"
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS /* conditional compilation */
 
@@ -36,34 +37,67 @@ static void UA_Notification_enqueueSub(UA_Notification *n);
 static void UA_Notification_dequeueSub(UA_Notification *n);
 
 UA_Notification *
-UA_Notification_new(void) {
-    UA_Notification *n = (UA_Notification*)UA_calloc(1, sizeof(UA_Notification));
-    if(n) {
-        /* Set the sentinel for a notification that is not enqueued a
-         * subscription */
-        TAILQ_NEXT(n, subEntry) = UA_SUBSCRIPTION_QUEUE_SENTINEL;
+UA_Notification_new(UA_Subscription *sub) {
+    /* Allocate a new slab if the free-list is empty */
+    if(!sub->notificationFreeList) {
+        UA_NotificationSlab *slab = (UA_NotificationSlab*)
+            UA_malloc(sizeof(UA_NotificationSlab));
+        if(!slab)
+            return NULL;
+        slab->next = sub->notificationSlabs;
+        sub->notificationSlabs = slab;
+        for(size_t i = 0; i < UA_NOTIFICATION_SLABSIZE; i++) {
+            UA_Notification *n = &slab->notifications[i];
+            TAILQ_NEXT(n, monEntry) = sub->notificationFreeList;
+            sub->notificationFreeList = n;
+        }
     }
+
+    /* Take from the free-list */
+    UA_Notification *n = sub->notificationFreeList;
+    sub->notificationFreeList = TAILQ_NEXT(n, monEntry);
+    memset(n, 0, sizeof(UA_Notification));
+
+    /* Set the sentinel for a notification that is not enqueued a
+     * subscription */
+    TAILQ_NEXT(n, subEntry) = UA_SUBSCRIPTION_QUEUE_SENTINEL;
     return n;
 }
 
-/* Dequeue and delete the notification */
+/* Clear the notification and return it to the free-list of the Subscription.
+ * The notification must no longer be enqueued. */
 static void
-UA_Notification_delete(UA_Notification *n) {
-    UA_assert(n != UA_SUBSCRIPTION_QUEUE_SENTINEL);
+UA_Notification_release(UA_Notification *n) {
     UA_assert(n->mon);
-    UA_Notification_dequeueMon(n);
-    UA_Notification_dequeueSub(n);
-    switch(n->mon->itemToMonitor.attributeId) {
+    UA_MonitoredItem *mon = n->mon;
+    UA_Subscription *sub = mon->subscription;
+    switch(mon->itemToMonitor.attributeId) {
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
     case UA_ATTRIBUTEID_EVENTNOTIFIER:
         UA_EventFieldList_clear(&n->data.event);
         break;
 #endif
     default:
+        /* The shared variant has UA_VARIANT_DATA_NODELETE set */
+        if(mon->lastValueShared == n)
+            mon->lastValueShared = NULL;
         UA_MonitoredItemNotification_clear(&n->data.dataChange);
         break;
     }
-    UA_free(n);
+
+    /* Return to the free-list of the Subscription */
+    TAILQ_NEXT(n, monEntry) = sub->notificationFreeList;
+    sub->notificationFreeList = n;
+}
+
+/* Dequeue and delete the notification */
+static void
+UA_Notification_delete(UA_Notification *n) {
+    UA_assert(n != UA_SUBSCRIPTION_QUEUE_SENTINEL);
+    UA_assert(n->mon);
+    UA_Notification_dequeueMon(n);
+    UA_Notification_dequeueSub(n);
+    UA_Notification_release(n);
 }
 
 /* Add to the MonitoredItem queue, update all counters and then handle overflow */
@@ -124,34 +158,12 @@ UA_Notification_enqueueSub(UA_Notification *n) {
     }
 }
 
-void
-UA_Notification_enqueueAndTrigger(UA_Server *server, UA_Notification *n) {
-    UA_MonitoredItem *mon = n->mon;
+/* Put the latest sample of the MonitoredItems linked from mon (with the
+ * SetTriggering service) into the publishing queue */
+static void
+triggerLinkedMonitoredItems(UA_Server *server, UA_MonitoredItem *mon,
+                            UA_DateTime nowMonotonic) {
     UA_Subscription *sub = mon->subscription;
-    UA_assert(sub); /* A MonitoredItem is always attached to a subscription. Can
-                     * be a local MonitoredItem that gets published immediately
-                     * with a callback. */
-
-    /* If reporting or (sampled+triggered), enqueue into the Subscription first
-     * and then into the MonitoredItem. UA_MonitoredItem_ensureQueueSpace
-     * (called within UA_Notification_enqueueMon) assumes the notification is
-     * already in the Subscription's publishing queue. */
-    UA_EventLoop *el = server->config.eventLoop;
-    UA_DateTime nowMonotonic = el->dateTime_nowMonotonic(el);
-    if(mon->monitoringMode == UA_MONITORINGMODE_REPORTING ||
-       (mon->monitoringMode == UA_MONITORINGMODE_SAMPLING &&
-        mon->triggeredUntil > nowMonotonic)) {
-        UA_Notification_enqueueSub(n);
-        mon->triggeredUntil = UA_INT64_MIN;
-        UA_LOG_DEBUG_SUBSCRIPTION(server->config.logging, sub,
-                                  "Notification enqueued (Queue size %lu)",
-                                  (long unsigned)sub->notificationQueueSize);
-    }
-
-    /* Insert into the MonitoredItem. This checks the queue size and
-     * handles overflow. */
-    UA_Notification_enqueueMon(server, n);
-
     for(size_t i = mon->triggeringLinksSize - 1; i < mon->triggeringLinksSize; i--) {
         /* Get the triggered MonitoredItem. Remove the link if the MI doesn't exist. */
         UA_MonitoredItem *triggeredMon =
@@ -168,7 +180,8 @@ UA_Notification_enqueueAndTrigger(UA_Server *server, UA_Notification *n) {
             continue;
 
         /* Get the latest sampled Notification from the triggered MonitoredItem.
-         * Enqueue for publication. */
+         * Enqueue for publication. Sampling MonitoredItems have no ring. */
+        UA_assert(!triggeredMon->ring);
         UA_Notification *n2 = TAILQ_LAST(&triggeredMon->queue, NotificationQueue);
         if(n2)
             UA_Notification_enqueueSub(n2);
@@ -184,6 +197,38 @@ UA_Notification_enqueueAndTrigger(UA_Server *server, UA_Notification *n) {
                                   "MonitoredItem %u triggers MonitoredItem %u",
                                   mon->monitoredItemId, triggeredMon->monitoredItemId);
     }
+}
+
+void
+UA_Notification_enqueueAndTrigger(UA_Server *server, UA_Notification *n) {
+    UA_MonitoredItem *mon = n->mon;
+    UA_Subscription *sub = mon->subscription;
+    UA_assert(sub); /* A MonitoredItem is always attached to a subscription. Can
+                     * be a local MonitoredItem that gets published immediately
+                     * with a callback. */
+
+    /* If reporting or (sampled+triggered), enqueue into the Subscription first
+     * and then into the MonitoredItem. UA_MonitoredItem_ensureQueueSpace
+     * (called within UA_Notification_enqueueMon) assumes the notification is
+     * already in the Subscription's publishing queue. */
+    UA_EventLoop *el = server->config.eventLoop;
+    UA_DateTime nowMonotonic = el->dateTime_nowMonotonic(el);
+    if(mon->monitoringMode == UA_MONITORINGMODE_REPORTING ||
+       (mon->monitoringMode == UA_MONITORINGMODE_SAMPLING &&
+        mon->triggeredUntil > nowMonotonic)) {
+        UA_Notification_enqueueSub(n);
+        mon->triggeredUntil = UA_INT64_MIN;
+        UA_LOG_DEBUG_SUBSCRIPTION(server->config.logging, sub,
+                                  "Notification enqueued (Queue size %lu)",
+                                  (long unsigned)sub->notificationQueueSize);
+    }
+
+    /* Insert into the MonitoredItem. This checks the queue size and
+     * handles overflow. */
+    UA_Notification_enqueueMon(server, n);
+
+    /* Trigger the linked MonitoredItems */
+    triggerLinkedMonitoredItems(server, mon, nowMonotonic);
 
     /* If we just enqueued a notification into the local adminSubscription, then
      * register a delayed callback for "local publishing". */
@@ -248,6 +293,280 @@ UA_Notification_dequeueSub(UA_Notification *n) {
     TAILQ_NEXT(n, subEntry) = UA_SUBSCRIPTION_QUEUE_SENTINEL;
 }
 
+/*********************/
+/* Notification Ring */
+/*********************/
+
+#define UA_RING_HASSTATUS          0x01
+#define UA_RING_HASSOURCETIMESTAMP 0x02
+#define UA_RING_HASSERVERTIMESTAMP 0x04
+
+#define UA_RING_INITIALCAPACITY 16
+
+static UA_Boolean
+isRingNotification(const UA_Notification *n) {
+    return (n->mon->ring && n == &n->mon->ring->notification);
+}
+
+/* Only scalars that fit into the value column without loss */
+static UA_Boolean
+isRingSample(const UA_DataValue *v) {
+    return (v->hasValue && v->value.type &&
+            UA_Variant_isScalar(&v->value) &&
+            UA_DataType_isNumeric(v->value.type) &&
+            v->value.type->memSize <= sizeof(UA_UInt64) &&
+            !v->hasSourcePicoseconds && !v->hasServerPicoseconds);
+}
+
+/* (Re)allocate the columns and move the samples to the front */
+static UA_StatusCode
+resizeRing(UA_NotificationRing *ring, size_t capacity) {
+    UA_assert(capacity >= ring->size);
+    size_t entrySize = sizeof(UA_UInt64) + (2 * sizeof(UA_DateTime)) +
+        sizeof(UA_StatusCode) + sizeof(UA_Byte);
+    UA_Byte *block = (UA_Byte*)UA_malloc(capacity * entrySize);
+    if(!block)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Columns with the largest alignment first */
+    UA_UInt64 *values = (UA_UInt64*)block;
+    UA_DateTime *sourceTimestamps = (UA_DateTime*)&values[capacity];
+    UA_DateTime *serverTimestamps = &sourceTimestamps[capacity];
+    UA_StatusCode *status = (UA_StatusCode*)&serverTimestamps[capacity];
+    UA_Byte *flags = (UA_Byte*)&status[capacity];
+
+    /* Copy the samples in order */
+    for(size_t i = 0; i < ring->size; i++) {
+        size_t pos = (ring->first + i) % ring->capacity;
+        values[i] = ring->values[pos];
+        sourceTimestamps[i] = ring->sourceTimestamps[pos];
+        serverTimestamps[i] = ring->serverTimestamps[pos];
+        status[i] = ring->status[pos];
+        flags[i] = ring->flags[pos];
+    }
+
+    UA_free(ring->values); /* Start of the previous block */
+    ring->values = values;
+    ring->sourceTimestamps = sourceTimestamps;
+    ring->serverTimestamps = serverTimestamps;
+    ring->status = status;
+    ring->flags = flags;
+    ring->capacity = capacity;
+    ring->first = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+setRingSample(UA_NotificationRing *ring, size_t pos, const UA_DataValue *v) {
+    ring->values[pos] = 0;
+    memcpy(&ring->values[pos], v->value.data, v->value.type->memSize);
+    ring->sourceTimestamps[pos] = v->sourceTimestamp;
+    ring->serverTimestamps[pos] = v->serverTimestamp;
+    ring->status[pos] = v->status;
+    ring->flags[pos] = (UA_Byte)
+        ((v->hasStatus ? UA_RING_HASSTATUS : 0) |
+         (v->hasSourceTimestamp ? UA_RING_HASSOURCETIMESTAMP : 0) |
+         (v->hasServerTimestamp ? UA_RING_HASSERVERTIMESTAMP : 0));
+}
+
+/* Get the i-th oldest sample. The value points into the ring. */
+static void
+getRingSample(const UA_MonitoredItem *mon, size_t i,
+              UA_MonitoredItemNotification *min) {
+    const UA_NotificationRing *ring = mon->ring;
+    UA_assert(i < ring->size);
+    size_t pos = (ring->first + i) % ring->capacity;
+    UA_MonitoredItemNotification_init(min);
+    min->clientHandle = mon->parameters.clientHandle;
+    UA_DataValue *dv = &min->value;
+    UA_Variant_setScalar(&dv->value, &ring->values[pos], ring->type);
+    dv->value.storageType = UA_VARIANT_DATA_NODELETE;
+    dv->hasValue = true;
+    dv->sourceTimestamp = ring->sourceTimestamps[pos];
+    dv->serverTimestamp = ring->serverTimestamps[pos];
+    dv->status = ring->status[pos];
+    dv->hasStatus = ((ring->flags[pos] & UA_RING_HASSTATUS) != 0);
+    dv->hasSourceTimestamp = ((ring->flags[pos] & UA_RING_HASSOURCETIMESTAMP) != 0);
+    dv->hasServerTimestamp = ((ring->flags[pos] & UA_RING_HASSERVERTIMESTAMP) != 0);
+}
+
+static void
+setRingOverflowInfoBits(UA_NotificationRing *ring, size_t pos) {
+    ring->flags[pos] |= UA_RING_HASSTATUS;
+    ring->status[pos] |=
+        (UA_STATUSCODE_INFOTYPE_DATAVALUE | UA_STATUSCODE_INFOBITS_OVERFLOW);
+}
+
+UA_Boolean
+UA_MonitoredItem_enqueueRingSample(UA_Server *server, UA_MonitoredItem *mon,
+                                   const UA_DataValue *value) {
+    /* Only for MonitoredItems that report every sample. Otherwise the Triggering
+     * and the removal of non-reported samples requires individual
+     * Notifications. Local MonitoredItems are not published in messages. */
+    UA_Subscription *sub = mon->subscription;
+    if(mon->monitoringMode != UA_MONITORINGMODE_REPORTING ||
+       mon->parameters.queueSize <= 1 || sub == server->adminSubscription ||
+       !isRingSample(value))
+        return false;
+
+    /* Individual Notifications are still queued */
+    UA_NotificationRing *ring = mon->ring;
+    if(mon->queueSize > 0 && (!ring || ring->size == 0))
+        return false;
+
+    /* Allocate the ring */
+    if(!ring) {
+        ring = (UA_NotificationRing*)UA_calloc(1, sizeof(UA_NotificationRing));
+        if(!ring)
+            return false;
+        ring->notification.mon = mon;
+        TAILQ_NEXT(&ring->notification, subEntry) = UA_SUBSCRIPTION_QUEUE_SENTINEL;
+        mon->ring = ring;
+    }
+
+    /* All samples in the ring have the same type */
+    if(ring->size == 0)
+        ring->type = value->value.type;
+    else if(ring->type != value->value.type)
+        return false;
+
+    if(ring->size >= mon->parameters.queueSize) {
+        /* The queue is full. Discard a sample and set the InfoBits, same as
+         * UA_MonitoredItem_ensureQueueSpace. */
+        UA_assert(ring->size == ring->capacity);
+        if(mon->parameters.discardOldest) {
+            /* Overwrite the oldest sample. The next one becomes the oldest. */
+            size_t pos = ring->first;
+            ring->first = (ring->first + 1) % ring->capacity;
+            setRingSample(ring, pos, value);
+            setRingOverflowInfoBits(ring, ring->first);
+        } else {
+            /* Replace the newest sample */
+            size_t last = (ring->first + ring->size - 1) % ring->capacity;
+            setRingSample(ring, last, value);
+            setRingOverflowInfoBits(ring, last);
+        }
+#ifdef UA_ENABLE_DIAGNOSTICS
+        sub->monitoringQueueOverflowCount++;
+#endif
+    } else {
+        /* Grow the columns */
+        if(ring->size == ring->capacity) {
+            size_t capacity = (ring->capacity > 0) ?
+                ring->capacity * 2 : UA_RING_INITIALCAPACITY;
+            if(capacity > mon->parameters.queueSize)
+                capacity = mon->parameters.queueSize;
+            if(resizeRing(ring, capacity) != UA_STATUSCODE_GOOD)
+                return false;
+        }
+
+        /* Append the sample */
+        setRingSample(ring, (ring->first + ring->size) % ring->capacity, value);
+        ring->size++;
+        mon->queueSize++;
+
+        /* The ring Notification is in the Subscription queue if the ring is
+         * not empty */
+        UA_Notification *n = &ring->notification;
+        if(TAILQ_NEXT(n, subEntry) == UA_SUBSCRIPTION_QUEUE_SENTINEL)
+            TAILQ_INSERT_TAIL(&sub->notificationQueue, n, subEntry);
+        ++sub->notificationQueueSize;
+        ++sub->dataChangeNotifications;
+    }
+
+    UA_LOG_DEBUG_SUBSCRIPTION(server->config.logging, sub,
+                              "MonitoredItem %" PRIi32 " | "
+                              "Sample enqueued in the ring (Queue size %lu / %lu)",
+                              mon->monitoredItemId,
+                              (long unsigned)mon->queueSize,
+                              (long unsigned)mon->parameters.queueSize);
+
+    /* Same as in UA_Notification_enqueueAndTrigger for reporting
+     * MonitoredItems */
+    UA_EventLoop *el = server->config.eventLoop;
+    mon->triggeredUntil = UA_INT64_MIN;
+    triggerLinkedMonitoredItems(server, mon, el->dateTime_nowMonotonic(el));
+    return true;
+}
+
+/* Remove the ring Notification from the Subscription queue and decrease the
+ * counters of the Subscription by the number of samples */
+static void
+dequeueRingNotification(UA_MonitoredItem *mon, size_t samples) {
+    UA_Notification *n = &mon->ring->notification;
+    if(TAILQ_NEXT(n, subEntry) == UA_SUBSCRIPTION_QUEUE_SENTINEL)
+        return;
+    UA_Subscription *sub = mon->subscription;
+    TAILQ_REMOVE(&sub->notificationQueue, n, subEntry);
+    TAILQ_NEXT(n, subEntry) = UA_SUBSCRIPTION_QUEUE_SENTINEL;
+    sub->notificationQueueSize -= (UA_UInt32)samples;
+    sub->dataChangeNotifications -= (UA_UInt32)samples;
+}
+
+/* Remove the oldest samples */
+static void
+removeRingSamples(UA_MonitoredItem *mon, size_t samples) {
+    UA_NotificationRing *ring = mon->ring;
+    UA_assert(samples <= ring->size);
+    ring->first = (ring->first + samples) % ring->capacity;
+    ring->size -= samples;
+    mon->queueSize -= samples;
+}
+
+void
+UA_MonitoredItem_spillRing(UA_MonitoredItem *mon) {
+    UA_NotificationRing *ring = mon->ring;
+    if(!ring)
+        return;
+    UA_assert(ring->sending == 0);
+
+    /* Create individual Notifications. Insert them where the ring Notification
+     * is in the Subscription queue. */
+    UA_Subscription *sub = mon->subscription;
+    UA_Notification *rn = &ring->notification;
+    UA_Boolean reporting = (TAILQ_NEXT(rn, subEntry) != UA_SUBSCRIPTION_QUEUE_SENTINEL);
+    size_t dropped = 0;
+    for(size_t i = 0; i < ring->size; i++) {
+        UA_MonitoredItemNotification min;
+        getRingSample(mon, i, &min);
+        UA_Notification *n = UA_Notification_new(sub);
+        if(!n) {
+            dropped++;
+            continue;
+        }
+        n->mon = mon;
+        if(UA_MonitoredItemNotification_copy(&min, &n->data.dataChange) !=
+           UA_STATUSCODE_GOOD) {
+            UA_Notification_release(n);
+            dropped++;
+            continue;
+        }
+        TAILQ_INSERT_TAIL(&mon->queue, n, monEntry);
+        if(reporting)
+            TAILQ_INSERT_BEFORE(rn, n, subEntry);
+    }
+
+    /* Remove the ring. Samples that could not be converted are lost. */
+    mon->queueSize -= dropped;
+    dequeueRingNotification(mon, dropped);
+    UA_free(ring->values);
+    UA_free(ring);
+    mon->ring = NULL;
+}
+
+/* Remove all samples and the ring */
+static void
+deleteRing(UA_MonitoredItem *mon) {
+    UA_NotificationRing *ring = mon->ring;
+    if(!ring)
+        return;
+    dequeueRingNotification(mon, ring->size);
+    mon->queueSize -= ring->size;
+    UA_free(ring->values);
+    UA_free(ring);
+    mon->ring = NULL;
+}
+
 /****************/
 /* Subscription */
 /****************/
@@ -324,7 +643,7 @@ UA_Subscription_delete(UA_Server *server, UA_Subscription *sub) {
     UA_NotificationMessageEntry *nme, *nme_tmp;
     TAILQ_FOREACH_SAFE(nme, &sub->retransmissionQueue, listEntry, nme_tmp) {
         TAILQ_REMOVE(&sub->retransmissionQueue, nme, listEntry);
-        UA_NotificationMessage_clear(&nme->message);
+        UA_ByteString_clear(&nme->encoded);
         UA_free(nme);
         if(sub->session)
             --sub->session->totalRetransmissionQueueSize;
@@ -332,6 +651,16 @@ UA_Subscription_delete(UA_Server *server, UA_Subscription *sub) {
     }
     UA_assert(sub->retransmissionQueueSize == 0);
 
+    /* Release the memory for Notifications. All Notifications have been
+     * returned to the free-list with the MonitoredItems. */
+    UA_NotificationSlab *slab, *slab_tmp;
+    for(slab = sub->notificationSlabs; slab; slab = slab_tmp) {
+        slab_tmp = slab->next;
+        UA_free(slab);
+    }
+    sub->notificationSlabs = NULL;
+    sub->notificationFreeList = NULL;
+
     /* Pointers to the subscription may still exist upwards in the call stack.
      * Add a delayed callback to remove the Subscription when the current jobs
      * have completed. */
@@ -361,7 +690,7 @@ removeOldestRetransmissionMessageFromSub(UA_Subscription *sub) {
     UA_NotificationMessageEntry *oldestEntry =
         TAILQ_LAST(&sub->retransmissionQueue, NotificationMessageQueue);
     TAILQ_REMOVE(&sub->retransmissionQueue, oldestEntry, listEntry);
-    UA_NotificationMessage_clear(&oldestEntry->message);
+    UA_ByteString_clear(&oldestEntry->encoded);
     UA_free(oldestEntry);
     --sub->retransmissionQueueSize;
     if(sub->session)
@@ -382,7 +711,7 @@ removeOldestRetransmissionMessageFromSession(UA_Session *session) {
             TAILQ_LAST(&sub->retransmissionQueue, NotificationMessageQueue);
         if(!first)
             continue;
-        if(!oldestEntry || oldestEntry->message.publishTime > first->message.publishTime) {
+        if(!oldestEntry || oldestEntry->publishTime > first->publishTime) {
             oldestEntry = first;
             oldestSub = sub;
         }
@@ -422,7 +751,7 @@ UA_Subscription_removeRetransmissionMessage(UA_Subscription *sub, UA_UInt32 sequ
     /* Find the retransmission message */
     UA_NotificationMessageEntry *entry;
     TAILQ_FOREACH(entry, &sub->retransmissionQueue, listEntry) {
-        if(entry->message.sequenceNumber == sequenceNumber)
+        if(entry->sequenceNumber == sequenceNumber)
             break;
     }
     if(!entry)
@@ -431,7 +760,7 @@ UA_Subscription_removeRetransmissionMessage(UA_Subscription *sub, UA_UInt32 sequ
     /* Remove the retransmission message */
     TAILQ_REMOVE(&sub->retransmissionQueue, entry, listEntry);
     --sub->retransmissionQueueSize;
-    UA_NotificationMessage_clear(&entry->message);
+    UA_ByteString_clear(&entry->encoded);
     UA_free(entry);
 
     if(sub->session)
@@ -440,103 +769,64 @@ UA_Subscription_removeRetransmissionMessage(UA_Subscription *sub, UA_UInt32 sequ
     return UA_STATUSCODE_GOOD;
 }
 
-/* The output counters are only set when the preparation is successful */
-static UA_StatusCode
-prepareNotificationMessage(UA_Server *server, UA_Subscription *sub,
-                           UA_NotificationMessage *message,
-                           size_t maxNotifications) {
-    UA_assert(maxNotifications > 0);
-
-    /* Allocate an ExtensionObject for Event- and DataChange-Notifications. Also
-     * there can be StatusChange-Notifications. The standard says in Part 4,
-     * 7.2.1:
-     *
-     * If a Subscription contains MonitoredItems for events and data, this array
-     * should have not more than 2 elements. */
-    message->notificationData = (UA_ExtensionObject*)
-        UA_Array_new(2, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
-    if(!message->notificationData)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    message->notificationDataSize = 2;
-
-    /* Pre-allocate DataChangeNotifications */
-    size_t notificationDataIdx = 0;
-    size_t dcnPos = 0; /* How many DataChangeNotifications? */
-    UA_DataChangeNotification *dcn = NULL;
-    if(sub->dataChangeNotifications > 0) {
-        dcn = UA_DataChangeNotification_new();
-        if(!dcn) {
-            UA_NotificationMessage_clear(message);
-            return UA_STATUSCODE_BADOUTOFMEMORY;
-        }
-        UA_ExtensionObject_setValue(message->notificationData, dcn,
-                                    &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION]);
-        size_t dcnSize = sub->dataChangeNotifications;
-        if(dcnSize > maxNotifications)
-            dcnSize = maxNotifications;
-        dcn->monitoredItems = (UA_MonitoredItemNotification*)
-            UA_Array_new(dcnSize, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
-        if(!dcn->monitoredItems) {
-            UA_NotificationMessage_clear(message); /* Also frees the dcn */
-            return UA_STATUSCODE_BADOUTOFMEMORY;
-        }
-        dcn->monitoredItemsSize = dcnSize;
-        notificationDataIdx++;
-    }
-
+/* Notifications taken out of the queues for one NotificationMessage. They stay
+ * linked via their monEntry until they are released after sending. The encoded
+ * sizes are computed while collecting, so that the message can be streamed
+ * without building the DataChangeNotification and EventNotificationList. */
+typedef struct {
+    NotificationQueue queue;
+    size_t dataChangeCount;
+    size_t dataChangeSize; /* Encoded size of the MonitoredItemNotifications */
+    size_t eventCount;
+    size_t eventSize;      /* Encoded size of the EventFieldLists */
+} NotificationBatch;
+
+static UA_Boolean
+isEventNotification(const UA_Notification *n) {
 #ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
-    size_t enlPos = 0; /* How many EventNotifications? */
-    UA_EventNotificationList *enl = NULL;
-    if(sub->eventNotifications > 0) {
-        enl = UA_EventNotificationList_new();
-        if(!enl) {
-            UA_NotificationMessage_clear(message);
-            return UA_STATUSCODE_BADOUTOFMEMORY;
-        }
-        UA_ExtensionObject_setValue(&message->notificationData[notificationDataIdx],
-                                    enl, &UA_TYPES[UA_TYPES_EVENTNOTIFICATIONLIST]);
-        size_t enlSize = sub->eventNotifications;
-        if(enlSize > maxNotifications)
-            enlSize = maxNotifications;
-        enl->events = (UA_EventFieldList*)
-            UA_Array_new(enlSize, &UA_TYPES[UA_TYPES_EVENTFIELDLIST]);
-        if(!enl->events) {
-            UA_NotificationMessage_clear(message);
-            return UA_STATUSCODE_BADOUTOFMEMORY;
-        }
-        enl->eventsSize = enlSize;
-        notificationDataIdx++;
-    }
+    return (n->mon->itemToMonitor.attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER);
+#else
+    return false;
 #endif
+}
 
-    UA_assert(notificationDataIdx > 0);
-    message->notificationDataSize = notificationDataIdx;
-
-    /* <-- The point of no return --> */
-
-    /* How many notifications were moved to the response overall? */
+static void
+collectNotifications(UA_Subscription *sub, NotificationBatch *batch,
+                     size_t maxNotifications) {
+    UA_assert(maxNotifications > 0);
     size_t totalNotifications = 0;
     UA_Notification *n, *n_tmp;
     TAILQ_FOREACH_SAFE(n, &sub->notificationQueue, subEntry, n_tmp) {
         if(totalNotifications >= maxNotifications)
             break;
 
-        /* Move the content to the response */
-        switch(n->mon->itemToMonitor.attributeId) {
-#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
-        case UA_ATTRIBUTEID_EVENTNOTIFIER:
-            UA_assert(enl != NULL); /* Have at least one event notification */
-            enl->events[enlPos] = n->data.event;
-            UA_EventFieldList_init(&n->data.event);
-            enlPos++;
-            break;
-#endif
-        default:
-            UA_assert(dcn != NULL); /* Have at least one change notification */
-            dcn->monitoredItems[dcnPos] = n->data.dataChange;
-            UA_DataValue_init(&n->data.dataChange.value);
-            dcnPos++;
-            break;
+        /* Take the oldest samples from the ring of the MonitoredItem. The ring
+         * Notification is moved to the end of the Subscription queue if
+         * samples remain. So MonitoredItems with a long queue don't starve the
+         * others. */
+        if(isRingNotification(n)) {
+            UA_MonitoredItem *mon = n->mon;
+            UA_NotificationRing *ring = mon->ring;
+            size_t samples = ring->size;
+            if(samples > maxNotifications - totalNotifications)
+                samples = maxNotifications - totalNotifications;
+            for(size_t i = 0; i < samples; i++) {
+                UA_MonitoredItemNotification min;
+                getRingSample(mon, i, &min);
+                batch->dataChangeSize +=
+                    UA_calcSizeBinary(&min, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+            }
+            batch->dataChangeCount += samples;
+            ring->sending = samples;
+            dequeueRingNotification(mon, samples);
+            if(samples < ring->size) {
+                /* The loop ends as the maximum number of notifications is
+                 * reached. So the ring Notification is not visited again. */
+                TAILQ_INSERT_TAIL(&sub->notificationQueue, n, subEntry);
+            }
+            TAILQ_INSERT_TAIL(&batch->queue, n, monEntry);
+            totalNotifications += samples;
+            continue;
         }
 
         /* If there are Notifications *before this one* in the MonitoredItem-
@@ -551,34 +841,327 @@ prepareNotificationMessage(UA_Server *server, UA_Subscription *sub,
             UA_assert(prev != TAILQ_PREV(n, NotificationQueue, monEntry));
         }
 
-        /* Delete the notification, remove from the queues and decrease the counters */
-        UA_Notification_delete(n);
+        /* Count the notification and its encoded size */
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+        if(isEventNotification(n)) {
+            batch->eventCount++;
+            batch->eventSize +=
+                UA_calcSizeBinary(&n->data.event, &UA_TYPES[UA_TYPES_EVENTFIELDLIST]);
+        } else
+#endif
+        {
+            batch->dataChangeCount++;
+            batch->dataChangeSize +=
+                UA_calcSizeBinary(&n->data.dataChange,
+                                  &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+        }
 
+        /* Remove from the queues (decreases the counters) and keep until the
+         * message was sent */
+        UA_Notification_dequeueMon(n);
+        UA_Notification_dequeueSub(n);
+        TAILQ_INSERT_TAIL(&batch->queue, n, monEntry);
         totalNotifications++;
     }
+}
 
-    /* Set sizes */
-    if(dcn) {
-        dcn->monitoredItemsSize = dcnPos;
-        if(dcnPos == 0) {
-            UA_free(dcn->monitoredItems);
-            dcn->monitoredItems = NULL;
+static void
+releaseNotifications(NotificationBatch *batch) {
+    UA_Notification *n, *n_tmp;
+    TAILQ_FOREACH_SAFE(n, &batch->queue, monEntry, n_tmp) {
+        if(isRingNotification(n)) {
+            /* The ring Notification itself is not released */
+            removeRingSamples(n->mon, n->mon->ring->sending);
+            n->mon->ring->sending = 0;
+            continue;
         }
+        UA_Notification_release(n);
     }
+    TAILQ_INIT(&batch->queue);
+}
 
-#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
-    if(enl) {
-        enl->eventsSize = enlPos;
-        if(enlPos == 0) {
-            UA_free(enl->events);
-            enl->events = NULL;
+/* Put the notifications back to the front of the queues if the message could
+ * not be sent. Nothing was added to the queues in the meantime. */
+static void
+restoreNotifications(UA_Subscription *sub, NotificationBatch *batch) {
+    UA_Notification *n;
+    while((n = TAILQ_LAST(&batch->queue, NotificationQueue))) {
+        TAILQ_REMOVE(&batch->queue, n, monEntry);
+        UA_MonitoredItem *mon = n->mon;
+
+        /* The samples are still in the ring. Move the ring Notification to the
+         * front of the Subscription queue. */
+        if(isRingNotification(n)) {
+            UA_NotificationRing *ring = mon->ring;
+            if(TAILQ_NEXT(n, subEntry) != UA_SUBSCRIPTION_QUEUE_SENTINEL)
+                TAILQ_REMOVE(&sub->notificationQueue, n, subEntry);
+            TAILQ_INSERT_HEAD(&sub->notificationQueue, n, subEntry);
+            sub->notificationQueueSize += (UA_UInt32)ring->sending;
+            sub->dataChangeNotifications += (UA_UInt32)ring->sending;
+            ring->sending = 0;
+            continue;
         }
+
+        /* Inverse of UA_Notification_dequeueMon / UA_Notification_dequeueSub */
+        TAILQ_INSERT_HEAD(&mon->queue, n, monEntry);
+        ++mon->queueSize;
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+        if(n->isOverflowEvent)
+            ++mon->eventOverflows;
+#endif
+        TAILQ_INSERT_HEAD(&sub->notificationQueue, n, subEntry);
+        ++sub->notificationQueueSize;
+        if(isEventNotification(n))
+            ++sub->eventNotifications;
+        else
+            ++sub->dataChangeNotifications;
+    }
+}
+
+/* The NotificationMessage is encoded into a flat buffer (for the retransmission
+ * queue) or streamed into the chunks of the SecureChannel */
+typedef UA_StatusCode
+(*EncodeCallback)(void *handle, const void *p, const UA_DataType *type);
+
+typedef struct {
+    UA_Byte *pos;
+    const UA_Byte *end;
+} FlatBuffer;
+
+static UA_StatusCode
+encodeFlatBuffer(void *handle, const void *p, const UA_DataType *type) {
+    FlatBuffer *fb = (FlatBuffer*)handle;
+    return UA_encodeBinaryInternal(p, type, &fb->pos, &fb->end, NULL, NULL);
+}
+
+static UA_StatusCode
+encodeMessageContext(void *handle, const void *p, const UA_DataType *type) {
+    return UA_MessageContext_encode((UA_MessageContext*)handle, p, type);
+}
+
+static UA_StatusCode
+encodeArray(EncodeCallback encode, void *handle, const void *array,
+            size_t size, const UA_DataType *type) {
+    /* Length prefix as in Array_encodeBinary */
+    if(size > UA_INT32_MAX)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    UA_Int32 signedLength = -1;
+    if(size > 0)
+        signedLength = (UA_Int32)size;
+    else if(array == UA_EMPTY_ARRAY_SENTINEL)
+        signedLength = 0;
+    UA_StatusCode res = encode(handle, &signedLength, &UA_TYPES[UA_TYPES_INT32]);
+    UA_CHECK_STATUS(res, return res);
+
+    uintptr_t ptr = (uintptr_t)array;
+    for(size_t i = 0; i < size; i++) {
+        res = encode(handle, (const void*)ptr, type);
+        UA_CHECK_STATUS(res, return res);
+        ptr += type->memSize;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Size of the DataChangeNotification / EventNotificationList body */
+static size_t
+notificationDataBodySize(const NotificationBatch *batch, UA_Boolean events) {
+    if(events)
+        return 4 + batch->eventSize; /* events array */
+    return 4 + batch->dataChangeSize + 4; /* monitoredItems and diagnosticInfos */
+}
+
+/* Encode an ExtensionObject with the DataChangeNotification or the
+ * EventNotificationList. The body is written directly from the notifications. */
+static UA_StatusCode
+encodeNotificationData(const NotificationBatch *batch, UA_Boolean events,
+                       EncodeCallback encode, void *handle) {
+    const UA_DataType *dataType = &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION];
+    size_t count = batch->dataChangeCount;
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    if(events) {
+        dataType = &UA_TYPES[UA_TYPES_EVENTNOTIFICATIONLIST];
+        count = batch->eventCount;
     }
 #endif
+    size_t bodySize = notificationDataBodySize(batch, events);
+    if(bodySize > UA_INT32_MAX)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+
+    /* ExtensionObject header */
+    UA_Byte encoding = (UA_Byte)UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
+    UA_Int32 bodyLength = (UA_Int32)bodySize;
+    UA_StatusCode res = encode(handle, &dataType->binaryEncodingId,
+                               &UA_TYPES[UA_TYPES_NODEID]);
+    UA_CHECK_STATUS(res, return res);
+    res = encode(handle, &encoding, &UA_TYPES[UA_TYPES_BYTE]);
+    UA_CHECK_STATUS(res, return res);
+    res = encode(handle, &bodyLength, &UA_TYPES[UA_TYPES_INT32]);
+    UA_CHECK_STATUS(res, return res);
+
+    /* The array of MonitoredItemNotifications / EventFieldLists */
+    UA_Int32 length = (UA_Int32)count;
+    res = encode(handle, &length, &UA_TYPES[UA_TYPES_INT32]);
+    UA_CHECK_STATUS(res, return res);
+    UA_Notification *n;
+    TAILQ_FOREACH(n, &batch->queue, monEntry) {
+        if(isEventNotification(n) != events)
+            continue;
+        if(isRingNotification(n)) {
+            for(size_t i = 0; i < n->mon->ring->sending; i++) {
+                UA_MonitoredItemNotification min;
+                getRingSample(n->mon, i, &min);
+                res = encode(handle, &min, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+                UA_CHECK_STATUS(res, return res);
+            }
+            continue;
+        }
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+        if(events) {
+            res = encode(handle, &n->data.event, &UA_TYPES[UA_TYPES_EVENTFIELDLIST]);
+            UA_CHECK_STATUS(res, return res);
+            continue;
+        }
+#endif
+        res = encode(handle, &n->data.dataChange,
+                     &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+        UA_CHECK_STATUS(res, return res);
+    }
 
+    /* The DataChangeNotification has no diagnosticInfos */
+    if(!events) {
+        UA_Int32 noDiagnostics = -1;
+        res = encode(handle, &noDiagnostics, &UA_TYPES[UA_TYPES_INT32]);
+    }
+    return res;
+}
+
+/* Encode the NotificationMessage with the same layout as UA_NotificationMessage */
+static UA_StatusCode
+encodeNotificationMessage(const NotificationBatch *batch, UA_UInt32 sequenceNumber,
+                          UA_DateTime publishTime, EncodeCallback encode,
+                          void *handle) {
+    UA_Int32 notificationDataSize = 0;
+    if(batch->dataChangeCount > 0)
+        notificationDataSize++;
+    if(batch->eventCount > 0)
+        notificationDataSize++;
+
+    UA_StatusCode res = encode(handle, &sequenceNumber, &UA_TYPES[UA_TYPES_UINT32]);
+    UA_CHECK_STATUS(res, return res);
+    res = encode(handle, &publishTime, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_CHECK_STATUS(res, return res);
+    res = encode(handle, &notificationDataSize, &UA_TYPES[UA_TYPES_INT32]);
+    UA_CHECK_STATUS(res, return res);
+    if(batch->dataChangeCount > 0) {
+        res = encodeNotificationData(batch, false, encode, handle);
+        UA_CHECK_STATUS(res, return res);
+    }
+    if(batch->eventCount > 0)
+        res = encodeNotificationData(batch, true, encode, handle);
+    return res;
+}
+
+static size_t
+notificationMessageSize(const NotificationBatch *batch) {
+    /* sequenceNumber, publishTime and the notificationData array length */
+    size_t size = 4 + 8 + 4;
+    if(batch->dataChangeCount > 0)
+        size += UA_calcSizeBinary(&UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION].
+                                  binaryEncodingId, &UA_TYPES[UA_TYPES_NODEID]) +
+            1 + 4 + notificationDataBodySize(batch, false);
+    if(batch->eventCount > 0)
+        size += UA_calcSizeBinary(&UA_TYPES[UA_TYPES_EVENTNOTIFICATIONLIST].
+                                  binaryEncodingId, &UA_TYPES[UA_TYPES_NODEID]) +
+            1 + 4 + notificationDataBodySize(batch, true);
+    return size;
+}
+
+/* Retain the encoded NotificationMessage for the retransmission queue */
+static UA_StatusCode
+encodeRetransmission(const NotificationBatch *batch,
+                     UA_NotificationMessageEntry *entry) {
+    UA_StatusCode res =
+        UA_ByteString_allocBuffer(&entry->encoded, notificationMessageSize(batch));
+    UA_CHECK_STATUS(res, return res);
+    FlatBuffer fb = {entry->encoded.data, entry->encoded.data + entry->encoded.length};
+    res = encodeNotificationMessage(batch, entry->sequenceNumber, entry->publishTime,
+                                    encodeFlatBuffer, &fb);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_ByteString_clear(&entry->encoded);
+        return res;
+    }
+    UA_assert(fb.pos == fb.end);
     return UA_STATUSCODE_GOOD;
 }
 
+/* Stream the PublishResponse into the SecureChannel (with the same layout as
+ * UA_PublishResponse). The NotificationMessage is copied from the retransmission
+ * entry if it was already encoded. Otherwise it is encoded from the batch. */
+static UA_StatusCode
+sendPublishResponse(UA_Server *server, UA_SecureChannel *channel,
+                    UA_UInt32 requestId, UA_PublishResponse *response,
+                    const NotificationBatch *batch,
+                    const UA_NotificationMessageEntry *retransmission) {
+    if(!channel)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* Prepare the ResponseHeader */
+    UA_EventLoop *el = server->config.eventLoop;
+    response->responseHeader.timestamp = el->dateTime_now(el);
+
+    /* Start the message context */
+    UA_MessageContext mc;
+    UA_StatusCode res = UA_MessageContext_begin(&mc, channel, requestId,
+                                                UA_MESSAGETYPE_MSG);
+    UA_CHECK_STATUS(res, return res);
+
+    /* Encode the response type and the fields before the NotificationMessage */
+    res = UA_MessageContext_encode(&mc, &UA_TYPES[UA_TYPES_PUBLISHRESPONSE].
+                                   binaryEncodingId, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_CHECK_STATUS(res, goto cleanup);
+    res = UA_MessageContext_encode(&mc, &response->responseHeader,
+                                   &UA_TYPES[UA_TYPES_RESPONSEHEADER]);
+    UA_CHECK_STATUS(res, goto cleanup);
+    res = UA_MessageContext_encode(&mc, &response->subscriptionId,
+                                   &UA_TYPES[UA_TYPES_UINT32]);
+    UA_CHECK_STATUS(res, goto cleanup);
+    res = encodeArray(encodeMessageContext, &mc, response->availableSequenceNumbers,
+                      response->availableSequenceNumbersSize,
+                      &UA_TYPES[UA_TYPES_UINT32]);
+    UA_CHECK_STATUS(res, goto cleanup);
+    res = UA_MessageContext_encode(&mc, &response->moreNotifications,
+                                   &UA_TYPES[UA_TYPES_BOOLEAN]);
+    UA_CHECK_STATUS(res, goto cleanup);
+
+    /* Encode the NotificationMessage */
+    if(retransmission)
+        res = UA_MessageContext_encodeRaw(&mc, &retransmission->encoded);
+    else
+        res = encodeNotificationMessage(batch,
+                                        response->notificationMessage.sequenceNumber,
+                                        response->notificationMessage.publishTime,
+                                        encodeMessageContext, &mc);
+    UA_CHECK_STATUS(res, goto cleanup);
+
+    /* Encode the remaining fields */
+    res = encodeArray(encodeMessageContext, &mc, response->results,
+                      response->resultsSize, &UA_TYPES[UA_TYPES_STATUSCODE]);
+    UA_CHECK_STATUS(res, goto cleanup);
+    res = encodeArray(encodeMessageContext, &mc, response->diagnosticInfos,
+                      response->diagnosticInfosSize,
+                      &UA_TYPES[UA_TYPES_DIAGNOSTICINFO]);
+    UA_CHECK_STATUS(res, goto cleanup);
+
+    /* Finish / send out */
+    return UA_MessageContext_finish(&mc);
+
+ cleanup:
+    /* The MessageContext is already aborted if the encoding failed inside */
+    if(mc.messageBuffer.length > 0)
+        UA_MessageContext_abort(&mc);
+    return res;
+}
+
 /* According to OPC Unified Architecture, Part 4 5.13.1.1 i) The value 0 is
  * never used for the sequence number */
 static UA_UInt32
@@ -813,31 +1396,14 @@ UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
     size_t priorDataChangeNotifications = sub->dataChangeNotifications;
     size_t priorEventNotifications = sub->eventNotifications;
 #endif
-    if(notifications > 0) {
-        if(server->config.enableRetransmissionQueue) {
-            /* Allocate the retransmission entry */
-            retransmission = (UA_NotificationMessageEntry*)
-                UA_malloc(sizeof(UA_NotificationMessageEntry));
-            if(!retransmission) {
-                UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, sub,
-                                            "Could not allocate memory for retransmission. "
-                                            "The subscription is late.");
-                sub->late = true;
-                UA_Session_queuePublishReq(sub->session, pre, true); /* Re-enqueue */
-                return;
-            }
-        }
-
-        /* Prepare the response */
-        UA_StatusCode retval =
-            prepareNotificationMessage(server, sub, message, notifications);
-        if(retval != UA_STATUSCODE_GOOD) {
+    if(notifications > 0 && server->config.enableRetransmissionQueue) {
+        /* Allocate the retransmission entry */
+        retransmission = (UA_NotificationMessageEntry*)
+            UA_calloc(1, sizeof(UA_NotificationMessageEntry));
+        if(!retransmission) {
             UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, sub,
-                                        "Could not prepare the notification message. "
+                                        "Could not allocate memory for retransmission. "
                                         "The subscription is late.");
-            /* If the retransmission queue is enabled a retransmission message is allocated */
-            if(retransmission)
-                UA_free(retransmission);
             sub->late = true;
             UA_Session_queuePublishReq(sub->session, pre, true); /* Re-enqueue */
             return;
@@ -846,6 +1412,14 @@ UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
 
     /* <-- The point of no return --> */
 
+    /* Take the notifications out of the queues. They are encoded directly
+     * from the batch when the response is sent. */
+    NotificationBatch batch;
+    memset(&batch, 0, sizeof(NotificationBatch));
+    TAILQ_INIT(&batch.queue);
+    if(notifications > 0)
+        collectNotifications(sub, &batch, notifications);
+
     /* Set up the response */
     response->subscriptionId = sub->subscriptionId;
     response->moreNotifications = (sub->notificationQueueSize > 0);
@@ -858,13 +1432,25 @@ UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
 
     if(notifications > 0) {
         /* If the retransmission queue is enabled a retransmission message is
-         * allocated */
+         * allocated. Only the encoded NotificationMessage is retained. */
         if(retransmission) {
-            /* Put the notification message into the retransmission queue. This
-             * needs to be done here, so that the message itself is included in
-             * the available sequence numbers for acknowledgement. */
-            retransmission->message = response->notificationMessage;
-            UA_Subscription_addRetransmissionMessage(server, sub, retransmission);
+            retransmission->sequenceNumber = message->sequenceNumber;
+            retransmission->publishTime = message->publishTime;
+            UA_StatusCode res = encodeRetransmission(&batch, retransmission);
+            if(res != UA_STATUSCODE_GOOD) {
+                UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, sub,
+                                            "Could not encode the notification "
+                                            "message for retransmission (%s)",
+                                            UA_StatusCode_name(res));
+                UA_free(retransmission);
+                retransmission = NULL;
+            } else {
+                /* Put the notification message into the retransmission queue.
+                 * This needs to be done here, so that the message itself is
+                 * included in the available sequence numbers for
+                 * acknowledgement. */
+                UA_Subscription_addRetransmissionMessage(server, sub, retransmission);
+            }
         }
         /* Only if a notification was created, the sequence number must be
          * increased. For a keepalive the sequence number can be reused. */
@@ -880,17 +1466,49 @@ UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
     size_t i = 0;
     UA_NotificationMessageEntry *nme;
     TAILQ_FOREACH(nme, &sub->retransmissionQueue, listEntry) {
-        response->availableSequenceNumbers[i] = nme->message.sequenceNumber;
+        response->availableSequenceNumbers[i] = nme->sequenceNumber;
         ++i;
     }
     UA_assert(i == sub->retransmissionQueueSize);
 
-    /* Send the response */
+    /* Send the response. A keepalive has no notifications to stream. */
     UA_LOG_DEBUG_SUBSCRIPTION(server->config.logging, sub,
                               "Sending out a publish response with %" PRIu32
                               " notifications", notifications);
-    sendResponse(server, sub->session->channel, pre->requestId,
-                 (UA_Response*)response, &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
+    UA_StatusCode sendRes;
+    if(notifications == 0)
+        sendRes = sendResponse(server, sub->session->channel, pre->requestId,
+                               (UA_Response*)response,
+                               &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
+    else
+        sendRes = sendPublishResponse(server, sub->session->channel, pre->requestId,
+                                      response, &batch, retransmission);
+
+    /* Sending failed. The notifications are retained in the retransmission
+     * queue for a Republish. Otherwise they are put back into the queues and
+     * the sequence number is not used up. */
+    if(sendRes != UA_STATUSCODE_GOOD) {
+        if(retransmission) {
+            UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, sub,
+                                        "Could not send the publish response (%s). "
+                                        "NotificationMessage %" PRIu32 " remains "
+                                        "available for Republish",
+                                        UA_StatusCode_name(sendRes),
+                                        message->sequenceNumber);
+        } else {
+            UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, sub,
+                                        "Could not send the publish response (%s)",
+                                        UA_StatusCode_name(sendRes));
+            if(notifications > 0) {
+                restoreNotifications(sub, &batch);
+                sub->nextSequenceNumber = message->sequenceNumber;
+                sub->late = true;
+            }
+        }
+    }
+
+    /* Release the sent notifications */
+    releaseNotifications(&batch);
 
     /* Reset the Subscription state to NORMAL. But only if all notifications
      * have been sent out. Otherwise keep the Subscription in the LATE state. So
@@ -906,10 +1524,6 @@ UA_Subscription_publish(UA_Server *server, UA_Subscription *sub) {
     sub->currentKeepAliveCount = 0;
 
     /* Free the response */
-    if(retransmission) {
-        /* NotificationMessage was moved into retransmission queue */
-        UA_NotificationMessage_init(&response->notificationMessage);
-    }
     response->availableSequenceNumbers = NULL;
     response->availableSequenceNumbersSize = 0;
     UA_PublishResponse_clear(&pre->response);
@@ -1104,7 +1718,7 @@ createEventOverflowNotification(UA_Server *server, UA_Subscription *sub,
     efl.eventFieldsSize = 1;
 
     /* Allocate the notification */
-    UA_Notification *overflowNotification = UA_Notification_new();
+    UA_Notification *overflowNotification = UA_Notification_new(sub);
     if(!overflowNotification) {
         UA_Variant_delete(efl.eventFields);
         return UA_STATUSCODE_BADOUTOFMEMORY;
@@ -1339,6 +1953,7 @@ UA_MonitoredItem_setMonitoringMode(UA_Server *server, UA_MonitoredItem *mon,
     if(mon->monitoringMode == UA_MONITORINGMODE_DISABLED) {
         UA_Notification *notification_tmp;
         UA_MonitoredItem_unregisterSampling(server, mon);
+        deleteRing(mon);
         TAILQ_FOREACH_SAFE(notification, &mon->queue, monEntry, notification_tmp) {
             UA_Notification_delete(notification);
         }
@@ -1346,6 +1961,10 @@ UA_MonitoredItem_setMonitoringMode(UA_Server *server, UA_MonitoredItem *mon,
         return UA_STATUSCODE_GOOD;
     }
 
+    /* Only reporting MonitoredItems store samples in the ring */
+    if(mon->monitoringMode != UA_MONITORINGMODE_REPORTING)
+        UA_MonitoredItem_spillRing(mon);
+
     /* When reporting is enabled, put all notifications that were already
      * sampled into the global queue of the subscription. When sampling is
      * enabled, remove all notifications from the global queue. !!! This needs
@@ -1408,12 +2027,17 @@ UA_MonitoredItem_delete(UA_Server *server, UA_MonitoredItem *mon) {
     }
 
     /* Remove the queued notifications attached to the subscription */
+    deleteRing(mon);
     UA_Notification *notification, *notification_tmp;
     TAILQ_FOREACH_SAFE(notification, &mon->queue, monEntry, notification_tmp) {
         UA_Notification_delete(notification);
     }
 
     /* Remove the settings */
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    UA_EventFilterProgram_delete(mon->eventFilterProgram);
+    mon->eventFilterProgram = NULL;
+#endif
     UA_ReadValueId_clear(&mon->itemToMonitor);
     UA_MonitoringParameters_clear(&mon->parameters);
 
@@ -1579,6 +2203,12 @@ UA_MonitoredItem_registerSampling(UA_Server *server, UA_MonitoredItem *mon) {
                                  addMonitoredItemBackpointer, mon);
         if(res == UA_STATUSCODE_GOOD)
             mon->samplingType = UA_MONITOREDITEMSAMPLINGTYPE_EVENT;
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+        /* The cached event listeners need to be recomputed */
+        if(res == UA_STATUSCODE_GOOD &&
+           mon->itemToMonitor.attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER)
+            server->eventPaths.listenersGeneration++;
+#endif
     } else if(mon->parameters.samplingInterval == sub->publishingInterval) {
         /* Add to the subscription for sampling before every publish */
         LIST_INSERT_HEAD(&sub->samplingMonitoredItems, mon,
@@ -1615,6 +2245,10 @@ UA_MonitoredItem_unregisterSampling(UA_Server *server, UA_MonitoredItem *mon) {
         UA_Server_editNode(server, &server->adminSession, &mon->itemToMonitor.nodeId,
                            0, UA_REFERENCETYPESET_NONE, UA_BROWSEDIRECTION_INVALID,
                            removeMonitoredItemBackPointer, mon);
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+        if(mon->itemToMonitor.attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER)
+            server->eventPaths.listenersGeneration++;
+#endif
         break;
     }
 
@@ -24,6 +24,7 @@
 
 #include "ua_session.h"
 #include "../util/ua_util_internal.h"
+#include "ziptree.h"
 
 _UA_BEGIN_DECLS
 
@@ -70,9 +71,20 @@ typedef struct UA_Notification {
 #endif
 } UA_Notification;
 
+/* Notifications are allocated from slabs owned by the Subscription. Released
+ * Notifications go to a free-list of the Subscription and are reused. So
+ * high-rate sampling does not cause a malloc/free for every Notification. The
+ * slabs are released only together with the Subscription. */
+#define UA_NOTIFICATION_SLABSIZE 64
+
+typedef struct UA_NotificationSlab {
+    struct UA_NotificationSlab *next;
+    UA_Notification notifications[UA_NOTIFICATION_SLABSIZE];
+} UA_NotificationSlab;
+
 /* Initializes and sets the sentinel pointers. Only create a notification if it
  * is also going to be immediately enqueued to a MonitoredItem (see below). */
-UA_Notification * UA_Notification_new(void);
+UA_Notification * UA_Notification_new(UA_Subscription *sub);
 
 /* Notifications are always added to the queue of a MonitoredItem. That queue
  * can overflow. If Notifications are reported, they are also added to the queue
@@ -85,11 +97,40 @@ UA_Notification * UA_Notification_new(void);
 void UA_Notification_enqueueAndTrigger(UA_Server *server,
                                        UA_Notification *n);
 
-/* A NotificationMessage contains an array of notifications.
- * Sent NotificationMessages are stored for the republish service. */
+/* Scalar numeric samples of a reporting MonitoredItem with a queueSize > 1 are
+ * stored in a columnar ring buffer instead of individual Notifications. Overflow
+ * then only moves the start index. The embedded Notification represents all
+ * samples of the ring in the queue of the Subscription. The queue counters of
+ * the Subscription and the MonitoredItem count the individual samples.
+ *
+ * The ring is converted back to individual Notifications ("spilled") whenever
+ * a sample does not fit into the ring or the MonitoredItem stops reporting. */
+typedef struct {
+    UA_Notification notification; /* Enqueued in the Subscription if size > 0 */
+    const UA_DataType *type;      /* The type of all samples in the ring */
+    size_t capacity;              /* Grows up to the queueSize of the MonItem */
+    size_t first;                 /* Position of the oldest sample */
+    size_t size;                  /* Number of samples in the ring */
+    size_t sending;               /* Oldest samples taken for the publish
+                                   * response that is currently encoded */
+
+    /* One column per field. The columns are allocated in one block. */
+    UA_UInt64 *values;            /* Scalar with up to 64bit */
+    UA_DateTime *sourceTimestamps;
+    UA_DateTime *serverTimestamps;
+    UA_StatusCode *status;
+    UA_Byte *flags;               /* hasStatus, has(Source|Server)Timestamp */
+} UA_NotificationRing;
+
+/* A NotificationMessage contains an array of notifications. Sent
+ * NotificationMessages are stored for the republish service. Only the binary
+ * encoding of the message is retained. It is decoded again if the message is
+ * actually republished. */
 typedef struct UA_NotificationMessageEntry {
     TAILQ_ENTRY(UA_NotificationMessageEntry) listEntry;
-    UA_NotificationMessage message;
+    UA_UInt32 sequenceNumber;
+    UA_DateTime publishTime;
+    UA_ByteString encoded; /* Encoded UA_NotificationMessage */
 } UA_NotificationMessageEntry;
 
 /* Queue Definitions */
@@ -158,6 +199,17 @@ struct UA_MonitoredItem {
     } sampling;
     UA_DataValue lastValue;
 
+    /* The newest DataChange Notification can share the variant content with
+     * lastValue instead of holding a deep copy. The shared variant in the
+     * Notification has UA_VARIANT_DATA_NODELETE set. When the next sample
+     * replaces lastValue, the ownership of the old content is moved to the
+     * Notification. So every sample is copied at most once. */
+    UA_Notification *lastValueShared;
+
+    /* Columnar storage of the queued samples. Can be NULL. If the ring contains
+     * samples, then the queue of individual Notifications is empty. */
+    UA_NotificationRing *ring;
+
     /* Triggering Links */
     size_t triggeringLinksSize;
     UA_UInt32 *triggeringLinks;
@@ -168,6 +220,11 @@ struct UA_MonitoredItem {
                        * (maximum) queueSize in the parameters. */
     size_t eventOverflows; /* Separate counter for the queue. Can at most double
                             * the queue size */
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS_EVENTS
+    /* The EventFilter from the parameters, compiled for repeated evaluation */
+    struct UA_EventFilterProgram *eventFilterProgram;
+#endif
 };
 
 void UA_MonitoredItem_init(UA_MonitoredItem *mon);
@@ -203,6 +260,18 @@ UA_StatusCode
 UA_MonitoredItem_addLink(UA_Subscription *sub, UA_MonitoredItem *mon,
                          UA_UInt32 linkId);
 
+/* Store the sample in the ring of the MonitoredItem. Returns false if that is
+ * not possible. Then the sample has to be enqueued as a regular Notification.
+ * The value is copied. */
+UA_Boolean
+UA_MonitoredItem_enqueueRingSample(UA_Server *server, UA_MonitoredItem *mon,
+                                   const UA_DataValue *value);
+
+/* Convert the samples of the ring into individual Notifications (at the same
+ * position in the Subscription queue) and free the ring */
+void
+UA_MonitoredItem_spillRing(UA_MonitoredItem *mon);
+
 UA_StatusCode
 UA_MonitoredItem_createDataChangeNotification(UA_Server *server, UA_MonitoredItem *mon,
                                               const UA_DataValue *value);
@@ -270,6 +339,10 @@ struct UA_Subscription {
      * publish interval of the subscription) */
     LIST_HEAD(, UA_MonitoredItem) samplingMonitoredItems;
 
+    /* Memory for the Notifications of the MonitoredItems */
+    UA_NotificationSlab *notificationSlabs;
+    UA_Notification *notificationFreeList; /* Linked via monEntry */
+
     /* Global list of notifications from the MonitoredItems */
     TAILQ_HEAD(, UA_Notification) notificationQueue;
     UA_UInt32 notificationQueueSize; /* Total queue size */
@@ -347,10 +420,99 @@ typedef struct UA_ConditionSource UA_ConditionSource;
 #define UA_EVENTFILTER_MAXOPERANDS 64 /* Max operands per operator */
 #define UA_EVENTFILTER_MAXSELECT   64 /* Max select clauses */
 
+/* Events propagate (bubble up) from the origin node over inverse Organizes,
+ * HasComponent, HasEventSource and HasNotifier references (and their subtypes)
+ * to the notifier objects. The propagation path is cached per origin node.
+ * Only origins below the ObjectsFolder are cached. All nodes visited while
+ * computing the paths are remembered as members. The cache is dropped when a
+ * member is deleted or a reference of a relevant type is added to or removed
+ * from a member. The subset of notifiers with attached Event-MonitoredItems
+ * is recomputed lazily when Event-MonitoredItems were (un)registered in the
+ * meantime. */
+typedef struct UA_EventPath {
+    ZIP_ENTRY(UA_EventPath) treeEntry;
+    UA_NodeId origin;
+    size_t notifiersSize; /* All objects on the path, including the Server */
+    UA_NodeId *notifiers;
+    UA_UInt64 listenersGeneration;
+    size_t listenersSize; /* Indices of notifiers with Event-MonitoredItems */
+    size_t *listeners;
+} UA_EventPath;
+
+typedef ZIP_HEAD(UA_EventPathTree, UA_EventPath) UA_EventPathTree;
+
+typedef struct UA_EventPathMember {
+    ZIP_ENTRY(UA_EventPathMember) treeEntry;
+    UA_NodeId nodeId;
+} UA_EventPathMember;
+
+typedef ZIP_HEAD(UA_EventPathMemberTree, UA_EventPathMember) UA_EventPathMemberTree;
+
+#define UA_EVENTPATHCACHE_MAXSIZE 4096 /* Max origin nodes in the cache */
+
+typedef struct {
+    UA_Boolean refTypesValid;
+    UA_ReferenceTypeSet inFolderRefTypes;
+    UA_ReferenceTypeSet emitRefTypes;
+
+    UA_EventPathTree paths;
+    size_t pathsSize;
+    UA_EventPathMemberTree members; /* Nodes visited for the cached paths */
+
+    /* Incremented when an Event-MonitoredItem is attached to or detached from
+     * a node */
+    UA_UInt64 listenersGeneration;
+
+    /* Paths are in use by triggerEvent. Postpone the invalidation. */
+    UA_UInt32 pinned;
+    UA_Boolean stale;
+} UA_EventPathCache;
+
+void
+UA_EventPathCache_clear(UA_EventPathCache *cache);
+
+/* Drop the cached paths if the ReferenceType is relevant for propagation and
+ * one of the nodes is on a cached path. HasSubtype references always drop the
+ * cache as they can change the relevant ReferenceTypes. */
+void
+UA_EventPathCache_referenceChanged(UA_EventPathCache *cache,
+                                   UA_Byte refTypeIndex,
+                                   const UA_NodeId *source,
+                                   const UA_NodeId *target);
+
+/* Drop the cached paths if the removed node is on one of them */
+void
+UA_EventPathCache_nodeRemoved(UA_EventPathCache *cache,
+                              const UA_NodeId *nodeId);
+
 UA_StatusCode
 UA_MonitoredItem_addEvent(UA_Server *server, UA_MonitoredItem *mon,
                           const UA_NodeId *event);
 
+/* An EventFilter is compiled into a flat program that is evaluated for every
+ * event. The program points into the EventFilter, which must outlive it. */
+typedef struct UA_EventFilterProgram UA_EventFilterProgram;
+
+UA_StatusCode
+UA_EventFilterProgram_compile(UA_Server *server, const UA_EventFilter *filter,
+                              UA_EventFilterProgram **outProgram);
+
+void
+UA_EventFilterProgram_delete(UA_EventFilterProgram *program);
+
+/* Evaluate the program for the event. Returns UA_STATUSCODE_BADNOMATCH if the
+ * where-clause does not match. Otherwise the select-clauses are written into
+ * the EventFieldList. */
+UA_StatusCode
+UA_EventFilterProgram_evaluate(UA_Server *server, UA_Session *session,
+                               UA_EventFilterProgram *program,
+                               const UA_NodeId *eventNode,
+                               UA_EventFieldList *efl);
+
+/* (Re)compile the EventFilter from the parameters of the MonitoredItem */
+UA_StatusCode
+UA_MonitoredItem_compileEventFilter(UA_Server *server, UA_MonitoredItem *mon);
+
 UA_StatusCode
 generateEventId(UA_ByteString *generatedId);
 
@@ -15,17 +15,33 @@
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS /* conditional compilation */
 
-/* Detect value changes outside the deadband */
-#define UA_DETECT_DEADBAND(TYPE) do {                           \
-    TYPE v1 = *(const TYPE*)data1;                              \
-    TYPE v2 = *(const TYPE*)data2;                              \
-    TYPE diff = (v1 > v2) ? (TYPE)(v1 - v2) : (TYPE)(v2 - v1);  \
-    return ((UA_Double)diff > deadband);                        \
+/* Detect value changes outside the deadband. The type switch is done once per
+ * array. The differences are then compared in blocks without branching, so
+ * that the compiler can vectorize the inner loop. The outer loop exits early
+ * after the first block with a change. */
+#define UA_DEADBAND_BLOCKSIZE 64
+
+#define UA_DETECT_DEADBAND(TYPE) do {                                   \
+    const TYPE *v1 = (const TYPE*)data1;                                \
+    const TYPE *v2 = (const TYPE*)data2;                                \
+    for(size_t i = 0; i < length; i += UA_DEADBAND_BLOCKSIZE) {         \
+        size_t end = (length - i > UA_DEADBAND_BLOCKSIZE) ?             \
+            i + UA_DEADBAND_BLOCKSIZE : length;                         \
+        UA_Boolean outside = false;                                     \
+        for(size_t j = i; j < end; j++) {                               \
+            TYPE diff = (v1[j] > v2[j]) ?                               \
+                (TYPE)(v1[j] - v2[j]) : (TYPE)(v2[j] - v1[j]);          \
+            outside |= ((UA_Double)diff > deadband);                    \
+        }                                                               \
+        if(outside)                                                     \
+            return true;                                                \
+    }                                                                   \
+    return false;                                                       \
 } while(false);
 
 static UA_Boolean
-detectScalarDeadBand(const void *data1, const void *data2,
-                     const UA_DataType *type, const UA_Double deadband) {
+detectArrayDeadBand(const void *data1, const void *data2, size_t length,
+                    const UA_DataType *type, const UA_Double deadband) {
     if(type->typeKind == UA_DATATYPEKIND_SBYTE) {
         UA_DETECT_DEADBAND(UA_SByte);
     } else if(type->typeKind == UA_DATATYPEKIND_BYTE) {
@@ -61,17 +77,36 @@ detectVariantDeadband(const UA_Variant *value, const UA_Variant *oldValue,
     size_t length = 1;
     if(!UA_Variant_isScalar(value))
         length = value->arrayLength;
-    uintptr_t data = (uintptr_t)value->data;
-    uintptr_t oldData = (uintptr_t)oldValue->data;
-    UA_UInt32 memSize = value->type->memSize;
-    for(size_t i = 0; i < length; ++i) {
-        if(detectScalarDeadBand((const void*)data, (const void*)oldData,
-                                value->type, deadbandValue))
-            return true;
-        data += memSize;
-        oldData += memSize;
+    return detectArrayDeadBand(value->data, oldValue->data, length,
+                               value->type, deadbandValue);
+}
+
+/* Compare the variants. Values of a pointer-free type are compared with memcmp
+ * first. Identical bits mean the values are equal. For overlayable types
+ * (except floating point, where 0.0 equals -0.0) different bits also mean that
+ * the values differ. Otherwise fall back to the type-aware comparison. */
+static UA_Boolean
+detectVariantChange(const UA_Variant *value, const UA_Variant *oldValue) {
+    const UA_DataType *type = value->type;
+    if(type && type == oldValue->type && type->pointerFree &&
+       value->arrayLength == oldValue->arrayLength &&
+       value->arrayDimensionsSize == oldValue->arrayDimensionsSize &&
+       UA_Variant_isScalar(value) == UA_Variant_isScalar(oldValue)) {
+        size_t length = UA_Variant_isScalar(value) ? 1 : value->arrayLength;
+        if(length > 0) {
+            if(memcmp(value->data, oldValue->data, length * type->memSize) == 0) {
+                if(value->arrayDimensionsSize == 0)
+                    return false;
+                return (memcmp(value->arrayDimensions, oldValue->arrayDimensions,
+                               value->arrayDimensionsSize * sizeof(UA_UInt32)) != 0);
+            }
+            if(type->overlayable &&
+               type->typeKind != UA_DATATYPEKIND_FLOAT &&
+               type->typeKind != UA_DATATYPEKIND_DOUBLE)
+                return true;
+        }
     }
-    return false;
+    return !UA_equal(value, oldValue, &UA_TYPES[UA_TYPES_VARIANT]);
 }
 
 static UA_Boolean
@@ -120,8 +155,7 @@ detectValueChange(UA_Server *server, UA_MonitoredItem *mon, const UA_DataValue *
     /* Has the value changed? */
     if(dv->hasValue != mon->lastValue.hasValue)
         return true;
-    return !UA_equal(&dv->value, &mon->lastValue.value,
-                     &UA_TYPES[UA_TYPES_VARIANT]);
+    return detectVariantChange(&dv->value, &mon->lastValue.value);
 }
 
 UA_StatusCode
@@ -134,7 +168,7 @@ UA_MonitoredItem_createDataChangeNotification(UA_Server *server, UA_MonitoredIte
         return retval;
 
     /* Allocate a new notification */
-    UA_Notification *n = UA_Notification_new();
+    UA_Notification *n = UA_Notification_new(mon->subscription);
     if(!n) {
         UA_DataValue_clear(&valueCopy);
         return UA_STATUSCODE_BADOUTOFMEMORY;
@@ -148,6 +182,56 @@ UA_MonitoredItem_createDataChangeNotification(UA_Server *server, UA_MonitoredIte
     return UA_STATUSCODE_GOOD;
 }
 
+/* Store the changed value and create the notification. This always takes
+ * ownership of the value. */
+static void
+processChangedValue(UA_Server *server, UA_MonitoredItem *mon, UA_DataValue *value) {
+    /* Store scalar numeric samples in the ring of the MonitoredItem. Then
+     * there is no individual Notification. */
+    if(UA_MonitoredItem_enqueueRingSample(server, mon, value)) {
+        UA_assert(!mon->lastValueShared);
+        UA_DataValue_clear(&mon->lastValue);
+        mon->lastValue = *value;
+        return;
+    }
+
+    /* Convert remaining samples in the ring to keep the order */
+    UA_MonitoredItem_spillRing(mon);
+
+    /* Allocate a new notification */
+    UA_Notification *n = UA_Notification_new(mon->subscription);
+    if(!n) {
+        UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, mon->subscription,
+                                    "MonitoredItem %" PRIi32 " | "
+                                    "Processing the sample returned the statuscode %s",
+                                    mon->monitoredItemId,
+                                    UA_StatusCode_name(UA_STATUSCODE_BADOUTOFMEMORY));
+        UA_DataValue_clear(value);
+        return;
+    }
+
+    /* The previous sample is replaced. Move its content to the Notification
+     * that shares it (if that is still queued). */
+    if(mon->lastValueShared) {
+        mon->lastValueShared->data.dataChange.value.value = mon->lastValue.value;
+        UA_Variant_init(&mon->lastValue.value);
+        mon->lastValueShared = NULL;
+    }
+
+    /* Move/store the value for filter comparison and TransferSubscription */
+    UA_DataValue_clear(&mon->lastValue);
+    mon->lastValue = *value;
+
+    /* Prepare the notification with a shallow copy of the value and enqueue.
+     * The notification can be deleted right away if the queue overflows. */
+    n->mon = mon;
+    n->data.dataChange.value = *value;
+    n->data.dataChange.value.value.storageType = UA_VARIANT_DATA_NODELETE;
+    n->data.dataChange.clientHandle = mon->parameters.clientHandle;
+    mon->lastValueShared = n;
+    UA_Notification_enqueueAndTrigger(server, n);
+}
+
 void
 UA_MonitoredItem_processSampledValue(UA_Server *server, UA_MonitoredItem *mon,
                                      UA_DataValue *value) {
@@ -164,21 +248,7 @@ UA_MonitoredItem_processSampledValue(UA_Server *server, UA_MonitoredItem *mon,
         return;
     }
 
-    /* Prepare a notification and enqueue it */
-    UA_StatusCode res =
-        UA_MonitoredItem_createDataChangeNotification(server, mon, value);
-    if(res != UA_STATUSCODE_GOOD) {
-        UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, mon->subscription,
-                                    "MonitoredItem %" PRIi32 " | "
-                                    "Processing the sample returned the statuscode %s",
-                                    mon->monitoredItemId, UA_StatusCode_name(res));
-        UA_DataValue_clear(value);
-        return;
-    }
-
-    /* Move/store the value for filter comparison and TransferSubscription */
-    UA_DataValue_clear(&mon->lastValue);
-    mon->lastValue = *value;
+    processChangedValue(server, mon, value);
 }
 
 void
@@ -194,11 +264,37 @@ UA_MonitoredItem_sample(UA_Server *server, UA_MonitoredItem *mon) {
      * sub->session can be NULL when the subscription is detached. Then
      * readWithSession returns the error-code BADUSERACCESSDENIED. */
     UA_Session *session = (sub) ? sub->session : &server->adminSession;
-    UA_DataValue dv = readWithSession(server, session, &mon->itemToMonitor,
-                                      mon->timestampsToReturn);
+    UA_BorrowedValues borrowed;
+    memset(&borrowed, 0, sizeof(UA_BorrowedValues));
+    UA_DataValue dv = readWithSessionBorrowed(server, session, &mon->itemToMonitor,
+                                              mon->timestampsToReturn, &borrowed);
 
     /* Process the sample. This always clears the value. */
-    UA_MonitoredItem_processSampledValue(server, mon, &dv);
+    if(borrowed.size == 0) {
+        UA_MonitoredItem_processSampledValue(server, mon, &dv);
+        return;
+    }
+
+    /* The value is borrowed from a data source. Only a changed value is
+     * copied. */
+    if(!detectValueChange(server, mon, &dv)) {
+        UA_LOG_DEBUG_SUBSCRIPTION(server->config.logging, sub,
+                                  "MonitoredItem %" PRIi32 " | "
+                                  "The value has not changed", mon->monitoredItemId);
+    } else {
+        UA_DataValue copy;
+        UA_StatusCode res = UA_DataValue_copy(&dv, &copy);
+        if(res == UA_STATUSCODE_GOOD) {
+            processChangedValue(server, mon, &copy);
+        } else {
+            UA_LOG_WARNING_SUBSCRIPTION(server->config.logging, sub,
+                                        "MonitoredItem %" PRIi32 " | "
+                                        "Processing the sample returned the statuscode %s",
+                                        mon->monitoredItemId, UA_StatusCode_name(res));
+        }
+    }
+    UA_DataValue_clear(&dv);
+    UA_BorrowedValues_release(server, &borrowed);
 }
 
 #endif /* UA_ENABLE_SUBSCRIPTIONS */
@@ -178,38 +178,29 @@ eventSetStandardFields(UA_Server *server, const UA_NodeId *event,
 UA_StatusCode
 UA_MonitoredItem_addEvent(UA_Server *server, UA_MonitoredItem *mon,
                           const UA_NodeId *event) {
-    /* Get the filter */
-    if(mon->parameters.filter.content.decoded.type != &UA_TYPES[UA_TYPES_EVENTFILTER])
+    /* Get the compiled filter */
+    UA_EventFilterProgram *program = mon->eventFilterProgram;
+    if(!program)
         return UA_STATUSCODE_BADFILTERNOTALLOWED;
-    UA_EventFilter *eventFilter = (UA_EventFilter*)
-        mon->parameters.filter.content.decoded.data;
 
     /* A MonitoredItem is always attached to a (local) Subscription.
      * A Subscription may not be attached to a Session. */
     UA_Subscription *sub = mon->subscription;
     UA_assert(sub);
 
-    /* Values to be returned when the filter matches */
+    /* Evaluate the filter. Return if it doesn't match. Otherwise the values
+     * of the select-clauses are returned. */
     UA_EventFieldList values;
-    UA_EventFieldList_init(&values);
-
-    UA_EventFilterResult efr; /* FilterResult contains only statuscodes. Ignored
-                               * outside the initial setup/validation. */
-    UA_EventFilterResult_init(&efr);
-
-    /* Evaluate the filter. Return if it doesn't match. */
-    UA_StatusCode ret = filterEvent(server, sub->session, event,
-                                    eventFilter, &values, &efr);
-    UA_EventFilterResult_clear(&efr);
+    UA_StatusCode ret =
+        UA_EventFilterProgram_evaluate(server, sub->session, program, event, &values);
     if(ret != UA_STATUSCODE_GOOD) {
-        UA_EventFieldList_clear(&values);
         if(ret == UA_STATUSCODE_BADNOMATCH)
             ret = UA_STATUSCODE_GOOD;
         return ret;
     }
 
     /* Allocate memory for the notification */
-    UA_Notification *notification = UA_Notification_new();
+    UA_Notification *notification = UA_Notification_new(sub);
     if(!notification) {
         UA_EventFieldList_clear(&values);
         return UA_STATUSCODE_BADOUTOFMEMORY;
@@ -282,6 +273,319 @@ static const UA_NodeId isInFolderReferences[2] =
     {{0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_ORGANIZES}},
      {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_HASCOMPONENT}}};
 
+/********************/
+/* Event Path Cache */
+/********************/
+
+static enum ZIP_CMP
+cmpEventPath(const UA_NodeId *a, const UA_NodeId *b) {
+    return (enum ZIP_CMP)UA_NodeId_order(a, b);
+}
+
+ZIP_FUNCTIONS(UA_EventPathTree, UA_EventPath, treeEntry,
+              UA_NodeId, origin, cmpEventPath)
+ZIP_FUNCTIONS(UA_EventPathMemberTree, UA_EventPathMember, treeEntry,
+              UA_NodeId, nodeId, cmpEventPath)
+
+static void *
+deleteEventPathCallback(void *context, UA_EventPath *path) {
+    UA_NodeId_clear(&path->origin);
+    UA_Array_delete(path->notifiers, path->notifiersSize,
+                    &UA_TYPES[UA_TYPES_NODEID]);
+    UA_free(path->listeners);
+    UA_free(path);
+    return NULL;
+}
+
+static void *
+deleteEventPathMemberCallback(void *context, UA_EventPathMember *member) {
+    UA_NodeId_clear(&member->nodeId);
+    UA_free(member);
+    return NULL;
+}
+
+static void
+deleteEventPaths(UA_EventPathCache *cache) {
+    UA_assert(cache->pinned == 0);
+    ZIP_ITER(UA_EventPathTree, &cache->paths, deleteEventPathCallback, NULL);
+    ZIP_INIT(&cache->paths);
+    ZIP_ITER(UA_EventPathMemberTree, &cache->members,
+             deleteEventPathMemberCallback, NULL);
+    ZIP_INIT(&cache->members);
+    cache->pathsSize = 0;
+}
+
+void
+UA_EventPathCache_clear(UA_EventPathCache *cache) {
+    /* In use. Clean up when the paths are released. */
+    if(cache->pinned > 0) {
+        cache->stale = true;
+        return;
+    }
+    deleteEventPaths(cache);
+    cache->refTypesValid = false;
+    cache->stale = false;
+}
+
+static UA_Boolean
+isEventPathMember(UA_EventPathCache *cache, const UA_NodeId *nodeId) {
+    return (ZIP_FIND(UA_EventPathMemberTree, &cache->members, nodeId) != NULL);
+}
+
+void
+UA_EventPathCache_referenceChanged(UA_EventPathCache *cache,
+                                   UA_Byte refTypeIndex,
+                                   const UA_NodeId *source,
+                                   const UA_NodeId *target) {
+    if(!cache->refTypesValid)
+        return; /* Nothing cached yet */
+    if(refTypeIndex == UA_REFERENCETYPEINDEX_HASSUBTYPE) {
+        UA_EventPathCache_clear(cache);
+        return;
+    }
+    if(!UA_ReferenceTypeSet_contains(&cache->emitRefTypes, refTypeIndex) &&
+       !UA_ReferenceTypeSet_contains(&cache->inFolderRefTypes, refTypeIndex))
+        return;
+    if(isEventPathMember(cache, source) || isEventPathMember(cache, target))
+        UA_EventPathCache_clear(cache);
+}
+
+void
+UA_EventPathCache_nodeRemoved(UA_EventPathCache *cache,
+                              const UA_NodeId *nodeId) {
+    if(isEventPathMember(cache, nodeId))
+        UA_EventPathCache_clear(cache);
+}
+
+static UA_StatusCode
+addEventPathMember(UA_EventPathCache *cache, const UA_NodeId *nodeId) {
+    if(isEventPathMember(cache, nodeId))
+        return UA_STATUSCODE_GOOD;
+    UA_EventPathMember *member = (UA_EventPathMember*)
+        UA_malloc(sizeof(UA_EventPathMember));
+    if(!member)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode res = UA_NodeId_copy(nodeId, &member->nodeId);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_free(member);
+        return res;
+    }
+    ZIP_INSERT(UA_EventPathMemberTree, &cache->members, member);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+computeEventRefTypes(UA_Server *server, UA_EventPathCache *cache) {
+    UA_ReferenceTypeSet_init(&cache->inFolderRefTypes);
+    UA_ReferenceTypeSet_init(&cache->emitRefTypes);
+
+    /* Only use Organizes and HasComponent to check if we are below the
+     * ObjectsFolder */
+    UA_StatusCode res;
+    UA_ReferenceTypeSet tmpRefTypes;
+    for(size_t i = 0; i < 2; ++i) {
+        res = referenceTypeIndices(server, &isInFolderReferences[i], &tmpRefTypes, true);
+        if(res != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
+                           "Events: Could not create the list of references and their subtypes "
+                           "with StatusCode %s", UA_StatusCode_name(res));
+            return res;
+        }
+        cache->inFolderRefTypes =
+            UA_ReferenceTypeSet_union(cache->inFolderRefTypes, tmpRefTypes);
+    }
+
+    /* Get all ReferenceTypes over which the events propagate */
+    for(size_t i = 0; i < EMIT_REFS_ROOT_COUNT; i++) {
+        res = referenceTypeIndices(server, &emitReferencesRoots[i], &tmpRefTypes, true);
+        if(res != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
+                           "Events: Could not create the list of references for event "
+                           "propagation with StatusCode %s", UA_StatusCode_name(res));
+            return res;
+        }
+        cache->emitRefTypes = UA_ReferenceTypeSet_union(cache->emitRefTypes, tmpRefTypes);
+    }
+
+    cache->refTypesValid = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns UA_STATUSCODE_BADINVALIDARGUMENT if the origin is not in the
+ * ObjectsFolder. That is not cached as it would have to be invalidated by
+ * reference changes anywhere in the information model. */
+static UA_StatusCode
+createEventPath(UA_Server *server, UA_EventPathCache *cache,
+                const UA_NodeId *origin, UA_EventPath **outPath) {
+    /* Make sure the origin is in the ObjectsFolder (TODO: or in the ViewsFolder) */
+    if(!isNodeInTree(server, origin, &objectsFolderId, &cache->inFolderRefTypes))
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+
+    /* Bound the memory use. Start over if the cache is full. Paths in use by
+     * triggerEvent are cleaned up when they are released. */
+    if(cache->pathsSize >= UA_EVENTPATHCACHE_MAXSIZE) {
+        if(cache->pinned > 0)
+            cache->stale = true;
+        else
+            deleteEventPaths(cache);
+    }
+
+    UA_EventPath *path = (UA_EventPath*)UA_calloc(1, sizeof(UA_EventPath));
+    if(!path)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode res = UA_NodeId_copy(origin, &path->origin);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_free(path);
+        return res;
+    }
+
+    /* Add the server node to the list of nodes from which the event is emitted.
+     * The server node emits all events.
+     *
+     * Part 3, 7.17: In particular, the root notifier of a Server, the Server
+     * Object defined in Part 5, is always capable of supplying all Events from
+     * a Server and as such has implied HasEventSource References to every event
+     * source in a Server. */
+    UA_NodeId emitStartNodes[2];
+    emitStartNodes[0] = *origin;
+    emitStartNodes[1] = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+
+    /* Get the list of nodes in the hierarchy that emits the event. Events
+     * propagate upwards (bubble up) in the node hierarchy. This includes the
+     * nodes visited by the ObjectsFolder check. */
+    UA_ExpandedNodeId *emitNodes = NULL;
+    size_t emitNodesSize = 0;
+    res = browseRecursive(server, 2, emitStartNodes, UA_BROWSEDIRECTION_INVERSE,
+                          &cache->emitRefTypes, UA_NODECLASS_UNSPECIFIED, true,
+                          &emitNodesSize, &emitNodes);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
+                       "Events: Could not create the list of nodes listening on the "
+                       "event with StatusCode %s", UA_StatusCode_name(res));
+        deleteEventPathCallback(NULL, path);
+        return res;
+    }
+
+    /* Remember all visited nodes. The path is not cached if that fails. */
+    res = addEventPathMember(cache, origin);
+    for(size_t i = 0; i < emitNodesSize && res == UA_STATUSCODE_GOOD; i++)
+        res = addEventPathMember(cache, &emitNodes[i].nodeId);
+    if(res != UA_STATUSCODE_GOOD) {
+        UA_Array_delete(emitNodes, emitNodesSize, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+        deleteEventPathCallback(NULL, path);
+        return res;
+    }
+
+    /* Keep only the objects. Move the NodeIds out of the ExpandedNodeIds. */
+    if(emitNodesSize > 0) {
+        path->notifiers = (UA_NodeId*)
+            UA_Array_new(emitNodesSize, &UA_TYPES[UA_TYPES_NODEID]);
+        if(!path->notifiers) {
+            UA_Array_delete(emitNodes, emitNodesSize, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+            deleteEventPathCallback(NULL, path);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+    for(size_t i = 0; i < emitNodesSize; i++) {
+        const UA_Node *node =
+            UA_NODESTORE_GET_SELECTIVE(server, &emitNodes[i].nodeId, 0,
+                                       UA_REFERENCETYPESET_NONE,
+                                       UA_BROWSEDIRECTION_INVALID);
+        if(!node)
+            continue;
+        UA_Boolean isObject = (node->head.nodeClass == UA_NODECLASS_OBJECT);
+        UA_NODESTORE_RELEASE(server, node);
+        if(!isObject)
+            continue;
+        path->notifiers[path->notifiersSize] = emitNodes[i].nodeId;
+        UA_NodeId_init(&emitNodes[i].nodeId);
+        path->notifiersSize++;
+    }
+    UA_Array_delete(emitNodes, emitNodesSize, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+
+    /* Force the computation of the listeners */
+    path->listenersGeneration = cache->listenersGeneration - 1;
+
+    ZIP_INSERT(UA_EventPathTree, &cache->paths, path);
+    cache->pathsSize++;
+    *outPath = path;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_Boolean
+hasEventMonitoredItem(const UA_Node *node) {
+    UA_MonitoredItem *mon = node->head.monitoredItems;
+    for(; mon != NULL; mon = mon->sampling.nodeListNext) {
+        if(mon->itemToMonitor.attributeId == UA_ATTRIBUTEID_EVENTNOTIFIER)
+            return true;
+    }
+    return false;
+}
+
+/* Recompute the notifiers with attached Event-MonitoredItems */
+static UA_StatusCode
+updateEventPathListeners(UA_Server *server, UA_EventPathCache *cache,
+                         UA_EventPath *path) {
+    if(path->listenersGeneration == cache->listenersGeneration)
+        return UA_STATUSCODE_GOOD;
+
+    path->listenersSize = 0;
+    if(!path->listeners && path->notifiersSize > 0) {
+        path->listeners = (size_t*)UA_malloc(sizeof(size_t) * path->notifiersSize);
+        if(!path->listeners)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    for(size_t i = 0; i < path->notifiersSize; i++) {
+        const UA_Node *node =
+            UA_NODESTORE_GET_SELECTIVE(server, &path->notifiers[i], 0,
+                                       UA_REFERENCETYPESET_NONE,
+                                       UA_BROWSEDIRECTION_INVALID);
+        if(!node)
+            continue;
+        if(hasEventMonitoredItem(node))
+            path->listeners[path->listenersSize++] = i;
+        UA_NODESTORE_RELEASE(server, node);
+    }
+
+    path->listenersGeneration = cache->listenersGeneration;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns the cached path. Pin the cache while the path is in use. */
+static UA_StatusCode
+getEventPath(UA_Server *server, const UA_NodeId *origin, UA_EventPath **outPath) {
+    UA_EventPathCache *cache = &server->eventPaths;
+    UA_StatusCode res;
+    if(!cache->refTypesValid) {
+        res = computeEventRefTypes(server, cache);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+    }
+
+    UA_EventPath *path = ZIP_FIND(UA_EventPathTree, &cache->paths, origin);
+    if(!path) {
+        res = createEventPath(server, cache, origin, &path);
+        if(res != UA_STATUSCODE_GOOD)
+            return res;
+    }
+
+    res = updateEventPathListeners(server, cache, path);
+    if(res != UA_STATUSCODE_GOOD)
+        return res;
+
+    *outPath = path;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+releaseEventPaths(UA_EventPathCache *cache) {
+    UA_assert(cache->pinned > 0);
+    cache->pinned--;
+    if(cache->pinned == 0 && cache->stale)
+        UA_EventPathCache_clear(cache);
+}
+
 UA_StatusCode
 triggerEvent(UA_Server *server, const UA_NodeId eventNodeId,
              const UA_NodeId origin, UA_ByteString *outEventId,
@@ -312,27 +616,21 @@ triggerEvent(UA_Server *server, const UA_NodeId eventNodeId,
     }
     UA_NODESTORE_RELEASE(server, originNode);
 
-    /* Make sure the origin is in the ObjectsFolder (TODO: or in the ViewsFolder) */
-    /* Only use Organizes and HasComponent to check if we are below the ObjectsFolder */
-    UA_StatusCode retval;
-    UA_ReferenceTypeSet refTypes;
-    UA_ReferenceTypeSet_init(&refTypes);
-    for(int i = 0; i < 2; ++i) {
-        UA_ReferenceTypeSet tmpRefTypes;
-        retval = referenceTypeIndices(server, &isInFolderReferences[i], &tmpRefTypes, true);
-        if(retval != UA_STATUSCODE_GOOD) {
-            UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
-                           "Events: Could not create the list of references and their subtypes "
-                           "with StatusCode %s", UA_StatusCode_name(retval));
-        }
-        refTypes = UA_ReferenceTypeSet_union(refTypes, tmpRefTypes);
-    }
-
-    if(!isNodeInTree(server, &origin, &objectsFolderId, &refTypes)) {
+    /* Get the (cached) list of nodes that emit the event */
+    UA_EventPath *path = NULL;
+    UA_StatusCode retval = getEventPath(server, &origin, &path);
+    if(retval == UA_STATUSCODE_BADINVALIDARGUMENT) {
         UA_LOG_ERROR(server->config.logging, UA_LOGCATEGORY_USERLAND,
                      "Node for event must be in ObjectsFolder!");
-        return UA_STATUSCODE_BADINVALIDARGUMENT;
+        return retval;
     }
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* The path must not be freed while the event is processed. Setting the
+     * standard fields and evaluating the filters might modify the
+     * information model. */
+    server->eventPaths.pinned++;
 
     /* Update the standard fields of the event */
     retval = eventSetStandardFields(server, &eventNodeId, &origin, outEventId);
@@ -340,64 +638,17 @@ triggerEvent(UA_Server *server, const UA_NodeId eventNodeId,
         UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
                        "Events: Could not set the standard event fields with StatusCode %s",
                        UA_StatusCode_name(retval));
-        return retval;
-    }
-
-    /* List of nodes that emit the node. Events propagate upwards (bubble up) in
-     * the node hierarchy. */
-    UA_ExpandedNodeId *emitNodes = NULL;
-    size_t emitNodesSize = 0;
-
-    /* Add the server node to the list of nodes from which the event is emitted.
-     * The server node emits all events.
-     *
-     * Part 3, 7.17: In particular, the root notifier of a Server, the Server
-     * Object defined in Part 5, is always capable of supplying all Events from
-     * a Server and as such has implied HasEventSource References to every event
-     * source in a Server. */
-    UA_NodeId emitStartNodes[2];
-    emitStartNodes[0] = origin;
-    emitStartNodes[1] = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
-
-    /* Get all ReferenceTypes over which the events propagate */
-    UA_ReferenceTypeSet emitRefTypes;
-    UA_ReferenceTypeSet_init(&emitRefTypes);
-    for(size_t i = 0; i < EMIT_REFS_ROOT_COUNT; i++) {
-        UA_ReferenceTypeSet tmpRefTypes;
-        retval = referenceTypeIndices(server, &emitReferencesRoots[i], &tmpRefTypes, true);
-        if(retval != UA_STATUSCODE_GOOD) {
-            UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
-                           "Events: Could not create the list of references for event "
-                           "propagation with StatusCode %s", UA_StatusCode_name(retval));
-            goto cleanup;
-        }
-        emitRefTypes = UA_ReferenceTypeSet_union(emitRefTypes, tmpRefTypes);
-    }
-
-    /* Get the list of nodes in the hierarchy that emits the event. */
-    retval = browseRecursive(server, 2, emitStartNodes, UA_BROWSEDIRECTION_INVERSE,
-                             &emitRefTypes, UA_NODECLASS_UNSPECIFIED, true,
-                             &emitNodesSize, &emitNodes);
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_LOG_WARNING(server->config.logging, UA_LOGCATEGORY_SERVER,
-                       "Events: Could not create the list of nodes listening on the "
-                       "event with StatusCode %s", UA_StatusCode_name(retval));
         goto cleanup;
     }
 
     /* Add the event to the listening MonitoredItems at each relevant node */
-    for(size_t i = 0; i < emitNodesSize; i++) {
+    for(size_t i = 0; i < path->listenersSize; i++) {
         /* Get the node */
-        const UA_Node *node = UA_NODESTORE_GET(server, &emitNodes[i].nodeId);
+        const UA_Node *node =
+            UA_NODESTORE_GET(server, &path->notifiers[path->listeners[i]]);
         if(!node)
             continue;
 
-        /* Only consider objects */
-        if(node->head.nodeClass != UA_NODECLASS_OBJECT) {
-            UA_NODESTORE_RELEASE(server, node);
-            continue;
-        }
-
         /* Add event to monitoreditems */
         UA_MonitoredItem *mon = node->head.monitoredItems;
         for(; mon != NULL; mon = mon->sampling.nodeListNext) {
@@ -414,13 +665,15 @@ triggerEvent(UA_Server *server, const UA_NodeId eventNodeId,
         }
 
         UA_NODESTORE_RELEASE(server, node);
+    }
 
-        /* Add event entry in the historical database */
+    /* Add event entry in the historical database */
 #ifdef UA_ENABLE_HISTORIZING
-        if(server->config.historyDatabase.setEvent)
-            setHistoricalEvent(server, &origin, &emitNodes[i].nodeId, &eventNodeId);
-#endif
+    if(server->config.historyDatabase.setEvent) {
+        for(size_t i = 0; i < path->notifiersSize; i++)
+            setHistoricalEvent(server, &origin, &path->notifiers[i], &eventNodeId);
     }
+#endif
 
     /* Delete the node representation of the event */
     if(deleteEventNode) {
@@ -433,7 +686,7 @@ triggerEvent(UA_Server *server, const UA_NodeId eventNodeId,
     }
 
  cleanup:
-    UA_Array_delete(emitNodes, emitNodesSize, &UA_TYPES[UA_TYPES_EXPANDEDNODEID]);
+    releaseEventPaths(&server->eventPaths);
     return retval;
 }
 
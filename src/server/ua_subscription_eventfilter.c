@@ -446,16 +446,373 @@ castImplicit(const UA_Variant *in, const UA_DataType *outType, UA_Variant *out)
     return res;
 }
 
+/* Compiled Filter
+ * ---------------
+ * An EventFilter is compiled into a flat program before it is evaluated. The
+ * operands of the where-clause are decoded in advance. The
+ * SimpleAttributeOperands of the select- and where-clause are deduplicated and
+ * the BrowseName hashes of their browse paths are precomputed. So each
+ * attribute is resolved at most once per event, without constructing and
+ * translating a BrowsePath. Literals that need to be cast for a comparison
+ * keep the cast value for the next event. */
+
+typedef enum {
+    UA_FILTEROPERAND_INVALID = 0,
+    UA_FILTEROPERAND_ELEMENT,
+    UA_FILTEROPERAND_LITERAL,
+    UA_FILTEROPERAND_ATTRIBUTE
+} UA_FilterOperandKind;
+
+typedef struct {
+    UA_FilterOperandKind kind;
+    size_t index;              /* ElementOperand or attribute index */
+    const UA_Variant *literal; /* Points into the filter */
+    UA_Variant cast;           /* Cached cast of the literal */
+} UA_FilterOperand;
+
+typedef struct {
+    UA_FilterOperator op;
+    size_t operandsSize;
+    UA_FilterOperand *operands;
+} UA_FilterInstruction;
+
+typedef struct {
+    const UA_SimpleAttributeOperand *sao; /* Points into the filter */
+    UA_UInt32 *pathHashes;                /* BrowseName hash for each element */
+    UA_Boolean isCondition;               /* Indirection over the ConditionId */
+} UA_FilterAttribute;
+
+struct UA_EventFilterProgram {
+    UA_ReferenceTypeSet hierarchicalRefs; /* To follow the browse paths */
+    UA_UInt32 eventTypeHash;
+    size_t selectSize;
+    size_t *select; /* Attribute index of each select-clause */
+    size_t instructionsSize;
+    UA_FilterInstruction *instructions;
+    size_t attributesSize;
+    UA_FilterAttribute *attributes;
+};
+
+static const UA_QualifiedName eventTypeName = {0, {9, (UA_Byte*)"EventType"}};
+
+void
+UA_EventFilterProgram_delete(UA_EventFilterProgram *program) {
+    if(!program)
+        return;
+    for(size_t i = 0; i < program->instructionsSize; i++) {
+        UA_FilterInstruction *ins = &program->instructions[i];
+        for(size_t j = 0; j < ins->operandsSize; j++)
+            UA_Variant_clear(&ins->operands[j].cast);
+        UA_free(ins->operands);
+    }
+    UA_free(program->instructions);
+    for(size_t i = 0; i < program->attributesSize; i++)
+        UA_free(program->attributes[i].pathHashes);
+    UA_free(program->attributes);
+    UA_free(program->select);
+    UA_free(program);
+}
+
+/* Returns the index of the (deduplicated) attribute or SIZE_MAX */
+static size_t
+addFilterAttribute(UA_EventFilterProgram *program,
+                   const UA_SimpleAttributeOperand *sao) {
+    for(size_t i = 0; i < program->attributesSize; i++) {
+        if(UA_order(program->attributes[i].sao, sao,
+                    &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]) == UA_ORDER_EQ)
+            return i;
+    }
+
+    UA_FilterAttribute *attr = &program->attributes[program->attributesSize];
+    attr->sao = sao;
+    attr->pathHashes = NULL;
+    if(sao->browsePathSize > 0) {
+        attr->pathHashes = (UA_UInt32*)
+            UA_malloc(sizeof(UA_UInt32) * sao->browsePathSize);
+        if(!attr->pathHashes)
+            return SIZE_MAX;
+        for(size_t i = 0; i < sao->browsePathSize; i++)
+            attr->pathHashes[i] = UA_QualifiedName_hash(&sao->browsePath[i]);
+    }
+
+    /* A Condition is an indirection. Look up the target node. */
+    /* TODO: check for Branches! One Condition could have multiple Branches */
+    UA_NodeId conditionTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_CONDITIONTYPE);
+    attr->isCondition = (sao->browsePathSize == 0 &&
+                         UA_NodeId_equal(&sao->typeDefinitionId, &conditionTypeId));
+    return program->attributesSize++;
+}
+
+static UA_StatusCode
+compileOperand(UA_EventFilterProgram *program, size_t elementsSize,
+               const UA_ExtensionObject *op, UA_FilterOperand *out) {
+    out->kind = UA_FILTEROPERAND_INVALID;
+    if(op->encoding != UA_EXTENSIONOBJECT_DECODED &&
+       op->encoding != UA_EXTENSIONOBJECT_DECODED_NODELETE)
+        return UA_STATUSCODE_GOOD; /* Fails during the evaluation */
+
+    /* Result of an operator that was evaluated prior */
+    if(op->content.decoded.type == &UA_TYPES[UA_TYPES_ELEMENTOPERAND]) {
+        UA_ElementOperand *eo = (UA_ElementOperand*)op->content.decoded.data;
+        if(eo->index >= elementsSize)
+            return UA_STATUSCODE_GOOD;
+        out->kind = UA_FILTEROPERAND_ELEMENT;
+        out->index = eo->index;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Literal value */
+    if(op->content.decoded.type == &UA_TYPES[UA_TYPES_LITERALOPERAND]) {
+        UA_LiteralOperand *lo = (UA_LiteralOperand*)op->content.decoded.data;
+        out->kind = UA_FILTEROPERAND_LITERAL;
+        out->literal = &lo->value;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* SimpleAttributeOperand with a BrowsePath */
+    if(op->content.decoded.type == &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]) {
+        out->index = addFilterAttribute(program, (const UA_SimpleAttributeOperand*)
+                                        op->content.decoded.data);
+        if(out->index == SIZE_MAX)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        out->kind = UA_FILTEROPERAND_ATTRIBUTE;
+    }
+
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+compileFilter(UA_Server *server, size_t selectSize,
+              const UA_SimpleAttributeOperand *select,
+              const UA_ContentFilter *where, UA_EventFilterProgram **outProgram) {
+    if(where->elementsSize > UA_EVENTFILTER_MAXELEMENTS)
+        return UA_STATUSCODE_BADEVENTFILTERINVALID;
+
+    UA_EventFilterProgram *program = (UA_EventFilterProgram*)
+        UA_calloc(1, sizeof(UA_EventFilterProgram));
+    if(!program)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    UA_NodeId hierarchicalRefs = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    UA_StatusCode res = referenceTypeIndices(server, &hierarchicalRefs,
+                                             &program->hierarchicalRefs, true);
+    if(res != UA_STATUSCODE_GOOD)
+        goto error;
+    program->eventTypeHash = UA_QualifiedName_hash(&eventTypeName);
+
+    /* Allocate for the worst case without deduplication */
+    size_t maxAttributes = selectSize;
+    for(size_t i = 0; i < where->elementsSize; i++)
+        maxAttributes += where->elements[i].filterOperandsSize;
+    if(maxAttributes > 0) {
+        program->attributes = (UA_FilterAttribute*)
+            UA_malloc(sizeof(UA_FilterAttribute) * maxAttributes);
+        if(!program->attributes) {
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+            goto error;
+        }
+    }
+
+    /* Compile the where-clause */
+    if(where->elementsSize > 0) {
+        program->instructions = (UA_FilterInstruction*)
+            UA_calloc(where->elementsSize, sizeof(UA_FilterInstruction));
+        if(!program->instructions) {
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+            goto error;
+        }
+        program->instructionsSize = where->elementsSize;
+    }
+    for(size_t i = 0; i < where->elementsSize; i++) {
+        const UA_ContentFilterElement *elm = &where->elements[i];
+        UA_FilterInstruction *ins = &program->instructions[i];
+        if(elm->filterOperator > UA_FILTEROPERATOR_BITWISEOR) {
+            res = UA_STATUSCODE_BADFILTEROPERATORINVALID;
+            goto error;
+        }
+        ins->op = elm->filterOperator;
+        if(elm->filterOperandsSize == 0)
+            continue;
+        ins->operands = (UA_FilterOperand*)
+            UA_calloc(elm->filterOperandsSize, sizeof(UA_FilterOperand));
+        if(!ins->operands) {
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+            goto error;
+        }
+        ins->operandsSize = elm->filterOperandsSize;
+        for(size_t j = 0; j < elm->filterOperandsSize; j++) {
+            res = compileOperand(program, where->elementsSize,
+                                 &elm->filterOperands[j], &ins->operands[j]);
+            if(res != UA_STATUSCODE_GOOD)
+                goto error;
+        }
+    }
+
+    /* Compile the select-clauses */
+    if(selectSize > 0) {
+        program->select = (size_t*)UA_malloc(sizeof(size_t) * selectSize);
+        if(!program->select) {
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+            goto error;
+        }
+        program->selectSize = selectSize;
+    }
+    for(size_t i = 0; i < selectSize; i++) {
+        program->select[i] = addFilterAttribute(program, &select[i]);
+        if(program->select[i] == SIZE_MAX) {
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+            goto error;
+        }
+    }
+
+    *outProgram = program;
+    return UA_STATUSCODE_GOOD;
+
+ error:
+    UA_EventFilterProgram_delete(program);
+    return res;
+}
+
+UA_StatusCode
+UA_EventFilterProgram_compile(UA_Server *server, const UA_EventFilter *filter,
+                              UA_EventFilterProgram **outProgram) {
+    if(filter->selectClausesSize == 0)
+        return UA_STATUSCODE_BADEVENTFILTERINVALID;
+    return compileFilter(server, filter->selectClausesSize, filter->selectClauses,
+                         &filter->whereClause, outProgram);
+}
+
+UA_StatusCode
+UA_MonitoredItem_compileEventFilter(UA_Server *server, UA_MonitoredItem *mon) {
+    UA_EventFilterProgram_delete(mon->eventFilterProgram);
+    mon->eventFilterProgram = NULL;
+    const UA_ExtensionObject *filter = &mon->parameters.filter;
+    if(filter->content.decoded.type != &UA_TYPES[UA_TYPES_EVENTFILTER])
+        return UA_STATUSCODE_BADFILTERNOTALLOWED;
+    return UA_EventFilterProgram_compile(server, (const UA_EventFilter*)
+                                         filter->content.decoded.data,
+                                         &mon->eventFilterProgram);
+}
+
+/* Browse Path Resolution
+ * ~~~~~~~~~~~~~~~~~~~~~~
+ * Follow forward hierarchical references with the precomputed BrowseName
+ * hashes. The first match (depth-first) is used. */
+
+#define UA_FILTER_NODECLASSMASK \
+    (UA_NODECLASS_OBJECT | UA_NODECLASS_VARIABLE | UA_NODECLASS_OBJECTTYPE)
+
+typedef struct {
+    UA_Server *server;
+    const UA_ReferenceTypeSet *refs;
+    size_t pathSize;
+    const UA_QualifiedName *path;
+    const UA_UInt32 *pathHashes;
+    UA_NodeId *target;
+} UA_FilterPathWalk;
+
+static UA_Boolean
+walkFilterPath(UA_FilterPathWalk *pw, const UA_Node *node);
+
+static UA_Boolean
+walkFilterPathTarget(UA_FilterPathWalk *pw, UA_NodePointer targetId) {
+    if(!UA_NodePointer_isLocal(targetId))
+        return false;
+    const UA_Node *child =
+        UA_NODESTORE_GETFROMREF_SELECTIVE(pw->server, targetId,
+                                          UA_NODEATTRIBUTESMASK_NODECLASS |
+                                          UA_NODEATTRIBUTESMASK_BROWSENAME,
+                                          *pw->refs, UA_BROWSEDIRECTION_FORWARD);
+    if(!child)
+        return false;
+
+    UA_Boolean found = false;
+    if((child->head.nodeClass & UA_FILTER_NODECLASSMASK) != 0 &&
+       UA_QualifiedName_equal(&child->head.browseName, pw->path)) {
+        if(pw->pathSize == 1) {
+            found = (UA_NodeId_copy(&child->head.nodeId, pw->target) ==
+                     UA_STATUSCODE_GOOD);
+        } else {
+            UA_FilterPathWalk next = *pw;
+            next.pathSize--;
+            next.path++;
+            next.pathHashes++;
+            found = walkFilterPath(&next, child);
+        }
+    }
+
+    UA_NODESTORE_RELEASE(pw->server, child);
+    return found;
+}
+
+static void *
+walkFilterPathCallback(void *context, UA_ReferenceTarget *t) {
+    UA_FilterPathWalk *pw = (UA_FilterPathWalk*)context;
+    return (walkFilterPathTarget(pw, t->targetId)) ? pw : NULL;
+}
+
+static UA_Boolean
+walkFilterPath(UA_FilterPathWalk *pw, const UA_Node *node) {
+    for(size_t i = 0; i < node->head.referencesSize; i++) {
+        UA_NodeReferenceKind *rk = &node->head.references[i];
+        if(rk->isInverse ||
+           !UA_ReferenceTypeSet_contains(pw->refs, rk->referenceTypeIndex))
+            continue;
+        if(UA_NodeReferenceKind_iterateName(rk, *pw->pathHashes,
+                                            walkFilterPathCallback, pw))
+            return true;
+    }
+    return false;
+}
+
+static UA_StatusCode
+resolveFilterPath(UA_Server *server, const UA_EventFilterProgram *program,
+                  const UA_NodeId *origin, size_t pathSize,
+                  const UA_QualifiedName *path, const UA_UInt32 *pathHashes,
+                  UA_NodeId *target) {
+    if(pathSize > UA_MAX_TREE_RECURSE)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    const UA_Node *node =
+        UA_NODESTORE_GET_SELECTIVE(server, origin, UA_NODEATTRIBUTESMASK_NODECLASS,
+                                   program->hierarchicalRefs,
+                                   UA_BROWSEDIRECTION_FORWARD);
+    if(!node)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    UA_FilterPathWalk pw = {server, &program->hierarchicalRefs,
+                            pathSize, path, pathHashes, target};
+    UA_Boolean found = walkFilterPath(&pw, node);
+    UA_NODESTORE_RELEASE(server, node);
+    return (found) ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADNOTFOUND;
+}
+
 /* Filter Evaluation
  * ----------------- */
 
+/* Attributes are resolved at most once during the evaluation */
+typedef struct {
+    UA_Boolean resolved;
+    UA_StatusCode status;
+    UA_Variant value;
+} UA_FilterAttributeValue;
+
 typedef struct {
     UA_Server *server;
     UA_Session *session;
-    const UA_NodeId *eventNode;
-    const UA_ContentFilter *filter;
-    UA_ContentFilterResult *filterResult;
+    const UA_NodeId *eventNode; /* NULL for a stored event */
+    UA_EventFilterProgram *program;
+    UA_ContentFilterResult *filterResult; /* Can be NULL */
     UA_Variant results[UA_EVENTFILTER_MAXELEMENTS];
+    UA_FilterAttributeValue *attributes;
+
+    /* The EventType of the event node (resolved on demand) */
+    UA_Boolean eventTypeResolved;
+    UA_StatusCode eventTypeStatus;
+    UA_NodeId eventType;
+
+    /* Stored event. The fields were recorded with the storedSelect clauses. */
+    size_t storedSelectSize;
+    const UA_SimpleAttributeOperand *storedSelect;
+    const UA_EventFieldList *storedEvent;
 
     /* The stack contains temporary variants. Cleaned up after the evaluation of
      * each operator. */
@@ -467,59 +824,97 @@ typedef struct {
  * ~~~~~~~~~~~~~~~~~
  * Methods that all resolve an operator operand to a Variant. */
 
+/* Look up the field that was recorded for the same attribute. A field that was
+ * recorded without an IndexRange can be used for any IndexRange. */
+static UA_StatusCode
+resolveStoredOperand(UA_FilterEvalContext *ctx,
+                     const UA_SimpleAttributeOperand *sao,
+                     UA_Variant *value) {
+    const UA_EventFieldList *event = ctx->storedEvent;
+    for(size_t i = 0; i < ctx->storedSelectSize && i < event->eventFieldsSize; i++) {
+        const UA_SimpleAttributeOperand *stored = &ctx->storedSelect[i];
+        if(stored->attributeId != sao->attributeId ||
+           stored->browsePathSize != sao->browsePathSize)
+            continue;
+        if(sao->browsePathSize == 0 &&
+           !UA_NodeId_equal(&stored->typeDefinitionId, &sao->typeDefinitionId))
+            continue;
+        size_t j = 0;
+        for(; j < sao->browsePathSize; j++) {
+            if(!UA_QualifiedName_equal(&stored->browsePath[j], &sao->browsePath[j]))
+                break;
+        }
+        if(j < sao->browsePathSize)
+            continue;
+
+        /* Found the field */
+        const UA_Variant *field = &event->eventFields[i];
+        if(UA_String_equal(&stored->indexRange, &sao->indexRange)) {
+            if(UA_Variant_isEmpty(field))
+                return UA_STATUSCODE_BADNODATAAVAILABLE;
+            return UA_Variant_copy(field, value);
+        }
+        if(stored->indexRange.length > 0)
+            continue;
+        if(UA_Variant_isEmpty(field))
+            return UA_STATUSCODE_BADNODATAAVAILABLE;
+        UA_NumericRange range;
+        UA_StatusCode res = UA_NumericRange_parse(&range, sao->indexRange);
+        UA_CHECK_STATUS(res, return res);
+        res = UA_Variant_copyRange(field, value, range);
+        UA_free(range.dimensions);
+        return res;
+    }
+    return UA_STATUSCODE_BADNOTFOUND;
+}
+
 /* Part 4, 7.4.4.5 SimpleAttributeOperand: The clause can point to any attribute
  * of nodes. Either a child of the event node and also the event type. */
 static UA_StatusCode
-resolveSimpleAttributeOperand(UA_Server *server, UA_Session *session,
-                              const UA_NodeId *origin,
-                              const UA_SimpleAttributeOperand *sao,
+resolveSimpleAttributeOperand(UA_FilterEvalContext *ctx,
+                              const UA_FilterAttribute *attr,
                               UA_Variant *value) {
+    const UA_SimpleAttributeOperand *sao = attr->sao;
+    if(!ctx->eventNode)
+        return resolveStoredOperand(ctx, sao, value);
+
     /* Prepare the ReadValueId */
     UA_ReadValueId rvi;
     UA_ReadValueId_init(&rvi);
     rvi.indexRange = sao->indexRange;
     rvi.attributeId = sao->attributeId;
 
-    /* Read the value */
-    UA_DataValue v;
+    /* Get the target node */
+    UA_NodeId target = UA_NODEID_NULL;
+    UA_StatusCode res = UA_STATUSCODE_GOOD;
     if(sao->browsePathSize == 0) {
         /* If this list (browsePath) is empty, the Node is the instance of the
          * TypeDefinition. (Part 4, 7.4.4.5) */
-        rvi.nodeId = *origin;
-
-        /* A Condition is an indirection. Look up the target node. */
-        /* TODO: check for Branches! One Condition could have multiple Branches */
-        UA_NodeId conditionTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_CONDITIONTYPE);
-        if(UA_NodeId_equal(&sao->typeDefinitionId, &conditionTypeId)) {
+        rvi.nodeId = *ctx->eventNode;
+        if(attr->isCondition) {
 #ifdef UA_ENABLE_SUBSCRIPTIONS_ALARMS_CONDITIONS
-            UA_StatusCode res = UA_getConditionId(server, origin, &rvi.nodeId);
+            res = UA_getConditionId(ctx->server, ctx->eventNode, &target);
             UA_CHECK_STATUS(res, return res);
+            rvi.nodeId = target;
 #else
             return UA_STATUSCODE_BADNOTSUPPORTED;
 #endif
         }
-
-        v = readWithSession(server, session, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
     } else {
         /* Resolve the browse path, starting from the event-source (and not the
          * typeDefinitionId). */
-        UA_BrowsePathResult bpr =
-            browseSimplifiedBrowsePath(server, *origin,
-                                       sao->browsePathSize, sao->browsePath);
-        if(bpr.targetsSize == 0 && bpr.statusCode == UA_STATUSCODE_GOOD)
-            bpr.statusCode = UA_STATUSCODE_BADNOTFOUND;
-        if(bpr.statusCode != UA_STATUSCODE_GOOD) {
-            UA_StatusCode res = bpr.statusCode;
-            UA_BrowsePathResult_clear(&bpr);
-            return res;
-        }
-
-        /* Use the first match */
-        rvi.nodeId = bpr.targets[0].targetId.nodeId;
-        v = readWithSession(server, session, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
-        UA_BrowsePathResult_clear(&bpr);
+        res = resolveFilterPath(ctx->server, ctx->program, ctx->eventNode,
+                                sao->browsePathSize, sao->browsePath,
+                                attr->pathHashes, &target);
+        UA_CHECK_STATUS(res, return res);
+        rvi.nodeId = target;
     }
 
+    /* Read the value */
+    UA_DataValue v = readWithSession(ctx->server, ctx->session, &rvi,
+                                     UA_TIMESTAMPSTORETURN_NEITHER);
+    UA_NodeId_clear(&target);
+
     /* Validate the result */
     if(v.status != UA_STATUSCODE_GOOD) {
         UA_Variant_clear(&v.value);
@@ -533,37 +928,96 @@ resolveSimpleAttributeOperand(UA_Server *server, UA_Session *session,
     return UA_STATUSCODE_GOOD;
 }
 
-static UA_StatusCode
-resolveOperand(UA_FilterEvalContext *ctx, UA_ExtensionObject *op, UA_Variant *out) {
-    if(op->encoding != UA_EXTENSIONOBJECT_DECODED &&
-       op->encoding != UA_EXTENSIONOBJECT_DECODED_NODELETE)
-        return UA_STATUSCODE_BADFILTEROPERATORUNSUPPORTED;
+/* Resolve on first use. The returned variant remains owned by the context. */
+static UA_FilterAttributeValue *
+resolveFilterAttribute(UA_FilterEvalContext *ctx, size_t index) {
+    UA_FilterAttributeValue *av = &ctx->attributes[index];
+    if(!av->resolved) {
+        av->status = resolveSimpleAttributeOperand(ctx, &ctx->program->attributes[index],
+                                                   &av->value);
+        av->resolved = true;
+    }
+    return av;
+}
 
-    /* Result of an operator that was evaluated prior */
-    if(op->content.decoded.type == &UA_TYPES[UA_TYPES_ELEMENTOPERAND]) {
-        UA_ElementOperand *eo = (UA_ElementOperand*)op->content.decoded.data;
-        *out = ctx->results[eo->index];
+static UA_StatusCode
+resolveOperand(UA_FilterEvalContext *ctx, const UA_FilterOperand *op,
+               UA_Variant *out) {
+    switch(op->kind) {
+    case UA_FILTEROPERAND_ELEMENT:
+        /* Result of an operator that was evaluated prior */
+        *out = ctx->results[op->index];
         out->storageType = UA_VARIANT_DATA_NODELETE;
         return UA_STATUSCODE_GOOD;
-    }
-
-    /* Literal value */
-    if(op->content.decoded.type == &UA_TYPES[UA_TYPES_LITERALOPERAND]) {
-        UA_LiteralOperand *lo = (UA_LiteralOperand*)op->content.decoded.data;
-        *out = lo->value;
+    case UA_FILTEROPERAND_LITERAL:
+        *out = *op->literal;
+        out->storageType = UA_VARIANT_DATA_NODELETE;
+        return UA_STATUSCODE_GOOD;
+    case UA_FILTEROPERAND_ATTRIBUTE: {
+        UA_FilterAttributeValue *av = resolveFilterAttribute(ctx, op->index);
+        if(av->status != UA_STATUSCODE_GOOD)
+            return av->status;
+        *out = av->value;
         out->storageType = UA_VARIANT_DATA_NODELETE;
         return UA_STATUSCODE_GOOD;
     }
-
-    /* SimpleAttributeOperand with a BrowsePath */
-    if(op->content.decoded.type == &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]) {
-        UA_SimpleAttributeOperand *sao =
-            (UA_SimpleAttributeOperand*)op->content.decoded.data;
-        return resolveSimpleAttributeOperand(ctx->server, ctx->session,
-                                             ctx->eventNode, sao, out);
+    default:
+        return UA_STATUSCODE_BADFILTEROPERATORUNSUPPORTED;
     }
+}
 
-    return UA_STATUSCODE_BADFILTEROPERATORUNSUPPORTED;
+/* The EventType property is read at most once during the evaluation */
+static UA_StatusCode
+getEventType(UA_FilterEvalContext *ctx, const UA_NodeId **outEventType) {
+    if(!ctx->eventTypeResolved && !ctx->eventNode) {
+        ctx->eventTypeResolved = true;
+        UA_SimpleAttributeOperand sao;
+        UA_SimpleAttributeOperand_init(&sao);
+        sao.typeDefinitionId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
+        sao.browsePathSize = 1;
+        sao.browsePath = (UA_QualifiedName*)(uintptr_t)&eventTypeName;
+        sao.attributeId = UA_ATTRIBUTEID_VALUE;
+        UA_Variant v;
+        UA_Variant_init(&v);
+        ctx->eventTypeStatus = resolveStoredOperand(ctx, &sao, &v);
+        if(ctx->eventTypeStatus == UA_STATUSCODE_GOOD &&
+           !UA_Variant_hasScalarType(&v, &UA_TYPES[UA_TYPES_NODEID]))
+            ctx->eventTypeStatus = UA_STATUSCODE_BADTYPEMISMATCH;
+        if(ctx->eventTypeStatus == UA_STATUSCODE_GOOD) {
+            ctx->eventType = *(UA_NodeId*)v.data;
+            UA_free(v.data); /* The NodeId content was moved out */
+        } else {
+            UA_Variant_clear(&v);
+        }
+    }
+    if(!ctx->eventTypeResolved) {
+        ctx->eventTypeResolved = true;
+        UA_NodeId propId;
+        ctx->eventTypeStatus =
+            resolveFilterPath(ctx->server, ctx->program, ctx->eventNode, 1,
+                              &eventTypeName, &ctx->program->eventTypeHash, &propId);
+        if(ctx->eventTypeStatus == UA_STATUSCODE_GOOD) {
+            UA_Variant v;
+            UA_Variant_init(&v);
+            ctx->eventTypeStatus =
+                readWithReadValue(ctx->server, &propId, UA_ATTRIBUTEID_VALUE, &v);
+            UA_NodeId_clear(&propId);
+            if(ctx->eventTypeStatus == UA_STATUSCODE_GOOD &&
+               !UA_Variant_hasScalarType(&v, &UA_TYPES[UA_TYPES_NODEID])) {
+                UA_LOG_WARNING(ctx->server->config.logging, UA_LOGCATEGORY_SERVER,
+                               "EventType has an invalid type.");
+                ctx->eventTypeStatus = UA_STATUSCODE_BADINTERNALERROR;
+            }
+            if(ctx->eventTypeStatus == UA_STATUSCODE_GOOD) {
+                ctx->eventType = *(UA_NodeId*)v.data;
+                UA_free(v.data); /* The NodeId content was moved out */
+            } else {
+                UA_Variant_clear(&v);
+            }
+        }
+    }
+    *outEventType = &ctx->eventType;
+    return ctx->eventTypeStatus;
 }
 
 /* The operandIndex is within the operator arguments, not the operand index for
@@ -571,6 +1025,8 @@ resolveOperand(UA_FilterEvalContext *ctx, UA_ExtensionObject *op, UA_Variant *ou
 static UA_StatusCode
 setOperandError(UA_FilterEvalContext *ctx, size_t elementIndex,
                 size_t operandIndex, UA_StatusCode statusCode) {
+    if(!ctx->filterResult)
+        return statusCode;
     UA_ContentFilterElementResult *res = &ctx->filterResult->elementResults[elementIndex];
     res->operandStatusCodes[operandIndex] = statusCode;
     /* The operator status is set globally in a single location upwards the call chain
@@ -583,48 +1039,37 @@ setOperandError(UA_FilterEvalContext *ctx, size_t elementIndex,
 
 static UA_StatusCode
 ofTypeOperator(UA_FilterEvalContext *ctx, size_t index) {
-    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
-    UA_assert(elm->filterOperandsSize == 1);
+    const UA_FilterInstruction *ins = &ctx->program->instructions[index];
+    UA_assert(ins->operandsSize == 1);
 
     /* Get the operand. Must be a literal NodeId */
     UA_Variant *op0 = &ctx->stack[ctx->top++];
-    UA_StatusCode res = resolveOperand(ctx, &elm->filterOperands[0], op0);
+    UA_StatusCode res = resolveOperand(ctx, &ins->operands[0], op0);
     if(res != UA_STATUSCODE_GOOD || !UA_Variant_hasScalarType(op0, &UA_TYPES[UA_TYPES_NODEID]))
         return setOperandError(ctx, index, 0, UA_STATUSCODE_BADFILTEROPERATORUNSUPPORTED);
 
     /* Read the event type */
-    UA_Variant eventTypeVar;
-    UA_Variant_init(&eventTypeVar);
-    const UA_NodeId *operandTypeId = (const UA_NodeId *)op0->data;
-    res = readObjectProperty(ctx->server, *ctx->eventNode,
-                             UA_QUALIFIEDNAME(0, "EventType"), &eventTypeVar);
+    const UA_NodeId *eventTypeId;
+    res = getEventType(ctx, &eventTypeId);
     UA_CHECK_STATUS(res, return res);
 
-    if(!UA_Variant_hasScalarType(&eventTypeVar, &UA_TYPES[UA_TYPES_NODEID])) {
-        UA_LOG_WARNING(ctx->server->config.logging, UA_LOGCATEGORY_SERVER,
-                       "EventType has an invalid type.");
-        UA_Variant_clear(&eventTypeVar);
-        return UA_STATUSCODE_BADINTERNALERROR;
-    }
-
     /* Check if the eventtype is equal to the operand or a subtype of it */
-    const UA_NodeId *eventTypeId = (UA_NodeId*)eventTypeVar.data;
+    const UA_NodeId *operandTypeId = (const UA_NodeId *)op0->data;
     UA_Boolean ofType = isNodeInTree_singleRef(ctx->server, eventTypeId, operandTypeId,
                                                UA_REFERENCETYPEINDEX_HASSUBTYPE);
     ctx->results[index] = t2v(ofType ? UA_TERNARY_TRUE : UA_TERNARY_FALSE);
-    UA_Variant_clear(&eventTypeVar);
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
 andOperator(UA_FilterEvalContext *ctx, size_t index) {
-    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
-    UA_assert(elm->filterOperandsSize == 2);
+    const UA_FilterInstruction *ins = &ctx->program->instructions[index];
+    UA_assert(ins->operandsSize == 2);
     UA_Variant *op0 = &ctx->stack[ctx->top++];
-    UA_StatusCode res = resolveOperand(ctx, &elm->filterOperands[0], op0);
+    UA_StatusCode res = resolveOperand(ctx, &ins->operands[0], op0);
     UA_CHECK_STATUS(res, return res);
     UA_Variant *op1 = &ctx->stack[ctx->top++];
-    res = resolveOperand(ctx, &elm->filterOperands[1], op1);
+    res = resolveOperand(ctx, &ins->operands[1], op1);
     UA_CHECK_STATUS(res, return res);
     ctx->results[index] = t2v(UA_Ternary_and(v2t(op0), v2t(op1)));
     return UA_STATUSCODE_GOOD;
@@ -632,13 +1077,13 @@ andOperator(UA_FilterEvalContext *ctx, size_t index) {
 
 static UA_StatusCode
 orOperator(UA_FilterEvalContext *ctx, size_t index) {
-    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
-    UA_assert(elm->filterOperandsSize == 2);
+    const UA_FilterInstruction *ins = &ctx->program->instructions[index];
+    UA_assert(ins->operandsSize == 2);
     UA_Variant *op0 = &ctx->stack[ctx->top++];
-    UA_StatusCode res = resolveOperand(ctx, &elm->filterOperands[0], op0);
+    UA_StatusCode res = resolveOperand(ctx, &ins->operands[0], op0);
     UA_CHECK_STATUS(res, return res);
     UA_Variant *op1 = &ctx->stack[ctx->top++];
-    res = resolveOperand(ctx, &elm->filterOperands[1], op1);
+    res = resolveOperand(ctx, &ins->operands[1], op1);
     UA_CHECK_STATUS(res, return res);
     ctx->results[index] = t2v(UA_Ternary_or(v2t(op0), v2t(op1)));
     return UA_STATUSCODE_GOOD;
@@ -646,10 +1091,10 @@ orOperator(UA_FilterEvalContext *ctx, size_t index) {
 
 static UA_StatusCode
 notOperator(UA_FilterEvalContext *ctx, size_t index) {
-    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
-    UA_assert(elm->filterOperandsSize == 1);
+    const UA_FilterInstruction *ins = &ctx->program->instructions[index];
+    UA_assert(ins->operandsSize == 1);
     UA_Variant *op0 = &ctx->stack[ctx->top++];
-    UA_StatusCode res = resolveOperand(ctx, &elm->filterOperands[0], op0);
+    UA_StatusCode res = resolveOperand(ctx, &ins->operands[0], op0);
     UA_CHECK_STATUS(res, return res);
     ctx->results[index] = t2v(UA_Ternary_not(v2t(op0)));
     return UA_STATUSCODE_GOOD;
@@ -660,15 +1105,15 @@ notOperator(UA_FilterEvalContext *ctx, size_t index) {
 static UA_StatusCode
 castResolveOperands(UA_FilterEvalContext *ctx, size_t index, UA_Boolean setError) {
     /* Enough space on the stack left? */
-    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
-    if(ctx->top + elm->filterOperandsSize > UA_EVENTFILTER_MAXOPERANDS)
+    UA_FilterInstruction *ins = &ctx->program->instructions[index];
+    if(ctx->top + ins->operandsSize > UA_EVENTFILTER_MAXOPERANDS)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
     /* Resolve all operands */
     UA_assert(ctx->top == 0); /* Assume the stack is empty */
     UA_StatusCode res = UA_STATUSCODE_GOOD;
-    for(size_t i = 0; i < elm->filterOperandsSize; i++) {
-        res = resolveOperand(ctx, &elm->filterOperands[i], &ctx->stack[ctx->top++]);
+    for(size_t i = 0; i < ins->operandsSize; i++) {
+        res = resolveOperand(ctx, &ins->operands[i], &ctx->stack[ctx->top++]);
         UA_CHECK_STATUS(res, return res);
     }
     UA_assert(ctx->top > 0); /* Assume the stack is no longer empty */
@@ -685,6 +1130,27 @@ castResolveOperands(UA_FilterEvalContext *ctx, size_t index, UA_Boolean setError
     /* Cast the operands. Put the result in the same location on the stack. */
     for(size_t pos = 0; pos < ctx->top; pos++) {
         UA_Variant orig = ctx->stack[pos];
+        if(orig.type == targetType && UA_Variant_isScalar(&orig))
+            continue; /* No casting necessary */
+
+        /* Literals are cast once and then reused */
+        UA_FilterOperand *op = &ins->operands[pos];
+        if(op->kind == UA_FILTEROPERAND_LITERAL && !UA_Variant_isEmpty(&orig)) {
+            if(op->cast.type != targetType) {
+                UA_Variant_clear(&op->cast);
+                res = castImplicit(&orig, targetType, &op->cast);
+                if(res != UA_STATUSCODE_GOOD)
+                    return (setError) ? setOperandError(ctx, index, pos, res) : res;
+                if(op->cast.data == orig.data)
+                    UA_Variant_init(&op->cast); /* Don't keep a NODELETE copy */
+            }
+            if(op->cast.type == targetType) {
+                ctx->stack[pos] = op->cast;
+                ctx->stack[pos].storageType = UA_VARIANT_DATA_NODELETE;
+                continue;
+            }
+        }
+
         res = castImplicit(&orig, targetType, &ctx->stack[pos]);
         if(res != UA_STATUSCODE_GOOD)
             return (setError) ? setOperandError(ctx, index, pos, res) : res;
@@ -702,7 +1168,7 @@ castResolveOperands(UA_FilterEvalContext *ctx, size_t index, UA_Boolean setError
 
 static UA_StatusCode
 compareOperator(UA_FilterEvalContext *ctx, size_t index, UA_FilterOperator op) {
-    UA_assert(ctx->filter->elements[index].filterOperandsSize == 2);
+    UA_assert(ctx->program->instructions[index].operandsSize == 2);
 
     /* Resolve and cast the operands. A failed casting results in FALSE. Note
      * that operands could cast to NULL. */
@@ -783,7 +1249,7 @@ lteOperator(UA_FilterEvalContext *ctx, size_t index) {
 
 static UA_StatusCode
 bitwiseOperator(UA_FilterEvalContext *ctx, size_t index, UA_FilterOperator op) {
-    UA_assert(ctx->filter->elements[index].filterOperandsSize == 2);
+    UA_assert(ctx->program->instructions[index].operandsSize == 2);
 
     /* Resolve and cast the operands. Note that operands could cast to NULL. */
     UA_assert(ctx->top == 0); /* Assume the stack is empty */
@@ -825,7 +1291,7 @@ bitwiseOrOperator(UA_FilterEvalContext *ctx, size_t index) {
 
 static UA_StatusCode
 betweenOperator(UA_FilterEvalContext *ctx, size_t index) {
-    UA_assert(ctx->filter->elements[index].filterOperandsSize == 3);
+    UA_assert(ctx->program->instructions[index].operandsSize == 3);
 
     /* If no implicit conversion is available and the operands are of different
      * types, the particular result is FALSE. */
@@ -855,15 +1321,15 @@ betweenOperator(UA_FilterEvalContext *ctx, size_t index) {
 
 static UA_StatusCode
 inListOperator(UA_FilterEvalContext *ctx, size_t index) {
-    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
-    UA_assert(elm->filterOperandsSize >= 2);
+    const UA_FilterInstruction *ins = &ctx->program->instructions[index];
+    UA_assert(ins->operandsSize >= 2);
     UA_Boolean found = false;
     UA_Variant *op0 = &ctx->stack[ctx->top++];
     UA_Variant *op1 = &ctx->stack[ctx->top++];
-    UA_StatusCode res = resolveOperand(ctx, &elm->filterOperands[0], op0);
+    UA_StatusCode res = resolveOperand(ctx, &ins->operands[0], op0);
     UA_CHECK_STATUS(res, return res);
-    for(size_t i = 1; i < elm->filterOperandsSize && !found; i++) {
-        res = resolveOperand(ctx, &elm->filterOperands[i], op1);
+    for(size_t i = 1; i < ins->operandsSize && !found; i++) {
+        res = resolveOperand(ctx, &ins->operands[i], op1);
         if(res != UA_STATUSCODE_GOOD)
             continue;
         if(op0->type == op1->type && UA_equal(op0->data, op1->data, op0->type))
@@ -876,10 +1342,10 @@ inListOperator(UA_FilterEvalContext *ctx, size_t index) {
 
 static UA_StatusCode
 isNullOperator(UA_FilterEvalContext *ctx, size_t index) {
-    const UA_ContentFilterElement *elm = &ctx->filter->elements[index];
-    UA_assert(elm->filterOperandsSize == 1);
+    const UA_FilterInstruction *ins = &ctx->program->instructions[index];
+    UA_assert(ins->operandsSize == 1);
     UA_Variant *op0 = &ctx->stack[ctx->top++];
-    UA_StatusCode res = resolveOperand(ctx, &elm->filterOperands[0], op0);
+    UA_StatusCode res = resolveOperand(ctx, &ins->operands[0], op0);
     UA_CHECK_STATUS(res, return res);
     ctx->results[index] = t2v(UA_Variant_isEmpty(op0) ? UA_TERNARY_TRUE : UA_TERNARY_FALSE);
     return UA_STATUSCODE_GOOD;
@@ -920,102 +1386,203 @@ static const UA_FilterOperatorJumptableElement operatorJumptable[18] = {
     {bitwiseOrOperator, 2, 2}
 };
 
-UA_StatusCode
-evaluateWhereClause(UA_Server *server, UA_Session *session, const UA_NodeId *eventNode,
-                    const UA_ContentFilter *contentFilter,
-                    UA_ContentFilterResult *contentFilterResult) {
-    UA_LOCK_ASSERT(&server->serviceMutex);
-
+static UA_StatusCode
+evaluateWhere(UA_FilterEvalContext *ctx) {
     /* An empty filter always succeeds */
-    if(contentFilter->elementsSize == 0)
+    UA_EventFilterProgram *program = ctx->program;
+    if(program->instructionsSize == 0)
         return UA_STATUSCODE_GOOD;
 
-    /* Prepare the context */
-    UA_FilterEvalContext ctx;
-    ctx.filterResult = contentFilterResult;
-    ctx.filter = contentFilter;
-    ctx.server = server;
-    ctx.session = session;
-    ctx.eventNode = eventNode;
-    ctx.top = 0;
-
     /* Pacify some compilers by initializing the first result */
-    UA_Variant_init(&ctx.results[0]);
+    UA_Variant_init(&ctx->results[0]);
 
     /* Evaluate the filter. Iterate backwards over the filter elements and
      * resolve each. This ensures that all element-index operands point to an
      * evaluated element. */
     UA_StatusCode res = UA_STATUSCODE_GOOD;
-    int i = (int)contentFilter->elementsSize - 1;
+    int i = (int)program->instructionsSize - 1;
     for(; i >= 0; i--) {
-        UA_ContentFilterElement *cfe = &contentFilter->elements[i];
-        res = operatorJumptable[cfe->filterOperator].operatorMethod(&ctx, (size_t)i);
-        for(size_t j = 0; j < ctx.top; j++)
-            UA_Variant_clear(&ctx.stack[j]); /* clean up the stack */
-        ctx.top = 0;
+        UA_FilterInstruction *ins = &program->instructions[i];
+        res = operatorJumptable[ins->op].operatorMethod(ctx, (size_t)i);
+        for(size_t j = 0; j < ctx->top; j++)
+            UA_Variant_clear(&ctx->stack[j]); /* clean up the stack */
+        ctx->top = 0;
         if(res != UA_STATUSCODE_GOOD)
             break;
     }
 
     /* The filter matches if the operator at the first position evaluates to TRUE */
-    if(res == UA_STATUSCODE_GOOD && v2t(&ctx.results[0]) != UA_TERNARY_TRUE)
+    if(res == UA_STATUSCODE_GOOD && v2t(&ctx->results[0]) != UA_TERNARY_TRUE)
         res = UA_STATUSCODE_BADNOMATCH;
 
     /* Clean up the element result variants */
-    for(int j = (int)contentFilter->elementsSize - 1; j > i; j--)
-        UA_Variant_clear(&ctx.results[j]);
+    for(int j = (int)program->instructionsSize - 1; j > i; j--)
+        UA_Variant_clear(&ctx->results[j]);
     return res;
 }
 
 static UA_Boolean
-isValidEvent(UA_Server *server, const UA_NodeId *validEventParent,
-             const UA_NodeId *eventId) {
-    UA_LOCK_ASSERT(&server->serviceMutex);
-
-    /* Find the eventType variableNode */
-    UA_QualifiedName findName = UA_QUALIFIEDNAME(0, "EventType");
-    UA_BrowsePathResult bpr = browseSimplifiedBrowsePath(server, *eventId, 1, &findName);
-    if(bpr.statusCode != UA_STATUSCODE_GOOD || bpr.targetsSize < 1) {
-        UA_BrowsePathResult_clear(&bpr);
-        return false;
-    }
-
-    /* Get the EventType Property Node */
-    UA_Variant tOutVariant;
-    UA_Variant_init(&tOutVariant);
-    /* Read the Value of EventType Property Node (the Value should be a NodeId) */
-    UA_StatusCode retval = readWithReadValue(server, &bpr.targets[0].targetId.nodeId,
-                                             UA_ATTRIBUTEID_VALUE, &tOutVariant);
-    if(retval != UA_STATUSCODE_GOOD ||
-       !UA_Variant_hasScalarType(&tOutVariant, &UA_TYPES[UA_TYPES_NODEID])) {
-        UA_BrowsePathResult_clear(&bpr);
+isValidEvent(UA_FilterEvalContext *ctx, const UA_NodeId *validEventParent) {
+    /* Get the EventType */
+    const UA_NodeId *tEventType;
+    if(getEventType(ctx, &tEventType) != UA_STATUSCODE_GOOD)
         return false;
-    }
-
-    const UA_NodeId *tEventType = (UA_NodeId*)tOutVariant.data;
 
     /* Check whether the EventType is a Subtype of CondtionType (Part 9 first
      * implementation) */
     UA_NodeId conditionTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_CONDITIONTYPE);
     if(UA_NodeId_equal(validEventParent, &conditionTypeId) &&
-       isNodeInTree_singleRef(server, tEventType, &conditionTypeId,
-                              UA_REFERENCETYPEINDEX_HASSUBTYPE)) {
-        UA_BrowsePathResult_clear(&bpr);
-        UA_Variant_clear(&tOutVariant);
+       isNodeInTree_singleRef(ctx->server, tEventType, &conditionTypeId,
+                              UA_REFERENCETYPEINDEX_HASSUBTYPE))
         return true;
-    }
 
     /* EventType is not a Subtype of CondtionType (ConditionId Clause won't be
      * present in Events, which are not Conditions) */
     /* Check whether Valid Event other than Conditions */
     UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
-    UA_Boolean isSubtypeOfBaseEvent =
-        isNodeInTree_singleRef(server, tEventType, &baseEventTypeId,
-                               UA_REFERENCETYPEINDEX_HASSUBTYPE);
+    return isNodeInTree_singleRef(ctx->server, tEventType, &baseEventTypeId,
+                                  UA_REFERENCETYPEINDEX_HASSUBTYPE);
+}
+
+/* Apply the select-clauses. The overall filter can succeed even if a single
+ * select-field cannot be resolved. */
+static void
+evaluateSelect(UA_FilterEvalContext *ctx, UA_EventFieldList *efl,
+               UA_StatusCode *selectResults) {
+    UA_EventFilterProgram *program = ctx->program;
+    UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
+    for(size_t i = 0; i < program->selectSize; i++) {
+        size_t attrIndex = program->select[i];
+        const UA_SimpleAttributeOperand *sc = program->attributes[attrIndex].sao;
+
+        /* Check if the browsePath is BaseEventType, in which case nothing more
+         * needs to be checked */
+        if(!UA_NodeId_equal(&sc->typeDefinitionId, &baseEventTypeId) &&
+           !isValidEvent(ctx, &sc->typeDefinitionId)) {
+            UA_Variant_init(&efl->eventFields[i]);
+            /* EventFilterResult currently isn't being used
+               notification->result.selectClauseResults[i] =
+                   UA_STATUSCODE_BADTYPEDEFINITIONINVALID; */
+            continue;
+        }
+
+        /* Lookup the field */
+        UA_FilterAttributeValue *av = resolveFilterAttribute(ctx, attrIndex);
+        if(selectResults)
+            selectResults[i] = av->status;
+        if(av->status != UA_STATUSCODE_GOOD)
+            continue;
+
+        /* Move the value out if it is not used by a later select-clause */
+        UA_Boolean usedLater = false;
+        for(size_t j = i + 1; j < program->selectSize && !usedLater; j++)
+            usedLater = (program->select[j] == attrIndex);
+        if(usedLater) {
+            UA_Variant_copy(&av->value, &efl->eventFields[i]);
+        } else {
+            efl->eventFields[i] = av->value;
+            UA_Variant_init(&av->value);
+        }
+    }
+}
+
+#define UA_FILTER_STACKATTRIBUTES 16
+
+static void
+initEvalContext(UA_FilterEvalContext *ctx, UA_Server *server, UA_Session *session,
+                UA_EventFilterProgram *program, const UA_NodeId *eventNode,
+                UA_ContentFilterResult *whereResult) {
+    ctx->server = server;
+    ctx->session = session;
+    ctx->eventNode = eventNode;
+    ctx->program = program;
+    ctx->filterResult = whereResult;
+    ctx->eventTypeResolved = false;
+    ctx->eventTypeStatus = UA_STATUSCODE_GOOD;
+    UA_NodeId_init(&ctx->eventType);
+    ctx->storedSelectSize = 0;
+    ctx->storedSelect = NULL;
+    ctx->storedEvent = NULL;
+    ctx->top = 0;
+}
+
+static UA_StatusCode
+evaluateContext(UA_FilterEvalContext *ctx, UA_EventFieldList *efl,
+                UA_StatusCode *selectResults) {
+    UA_LOCK_ASSERT(&ctx->server->serviceMutex);
+
+    /* Resolved attribute values. On the stack for small filters. */
+    UA_EventFilterProgram *program = ctx->program;
+    UA_FilterAttributeValue attributes[UA_FILTER_STACKATTRIBUTES];
+    ctx->attributes = attributes;
+    if(program->attributesSize > UA_FILTER_STACKATTRIBUTES) {
+        ctx->attributes = (UA_FilterAttributeValue*)
+            UA_malloc(sizeof(UA_FilterAttributeValue) * program->attributesSize);
+        if(!ctx->attributes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    memset(ctx->attributes, 0, sizeof(UA_FilterAttributeValue) * program->attributesSize);
+
+    /* Evaluate the where filter. Do we event need to consider the event? */
+    UA_StatusCode res = evaluateWhere(ctx);
+    if(res == UA_STATUSCODE_GOOD && efl)
+        evaluateSelect(ctx, efl, selectResults);
+
+    /* Clean up */
+    for(size_t i = 0; i < program->attributesSize; i++)
+        UA_Variant_clear(&ctx->attributes[i].value);
+    if(ctx->attributes != attributes)
+        UA_free(ctx->attributes);
+    UA_NodeId_clear(&ctx->eventType);
+    return res;
+}
+
+static UA_StatusCode
+evaluateEventFilter(UA_Server *server, UA_Session *session,
+                    UA_EventFilterProgram *program, const UA_NodeId *eventNode,
+                    UA_ContentFilterResult *whereResult,
+                    UA_EventFieldList *efl, UA_StatusCode *selectResults) {
+    UA_FilterEvalContext ctx;
+    initEvalContext(&ctx, server, session, program, eventNode, whereResult);
+    return evaluateContext(&ctx, efl, selectResults);
+}
+
+UA_StatusCode
+UA_EventFilterProgram_evaluate(UA_Server *server, UA_Session *session,
+                               UA_EventFilterProgram *program,
+                               const UA_NodeId *eventNode,
+                               UA_EventFieldList *efl) {
+    UA_EventFieldList_init(efl);
+    efl->eventFields = (UA_Variant *)
+        UA_Array_new(program->selectSize, &UA_TYPES[UA_TYPES_VARIANT]);
+    if(!efl->eventFields)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    efl->eventFieldsSize = program->selectSize;
+
+    UA_StatusCode res = evaluateEventFilter(server, session, program, eventNode,
+                                            NULL, efl, NULL);
+    if(res != UA_STATUSCODE_GOOD)
+        UA_EventFieldList_clear(efl);
+    return res;
+}
+
+UA_StatusCode
+evaluateWhereClause(UA_Server *server, UA_Session *session, const UA_NodeId *eventNode,
+                    const UA_ContentFilter *contentFilter,
+                    UA_ContentFilterResult *contentFilterResult) {
+    UA_LOCK_ASSERT(&server->serviceMutex);
+
+    /* An empty filter always succeeds */
+    if(contentFilter->elementsSize == 0)
+        return UA_STATUSCODE_GOOD;
 
-    UA_BrowsePathResult_clear(&bpr);
-    UA_Variant_clear(&tOutVariant);
-    return isSubtypeOfBaseEvent;
+    UA_EventFilterProgram *program = NULL;
+    UA_StatusCode res = compileFilter(server, 0, NULL, contentFilter, &program);
+    UA_CHECK_STATUS(res, return res);
+    res = evaluateEventFilter(server, session, program, eventNode,
+                              contentFilterResult, NULL, NULL);
+    UA_EventFilterProgram_delete(program);
+    return res;
 }
 
 UA_StatusCode
@@ -1072,39 +1639,66 @@ filterEvent(UA_Server *server, UA_Session *session,
         }
     }
 
-    /* Evaluate the where filter. Do we event need to consider the event? */
-    UA_StatusCode res = evaluateWhereClause(server, session, eventNode,
-                                            &filter->whereClause,
-                                            &result->whereClauseResult);
-    if(res != UA_STATUSCODE_GOOD){
+    /* Compile and evaluate the filter */
+    UA_EventFilterProgram *program = NULL;
+    UA_StatusCode res = UA_EventFilterProgram_compile(server, filter, &program);
+    if(res == UA_STATUSCODE_GOOD) {
+        res = evaluateEventFilter(server, session, program, eventNode,
+                                  &result->whereClauseResult, efl,
+                                  result->selectClauseResults);
+        UA_EventFilterProgram_delete(program);
+    }
+    if(res != UA_STATUSCODE_GOOD) {
         UA_EventFieldList_clear(efl);
         UA_EventFilterResult_clear(result);
-        return res;
     }
+    return res;
+}
 
-    /* Apply the select filter */
-    UA_NodeId baseEventTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
-    for(size_t i = 0; i < filter->selectClausesSize; i++) {
-        UA_SimpleAttributeOperand *sc = &filter->selectClauses[i];
-        /* Check if the browsePath is BaseEventType, in which case nothing more
-         * needs to be checked */
-        if(!UA_NodeId_equal(&sc->typeDefinitionId, &baseEventTypeId) &&
-           !isValidEvent(server, &sc->typeDefinitionId, eventNode)) {
-            UA_Variant_init(&efl->eventFields[i]);
-            /* EventFilterResult currently isn't being used
-               notification->result.selectClauseResults[i] =
-                   UA_STATUSCODE_BADTYPEDEFINITIONINVALID; */
-            continue;
+UA_StatusCode
+UA_Server_filterStoredEvents(UA_Server *server, const UA_EventFilter *filter,
+                             size_t storedSelectSize,
+                             const UA_SimpleAttributeOperand *storedSelect,
+                             size_t eventsSize, const UA_EventFieldList *events,
+                             UA_EventFieldList *results) {
+    for(size_t i = 0; i < eventsSize; i++)
+        UA_EventFieldList_init(&results[i]);
+
+    UA_LOCK(&server->serviceMutex);
+    UA_EventFilterProgram *program = NULL;
+    UA_StatusCode res = UA_EventFilterProgram_compile(server, filter, &program);
+    for(size_t i = 0; i < eventsSize && res == UA_STATUSCODE_GOOD; i++) {
+        UA_EventFieldList *efl = &results[i];
+        efl->eventFields = (UA_Variant *)
+            UA_Array_new(program->selectSize, &UA_TYPES[UA_TYPES_VARIANT]);
+        if(!efl->eventFields) {
+            res = UA_STATUSCODE_BADOUTOFMEMORY;
+            break;
         }
-
-        /* Lookup the field. The overall filter can succeed even if a single
-         * select-field cannot be resolved. */
-        result->selectClauseResults[i] =
-            resolveSimpleAttributeOperand(server, session, eventNode,
-                                          sc, &efl->eventFields[i]);
+        efl->eventFieldsSize = program->selectSize;
+
+        UA_FilterEvalContext ctx;
+        initEvalContext(&ctx, server, &server->adminSession, program, NULL, NULL);
+        ctx.storedSelectSize = storedSelectSize;
+        ctx.storedSelect = storedSelect;
+        ctx.storedEvent = &events[i];
+        UA_StatusCode evalRes = evaluateContext(&ctx, efl, NULL);
+
+        /* Fields that are not recorded or the where-clause cannot be evaluated
+         * for the event. Only a failed allocation is a failure overall. */
+        if(evalRes != UA_STATUSCODE_GOOD)
+            UA_EventFieldList_clear(efl);
+        if(evalRes == UA_STATUSCODE_BADOUTOFMEMORY)
+            res = evalRes;
     }
+    UA_EventFilterProgram_delete(program);
+    UA_UNLOCK(&server->serviceMutex);
 
-    return UA_STATUSCODE_GOOD;
+    if(res != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < eventsSize; i++)
+            UA_EventFieldList_clear(&results[i]);
+    }
+    return res;
 }
 
 /*****************************************/
@@ -502,6 +502,34 @@ UA_MessageContext_encode(UA_MessageContext *mc, const void *content,
     return res;
 }
 
+UA_StatusCode
+UA_MessageContext_encodeRaw(UA_MessageContext *mc, const UA_ByteString *raw) {
+    const UA_Byte *src = raw->data;
+    size_t remaining = raw->length;
+    while(remaining > 0) {
+        /* Send out the full chunk and continue in a new buffer */
+        if(mc->buf_pos >= mc->buf_end) {
+            UA_StatusCode res =
+                sendSymmetricEncodingCallback(mc, &mc->buf_pos, &mc->buf_end);
+            if(res != UA_STATUSCODE_GOOD) {
+                if(mc->messageBuffer.length > 0)
+                    UA_MessageContext_abort(mc);
+                return res;
+            }
+        }
+
+        /* Copy as much as fits into the current chunk */
+        size_t possible = (uintptr_t)mc->buf_end - (uintptr_t)mc->buf_pos;
+        if(possible > remaining)
+            possible = remaining;
+        memcpy(mc->buf_pos, src, possible);
+        mc->buf_pos += possible;
+        src += possible;
+        remaining -= possible;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
 UA_StatusCode
 UA_MessageContext_finish(UA_MessageContext *mc) {
     mc->final = true;
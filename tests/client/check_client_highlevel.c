@@ -316,6 +316,51 @@ START_TEST(Node_Browse) {
 }
 END_TEST
 
+/* The Browse service returns the same results over the network as the local
+ * UA_Server_browse */
+START_TEST(Node_Browse_Results) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+    bd.browseDirection = UA_BROWSEDIRECTION_BOTH;
+    bd.includeSubtypes = true;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+
+    UA_BrowseRequest bReq;
+    UA_BrowseRequest_init(&bReq);
+    bReq.nodesToBrowse = &bd;
+    bReq.nodesToBrowseSize = 1;
+    UA_BrowseResponse bResp = UA_Client_Service_browse(client, bReq);
+    ck_assert_uint_eq(bResp.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(bResp.resultsSize, 1);
+
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_gt(br.referencesSize, 0);
+    ck_assert_uint_eq(bResp.results[0].referencesSize, br.referencesSize);
+    for(size_t i = 0; i < br.referencesSize; i++) {
+        ck_assert(UA_order(&bResp.results[0].references[i], &br.references[i],
+                           &UA_TYPES[UA_TYPES_REFERENCEDESCRIPTION]) == UA_ORDER_EQ);
+    }
+
+    /* The TypeDefinition is set for the Object and Variable targets */
+    UA_NodeId serverType = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVERTYPE);
+    UA_Boolean foundType = false;
+    for(size_t i = 0; i < br.referencesSize; i++) {
+        UA_ReferenceDescription *rd = &br.references[i];
+        if(rd->nodeClass == UA_NODECLASS_OBJECT ||
+           rd->nodeClass == UA_NODECLASS_VARIABLE)
+            ck_assert(!UA_NodeId_isNull(&rd->typeDefinition.nodeId));
+        if(UA_NodeId_equal(&rd->nodeId.nodeId, &serverType))
+            foundType = true;
+    }
+    ck_assert(foundType);
+
+    UA_BrowseResult_clear(&br);
+    UA_BrowseResponse_clear(&bResp);
+}
+END_TEST
+
 START_TEST(Node_Register) {
     UA_RegisterNodesRequest req;
     UA_RegisterNodesRequest_init(&req);
@@ -1034,12 +1079,80 @@ END_TEST
 
 #endif
 
+/* Read a borrowed DataSource over the network. The response is encoded from
+ * the application memory and the view is released after it was sent. */
+#define BORROWEDSIZE 100
+static UA_Int32 borrowedArray[BORROWEDSIZE];
+static size_t releaseCount;
+
+static UA_StatusCode
+readBorrowed(UA_Server *s, const UA_NodeId *sessionId, void *sessionContext,
+             const UA_NodeId *nodeId, void *nodeContext, UA_Boolean includeSourceTimeStamp,
+             const UA_NumericRange *range, UA_DataValue *value) {
+    UA_Variant_setArray(&value->value, borrowedArray, BORROWEDSIZE,
+                        &UA_TYPES[UA_TYPES_INT32]);
+    value->value.storageType = UA_VARIANT_DATA_NODELETE;
+    value->hasValue = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+releaseBorrowed(UA_Server *s, const UA_NodeId *nodeId, void *nodeContext,
+                UA_DataValue *value) {
+    ck_assert_ptr_eq(value->value.data, borrowedArray);
+    releaseCount++;
+}
+
+START_TEST(Misc_ReadBorrowedDataSource) {
+    for(size_t i = 0; i < BORROWEDSIZE; i++)
+        borrowedArray[i] = (UA_Int32)i;
+    releaseCount = 0;
+
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    attr.dataType = UA_TYPES[UA_TYPES_INT32].typeId;
+    attr.valueRank = UA_VALUERANK_ONE_DIMENSION;
+    UA_UInt32 arrayDims[1] = {BORROWEDSIZE};
+    attr.arrayDimensions = arrayDims;
+    attr.arrayDimensionsSize = 1;
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "borrowed");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "borrowed"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_ValueBackend backend;
+    memset(&backend, 0, sizeof(UA_ValueBackend));
+    backend.backendType = UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED;
+    backend.backend.borrowed.dataSource.read = readBorrowed;
+    backend.backend.borrowed.release = releaseBorrowed;
+    retval = UA_Server_setVariableNode_valueBackend(server, nodeId, backend);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    for(size_t j = 0; j < 2; j++) {
+        UA_Variant val;
+        retval = UA_Client_readValueAttribute(client, nodeId, &val);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(val.arrayLength, BORROWEDSIZE);
+        ck_assert(val.type == &UA_TYPES[UA_TYPES_INT32]);
+        ck_assert_int_eq(memcmp(val.data, borrowedArray, sizeof(borrowedArray)), 0);
+        UA_Variant_clear(&val);
+    }
+
+    /* The view of the first read was released after its response was sent */
+    ck_assert_uint_ge(releaseCount, 1);
+}
+END_TEST
+
 static Suite *testSuite_Client(void) {
     Suite *s = suite_create("Client Highlevel");
     TCase *tc_misc = tcase_create("Client Highlevel Misc");
     tcase_add_checked_fixture(tc_misc, setup, teardown);
     tcase_add_test(tc_misc, Misc_State);
     tcase_add_test(tc_misc, Misc_NamespaceGetIndex);
+    tcase_add_test(tc_misc, Misc_ReadBorrowedDataSource);
     suite_add_tcase(s, tc_misc);
 
     TCase *tc_nodes = tcase_create("Client Highlevel Node Management");
@@ -1048,6 +1161,7 @@ static Suite *testSuite_Client(void) {
     tcase_add_test(tc_nodes, Node_Add);
 #endif
     tcase_add_test(tc_nodes, Node_Browse);
+    tcase_add_test(tc_nodes, Node_Browse_Results);
     tcase_add_test(tc_nodes, Node_Register);
     suite_add_tcase(s, tc_nodes);
 
@@ -10,6 +10,7 @@
 
 #include "client/ua_client_internal.h"
 #include "server/ua_server_internal.h"
+#include "server/ua_services.h"
 #include "test_helpers.h"
 
 #include <stdio.h>
@@ -177,6 +178,180 @@ START_TEST(Client_subscription) {
 }
 END_TEST
 
+START_TEST(Client_subscription_republish) {
+    UA_Client *client = UA_Client_newForUnitTest();
+    UA_StatusCode retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_CreateSubscriptionRequest request = UA_CreateSubscriptionRequest_default();
+    UA_CreateSubscriptionResponse response = UA_Client_Subscriptions_create(client, request,
+                                                                            NULL, NULL, NULL);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UInt32 subId = response.subscriptionId;
+
+    /* monitor the server state */
+    UA_MonitoredItemCreateRequest monRequest =
+        UA_MonitoredItemCreateRequest_default(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_STATE));
+    UA_MonitoredItemCreateResult monResponse =
+        UA_Client_MonitoredItems_createDataChange(client, subId,
+                                                  UA_TIMESTAMPSTORETURN_BOTH,
+                                                  monRequest, NULL, dataChangeHandler, NULL);
+    ck_assert_uint_eq(monResponse.statusCode, UA_STATUSCODE_GOOD);
+
+    /* manually control the server thread */
+    running = false;
+    THREAD_JOIN(server_thread);
+
+    UA_Server_run_iterate(server, true);
+    retval = UA_Client_run_iterate(client, 1);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_fakeSleep((UA_UInt32)publishingInterval + 1);
+
+    notificationReceived = false;
+    UA_Server_run_iterate(server, true);
+    retval = UA_Client_run_iterate(client, 1);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(notificationReceived, true);
+
+    /* The server has not yet received the acknowledgement. The message is
+     * retained in encoded form and decoded for the republish. */
+    UA_LOCK(&server->serviceMutex);
+    UA_Subscription *sub = getSubscriptionById(server, subId);
+    ck_assert_ptr_ne(sub, NULL);
+    UA_NotificationMessageEntry *entry =
+        TAILQ_LAST(&sub->retransmissionQueue, NotificationMessageQueue);
+    ck_assert_ptr_ne(entry, NULL);
+    ck_assert_uint_gt(entry->encoded.length, 0);
+
+    UA_RepublishRequest repRequest;
+    UA_RepublishRequest_init(&repRequest);
+    repRequest.subscriptionId = subId;
+    repRequest.retransmitSequenceNumber = entry->sequenceNumber;
+    UA_RepublishResponse repResponse;
+    UA_RepublishResponse_init(&repResponse);
+    Service_Republish(server, sub->session, &repRequest, &repResponse);
+    UA_UNLOCK(&server->serviceMutex);
+
+    ck_assert_uint_eq(repResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_NotificationMessage *msg = &repResponse.notificationMessage;
+    ck_assert_uint_eq(msg->sequenceNumber, repRequest.retransmitSequenceNumber);
+    ck_assert_uint_eq(msg->notificationDataSize, 1);
+    ck_assert_ptr_eq(msg->notificationData[0].content.decoded.type,
+                     &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION]);
+    UA_DataChangeNotification *dcn = (UA_DataChangeNotification*)
+        msg->notificationData[0].content.decoded.data;
+    ck_assert_uint_eq(dcn->monitoredItemsSize, 1);
+    ck_assert(dcn->monitoredItems[0].value.hasValue);
+    ck_assert_ptr_eq(dcn->monitoredItems[0].value.value.type,
+                     &UA_TYPES[UA_TYPES_INT32]); /* Enums are encoded as Int32 */
+    UA_RepublishResponse_clear(&repResponse);
+
+    /* run the server in an independent thread again */
+    running = true;
+    THREAD_CREATE(server_thread, serverloop);
+
+    retval = UA_Client_Subscriptions_deleteSingle(client, subId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+}
+END_TEST
+
+static UA_Double ringValues[8];
+static size_t ringValuesSize = 0;
+
+static void
+ringDataChangeHandler(UA_Client *client, UA_UInt32 subId, void *subContext,
+                      UA_UInt32 monId, void *monContext, UA_DataValue *value) {
+    ck_assert(UA_Variant_hasScalarType(&value->value, &UA_TYPES[UA_TYPES_DOUBLE]));
+    ck_assert_uint_lt(ringValuesSize, 8);
+    ringValues[ringValuesSize++] = *(UA_Double*)value->value.data;
+}
+
+START_TEST(Client_subscription_ringQueue) {
+    /* manually control the server thread */
+    running = false;
+    THREAD_JOIN(server_thread);
+
+    /* Add a scalar numeric variable */
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Double d = 0.0;
+    UA_Variant_setScalar(&attr.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_NodeId varId = UA_NODEID_STRING(1, "ring");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, varId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "ring"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    running = true;
+    THREAD_CREATE(server_thread, serverloop);
+
+    UA_Client *client = UA_Client_newForUnitTest();
+    retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Only two notifications per publish response */
+    UA_CreateSubscriptionRequest request = UA_CreateSubscriptionRequest_default();
+    request.maxNotificationsPerPublish = 2;
+    UA_CreateSubscriptionResponse response =
+        UA_Client_Subscriptions_create(client, request, NULL, NULL, NULL);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_UInt32 subId = response.subscriptionId;
+
+    UA_MonitoredItemCreateRequest monRequest = UA_MonitoredItemCreateRequest_default(varId);
+    monRequest.requestedParameters.queueSize = 10;
+    monRequest.requestedParameters.samplingInterval = 50.0;
+    ringValuesSize = 0;
+    UA_MonitoredItemCreateResult monResponse =
+        UA_Client_MonitoredItems_createDataChange(client, subId,
+                                                  UA_TIMESTAMPSTORETURN_BOTH,
+                                                  monRequest, NULL,
+                                                  ringDataChangeHandler, NULL);
+    ck_assert_uint_eq(monResponse.statusCode, UA_STATUSCODE_GOOD);
+
+    /* manually control the server thread */
+    running = false;
+    THREAD_JOIN(server_thread);
+
+    /* Write more values. They are queued in the ring of the MonitoredItem. */
+    for(size_t i = 1; i <= 4; i++) {
+        UA_Double v = (UA_Double)i;
+        UA_Variant var;
+        UA_Variant_setScalar(&var, &v, &UA_TYPES[UA_TYPES_DOUBLE]);
+        retval = UA_Server_writeValue(server, varId, var);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        UA_fakeSleep((UA_UInt32)monRequest.requestedParameters.samplingInterval + 1);
+        UA_Server_run_iterate(server, false);
+    }
+
+    /* The samples are published in order over several responses */
+    for(size_t i = 0; i < 10 && ringValuesSize < 5; i++) {
+        UA_fakeSleep((UA_UInt32)publishingInterval + 1);
+        UA_Server_run_iterate(server, true);
+        retval = UA_Client_run_iterate(client, 1);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(ringValuesSize, 5);
+    for(size_t i = 0; i < ringValuesSize; i++)
+        ck_assert(ringValues[i] == (UA_Double)i);
+
+    /* run the server in an independent thread again */
+    running = true;
+    THREAD_CREATE(server_thread, serverloop);
+
+    retval = UA_Client_Subscriptions_deleteSingle(client, subId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+}
+END_TEST
+
 START_TEST(Client_subscription_async) {
     UA_Client *client = UA_Client_newForUnitTest();
     UA_StatusCode retval = UA_Client_connect(client, "opc.tcp://localhost:4840");
@@ -1653,6 +1828,8 @@ static Suite* testSuite_Client(void) {
     TCase *tc_client = tcase_create("Client Subscription Basic");
     tcase_add_checked_fixture(tc_client, setup, teardown);
     tcase_add_test(tc_client, Client_subscription);
+    tcase_add_test(tc_client, Client_subscription_republish);
+    tcase_add_test(tc_client, Client_subscription_ringQueue);
     tcase_add_test(tc_client, Client_subscription_async);
     tcase_add_test(tc_client, Client_subscription_statusChange);
     tcase_add_test(tc_client, Client_subscription_timeout);
@@ -243,6 +243,151 @@ START_TEST(Server_LocalMonitoredItem_CustomType) {
 }
 END_TEST
 
+static void
+dataChangeCountCallback(UA_Server *thisServer, UA_UInt32 monitoredItemId,
+                        void *monitoredItemContext, const UA_NodeId *nodeId,
+                        void *nodeContext, UA_UInt32 attributeId,
+                        const UA_DataValue *value) {
+    callbackCount++;
+}
+
+#define TEST_ARRAYSIZE 1000
+
+static void
+writeAndSample(UA_Variant *val) {
+    UA_StatusCode retval = UA_Server_writeValue(server, outNodeId, *val);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_fakeSleep(100);
+    UA_Server_run_iterate(server, 1);
+}
+
+/* Absolute deadband over the elements of an array */
+START_TEST(Server_LocalMonitoredItemArrayDeadband) {
+    callbackCount = 0;
+
+    UA_DataChangeFilter filter;
+    UA_DataChangeFilter_init(&filter);
+    filter.trigger = UA_DATACHANGETRIGGER_STATUSVALUE;
+    filter.deadbandType = UA_DEADBANDTYPE_ABSOLUTE;
+    filter.deadbandValue = 0.5;
+
+    UA_MonitoredItemCreateRequest monitorRequest =
+            UA_MonitoredItemCreateRequest_default(outNodeId);
+    monitorRequest.requestedParameters.samplingInterval = (double)100;
+    monitorRequest.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    UA_ExtensionObject_setValue(&monitorRequest.requestedParameters.filter,
+                                &filter, &UA_TYPES[UA_TYPES_DATACHANGEFILTER]);
+    UA_MonitoredItemCreateResult result =
+            UA_Server_createDataChangeMonitoredItem(server, UA_TIMESTAMPSTORETURN_BOTH,
+                                                    monitorRequest, NULL,
+                                                    &dataChangeCountCallback);
+    ASSERT_STATUSCODE(result.statusCode, UA_STATUSCODE_GOOD);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(callbackCount, 1);
+
+    UA_Double arr[TEST_ARRAYSIZE];
+    for(size_t i = 0; i < TEST_ARRAYSIZE; i++)
+        arr[i] = (UA_Double)i;
+    UA_Variant val;
+    UA_Variant_setArray(&val, arr, TEST_ARRAYSIZE, &UA_TYPES[UA_TYPES_DOUBLE]);
+
+    /* Changed type */
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 2);
+
+    /* Within the deadband. Also in the last element after the full blocks. */
+    arr[3] += 0.4;
+    arr[TEST_ARRAYSIZE - 1] -= 0.4;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 2);
+
+    /* Outside the deadband compared to the last reported value */
+    arr[TEST_ARRAYSIZE - 1] -= 0.4;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 3);
+
+    /* Changed array length */
+    val.arrayLength = TEST_ARRAYSIZE - 1;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 4);
+
+    /* Integer array */
+    UA_Int16 intArr[TEST_ARRAYSIZE];
+    for(size_t i = 0; i < TEST_ARRAYSIZE; i++)
+        intArr[i] = (UA_Int16)i;
+    UA_Variant_setArray(&val, intArr, TEST_ARRAYSIZE, &UA_TYPES[UA_TYPES_INT16]);
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 5);
+    intArr[500] += 1;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 6);
+}
+END_TEST
+
+/* Change detection without a filter */
+START_TEST(Server_LocalMonitoredItemArrayChange) {
+    callbackCount = 0;
+
+    UA_MonitoredItemCreateRequest monitorRequest =
+            UA_MonitoredItemCreateRequest_default(outNodeId);
+    monitorRequest.requestedParameters.samplingInterval = (double)100;
+    monitorRequest.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    UA_MonitoredItemCreateResult result =
+            UA_Server_createDataChangeMonitoredItem(server, UA_TIMESTAMPSTORETURN_BOTH,
+                                                    monitorRequest, NULL,
+                                                    &dataChangeCountCallback);
+    ASSERT_STATUSCODE(result.statusCode, UA_STATUSCODE_GOOD);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(callbackCount, 1);
+
+    UA_Float arr[TEST_ARRAYSIZE];
+    for(size_t i = 0; i < TEST_ARRAYSIZE; i++)
+        arr[i] = 0.0f;
+    UA_Variant val;
+    UA_Variant_setArray(&val, arr, TEST_ARRAYSIZE, &UA_TYPES[UA_TYPES_FLOAT]);
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 2);
+
+    /* Identical value */
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 2);
+
+    /* -0.0 equals 0.0 although the bits differ */
+    arr[700] = -0.0f;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 2);
+
+    arr[700] = 1.0f;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 3);
+
+    /* Same data with array dimensions */
+    UA_UInt32 dims[2] = {10, TEST_ARRAYSIZE / 10};
+    val.arrayDimensions = dims;
+    val.arrayDimensionsSize = 2;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 4);
+
+    dims[0] = TEST_ARRAYSIZE / 10;
+    dims[1] = 10;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 5);
+
+    /* Overlayable integer array */
+    UA_UInt32 intArr[TEST_ARRAYSIZE];
+    for(size_t i = 0; i < TEST_ARRAYSIZE; i++)
+        intArr[i] = (UA_UInt32)i;
+    UA_Variant_setArray(&val, intArr, TEST_ARRAYSIZE, &UA_TYPES[UA_TYPES_UINT32]);
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 6);
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 6);
+    intArr[TEST_ARRAYSIZE - 1] = 0;
+    writeAndSample(&val);
+    ck_assert_uint_eq(callbackCount, 7);
+}
+END_TEST
+
 static void setupIndexRange(void) {
     server = UA_Server_newForUnitTest();
     ck_assert(server != NULL);
@@ -329,6 +474,8 @@ static Suite * testSuite_Client(void) {
     tcase_add_test(tc_server, Server_LocalMonitoredItem);
     tcase_add_test(tc_server, Server_LocalMonitoredItem_dataSource);
     tcase_add_test(tc_server, Server_LocalMonitoredItem_CustomType);
+    tcase_add_test(tc_server, Server_LocalMonitoredItemArrayDeadband);
+    tcase_add_test(tc_server, Server_LocalMonitoredItemArrayChange);
     suite_add_tcase(s, tc_server);
 
     TCase *tc_server_indexrange = tcase_create("Local Monitored Item Index Range");
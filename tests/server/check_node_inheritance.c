@@ -447,6 +447,182 @@ START_TEST(Nodes_createObjectWithInterfaceOnObject) {
 }
 END_TEST
 
+#ifdef UA_GENERATED_NAMESPACE_ZERO
+static void
+addMandatoryVariable(UA_NodeId parent, UA_UInt32 id, char *name) {
+    UA_VariableAttributes vAttr = UA_VariableAttributes_default;
+    vAttr.displayName = UA_LOCALIZEDTEXT("", name);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, id), parent,
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                  UA_QUALIFIEDNAME(1, name),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  vAttr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addReference(server, UA_NODEID_NUMERIC(1, id),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASMODELLINGRULE),
+                                    UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_MODELLINGRULE_MANDATORY),
+                                    true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+static UA_Boolean
+hasChild(UA_NodeId parent, char *name) {
+    UA_RelativePathElement rpe;
+    UA_RelativePathElement_init(&rpe);
+    rpe.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    rpe.targetName = UA_QUALIFIEDNAME(1, name);
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = parent;
+    bp.relativePath.elementsSize = 1;
+    bp.relativePath.elements = &rpe;
+    UA_BrowsePathResult bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+    UA_Boolean found = (bpr.statusCode == UA_STATUSCODE_GOOD && bpr.targetsSize == 1);
+    UA_BrowsePathResult_clear(&bpr);
+    return found;
+}
+
+static void
+createPumpTypes(void) {
+    /* PumpType with a subtype that overrides the Speed variable */
+    UA_ObjectTypeAttributes otAttr = UA_ObjectTypeAttributes_default;
+    otAttr.displayName = UA_LOCALIZEDTEXT("", "PumpType");
+    UA_StatusCode retval =
+        UA_Server_addObjectTypeNode(server, UA_NODEID_NUMERIC(1, 9000),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                    UA_QUALIFIEDNAME(1, "PumpType"),
+                                    otAttr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    addMandatoryVariable(UA_NODEID_NUMERIC(1, 9000), 9001, "Speed");
+    addMandatoryVariable(UA_NODEID_NUMERIC(1, 9000), 9002, "Temperature");
+
+    otAttr.displayName = UA_LOCALIZEDTEXT("", "FastPumpType");
+    retval = UA_Server_addObjectTypeNode(server, UA_NODEID_NUMERIC(1, 9010),
+                                         UA_NODEID_NUMERIC(1, 9000),
+                                         UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                         UA_QUALIFIEDNAME(1, "FastPumpType"),
+                                         otAttr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    addMandatoryVariable(UA_NODEID_NUMERIC(1, 9010), 9011, "Speed");
+}
+#endif
+
+START_TEST(Nodes_addObjectNodes) {
+#ifdef UA_GENERATED_NAMESPACE_ZERO
+    createPumpTypes();
+
+    UA_QualifiedName names[3] = {UA_QUALIFIEDNAME(1, "Pump1"),
+                                 UA_QUALIFIEDNAME(1, "Pump2"),
+                                 UA_QUALIFIEDNAME(1, "Pump3")};
+    UA_NodeId ids[3];
+    UA_StatusCode retval =
+        UA_Server_addObjectNodes(server, 3, NULL,
+                                 UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                 UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                 names, UA_NODEID_NUMERIC(1, 9010),
+                                 UA_ObjectAttributes_default, NULL, ids);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(server->instantiation.plansSize > 0);
+
+    /* The overridden Speed variable is instantiated once */
+    for(size_t i = 0; i < 3; i++) {
+        ck_assert(hasChild(ids[i], "Speed"));
+        ck_assert(hasChild(ids[i], "Temperature"));
+        UA_NodeId_clear(&ids[i]);
+    }
+#endif
+}
+END_TEST
+
+START_TEST(Nodes_addObjectNodesRollback) {
+#ifdef UA_GENERATED_NAMESPACE_ZERO
+    createPumpTypes();
+
+    /* The second requested NodeId exists already */
+    UA_QualifiedName names[2] = {UA_QUALIFIEDNAME(1, "Pump1"),
+                                 UA_QUALIFIEDNAME(1, "Pump2")};
+    UA_NodeId requested[2] = {UA_NODEID_NUMERIC(1, 9100), UA_NODEID_NUMERIC(1, 9000)};
+    UA_StatusCode retval =
+        UA_Server_addObjectNodes(server, 2, requested,
+                                 UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                 UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                 names, UA_NODEID_NUMERIC(1, 9000),
+                                 UA_ObjectAttributes_default, NULL, NULL);
+    ck_assert_uint_ne(retval, UA_STATUSCODE_GOOD);
+
+    /* The first instance was removed again */
+    UA_NodeClass nc;
+    retval = UA_Server_readNodeClass(server, UA_NODEID_NUMERIC(1, 9100), &nc);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADNODEIDUNKNOWN);
+#endif
+}
+END_TEST
+
+START_TEST(Nodes_instantiationPlanChanged) {
+#ifdef UA_GENERATED_NAMESPACE_ZERO
+    createPumpTypes();
+
+    UA_NodeId pump1;
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, UA_NODEID_NULL,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Pump1"), UA_NODEID_NUMERIC(1, 9010),
+                                UA_ObjectAttributes_default, NULL, &pump1);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(!hasChild(pump1, "Pressure"));
+    UA_UInt64 generation = server->instantiation.generation;
+
+    /* Adding a member to the supertype outdates the plan of the subtype */
+    addMandatoryVariable(UA_NODEID_NUMERIC(1, 9000), 9003, "Pressure");
+    ck_assert(server->instantiation.generation > generation);
+
+    UA_NodeId pump2;
+    retval = UA_Server_addObjectNode(server, UA_NODEID_NULL,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_QUALIFIEDNAME(1, "Pump2"),
+                                     UA_NODEID_NUMERIC(1, 9010),
+                                     UA_ObjectAttributes_default, NULL, &pump2);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(hasChild(pump2, "Pressure"));
+
+    /* Creating instances leaves the plans valid */
+    generation = server->instantiation.generation;
+    UA_NodeId pump3;
+    retval = UA_Server_addObjectNode(server, UA_NODEID_NULL,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_QUALIFIEDNAME(1, "Pump3"),
+                                     UA_NODEID_NUMERIC(1, 9010),
+                                     UA_ObjectAttributes_default, NULL, &pump3);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(server->instantiation.generation, generation);
+
+    /* Removing a member outdates the plan */
+    retval = UA_Server_deleteNode(server, UA_NODEID_NUMERIC(1, 9002), true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_NodeId pump4;
+    retval = UA_Server_addObjectNode(server, UA_NODEID_NULL,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_QUALIFIEDNAME(1, "Pump4"),
+                                     UA_NODEID_NUMERIC(1, 9010),
+                                     UA_ObjectAttributes_default, NULL, &pump4);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(hasChild(pump4, "Pressure"));
+    ck_assert(!hasChild(pump4, "Temperature"));
+
+    UA_NodeId_clear(&pump1);
+    UA_NodeId_clear(&pump2);
+    UA_NodeId_clear(&pump3);
+    UA_NodeId_clear(&pump4);
+#endif
+}
+END_TEST
+
 static Suite *testSuite_Client(void) {
     Suite *s = suite_create("Node inheritance");
     TCase *tc_inherit_subtype = tcase_create("Inherit subtype value");
@@ -464,6 +640,12 @@ static Suite *testSuite_Client(void) {
     tcase_add_test(tc_interface_addin, Nodes_createObjectWithInterfaceOnType);
     tcase_add_test(tc_interface_addin, Nodes_createObjectWithInterfaceOnObject);
     suite_add_tcase(s, tc_interface_addin);
+    TCase *tc_plans = tcase_create("Instantiation plans");
+    tcase_add_checked_fixture(tc_plans, setup, teardown);
+    tcase_add_test(tc_plans, Nodes_addObjectNodes);
+    tcase_add_test(tc_plans, Nodes_addObjectNodesRollback);
+    tcase_add_test(tc_plans, Nodes_instantiationPlanChanged);
+    suite_add_tcase(s, tc_plans);
     return s;
 }
 
@@ -5,6 +5,8 @@
 #include <open62541/types.h>
 #include <open62541/util.h>
 #include <open62541/plugin/nodestore_default.h>
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
 #include "open62541/plugin/nodestore.h"
 #include "open62541/types_generated.h"
 
@@ -27,6 +29,14 @@ static void setupHashMap(void) {
     UA_Nodestore_HashMap(&ns);
 }
 
+static void setupHashMapDirect(void) {
+    UA_Nodestore_HashMapDirect(&ns);
+}
+
+static void setupHashMapInterned(void) {
+    UA_Nodestore_HashMapWithOptions(&ns, UA_NODESTORE_HASHMAP_INTERNSTRINGS);
+}
+
 static void teardown(void) {
     ns.clear(ns.context);
 }
@@ -39,7 +49,7 @@ static void checkZeroVisitor(void *context, const UA_Node* node) {
 }
 
 static UA_Node* createNode(UA_UInt16 nsid, UA_UInt32 id) {
-    UA_Node *p = ns.newNode(&ns.context, UA_NODECLASS_VARIABLE);
+    UA_Node *p = ns.newNode(ns.context, UA_NODECLASS_VARIABLE);
     p->head.nodeId.identifierType = UA_NODEIDTYPE_NUMERIC;
     p->head.nodeId.namespaceIndex = nsid;
     p->head.nodeId.identifier.numeric = id;
@@ -120,6 +130,35 @@ START_TEST(findNodeInUA_NodeStoreWithSeveralEntries) {
 }
 END_TEST
 
+START_TEST(findNodeAfterReserve) {
+    UA_Node* n1 = createNode(0,2253);
+    ns.insertNode(ns.context, n1, NULL);
+
+    /* The reserve callback is optional */
+    if(ns.reserve) {
+        UA_StatusCode res = ns.reserve(ns.context, 5000);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    }
+    for(UA_UInt32 i = 1; i <= 5000; i++) {
+        UA_Node* n = createNode(1, i);
+        ns.insertNode(ns.context, n, NULL);
+    }
+
+    for(UA_UInt32 i = 1; i <= 5000; i += 97) {
+        UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+        const UA_Node* nr = ns.getNode(ns.context, &id, ~(UA_UInt32)0,
+                                       UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+        ck_assert_ptr_ne(nr, NULL);
+        ns.releaseNode(ns.context, nr);
+    }
+    UA_NodeId in1 = UA_NODEID_NUMERIC(0, 2253);
+    const UA_Node* nr = ns.getNode(ns.context, &in1, ~(UA_UInt32)0,
+                                   UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    ck_assert_uint_eq((uintptr_t)nr, (uintptr_t)n1);
+    ns.releaseNode(ns.context, nr);
+}
+END_TEST
+
 START_TEST(iterateOverUA_NodeStoreShallNotVisitEmptyNodes) {
     UA_Node* n1 = createNode(0,2253);
     ns.insertNode(ns.context, n1, NULL);
@@ -191,6 +230,853 @@ START_TEST(failToFindNonExistentNodeInUA_NodeStoreWithSeveralEntries) {
 }
 END_TEST
 
+/*****************************/
+/* Direct Pointer Test Cases */
+/*****************************/
+
+static void
+addRef(UA_Node *node, UA_Boolean isForward, UA_UInt32 target) {
+    UA_ExpandedNodeId targetId = UA_EXPANDEDNODEID_NUMERIC(0, target);
+    UA_StatusCode res = UA_Node_addReference(node, 0, isForward, &targetId, 0);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+}
+
+static const UA_NodeHead *
+firstTarget(UA_UInt32 id) {
+    UA_NodeId nodeId = UA_NODEID_NUMERIC(0, id);
+    const UA_Node *node = ns.getNode(ns.context, &nodeId, ~(UA_UInt32)0,
+                                     UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    ck_assert_ptr_ne(node, NULL);
+    ck_assert_uint_eq(node->head.referencesSize, 1);
+    const UA_NodeHead *target =
+        UA_NodePointer_getNode(node->head.references[0].targets.array[0].targetId);
+    ns.releaseNode(ns.context, node);
+    return target;
+}
+
+START_TEST(directPointerAfterInsert) {
+    UA_Node *n1 = createNode(0, 1);
+    addRef(n1, true, 2);
+    ns.insertNode(ns.context, n1, NULL);
+    ck_assert_ptr_eq(firstTarget(1), NULL); /* Target does not exist yet */
+
+    UA_Node *n2 = createNode(0, 2);
+    addRef(n2, false, 1);
+    ns.insertNode(ns.context, n2, NULL);
+    ck_assert_ptr_eq(firstTarget(1), &n2->head);
+    ck_assert_ptr_eq(firstTarget(2), &n1->head);
+
+    /* Resolve the direct pointer */
+    const UA_Node *nr =
+        ns.getNodeFromPtr(ns.context, n1->head.references[0].targets.array[0].targetId,
+                          ~(UA_UInt32)0, UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    ck_assert_ptr_eq(nr, n2);
+    ns.releaseNode(ns.context, nr);
+} END_TEST
+
+START_TEST(directPointerAfterEdit) {
+    UA_Node *n1 = createNode(0, 1);
+    ns.insertNode(ns.context, n1, NULL);
+    UA_Node *n2 = createNode(0, 2);
+    ns.insertNode(ns.context, n2, NULL);
+
+    /* Add the reference in-situ. Swizzled when the node is released. */
+    UA_NodeId id1 = UA_NODEID_NUMERIC(0, 1);
+    UA_Node *edit = ns.getEditNode(ns.context, &id1, ~(UA_UInt32)0,
+                                   UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    addRef(edit, true, 2);
+    ns.releaseNode(ns.context, edit);
+    ck_assert_ptr_eq(firstTarget(1), &n2->head);
+
+    /* Add the inverse reference */
+    UA_NodeId id2 = UA_NODEID_NUMERIC(0, 2);
+    edit = ns.getEditNode(ns.context, &id2, ~(UA_UInt32)0,
+                          UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    addRef(edit, false, 1);
+    ns.releaseNode(ns.context, edit);
+    ck_assert_ptr_eq(firstTarget(2), &n1->head);
+} END_TEST
+
+START_TEST(directPointerRemove) {
+    UA_Node *n1 = createNode(0, 1);
+    addRef(n1, true, 2);
+    ns.insertNode(ns.context, n1, NULL);
+    UA_Node *n2 = createNode(0, 2);
+    addRef(n2, false, 1);
+    ns.insertNode(ns.context, n2, NULL);
+    ck_assert_ptr_eq(firstTarget(1), &n2->head);
+
+    UA_NodeId id2 = UA_NODEID_NUMERIC(0, 2);
+    UA_StatusCode res = ns.removeNode(ns.context, &id2);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    /* Reverted to the NodeId */
+    ck_assert_ptr_eq(firstTarget(1), NULL);
+    UA_NodePointer target = n1->head.references[0].targets.array[0].targetId;
+    UA_NodeId targetId = UA_NodePointer_toNodeId(target);
+    ck_assert(UA_NodeId_equal(&targetId, &id2));
+    const UA_Node *nr = ns.getNodeFromPtr(ns.context, target, ~(UA_UInt32)0,
+                                          UA_REFERENCETYPESET_ALL,
+                                          UA_BROWSEDIRECTION_BOTH);
+    ck_assert_ptr_eq(nr, NULL);
+} END_TEST
+
+START_TEST(directPointerRemoveOneWay) {
+    UA_Node *n1 = createNode(0, 1);
+    addRef(n1, true, 2);
+    ns.insertNode(ns.context, n1, NULL);
+    UA_Node *n2 = createNode(0, 2);
+    addRef(n2, false, 1);
+    ns.insertNode(ns.context, n2, NULL);
+
+    /* Delete only the inverse reference */
+    UA_NodeId id2 = UA_NODEID_NUMERIC(0, 2);
+    UA_ExpandedNodeId eid1 = UA_EXPANDEDNODEID_NUMERIC(0, 1);
+    UA_Node *edit = ns.getEditNode(ns.context, &id2, ~(UA_UInt32)0,
+                                   UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    UA_StatusCode res = UA_Node_deleteReference(edit, 0, false, &eid1);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ns.releaseNode(ns.context, edit);
+
+    /* The direct pointer in n1 is still found and reverted */
+    res = ns.removeNode(ns.context, &id2);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(firstTarget(1), NULL);
+} END_TEST
+
+START_TEST(directPointerReplace) {
+    UA_Node *n1 = createNode(0, 1);
+    addRef(n1, true, 2);
+    ns.insertNode(ns.context, n1, NULL);
+    UA_Node *n2 = createNode(0, 2);
+    addRef(n2, false, 1);
+    ns.insertNode(ns.context, n2, NULL);
+
+    UA_NodeId id2 = UA_NODEID_NUMERIC(0, 2);
+    UA_Node *copy;
+    UA_StatusCode res = ns.getNodeCopy(ns.context, &id2, &copy);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(UA_NodePointer_getNode(copy->head.references[0].
+                                            targets.array[0].targetId), NULL);
+    res = ns.replaceNode(ns.context, copy);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    /* Both directions point to the current nodes */
+    ck_assert_ptr_eq(firstTarget(1), &copy->head);
+    ck_assert_ptr_eq(firstTarget(2), &n1->head);
+} END_TEST
+
+START_TEST(directPointerServer) {
+    UA_ServerConfig config;
+    memset(&config, 0, sizeof(UA_ServerConfig));
+    UA_Nodestore_HashMapDirect(&config.nodestore);
+    UA_ServerConfig_setDefault(&config);
+    UA_Server *server = UA_Server_newWithConfig(&config);
+    ck_assert_ptr_ne(server, NULL);
+
+    UA_NodeId objId = UA_NODEID_STRING(1, "DirectObject");
+    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, objId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "DirectObject"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                oAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    /* Follow the references from the root */
+    UA_RelativePathElement rpe[2];
+    memset(rpe, 0, sizeof(rpe));
+    rpe[0].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    rpe[0].targetName = UA_QUALIFIEDNAME(0, "Objects");
+    rpe[1].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    rpe[1].targetName = UA_QUALIFIEDNAME(1, "DirectObject");
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
+    bp.relativePath.elements = rpe;
+    bp.relativePath.elementsSize = 2;
+    UA_BrowsePathResult bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+    ck_assert_uint_eq(bpr.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(bpr.targetsSize, 1);
+    ck_assert(UA_NodeId_equal(&bpr.targets[0].targetId.nodeId, &objId));
+    UA_BrowsePathResult_clear(&bpr);
+
+    /* The reference is gone with the node */
+    res = UA_Server_deleteNode(server, objId, true);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+    ck_assert_uint_eq(bpr.statusCode, UA_STATUSCODE_BADNOMATCH);
+    UA_BrowsePathResult_clear(&bpr);
+
+    UA_Server_delete(server);
+} END_TEST
+
+/*******************************/
+/* Interned Strings Test Cases */
+/*******************************/
+
+static UA_Node *
+createNamedNode(UA_UInt32 id, const char *name) {
+    UA_Node *n = createNode(0, id);
+    n->head.browseName = UA_QUALIFIEDNAME_ALLOC(1, name);
+    n->head.displayName = (UA_LocalizedTextListEntry*)
+        UA_calloc(1, sizeof(UA_LocalizedTextListEntry));
+    ck_assert_ptr_ne(n->head.displayName, NULL);
+    n->head.displayName->localizedText = UA_LOCALIZEDTEXT_ALLOC("en-US", name);
+    return n;
+}
+
+START_TEST(internSharedStrings) {
+    UA_Node *n1 = createNamedNode(1, "Value");
+    ns.insertNode(ns.context, n1, NULL);
+    UA_Node *n2 = createNamedNode(2, "Value");
+    ns.insertNode(ns.context, n2, NULL);
+
+    ck_assert_ptr_eq(n1->head.browseName.name.data, n2->head.browseName.name.data);
+    ck_assert_ptr_eq(n1->head.displayName->localizedText.locale.data,
+                     n2->head.displayName->localizedText.locale.data);
+    ck_assert_ptr_eq(n1->head.displayName->localizedText.text.data,
+                     n2->head.displayName->localizedText.text.data);
+
+    /* Remove one node. The strings remain for the other. */
+    UA_NodeId id1 = UA_NODEID_NUMERIC(0, 1);
+    ns.removeNode(ns.context, &id1);
+    UA_String value = UA_STRING("Value");
+    ck_assert(UA_String_equal(&n2->head.browseName.name, &value));
+} END_TEST
+
+START_TEST(internEditCopyOnWrite) {
+    UA_Node *n1 = createNamedNode(1, "Value");
+    ns.insertNode(ns.context, n1, NULL);
+    UA_Node *n2 = createNamedNode(2, "Value");
+    ns.insertNode(ns.context, n2, NULL);
+
+    /* The edited node gets private strings */
+    UA_NodeId id1 = UA_NODEID_NUMERIC(0, 1);
+    UA_Node *edit = ns.getEditNode(ns.context, &id1, ~(UA_UInt32)0,
+                                   UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    ck_assert_ptr_ne(edit, NULL);
+    ck_assert_ptr_ne(edit->head.browseName.name.data, n2->head.browseName.name.data);
+    UA_String_clear(&edit->head.displayName->localizedText.text);
+    edit->head.displayName->localizedText.text = UA_STRING_ALLOC("Changed");
+    ns.releaseNode(ns.context, edit);
+
+    /* Unchanged strings are shared again after the release */
+    ck_assert_ptr_eq(n1->head.browseName.name.data, n2->head.browseName.name.data);
+    ck_assert_ptr_eq(n1->head.displayName->localizedText.locale.data,
+                     n2->head.displayName->localizedText.locale.data);
+    ck_assert_ptr_ne(n1->head.displayName->localizedText.text.data,
+                     n2->head.displayName->localizedText.text.data);
+    UA_String value = UA_STRING("Value");
+    UA_String changed = UA_STRING("Changed");
+    ck_assert(UA_String_equal(&n1->head.displayName->localizedText.text, &changed));
+    ck_assert(UA_String_equal(&n2->head.displayName->localizedText.text, &value));
+} END_TEST
+
+START_TEST(internReplace) {
+    UA_Node *n1 = createNamedNode(1, "Value");
+    ns.insertNode(ns.context, n1, NULL);
+    UA_Node *n2 = createNamedNode(2, "Value");
+    ns.insertNode(ns.context, n2, NULL);
+
+    UA_NodeId id1 = UA_NODEID_NUMERIC(0, 1);
+    UA_Node *copy;
+    UA_StatusCode res = ns.getNodeCopy(ns.context, &id1, &copy);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_ne(copy->head.browseName.name.data, n2->head.browseName.name.data);
+    res = ns.replaceNode(ns.context, copy);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(copy->head.browseName.name.data, n2->head.browseName.name.data);
+} END_TEST
+
+START_TEST(internServer) {
+    UA_ServerConfig config;
+    memset(&config, 0, sizeof(UA_ServerConfig));
+    UA_Nodestore_HashMapWithOptions(&config.nodestore,
+                                    UA_NODESTORE_HASHMAP_DIRECTPOINTERS |
+                                    UA_NODESTORE_HASHMAP_INTERNSTRINGS);
+    UA_ServerConfig_setDefault(&config);
+    UA_Server *server = UA_Server_newWithConfig(&config);
+    ck_assert_ptr_ne(server, NULL);
+
+    /* Write and read back the DisplayName of a namespace zero node */
+    UA_NodeId serverId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+    UA_LocalizedText lt = UA_LOCALIZEDTEXT("de-DE", "Rechner");
+    UA_StatusCode res = UA_Server_writeDisplayName(server, serverId, lt);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_LocalizedText out;
+    res = UA_Server_readDisplayName(server, serverId, &out);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_String text = UA_STRING("Server");
+    ck_assert(UA_String_equal(&out.text, &text)); /* Default locale en-US */
+    UA_LocalizedText_clear(&out);
+
+    UA_QualifiedName bn;
+    res = UA_Server_readBrowseName(server, serverId, &bn);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(UA_String_equal(&bn.name, &text));
+    UA_QualifiedName_clear(&bn);
+
+    UA_Server_delete(server);
+} END_TEST
+
+/***********************/
+/* Snapshot Test Cases */
+/***********************/
+
+static UA_Server *
+newSnapshotServer(UA_UInt32 options) {
+    UA_ServerConfig config;
+    memset(&config, 0, sizeof(UA_ServerConfig));
+    UA_Nodestore_HashMapWithOptions(&config.nodestore, options);
+    UA_ServerConfig_setDefault(&config);
+    UA_Server *server = UA_Server_newWithConfig(&config);
+    ck_assert_ptr_ne(server, NULL);
+    return server;
+}
+
+static void
+populateSnapshotServer(UA_Server *server) {
+    /* Custom ReferenceType */
+    UA_ReferenceTypeAttributes rtAttr = UA_ReferenceTypeAttributes_default;
+    rtAttr.inverseName = UA_LOCALIZEDTEXT("en-US", "PumpOf");
+    UA_StatusCode res =
+        UA_Server_addReferenceTypeNode(server, UA_NODEID_NUMERIC(1, 7000),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                       UA_QUALIFIEDNAME(1, "HasPump"),
+                                       rtAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+    oAttr.displayName = UA_LOCALIZEDTEXT("en-US", "Station");
+    res = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 7001),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "Station"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                  oAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    oAttr.displayName = UA_LOCALIZEDTEXT("en-US", "Pump");
+    res = UA_Server_addObjectNode(server, UA_NODEID_STRING(1, "Pump"),
+                                  UA_NODEID_NUMERIC(1, 7001),
+                                  UA_NODEID_NUMERIC(1, 7000),
+                                  UA_QUALIFIEDNAME(1, "Pump"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                  oAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    UA_VariableAttributes vAttr = UA_VariableAttributes_default;
+    UA_Double speed = 42.5;
+    UA_Variant_setScalar(&vAttr.value, &speed, &UA_TYPES[UA_TYPES_DOUBLE]);
+    vAttr.displayName = UA_LOCALIZEDTEXT("en-US", "Speed");
+    vAttr.description = UA_LOCALIZEDTEXT("en-US", "Rotational speed");
+    vAttr.accessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE;
+    res = UA_Server_addVariableNode(server, UA_NODEID_STRING(1, "Pump.Speed"),
+                                    UA_NODEID_STRING(1, "Pump"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                    UA_QUALIFIEDNAME(1, "Speed"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                    vAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+}
+
+static void
+checkSnapshotServer(UA_Server *server) {
+    /* Attributes and value */
+    UA_Variant value;
+    UA_StatusCode res =
+        UA_Server_readValue(server, UA_NODEID_STRING(1, "Pump.Speed"), &value);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(UA_Variant_hasScalarType(&value, &UA_TYPES[UA_TYPES_DOUBLE]));
+    ck_assert(*(UA_Double*)value.data == 42.5);
+    UA_Variant_clear(&value);
+
+    UA_LocalizedText lt;
+    res = UA_Server_readDescription(server, UA_NODEID_STRING(1, "Pump.Speed"), &lt);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_String text = UA_STRING("Rotational speed");
+    ck_assert(UA_String_equal(&lt.text, &text));
+    UA_LocalizedText_clear(&lt);
+
+    UA_Byte accessLevel = 0;
+    res = UA_Server_readAccessLevel(server, UA_NODEID_STRING(1, "Pump.Speed"),
+                                    &accessLevel);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(accessLevel, UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE);
+
+    /* References from namespace zero and the custom ReferenceType. The
+     * custom ReferenceType is a hierarchical reference. */
+    UA_RelativePathElement rpe[4];
+    memset(rpe, 0, sizeof(rpe));
+    rpe[0].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    rpe[0].targetName = UA_QUALIFIEDNAME(0, "Objects");
+    rpe[1].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    rpe[1].targetName = UA_QUALIFIEDNAME(1, "Station");
+    rpe[2].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    rpe[2].includeSubtypes = true;
+    rpe[2].targetName = UA_QUALIFIEDNAME(1, "Pump");
+    rpe[3].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    rpe[3].targetName = UA_QUALIFIEDNAME(1, "Speed");
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = UA_NODEID_NUMERIC(0, UA_NS0ID_ROOTFOLDER);
+    bp.relativePath.elements = rpe;
+    bp.relativePath.elementsSize = 4;
+    UA_BrowsePathResult bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+    ck_assert_uint_eq(bpr.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(bpr.targetsSize, 1);
+    UA_NodeId speedId = UA_NODEID_STRING(1, "Pump.Speed");
+    ck_assert(UA_NodeId_equal(&bpr.targets[0].targetId.nodeId, &speedId));
+    UA_BrowsePathResult_clear(&bpr);
+
+    /* Inverse reference of the custom ReferenceType */
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_STRING(1, "Pump");
+    bd.referenceTypeId = UA_NODEID_NUMERIC(1, 7000);
+    bd.browseDirection = UA_BROWSEDIRECTION_INVERSE;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(br.referencesSize, 1);
+    UA_NodeId stationId = UA_NODEID_NUMERIC(1, 7001);
+    ck_assert(UA_NodeId_equal(&br.references[0].nodeId.nodeId, &stationId));
+    UA_BrowseResult_clear(&br);
+}
+
+static void
+snapshotRestore(UA_UInt32 options) {
+    UA_Server *server = newSnapshotServer(options);
+    populateSnapshotServer(server);
+    checkSnapshotServer(server);
+    UA_ByteString snapshot;
+    UA_StatusCode res = UA_Server_snapshotNodestore(server, &snapshot);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+
+    /* Restore into a fresh server with only namespace zero. Restoring again
+     * changes nothing. */
+    server = newSnapshotServer(options);
+    res = UA_Server_restoreNodestore(server, &snapshot);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    checkSnapshotServer(server);
+    res = UA_Server_restoreNodestore(server, &snapshot);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    checkSnapshotServer(server);
+
+    /* The restored nodes are normal nodes */
+    res = UA_Server_deleteNode(server, UA_NODEID_STRING(1, "Pump"), true);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+    UA_ByteString_clear(&snapshot);
+}
+
+START_TEST(snapshotRestoreHashMap) {
+    snapshotRestore(0);
+} END_TEST
+
+START_TEST(snapshotRestoreHashMapOptions) {
+    snapshotRestore(UA_NODESTORE_HASHMAP_DIRECTPOINTERS |
+                    UA_NODESTORE_HASHMAP_INTERNSTRINGS |
+                    UA_NODESTORE_HASHMAP_SORTEDREFERENCES);
+} END_TEST
+
+START_TEST(snapshotRestoreInvalid) {
+    UA_Server *server = newSnapshotServer(0);
+    populateSnapshotServer(server);
+    UA_ByteString snapshot;
+    UA_StatusCode res = UA_Server_snapshotNodestore(server, &snapshot);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+
+    /* Truncated snapshot. Nothing is added as the records are checked before
+     * the nodes are restored. */
+    server = newSnapshotServer(0);
+    UA_ByteString truncated = snapshot;
+    truncated.length -= 10;
+    res = UA_Server_restoreNodestore(server, &truncated);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADDECODINGERROR);
+    UA_NodeClass nc;
+    res = UA_Server_readNodeClass(server, UA_NODEID_STRING(1, "Pump"), &nc);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADNODEIDUNKNOWN);
+
+    /* Wrong magic number */
+    snapshot.data[0] ^= 0xff;
+    res = UA_Server_restoreNodestore(server, &snapshot);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADDECODINGERROR);
+    UA_Server_delete(server);
+    UA_ByteString_clear(&snapshot);
+} END_TEST
+
+START_TEST(snapshotNotSupported) {
+    UA_ServerConfig config;
+    memset(&config, 0, sizeof(UA_ServerConfig));
+    UA_Nodestore_ZipTree(&config.nodestore);
+    UA_ServerConfig_setDefault(&config);
+    UA_Server *server = UA_Server_newWithConfig(&config);
+    ck_assert_ptr_ne(server, NULL);
+    UA_ByteString snapshot = UA_BYTESTRING_NULL;
+    UA_StatusCode res = UA_Server_snapshotNodestore(server, &snapshot);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADNOTSUPPORTED);
+    UA_Server_delete(server);
+} END_TEST
+
+/********************************/
+/* Sorted References Test Cases */
+/********************************/
+
+#define SORTED_TARGETS 1000
+
+static void
+checkSortedKind(const UA_NodeReferenceKind *rk) {
+    ck_assert(rk->hasSortedArray);
+    const UA_ReferenceTargetIndex *idx = rk->targets.sorted.index;
+    ck_assert_uint_le(idx->sortedSize, rk->targetsSize);
+    ck_assert_uint_le(rk->targetsSize, idx->capacity);
+    for(size_t i = 1; i < idx->sortedSize; i++)
+        ck_assert_int_eq(UA_NodePointer_order(rk->targets.array[i-1].targetId,
+                                              rk->targets.array[i].targetId),
+                         UA_ORDER_LESS);
+    for(size_t i = 0; i < idx->sortedSize; i++) {
+        if(i > 0)
+            ck_assert_uint_le(idx->nameHashes[i-1], idx->nameHashes[i]);
+        ck_assert_uint_lt(idx->namePositions[i], idx->sortedSize);
+        ck_assert_uint_eq(rk->targets.array[idx->namePositions[i]].targetNameHash,
+                          idx->nameHashes[i]);
+    }
+}
+
+static void *
+countTargetCallback(void *context, UA_ReferenceTarget *t) {
+    (*(size_t*)context)++;
+    return NULL;
+}
+
+/* Every second target is in the kind */
+static void
+checkSortedTargets(UA_NodeReferenceKind *rk) {
+    ck_assert_uint_eq(rk->targetsSize, SORTED_TARGETS / 2);
+    for(UA_UInt32 i = 0; i < SORTED_TARGETS; i++) {
+        UA_ExpandedNodeId id = UA_EXPANDEDNODEID_NUMERIC(1, 1000 + i);
+        const UA_ReferenceTarget *t = UA_NodeReferenceKind_findTarget(rk, &id);
+        if(i % 2 == 1) {
+            ck_assert_ptr_eq(t, NULL);
+            continue;
+        }
+        ck_assert_ptr_ne(t, NULL);
+        ck_assert_uint_eq(t->targetNameHash, i % 10);
+    }
+    size_t count = 0;
+    UA_NodeReferenceKind_iterate(rk, countTargetCallback, &count);
+    ck_assert_uint_eq(count, SORTED_TARGETS / 2);
+    count = 0;
+    UA_NodeReferenceKind_iterateName(rk, 4, countTargetCallback, &count);
+    ck_assert_uint_eq(count, SORTED_TARGETS / 10);
+    count = 0;
+    UA_NodeReferenceKind_iterateName(rk, 5, countTargetCallback, &count);
+    ck_assert_uint_eq(count, 0);
+}
+
+START_TEST(sortedReferenceKind) {
+    UA_Node *node = createNode(1, 1);
+
+    /* Add in scrambled order. Sort after the first half. */
+    for(UA_UInt32 i = 0; i < SORTED_TARGETS; i++) {
+        UA_UInt32 j = (i * 7919) % SORTED_TARGETS;
+        UA_ExpandedNodeId id = UA_EXPANDEDNODEID_NUMERIC(1, 1000 + j);
+        UA_StatusCode res = UA_Node_addReference(node, UA_REFERENCETYPEINDEX_ORGANIZES,
+                                                 true, &id, j % 10);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+        if(i == SORTED_TARGETS / 2) {
+            res = UA_NodeReferenceKind_sort(&node->head.references[0]);
+            ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+        }
+    }
+    ck_assert_uint_eq(node->head.referencesSize, 1);
+    UA_NodeReferenceKind *rk = &node->head.references[0];
+    checkSortedKind(rk);
+    UA_ExpandedNodeId dup = UA_EXPANDEDNODEID_NUMERIC(1, 1000);
+    ck_assert_uint_eq(UA_Node_addReference(node, UA_REFERENCETYPEINDEX_ORGANIZES,
+                                           true, &dup, 0),
+                      UA_STATUSCODE_BADDUPLICATEREFERENCENOTALLOWED);
+
+    /* Delete every second target from the sorted part and the tail */
+    for(UA_UInt32 i = 1; i < SORTED_TARGETS; i += 2) {
+        UA_ExpandedNodeId id = UA_EXPANDEDNODEID_NUMERIC(1, 1000 + i);
+        UA_StatusCode res = UA_Node_deleteReference(node, UA_REFERENCETYPEINDEX_ORGANIZES,
+                                                    true, &id);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    }
+    checkSortedKind(rk);
+    checkSortedTargets(rk);
+
+    /* Copy the node */
+    UA_Node *copy = UA_Node_copy_alloc(node);
+    ck_assert_ptr_ne(copy, NULL);
+    checkSortedKind(&copy->head.references[0]);
+    checkSortedTargets(&copy->head.references[0]);
+    UA_Node_clear(copy);
+    UA_free(copy);
+
+    /* Switch to the tree and back to the sorted array */
+    UA_StatusCode res = UA_NodeReferenceKind_switch(rk);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(rk->hasRefTree);
+    ck_assert(!rk->hasSortedArray);
+    checkSortedTargets(rk);
+    res = UA_NodeReferenceKind_sort(rk);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(!rk->hasRefTree);
+    checkSortedKind(rk);
+    ck_assert_uint_eq(rk->targets.sorted.index->sortedSize, rk->targetsSize);
+    checkSortedTargets(rk);
+
+    /* Delete all targets. The ReferenceKind is removed. */
+    for(UA_UInt32 i = 0; i < SORTED_TARGETS; i += 2) {
+        UA_ExpandedNodeId id = UA_EXPANDEDNODEID_NUMERIC(1, 1000 + i);
+        res = UA_Node_deleteReference(node, UA_REFERENCETYPEINDEX_ORGANIZES,
+                                      true, &id);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(node->head.referencesSize, 0);
+    ns.deleteNode(ns.context, node);
+} END_TEST
+
+START_TEST(sortedReferenceBatch) {
+    UA_Node *node = createNode(1, 1);
+    UA_ExpandedNodeId ids[SORTED_TARGETS];
+    UA_UInt32 hashes[SORTED_TARGETS];
+
+    /* The first batch goes into an array */
+    for(UA_UInt32 i = 0; i < 20; i++) {
+        ids[i] = UA_EXPANDEDNODEID_NUMERIC(1, 1000 + (2 * i));
+        hashes[i] = (2 * i) % 10;
+    }
+    size_t added = 0;
+    UA_StatusCode res =
+        UA_Node_addReferences(node, UA_REFERENCETYPEINDEX_ORGANIZES, true,
+                              20, ids, hashes, &added);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(added, 20);
+    UA_NodeReferenceKind *rk = &node->head.references[0];
+    ck_assert(!rk->hasSortedArray);
+    res = UA_NodeReferenceKind_sort(rk);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    /* The second batch is merged into the sorted array. Skips the targets
+     * that exist already and the duplicates within the batch. */
+    for(UA_UInt32 i = 0; i < SORTED_TARGETS; i++) {
+        UA_UInt32 j = (i * 7919) % (SORTED_TARGETS / 2);
+        ids[i] = UA_EXPANDEDNODEID_NUMERIC(1, 1000 + (2 * j));
+        hashes[i] = (2 * j) % 10;
+    }
+    res = UA_Node_addReferences(node, UA_REFERENCETYPEINDEX_ORGANIZES, true,
+                                SORTED_TARGETS, ids, hashes, &added);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(added, (SORTED_TARGETS / 2) - 20);
+    checkSortedKind(rk);
+    ck_assert_uint_eq(rk->targets.sorted.index->sortedSize, rk->targetsSize);
+    checkSortedTargets(rk);
+    ns.deleteNode(ns.context, node);
+} END_TEST
+
+/* Without the option, many targets are kept in the RefTree */
+START_TEST(sortedReferenceDefault) {
+    UA_Node *node = createNode(1, 1);
+    for(UA_UInt32 i = 0; i < 20; i++) {
+        UA_ExpandedNodeId id = UA_EXPANDEDNODEID_NUMERIC(1, 1000 + i);
+        UA_StatusCode res = UA_Node_addReference(node, UA_REFERENCETYPEINDEX_ORGANIZES,
+                                                 true, &id, i % 10);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    }
+    UA_StatusCode res = ns.insertNode(ns.context, node, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 1);
+    const UA_Node *n = ns.getNode(ns.context, &nodeId, ~(UA_UInt32)0,
+                                  UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    ck_assert_ptr_ne(n, NULL);
+    ns.releaseNode(ns.context, n);
+
+    n = ns.getNode(ns.context, &nodeId, ~(UA_UInt32)0,
+                   UA_REFERENCETYPESET_ALL, UA_BROWSEDIRECTION_BOTH);
+    ck_assert_ptr_ne(n, NULL);
+    ck_assert_uint_eq(n->head.referencesSize, 1);
+    ck_assert(n->head.references[0].hasRefTree);
+    ck_assert(!n->head.references[0].hasSortedArray);
+    ns.releaseNode(ns.context, n);
+} END_TEST
+
+START_TEST(sortedReferenceServer) {
+    UA_Server *server =
+        newSnapshotServer(UA_NODESTORE_HASHMAP_DIRECTPOINTERS |
+                          UA_NODESTORE_HASHMAP_SORTEDREFERENCES);
+    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 1),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Tags"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                oAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    UA_VariableAttributes vAttr = UA_VariableAttributes_default;
+    char name[32];
+    for(UA_UInt32 i = 0; i < SORTED_TARGETS; i++) {
+        UA_UInt32 j = (i * 7919) % SORTED_TARGETS;
+        snprintf(name, sizeof(name), "Tag%u", (unsigned)j);
+        res = UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, 1000 + j),
+                                        UA_NODEID_NUMERIC(1, 1),
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                        UA_QUALIFIEDNAME(1, name),
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                        vAttr, NULL, NULL);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    }
+    for(UA_UInt32 i = 1; i < SORTED_TARGETS; i += 2) {
+        res = UA_Server_deleteNode(server, UA_NODEID_NUMERIC(1, 1000 + i), true);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    /* Lookup by BrowseName */
+    UA_RelativePathElement rpe[2];
+    memset(rpe, 0, sizeof(rpe));
+    rpe[0].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    rpe[0].targetName = UA_QUALIFIEDNAME(1, "Tags");
+    rpe[1].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bp.relativePath.elements = rpe;
+    bp.relativePath.elementsSize = 2;
+    for(UA_UInt32 i = 0; i < SORTED_TARGETS; i += 111) {
+        snprintf(name, sizeof(name), "Tag%u", (unsigned)i);
+        rpe[1].targetName = UA_QUALIFIEDNAME(1, name);
+        UA_BrowsePathResult bpr = UA_Server_translateBrowsePathToNodeIds(server, &bp);
+        if(i % 2 == 1) {
+            ck_assert_uint_eq(bpr.statusCode, UA_STATUSCODE_BADNOMATCH);
+        } else {
+            ck_assert_uint_eq(bpr.statusCode, UA_STATUSCODE_GOOD);
+            ck_assert_uint_eq(bpr.targetsSize, 1);
+            UA_NodeId id = UA_NODEID_NUMERIC(1, 1000 + i);
+            ck_assert(UA_NodeId_equal(&bpr.targets[0].targetId.nodeId, &id));
+        }
+        UA_BrowsePathResult_clear(&bpr);
+    }
+
+    /* Browse with continuation points. Every child is returned once. */
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(1, 1);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_Boolean seen[SORTED_TARGETS];
+    memset(seen, 0, sizeof(seen));
+    size_t total = 0;
+    UA_BrowseResult br = UA_Server_browse(server, 64, &bd);
+    while(true) {
+        ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+        for(size_t i = 0; i < br.referencesSize; i++) {
+            UA_UInt32 j = br.references[i].nodeId.nodeId.identifier.numeric - 1000;
+            ck_assert_uint_lt(j, SORTED_TARGETS);
+            ck_assert(!seen[j]);
+            seen[j] = true;
+            total++;
+        }
+        if(br.continuationPoint.length == 0)
+            break;
+        UA_ByteString cp = br.continuationPoint;
+        UA_ByteString_init(&br.continuationPoint);
+        UA_BrowseResult_clear(&br);
+        br = UA_Server_browseNext(server, false, &cp);
+        UA_ByteString_clear(&cp);
+    }
+    UA_BrowseResult_clear(&br);
+    ck_assert_uint_eq(total, SORTED_TARGETS / 2);
+
+    UA_Server_delete(server);
+} END_TEST
+
+static void
+addSortedChild(UA_Server *server, UA_UInt32 id) {
+    char name[32];
+    snprintf(name, sizeof(name), "Tag%u", (unsigned)id);
+    UA_VariableAttributes vAttr = UA_VariableAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, 10000 + id),
+                                  UA_NODEID_NUMERIC(1, 1),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, name),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  vAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+}
+
+/* Children are added between the pages of a Browse. Merging the tail of the
+ * sorted array moves targets in front of the continuation point. Every child
+ * that existed before the Browse is still returned exactly once. */
+START_TEST(sortedReferenceBrowseInsert) {
+    UA_Server *server = newSnapshotServer(UA_NODESTORE_HASHMAP_SORTEDREFERENCES);
+    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 1),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Tags"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                oAttr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    /* The children with the smallest ids are added last. They remain in the
+     * unsorted tail. */
+    for(UA_UInt32 i = 100; i < SORTED_TARGETS; i++)
+        addSortedChild(server, i);
+    for(UA_UInt32 i = 0; i < 10; i++)
+        addSortedChild(server, i);
+
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(1, 1);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_Boolean seen[2 * SORTED_TARGETS];
+    memset(seen, 0, sizeof(seen));
+    UA_UInt32 nextId = SORTED_TARGETS;
+    UA_BrowseResult br = UA_Server_browse(server, 64, &bd);
+    while(true) {
+        ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+        for(size_t i = 0; i < br.referencesSize; i++) {
+            UA_UInt32 j = br.references[i].nodeId.nodeId.identifier.numeric - 10000;
+            ck_assert_uint_lt(j, 2 * SORTED_TARGETS);
+            ck_assert(!seen[j]);
+            seen[j] = true;
+        }
+        if(br.continuationPoint.length == 0)
+            break;
+
+        /* Fill the tail to force a merge */
+        for(size_t i = 0; i < 20; i++)
+            addSortedChild(server, nextId++);
+
+        UA_ByteString cp = br.continuationPoint;
+        UA_ByteString_init(&br.continuationPoint);
+        UA_BrowseResult_clear(&br);
+        br = UA_Server_browseNext(server, false, &cp);
+        UA_ByteString_clear(&cp);
+    }
+    UA_BrowseResult_clear(&br);
+
+    for(UA_UInt32 i = 0; i < 10; i++)
+        ck_assert(seen[i]);
+    for(UA_UInt32 i = 100; i < SORTED_TARGETS; i++)
+        ck_assert(seen[i]);
+
+    UA_Server_delete(server);
+} END_TEST
+
 /************************************/
 /* Performance Profiling Test Cases */
 /************************************/
@@ -267,6 +1153,7 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_find, findNodeInExpandedNamespace);
     tcase_add_test (tc_find, failToFindNonExistentNodeInUA_NodeStoreWithSeveralEntries);
     tcase_add_test (tc_find, failToFindNodeInOtherUA_NodeStore);
+    tcase_add_test (tc_find, findNodeAfterReserve);
     suite_add_tcase (s, tc_find);
 
     TCase *tc_replace = tcase_create("Replace-ZipTree");
@@ -293,6 +1180,7 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_find_hm, findNodeInExpandedNamespace);
     tcase_add_test (tc_find_hm, failToFindNonExistentNodeInUA_NodeStoreWithSeveralEntries);
     tcase_add_test (tc_find_hm, failToFindNodeInOtherUA_NodeStore);
+    tcase_add_test (tc_find_hm, findNodeAfterReserve);
     suite_add_tcase (s, tc_find_hm);
 
     TCase *tc_replace_hm = tcase_create("Replace-HashMap");
@@ -312,6 +1200,52 @@ static Suite * namespace_suite (void) {
     tcase_add_test (tc_profile_hm, profileGetDelete);
     suite_add_tcase (s, tc_profile_hm);
 
+    TCase* tc_direct = tcase_create ("DirectPointers-HashMap");
+    tcase_add_checked_fixture(tc_direct, setupHashMapDirect, teardown);
+    tcase_add_test (tc_direct, directPointerAfterInsert);
+    tcase_add_test (tc_direct, directPointerAfterEdit);
+    tcase_add_test (tc_direct, directPointerRemove);
+    tcase_add_test (tc_direct, directPointerRemoveOneWay);
+    tcase_add_test (tc_direct, directPointerReplace);
+    tcase_add_test (tc_direct, findNodeInUA_NodeStoreWithSeveralEntries);
+    tcase_add_test (tc_direct, replaceOldNode);
+    suite_add_tcase (s, tc_direct);
+
+    TCase* tc_direct_server = tcase_create ("DirectPointers-Server");
+    tcase_add_test (tc_direct_server, directPointerServer);
+    suite_add_tcase (s, tc_direct_server);
+
+    TCase* tc_intern = tcase_create ("InternStrings-HashMap");
+    tcase_add_checked_fixture(tc_intern, setupHashMapInterned, teardown);
+    tcase_add_test (tc_intern, internSharedStrings);
+    tcase_add_test (tc_intern, internEditCopyOnWrite);
+    tcase_add_test (tc_intern, internReplace);
+    tcase_add_test (tc_intern, findNodeInUA_NodeStoreWithSeveralEntries);
+    suite_add_tcase (s, tc_intern);
+
+    TCase* tc_intern_server = tcase_create ("InternStrings-Server");
+    tcase_add_test (tc_intern_server, internServer);
+    suite_add_tcase (s, tc_intern_server);
+
+    TCase* tc_snapshot = tcase_create ("Snapshot-Server");
+    tcase_add_test (tc_snapshot, snapshotRestoreHashMap);
+    tcase_add_test (tc_snapshot, snapshotRestoreHashMapOptions);
+    tcase_add_test (tc_snapshot, snapshotRestoreInvalid);
+    tcase_add_test (tc_snapshot, snapshotNotSupported);
+    suite_add_tcase (s, tc_snapshot);
+
+    TCase* tc_sorted = tcase_create ("SortedReferences-HashMap");
+    tcase_add_checked_fixture(tc_sorted, setupHashMap, teardown);
+    tcase_add_test (tc_sorted, sortedReferenceKind);
+    tcase_add_test (tc_sorted, sortedReferenceBatch);
+    tcase_add_test (tc_sorted, sortedReferenceDefault);
+    suite_add_tcase (s, tc_sorted);
+
+    TCase* tc_sorted_server = tcase_create ("SortedReferences-Server");
+    tcase_add_test (tc_sorted_server, sortedReferenceServer);
+    tcase_add_test (tc_sorted_server, sortedReferenceBrowseInsert);
+    suite_add_tcase (s, tc_sorted_server);
+
     return s;
 }
 
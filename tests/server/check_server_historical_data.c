@@ -10,6 +10,7 @@
 #include <open62541/client_highlevel.h>
 #include <open62541/plugin/historydata/history_data_backend.h>
 #include <open62541/plugin/historydata/history_data_backend_memory.h>
+#include <open62541/plugin/historydata/history_data_backend_file.h>
 #include <open62541/plugin/historydata/history_data_gathering_default.h>
 #include <open62541/plugin/historydata/history_database_default.h>
 #include <open62541/plugin/historydatabase.h>
@@ -22,6 +23,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#ifdef __linux__
+#include <ftw.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
 #include "test_helpers.h"
 #include "testing_clock.h"
 #include "thread_wrapper.h"
@@ -203,9 +210,9 @@ resultIsEqual(const UA_DataValue * result, const testTuple * tuple, size_t index
 }
 
 static UA_Boolean
-fillHistoricalDataBackend(UA_HistoryDataBackend backend) {
+fillHistoricalDataBackend(UA_HistoryDataBackend backend, UA_DateTime *data) {
     int i = 0;
-    UA_DateTime currentDateTime = testData[i];
+    UA_DateTime currentDateTime = data[i];
     fprintf(stderr, "Adding to historical data backend: ");
     while (currentDateTime) {
         fprintf(stderr, "%lld, ", currentDateTime / UA_DATETIME_SEC);
@@ -225,7 +232,7 @@ fillHistoricalDataBackend(UA_HistoryDataBackend backend) {
             return false;
         }
         UA_DataValue_clear(&value);
-        currentDateTime = testData[++i];
+        currentDateTime = data[++i];
     }
     fprintf(stderr, "\n");
     return true;
@@ -571,7 +578,7 @@ START_TEST(Server_HistorizingUpdateDelete)
     ck_assert_str_eq(UA_StatusCode_name(ret), UA_StatusCode_name(UA_STATUSCODE_GOOD));
 
     // fill backend
-    ck_assert_uint_eq(fillHistoricalDataBackend(backend), true);
+    ck_assert_uint_eq(fillHistoricalDataBackend(backend, testData), true);
 
     // delete some values
     ck_assert_str_eq(UA_StatusCode_name(deleteHistory(DELETE_START_TIME, DELETE_STOP_TIME)),
@@ -905,7 +912,7 @@ START_TEST(Server_HistorizingBackendMemory)
     fprintf(stderr, "%x tests expected failed.\n", retval);
 
     // fill backend
-    ck_assert_uint_eq(fillHistoricalDataBackend(backend), true);
+    ck_assert_uint_eq(fillHistoricalDataBackend(backend, testData), true);
 
     // read all in one
     retval = testHistoricalDataBackend(100);
@@ -953,6 +960,741 @@ START_TEST(Server_HistorizingRandomIndexBackend)
 }
 END_TEST
 
+START_TEST(Server_HistorizingBackendColumnar)
+{
+    /* Small chunks to test splitting when out-of-order samples are inserted */
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_Memory_Columnar(4);
+    UA_HistorizingNodeIdSettings setting;
+    setting.historizingBackend = backend;
+    setting.maxHistoryDataResponseSize = 1000;
+    setting.historizingUpdateStrategy = UA_HISTORIZINGUPDATESTRATEGY_USER;
+    UA_StatusCode ret = gathering->registerNodeId(server, gathering->context, &outNodeId, setting);
+    ck_assert_str_eq(UA_StatusCode_name(ret), UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    // empty backend should not crash
+    UA_UInt32 retval = testHistoricalDataBackend(100);
+    fprintf(stderr, "%x tests expected failed.\n", retval);
+
+    // fill backend
+    ck_assert_uint_eq(fillHistoricalDataBackend(backend, testData), true);
+
+    // read all in one
+    retval = testHistoricalDataBackend(100);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+
+    // read continuous one at one request
+    retval = testHistoricalDataBackend(1);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+
+    // read continuous two at one request
+    retval = testHistoricalDataBackend(2);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+    UA_HistoryDataBackend_Memory_clear(&setting.historizingBackend);
+}
+END_TEST
+
+START_TEST(Server_HistorizingUpdateColumnar)
+{
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_Memory_Columnar(4);
+    UA_HistorizingNodeIdSettings setting;
+    setting.historizingBackend = backend;
+    setting.maxHistoryDataResponseSize = 1000;
+    setting.historizingUpdateStrategy = UA_HISTORIZINGUPDATESTRATEGY_USER;
+    UA_StatusCode ret = gathering->registerNodeId(server, gathering->context, &outNodeId, setting);
+    ck_assert_str_eq(UA_StatusCode_name(ret), UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    // fill backend with insert
+    ck_assert_str_eq(UA_StatusCode_name(updateHistory(UA_PERFORMUPDATETYPE_INSERT, testData, NULL, NULL))
+                                        , UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    testResult(testDataSorted, NULL);
+
+    // delete some values
+    ck_assert_str_eq(UA_StatusCode_name(deleteHistory(DELETE_START_TIME, DELETE_STOP_TIME)),
+                     UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    testResult(testDataAfterDelete, NULL);
+
+    // update all and insert some
+    UA_StatusCode *result = NULL;
+    size_t resultSize = 0;
+    ck_assert_uint_eq(updateHistory(UA_PERFORMUPDATETYPE_UPDATE, testDataSorted, &result, &resultSize),
+                      UA_STATUSCODE_GOOD);
+
+    for (size_t i = 0; i < resultSize; ++i) {
+        ck_assert_str_eq(UA_StatusCode_name(result[i]), UA_StatusCode_name(testDataUpdateResult[i]));
+    }
+    UA_Array_delete(result, resultSize, &UA_TYPES[UA_TYPES_STATUSCODE]);
+
+    UA_HistoryData data;
+    UA_HistoryData_init(&data);
+
+    testResult(testDataSorted, &data);
+
+    for (size_t i = 0; i < data.dataValuesSize; ++i) {
+        ck_assert_uint_eq(data.dataValues[i].hasValue, true);
+        ck_assert(data.dataValues[i].value.type == &UA_TYPES[UA_TYPES_INT64]);
+        ck_assert_int_eq(*((UA_Int64*)data.dataValues[i].value.data), UA_PERFORMUPDATETYPE_UPDATE);
+    }
+
+    UA_HistoryData_clear(&data);
+    UA_HistoryDataBackend_Memory_clear(&setting.historizingBackend);
+}
+END_TEST
+
+START_TEST(Server_HistorizingColumnarMixedTypes)
+{
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_Memory_Columnar(4);
+
+    /* Numeric samples in time order */
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    value.hasValue = true;
+    value.hasSourceTimestamp = true;
+    for(UA_Int64 i = 0; i < 10; i++) {
+        UA_Int64 d = i * 2;
+        UA_Variant_setScalar(&value.value, &d, &UA_TYPES[UA_TYPES_INT64]);
+        value.sourceTimestamp = (i * 2) * UA_DATETIME_SEC;
+        ck_assert_uint_eq(backend.serverSetHistoryData(server, backend.context, NULL, NULL,
+                                                       &outNodeId, false, &value),
+                          UA_STATUSCODE_GOOD);
+    }
+
+    /* A string sample in between converts the chunk to full DataValues */
+    UA_String s = UA_STRING("text");
+    UA_Variant_setScalar(&value.value, &s, &UA_TYPES[UA_TYPES_STRING]);
+    value.sourceTimestamp = 5 * UA_DATETIME_SEC;
+    ck_assert_uint_eq(backend.serverSetHistoryData(server, backend.context, NULL, NULL,
+                                                   &outNodeId, false, &value),
+                      UA_STATUSCODE_GOOD);
+
+    size_t end = backend.getEnd(server, backend.context, NULL, NULL, &outNodeId);
+    ck_assert_uint_eq(end, 11);
+    size_t index = backend.getDateTimeMatch(server, backend.context, NULL, NULL, &outNodeId,
+                                            5 * UA_DATETIME_SEC, MATCH_EQUAL);
+    ck_assert_uint_eq(index, 3);
+
+    UA_DataValue values[11];
+    size_t provided = 0;
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    UA_ByteString outCp = UA_BYTESTRING_NULL;
+    UA_NumericRange range = {0, NULL};
+    UA_StatusCode ret =
+        backend.copyDataValues(server, backend.context, NULL, NULL, &outNodeId,
+                               0, end - 1, false, 11, range, false, &cp, &outCp,
+                               &provided, values);
+    ck_assert_uint_eq(ret, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(provided, 11);
+    ck_assert_uint_eq(outCp.length, 0);
+    for(size_t i = 0; i < provided; i++) {
+        ck_assert(values[i].hasServerTimestamp);
+        if(i > 0)
+            ck_assert_int_lt(values[i-1].sourceTimestamp, values[i].sourceTimestamp);
+        if(i == 3) {
+            ck_assert(values[i].value.type == &UA_TYPES[UA_TYPES_STRING]);
+            ck_assert(UA_String_equal((UA_String*)values[i].value.data, &s));
+        } else {
+            ck_assert(values[i].value.type == &UA_TYPES[UA_TYPES_INT64]);
+            ck_assert_int_eq(*(UA_Int64*)values[i].value.data * UA_DATETIME_SEC,
+                             values[i].sourceTimestamp);
+        }
+        UA_DataValue_clear(&values[i]);
+    }
+
+    UA_HistoryDataBackend_Memory_clear(&backend);
+}
+END_TEST
+
+START_TEST(Server_HistorizingBackendCompressed)
+{
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_Memory_Compressed(4);
+    UA_HistorizingNodeIdSettings setting;
+    setting.historizingBackend = backend;
+    setting.maxHistoryDataResponseSize = 1000;
+    setting.historizingUpdateStrategy = UA_HISTORIZINGUPDATESTRATEGY_USER;
+    UA_StatusCode ret = gathering->registerNodeId(server, gathering->context, &outNodeId, setting);
+    ck_assert_str_eq(UA_StatusCode_name(ret), UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    // fill backend in time order to pack the full chunks
+    ck_assert_uint_eq(fillHistoricalDataBackend(backend, testDataSorted), true);
+
+    // read all in one
+    UA_UInt32 retval = testHistoricalDataBackend(100);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+
+    // read continuous one at one request
+    retval = testHistoricalDataBackend(1);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+
+    // read continuous two at one request
+    retval = testHistoricalDataBackend(2);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+    UA_HistoryDataBackend_Memory_clear(&setting.historizingBackend);
+}
+END_TEST
+
+START_TEST(Server_HistorizingUpdateCompressed)
+{
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_Memory_Compressed(4);
+    UA_HistorizingNodeIdSettings setting;
+    setting.historizingBackend = backend;
+    setting.maxHistoryDataResponseSize = 1000;
+    setting.historizingUpdateStrategy = UA_HISTORIZINGUPDATESTRATEGY_USER;
+    UA_StatusCode ret = gathering->registerNodeId(server, gathering->context, &outNodeId, setting);
+    ck_assert_str_eq(UA_StatusCode_name(ret), UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    // fill backend with insert in time order
+    ck_assert_str_eq(UA_StatusCode_name(updateHistory(UA_PERFORMUPDATETYPE_INSERT, testDataSorted, NULL, NULL))
+                                        , UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    testResult(testDataSorted, NULL);
+
+    // delete some values from the packed chunks
+    ck_assert_str_eq(UA_StatusCode_name(deleteHistory(DELETE_START_TIME, DELETE_STOP_TIME)),
+                     UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    testResult(testDataAfterDelete, NULL);
+
+    // update all and insert some
+    UA_StatusCode *result = NULL;
+    size_t resultSize = 0;
+    ck_assert_uint_eq(updateHistory(UA_PERFORMUPDATETYPE_UPDATE, testDataSorted, &result, &resultSize),
+                      UA_STATUSCODE_GOOD);
+
+    for (size_t i = 0; i < resultSize; ++i) {
+        ck_assert_str_eq(UA_StatusCode_name(result[i]), UA_StatusCode_name(testDataUpdateResult[i]));
+    }
+    UA_Array_delete(result, resultSize, &UA_TYPES[UA_TYPES_STATUSCODE]);
+
+    UA_HistoryData data;
+    UA_HistoryData_init(&data);
+
+    testResult(testDataSorted, &data);
+
+    for (size_t i = 0; i < data.dataValuesSize; ++i) {
+        ck_assert_uint_eq(data.dataValues[i].hasValue, true);
+        ck_assert(data.dataValues[i].value.type == &UA_TYPES[UA_TYPES_INT64]);
+        ck_assert_int_eq(*((UA_Int64*)data.dataValues[i].value.data), UA_PERFORMUPDATETYPE_UPDATE);
+    }
+
+    UA_HistoryData_clear(&data);
+    UA_HistoryDataBackend_Memory_clear(&setting.historizingBackend);
+}
+END_TEST
+
+#define COMPRESSED_SAMPLES 1000
+
+static void
+compressedSample(size_t i, UA_DataValue *value, UA_Double *d) {
+    /* A fixed period with some jitter and a slowly changing value */
+    UA_DataValue_init(value);
+    value->hasSourceTimestamp = true;
+    value->sourceTimestamp = UA_DateTime_fromUnixTime(1600000000) +
+        (UA_DateTime)i * UA_DATETIME_SEC + (UA_DateTime)((i % 7 == 0) ? i % 50 : 0);
+    value->hasServerTimestamp = true;
+    value->serverTimestamp = (i % 3 == 0) ? value->sourceTimestamp :
+        value->sourceTimestamp + (UA_DateTime)(i * 17) * UA_DATETIME_MSEC;
+    if(i % 100 == 50) {
+        value->hasStatus = true;
+        value->status = UA_STATUSCODE_UNCERTAIN;
+    }
+    if(i % 250 == 249)
+        return; /* No value */
+    *d = 20.0 + (UA_Double)(i / 10) * 0.125 + ((i % 13 == 0) ? 1e-9 * (UA_Double)i : 0.0);
+    value->hasValue = true;
+    UA_Variant_setScalar(&value->value, d, &UA_TYPES[UA_TYPES_DOUBLE]);
+}
+
+static void
+checkCompressedSamples(UA_HistoryDataBackend *backend, size_t skipFrom, size_t skipTo) {
+    size_t end = backend->getEnd(server, backend->context, NULL, NULL, &outNodeId);
+    ck_assert_uint_eq(end, COMPRESSED_SAMPLES - (skipTo - skipFrom));
+    UA_DataValue *values = (UA_DataValue*)UA_calloc(end, sizeof(UA_DataValue));
+    size_t provided = 0;
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    UA_ByteString outCp = UA_BYTESTRING_NULL;
+    UA_NumericRange range = {0, NULL};
+    UA_StatusCode ret =
+        backend->copyDataValues(server, backend->context, NULL, NULL, &outNodeId,
+                                0, end - 1, false, end, range, false, &cp, &outCp,
+                                &provided, values);
+    ck_assert_uint_eq(ret, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(provided, end);
+    size_t j = 0;
+    for(size_t i = 0; i < COMPRESSED_SAMPLES; i++) {
+        if(i >= skipFrom && i < skipTo)
+            continue;
+        UA_DataValue expected;
+        UA_Double d;
+        compressedSample(i, &expected, &d);
+        ck_assert(UA_order(&expected, &values[j], &UA_TYPES[UA_TYPES_DATAVALUE]) == UA_ORDER_EQ);
+
+        /* Random access */
+        size_t index = backend->getDateTimeMatch(server, backend->context, NULL, NULL, &outNodeId,
+                                                 expected.sourceTimestamp, MATCH_EQUAL);
+        ck_assert_uint_eq(index, j);
+        const UA_DataValue *dv = backend->getDataValue(server, backend->context, NULL, NULL,
+                                                       &outNodeId, index);
+        ck_assert(UA_order(&expected, dv, &UA_TYPES[UA_TYPES_DATAVALUE]) == UA_ORDER_EQ);
+        UA_DataValue_clear(&values[j]);
+        j++;
+    }
+    UA_free(values);
+}
+
+START_TEST(Server_HistorizingCompressedDouble)
+{
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_Memory_Compressed(64);
+    for(size_t i = 0; i < COMPRESSED_SAMPLES; i++) {
+        UA_DataValue value;
+        UA_Double d;
+        compressedSample(i, &value, &d);
+        ck_assert_uint_eq(backend.serverSetHistoryData(server, backend.context, NULL, NULL,
+                                                       &outNodeId, false, &value),
+                          UA_STATUSCODE_GOOD);
+    }
+    checkCompressedSamples(&backend, 0, 0);
+
+    /* Remove samples across packed chunks */
+    UA_DataValue first;
+    UA_DataValue last;
+    UA_Double d;
+    compressedSample(100, &first, &d);
+    compressedSample(300, &last, &d);
+    ck_assert_uint_eq(backend.removeDataValue(server, backend.context, NULL, NULL, &outNodeId,
+                                              first.sourceTimestamp, last.sourceTimestamp),
+                      UA_STATUSCODE_GOOD);
+    checkCompressedSamples(&backend, 100, 300);
+
+    /* Insert them again. This unpacks the chunks. */
+    for(size_t i = 100; i < 300; i++) {
+        UA_DataValue value;
+        compressedSample(i, &value, &d);
+        ck_assert_uint_eq(backend.insertDataValue(server, backend.context, NULL, NULL,
+                                                  &outNodeId, &value),
+                          UA_STATUSCODE_GOOD);
+    }
+    checkCompressedSamples(&backend, 0, 0);
+
+    UA_HistoryDataBackend_Memory_clear(&backend);
+}
+END_TEST
+
+#define AGGREGATE_BASE UA_DateTime_fromUnixTime(1600000000)
+
+/* Ten samples with one second in between and the values 0 to 9. The sixth
+ * sample has a bad status. */
+static UA_HistoryDataBackend
+fillAggregateBackend(size_t maxResponseSize) {
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_Memory(1, 100);
+    UA_HistorizingNodeIdSettings setting;
+    setting.historizingBackend = backend;
+    setting.maxHistoryDataResponseSize = maxResponseSize;
+    setting.historizingUpdateStrategy = UA_HISTORIZINGUPDATESTRATEGY_USER;
+    UA_StatusCode ret = gathering->registerNodeId(server, gathering->context, &outNodeId, setting);
+    ck_assert_str_eq(UA_StatusCode_name(ret), UA_StatusCode_name(UA_STATUSCODE_GOOD));
+    for(size_t i = 0; i < 10; i++) {
+        UA_Double d = (UA_Double)i;
+        UA_DataValue value;
+        UA_DataValue_init(&value);
+        UA_Variant_setScalar(&value.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+        value.hasValue = true;
+        value.hasSourceTimestamp = true;
+        value.sourceTimestamp = AGGREGATE_BASE + (UA_DateTime)i * UA_DATETIME_SEC;
+        if(i == 5) {
+            value.hasStatus = true;
+            value.status = UA_STATUSCODE_BADSENSORFAILURE;
+        }
+        ck_assert_uint_eq(backend.serverSetHistoryData(server, backend.context, NULL, NULL,
+                                                       &outNodeId, false, &value),
+                          UA_STATUSCODE_GOOD);
+    }
+    return backend;
+}
+
+static UA_HistoryReadResponse
+readProcessed(UA_UInt32 aggregate, const UA_ByteString *continuationPoint) {
+    UA_NodeId aggregateType = UA_NODEID_NUMERIC(0, aggregate);
+    UA_ReadProcessedDetails details;
+    UA_ReadProcessedDetails_init(&details);
+    details.startTime = AGGREGATE_BASE;
+    details.endTime = AGGREGATE_BASE + 10 * UA_DATETIME_SEC;
+    details.processingInterval = 5000.0;
+    details.aggregateTypeSize = 1;
+    details.aggregateType = &aggregateType;
+    details.aggregateConfiguration.useServerCapabilitiesDefaults = true;
+
+    UA_HistoryReadValueId item;
+    UA_HistoryReadValueId_init(&item);
+    item.nodeId = outNodeId;
+    if(continuationPoint)
+        item.continuationPoint = *continuationPoint;
+
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    UA_ExtensionObject_setValue(&request.historyReadDetails, &details,
+                                &UA_TYPES[UA_TYPES_READPROCESSEDDETAILS]);
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    request.nodesToReadSize = 1;
+    request.nodesToRead = &item;
+    return UA_Client_Service_historyRead(client, request);
+}
+
+static UA_HistoryData *
+processedData(UA_HistoryReadResponse *response) {
+    ck_assert_uint_eq(response->responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response->resultsSize, 1);
+    ck_assert_uint_eq(response->results[0].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert(response->results[0].historyData.content.decoded.type ==
+              &UA_TYPES[UA_TYPES_HISTORYDATA]);
+    return (UA_HistoryData*)response->results[0].historyData.content.decoded.data;
+}
+
+static void
+checkProcessed(UA_UInt32 aggregate, UA_Double v1, UA_StatusCode s1,
+               UA_Double v2, UA_StatusCode s2) {
+    UA_HistoryReadResponse response = readProcessed(aggregate, NULL);
+    UA_HistoryData *data = processedData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 2);
+    UA_Double expected[2] = {v1, v2};
+    UA_StatusCode status[2] = {s1, s2};
+    for(size_t i = 0; i < 2; i++) {
+        UA_DataValue *dv = &data->dataValues[i];
+        ck_assert_str_eq(UA_StatusCode_name(dv->status & 0xFFFF0000),
+                         UA_StatusCode_name(status[i]));
+        ck_assert(dv->hasValue);
+        UA_Double d;
+        if(dv->value.type == &UA_TYPES[UA_TYPES_INT32])
+            d = *(UA_Int32*)dv->value.data;
+        else
+            d = *(UA_Double*)dv->value.data;
+        ck_assert(d > expected[i] - 1e-9 && d < expected[i] + 1e-9);
+    }
+    UA_HistoryReadResponse_clear(&response);
+}
+
+START_TEST(Server_HistorizingReadProcessed)
+{
+    UA_HistoryDataBackend backend = fillAggregateBackend(100);
+
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_AVERAGE, 2.0, UA_STATUSCODE_GOOD,
+                   7.5, UA_STATUSCODE_UNCERTAINDATASUBNORMAL);
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_COUNT, 5, UA_STATUSCODE_GOOD,
+                   4, UA_STATUSCODE_UNCERTAINDATASUBNORMAL);
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_MINIMUM, 0.0, UA_STATUSCODE_GOOD,
+                   6.0, UA_STATUSCODE_UNCERTAINDATASUBNORMAL);
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_MAXIMUM, 4.0, UA_STATUSCODE_GOOD,
+                   9.0, UA_STATUSCODE_UNCERTAINDATASUBNORMAL);
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_START, 0.0, UA_STATUSCODE_GOOD,
+                   6.0, UA_STATUSCODE_GOOD);
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_END, 4.0, UA_STATUSCODE_GOOD,
+                   9.0, UA_STATUSCODE_GOOD);
+    /* The bad sample at 5s is interpolated from its neighbours */
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_INTERPOLATIVE, 0.0, UA_STATUSCODE_GOOD,
+                   5.0, UA_STATUSCODE_GOOD);
+    /* The value after the last sample is extrapolated */
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_TIMEAVERAGE, 2.5, UA_STATUSCODE_GOOD,
+                   7.4, UA_STATUSCODE_UNCERTAINDATASUBNORMAL);
+    checkProcessed(UA_NS0ID_AGGREGATEFUNCTION_TOTAL, 12.5, UA_STATUSCODE_GOOD,
+                   37.0, UA_STATUSCODE_UNCERTAINDATASUBNORMAL);
+
+    /* Start and End return the timestamp of the raw sample */
+    UA_HistoryReadResponse response = readProcessed(UA_NS0ID_AGGREGATEFUNCTION_START, NULL);
+    UA_HistoryData *data = processedData(&response);
+    ck_assert_int_eq(data->dataValues[1].sourceTimestamp, AGGREGATE_BASE + 6 * UA_DATETIME_SEC);
+    UA_HistoryReadResponse_clear(&response);
+
+    response = readProcessed(UA_NS0ID_AGGREGATEFUNCTION_RANGE, NULL);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADAGGREGATENOTSUPPORTED);
+    UA_HistoryReadResponse_clear(&response);
+
+    UA_HistoryDataBackend_Memory_clear(&backend);
+}
+END_TEST
+
+START_TEST(Server_HistorizingReadProcessedContinuation)
+{
+    UA_HistoryDataBackend backend = fillAggregateBackend(1);
+
+    UA_HistoryReadResponse response = readProcessed(UA_NS0ID_AGGREGATEFUNCTION_AVERAGE, NULL);
+    UA_HistoryData *data = processedData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 1);
+    ck_assert(*(UA_Double*)data->dataValues[0].value.data == 2.0);
+    ck_assert_int_eq(data->dataValues[0].sourceTimestamp, AGGREGATE_BASE);
+    ck_assert_uint_gt(response.results[0].continuationPoint.length, 0);
+
+    UA_ByteString cp;
+    UA_ByteString_copy(&response.results[0].continuationPoint, &cp);
+    UA_HistoryReadResponse_clear(&response);
+    response = readProcessed(UA_NS0ID_AGGREGATEFUNCTION_AVERAGE, &cp);
+    data = processedData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 1);
+    ck_assert(*(UA_Double*)data->dataValues[0].value.data == 7.5);
+    ck_assert_int_eq(data->dataValues[0].sourceTimestamp, AGGREGATE_BASE + 5 * UA_DATETIME_SEC);
+    ck_assert_uint_eq(response.results[0].continuationPoint.length, 0);
+    UA_HistoryReadResponse_clear(&response);
+    UA_ByteString_clear(&cp);
+
+    UA_HistoryDataBackend_Memory_clear(&backend);
+}
+END_TEST
+
+START_TEST(Server_HistorizingReadAtTime)
+{
+    UA_HistoryDataBackend backend = fillAggregateBackend(100);
+
+    UA_DateTime reqTimes[4] = {AGGREGATE_BASE + 2 * UA_DATETIME_SEC,
+                               AGGREGATE_BASE + 2500 * UA_DATETIME_MSEC,
+                               AGGREGATE_BASE + 20 * UA_DATETIME_SEC,
+                               AGGREGATE_BASE - UA_DATETIME_SEC};
+    UA_ReadAtTimeDetails details;
+    UA_ReadAtTimeDetails_init(&details);
+    details.reqTimesSize = 4;
+    details.reqTimes = reqTimes;
+    details.useSimpleBounds = true;
+
+    UA_HistoryReadValueId item;
+    UA_HistoryReadValueId_init(&item);
+    item.nodeId = outNodeId;
+
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    UA_ExtensionObject_setValue(&request.historyReadDetails, &details,
+                                &UA_TYPES[UA_TYPES_READATTIMEDETAILS]);
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    request.nodesToReadSize = 1;
+    request.nodesToRead = &item;
+    UA_HistoryReadResponse response = UA_Client_Service_historyRead(client, request);
+    UA_HistoryData *data = processedData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 4);
+
+    /* The raw sample */
+    ck_assert(!data->dataValues[0].hasStatus);
+    ck_assert(*(UA_Double*)data->dataValues[0].value.data == 2.0);
+    /* Interpolated */
+    ck_assert_uint_eq(data->dataValues[1].status & 0xFFFF0000, UA_STATUSCODE_GOOD);
+    ck_assert(*(UA_Double*)data->dataValues[1].value.data == 2.5);
+    /* Extrapolated after the last sample */
+    ck_assert_uint_eq(data->dataValues[2].status & 0xFFFF0000,
+                      UA_STATUSCODE_UNCERTAINDATASUBNORMAL);
+    ck_assert(*(UA_Double*)data->dataValues[2].value.data == 9.0);
+    /* No data before the first sample */
+    ck_assert_uint_eq(data->dataValues[3].status, UA_STATUSCODE_BADNODATA);
+    ck_assert(!data->dataValues[3].hasValue);
+    for(size_t i = 0; i < 4; i++)
+        ck_assert_int_eq(data->dataValues[i].sourceTimestamp, reqTimes[i]);
+    UA_HistoryReadResponse_clear(&response);
+
+    UA_HistoryDataBackend_Memory_clear(&backend);
+}
+END_TEST
+
+#define SETVALUES_NODES 2000
+
+START_TEST(Server_HistorizingSetValues)
+{
+    /* Many nodes share a backend. They are looked up by their hash. */
+    UA_HistorizingNodeIdSettings setting;
+    memset(&setting, 0, sizeof(UA_HistorizingNodeIdSettings));
+    setting.historizingBackend = UA_HistoryDataBackend_Memory(1, 4);
+    setting.maxHistoryDataResponseSize = 100;
+    setting.historizingUpdateStrategy = UA_HISTORIZINGUPDATESTRATEGY_VALUESET;
+
+    UA_NodeId *nodeIds = (UA_NodeId*)
+        UA_Array_new(SETVALUES_NODES, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Boolean *historizing = (UA_Boolean*)
+        UA_Array_new(SETVALUES_NODES, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    UA_DataValue *values = (UA_DataValue*)
+        UA_Array_new(SETVALUES_NODES, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_UInt32 *numbers = (UA_UInt32*)
+        UA_Array_new(SETVALUES_NODES, &UA_TYPES[UA_TYPES_UINT32]);
+    for(size_t i = 0; i < SETVALUES_NODES; i++) {
+        if(i % 2 == 0) {
+            nodeIds[i] = UA_NODEID_NUMERIC(1, (UA_UInt32)i + 10000);
+        } else {
+            char name[32];
+            snprintf(name, sizeof(name), "setValues.%u", (unsigned)i);
+            nodeIds[i] = UA_NODEID_STRING_ALLOC(1, name);
+        }
+        UA_StatusCode retval =
+            gathering->registerNodeId(server, gathering->context, &nodeIds[i], setting);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        historizing[i] = true;
+        numbers[i] = (UA_UInt32)i;
+        UA_Variant_setScalar(&values[i].value, &numbers[i], &UA_TYPES[UA_TYPES_UINT32]);
+        values[i].hasValue = true;
+        values[i].sourceTimestamp = AGGREGATE_BASE;
+        values[i].hasSourceTimestamp = true;
+    }
+    ck_assert_uint_eq(gathering->registerNodeId(server, gathering->context,
+                                                &nodeIds[1], setting),
+                      UA_STATUSCODE_BADNODEIDEXISTS);
+
+    /* Historize the values in one call */
+    UA_HistoryDatabase *hdb = &UA_Server_getConfig(server)->historyDatabase;
+    ck_assert(hdb->setValues != NULL);
+    hdb->setValues(server, hdb->context, NULL, NULL, SETVALUES_NODES,
+                   nodeIds, historizing, values);
+
+    UA_HistoryDataBackend *backend = &setting.historizingBackend;
+    for(size_t i = 0; i < SETVALUES_NODES; i++) {
+        const UA_HistorizingNodeIdSettings *s2 =
+            gathering->getHistorizingSetting(server, gathering->context, &nodeIds[i]);
+        ck_assert(s2 != NULL);
+        ck_assert_uint_eq(backend->getEnd(server, backend->context, NULL, NULL,
+                                          &nodeIds[i]), 1);
+        const UA_DataValue *dv =
+            backend->getDataValue(server, backend->context, NULL, NULL, &nodeIds[i], 0);
+        ck_assert(dv != NULL);
+        ck_assert_uint_eq(*(UA_UInt32*)dv->value.data, i);
+    }
+
+    /* Values are stored only to the registered nodes */
+    UA_NodeId unknown = UA_NODEID_NUMERIC(1, 9999);
+    hdb->setValues(server, hdb->context, NULL, NULL, 1, &unknown, historizing, values);
+    ck_assert(gathering->getHistorizingSetting(server, gathering->context,
+                                               &unknown) == NULL);
+
+    for(size_t i = 0; i < SETVALUES_NODES; i++)
+        UA_Variant_init(&values[i].value);
+    UA_Array_delete(values, SETVALUES_NODES, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    UA_Array_delete(numbers, SETVALUES_NODES, &UA_TYPES[UA_TYPES_UINT32]);
+    UA_Array_delete(historizing, SETVALUES_NODES, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    UA_Array_delete(nodeIds, SETVALUES_NODES, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_HistoryDataBackend_Memory_clear(&setting.historizingBackend);
+}
+END_TEST
+
+#ifdef __linux__
+
+static int
+removeStoreFile(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf) {
+    return remove(path);
+}
+
+static char lastSegment[4096];
+
+static int
+findLastSegment(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf) {
+    size_t len = strlen(path);
+    if(len > 4 && strcmp(&path[len - 4], ".seg") == 0 && strcmp(path, lastSegment) > 0)
+        strncpy(lastSegment, path, sizeof(lastSegment) - 1);
+    return 0;
+}
+
+START_TEST(Server_HistorizingBackendFile)
+{
+    char dir[] = "/tmp/open62541_history_XXXXXX";
+    ck_assert(mkdtemp(dir) != NULL);
+
+    /* Small segments to test the rollover */
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_File(dir, 256);
+    ck_assert(backend.context != NULL);
+    UA_HistorizingNodeIdSettings setting;
+    setting.historizingBackend = backend;
+    setting.maxHistoryDataResponseSize = 1000;
+    setting.historizingUpdateStrategy = UA_HISTORIZINGUPDATESTRATEGY_USER;
+    UA_StatusCode ret = gathering->registerNodeId(server, gathering->context, &outNodeId, setting);
+    ck_assert_str_eq(UA_StatusCode_name(ret), UA_StatusCode_name(UA_STATUSCODE_GOOD));
+
+    // empty backend should not crash
+    UA_UInt32 retval = testHistoricalDataBackend(100);
+    fprintf(stderr, "%x tests expected failed.\n", retval);
+
+    // fill backend in time order
+    ck_assert_uint_eq(fillHistoricalDataBackend(backend, testDataSorted), true);
+
+    retval = testHistoricalDataBackend(100);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+
+    retval = testHistoricalDataBackend(1);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+
+    retval = testHistoricalDataBackend(2);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+    UA_HistoryDataBackend_File_clear(&backend);
+
+    // reopen the store and read the persisted data
+    backend = UA_HistoryDataBackend_File(dir, 256);
+    setting.historizingBackend = backend;
+    gathering->updateNodeIdSetting(server, gathering->context, &outNodeId, setting);
+    retval = testHistoricalDataBackend(100);
+    fprintf(stderr, "%x tests failed.\n", retval);
+    ck_assert_uint_eq(retval, 0);
+    UA_HistoryDataBackend_File_clear(&backend);
+
+    nftw(dir, removeStoreFile, 16, FTW_DEPTH | FTW_PHYS);
+}
+END_TEST
+
+START_TEST(Server_HistorizingBackendFileRecovery)
+{
+    char dir[] = "/tmp/open62541_history_XXXXXX";
+    ck_assert(mkdtemp(dir) != NULL);
+    UA_HistoryDataBackend backend = UA_HistoryDataBackend_File(dir, 0);
+
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    value.hasValue = true;
+    value.hasSourceTimestamp = true;
+    UA_Int64 d = 0;
+    UA_Variant_setScalar(&value.value, &d, &UA_TYPES[UA_TYPES_INT64]);
+    for(d = 1; d <= 10; d++) {
+        value.sourceTimestamp = d * UA_DATETIME_SEC;
+        ck_assert_uint_eq(backend.serverSetHistoryData(server, backend.context, NULL, NULL,
+                                                       &outNodeId, false, &value),
+                          UA_STATUSCODE_GOOD);
+    }
+
+    /* Samples are appended in time order */
+    value.sourceTimestamp = 5 * UA_DATETIME_SEC;
+    ck_assert_uint_eq(backend.serverSetHistoryData(server, backend.context, NULL, NULL,
+                                                   &outNodeId, false, &value),
+                      UA_STATUSCODE_BADINVALIDTIMESTAMP);
+    UA_HistoryDataBackend_File_clear(&backend);
+
+    /* Simulate a torn write of the last record */
+    lastSegment[0] = 0;
+    nftw(dir, findLastSegment, 16, FTW_PHYS);
+    struct stat st;
+    ck_assert_int_eq(stat(lastSegment, &st), 0);
+    ck_assert_int_eq(truncate(lastSegment, st.st_size - 3), 0);
+
+    /* The incomplete record is dropped when the store is reopened */
+    backend = UA_HistoryDataBackend_File(dir, 0);
+    ck_assert_uint_eq(backend.getEnd(server, backend.context, NULL, NULL, &outNodeId), 9);
+    d = 20;
+    value.sourceTimestamp = d * UA_DATETIME_SEC;
+    ck_assert_uint_eq(backend.serverSetHistoryData(server, backend.context, NULL, NULL,
+                                                   &outNodeId, false, &value),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(backend.getEnd(server, backend.context, NULL, NULL, &outNodeId), 10);
+    const UA_DataValue *last =
+        backend.getDataValue(server, backend.context, NULL, NULL, &outNodeId, 9);
+    ck_assert(last != NULL);
+    ck_assert_int_eq(last->sourceTimestamp, 20 * UA_DATETIME_SEC);
+    ck_assert_int_eq(*(UA_Int64*)last->value.data, 20);
+    size_t index = backend.getDateTimeMatch(server, backend.context, NULL, NULL, &outNodeId,
+                                            9 * UA_DATETIME_SEC, MATCH_AFTER);
+    ck_assert_uint_eq(index, 9);
+    UA_HistoryDataBackend_File_clear(&backend);
+
+    nftw(dir, removeStoreFile, 16, FTW_DEPTH | FTW_PHYS);
+}
+END_TEST
+
+#endif
+
 static Suite *
 testSuite_Client(void) {
     Suite *s = suite_create("Server Historical Data");
@@ -967,6 +1709,20 @@ testSuite_Client(void) {
     tcase_add_test(tc_server, Server_HistorizingUpdateInsert);
     tcase_add_test(tc_server, Server_HistorizingUpdateReplace);
     tcase_add_test(tc_server, Server_HistorizingUpdateUpdate);
+    tcase_add_test(tc_server, Server_HistorizingBackendColumnar);
+    tcase_add_test(tc_server, Server_HistorizingUpdateColumnar);
+    tcase_add_test(tc_server, Server_HistorizingColumnarMixedTypes);
+    tcase_add_test(tc_server, Server_HistorizingBackendCompressed);
+    tcase_add_test(tc_server, Server_HistorizingUpdateCompressed);
+    tcase_add_test(tc_server, Server_HistorizingCompressedDouble);
+    tcase_add_test(tc_server, Server_HistorizingReadProcessed);
+    tcase_add_test(tc_server, Server_HistorizingReadProcessedContinuation);
+    tcase_add_test(tc_server, Server_HistorizingReadAtTime);
+    tcase_add_test(tc_server, Server_HistorizingSetValues);
+#ifdef __linux__
+    tcase_add_test(tc_server, Server_HistorizingBackendFile);
+    tcase_add_test(tc_server, Server_HistorizingBackendFileRecovery);
+#endif
     suite_add_tcase(s, tc_server);
 
     return s;
@@ -0,0 +1,330 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <open62541/client.h>
+#include <open62541/client_config_default.h>
+#include <open62541/client_highlevel.h>
+#include <open62541/plugin/historydata/history_data_gathering_default.h>
+#include <open62541/plugin/historydata/history_database_default.h>
+#include <open62541/server.h>
+#include <open62541/server_config_default.h>
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "test_helpers.h"
+#include "thread_wrapper.h"
+
+#define EVENT_BASE (UA_DATETIME_UNIX_EPOCH + 1000 * (UA_DateTime)UA_DATETIME_SEC)
+#define MAX_EVENTS 50
+
+static UA_Server *server;
+static UA_Boolean running;
+static THREAD_HANDLE server_thread;
+static UA_Client *client;
+
+static const UA_NodeId serverId = {0, UA_NODEIDTYPE_NUMERIC, {UA_NS0ID_SERVER}};
+
+THREAD_CALLBACK(serverloop) {
+    while(running) {
+        UA_Server_run_iterate(server, false);
+    }
+    return 0;
+}
+
+static void
+setSelectClause(UA_SimpleAttributeOperand *sao, const char *name) {
+    UA_SimpleAttributeOperand_init(sao);
+    sao->typeDefinitionId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE);
+    sao->browsePathSize = 1;
+    sao->browsePath = UA_QualifiedName_new();
+    *sao->browsePath = UA_QUALIFIEDNAME_ALLOC(0, name);
+    sao->attributeId = UA_ATTRIBUTEID_VALUE;
+}
+
+/* Record EventType, Time and Severity of the events emitted by the node */
+static void
+addHistoricalEventFilter(const UA_NodeId nodeId) {
+    UA_EventFilter filter;
+    UA_EventFilter_init(&filter);
+    filter.selectClauses = (UA_SimpleAttributeOperand*)
+        UA_Array_new(3, &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]);
+    filter.selectClausesSize = 3;
+    setSelectClause(&filter.selectClauses[0], "EventType");
+    setSelectClause(&filter.selectClauses[1], "Time");
+    setSelectClause(&filter.selectClauses[2], "Severity");
+
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Variant_setScalar(&attr.value, &filter, &UA_TYPES[UA_TYPES_EVENTFILTER]);
+    attr.dataType = UA_TYPES[UA_TYPES_EVENTFILTER].typeId;
+    UA_StatusCode res =
+        UA_Server_addVariableNode(server, UA_NODEID_NULL, nodeId,
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY),
+                                  UA_QUALIFIEDNAME(0, "HistoricalEventFilter"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE),
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_EventFilter_clear(&filter);
+
+    res = UA_Server_writeEventNotifier(server, nodeId,
+                                       UA_EVENTNOTIFIER_SUBSCRIBE_TO_EVENT |
+                                       UA_EVENTNOTIFIER_HISTORY_READ);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+}
+
+static void setup(void) {
+    running = true;
+    server = UA_Server_newForUnitTest();
+    ck_assert(server != NULL);
+    UA_ServerConfig *config = UA_Server_getConfig(server);
+    config->historyDatabase =
+        UA_HistoryDatabase_defaultWithEvents(UA_HistoryDataGathering_Default(1),
+                                             MAX_EVENTS, 0, 0);
+    addHistoricalEventFilter(serverId);
+    UA_StatusCode res = UA_Server_run_startup(server);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    THREAD_CREATE(server_thread, serverloop);
+
+    client = UA_Client_newForUnitTest();
+    res = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+}
+
+static void teardown(void) {
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    running = false;
+    THREAD_JOIN(server_thread);
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+}
+
+/* The event i has the time EVENT_BASE + i seconds and severity i */
+static void
+triggerEventAt(const UA_NodeId origin, size_t i) {
+    UA_NodeId eventNodeId;
+    UA_StatusCode res =
+        UA_Server_createEvent(server, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEEVENTTYPE),
+                              &eventNodeId);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_DateTime time = EVENT_BASE + (UA_DateTime)i * UA_DATETIME_SEC;
+    UA_UInt16 severity = (UA_UInt16)i;
+    UA_Server_writeObjectProperty_scalar(server, eventNodeId, UA_QUALIFIEDNAME(0, "Time"),
+                                         &time, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Server_writeObjectProperty_scalar(server, eventNodeId, UA_QUALIFIEDNAME(0, "Severity"),
+                                         &severity, &UA_TYPES[UA_TYPES_UINT16]);
+    res = UA_Server_triggerEvent(server, eventNodeId, origin, NULL, true);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+}
+
+static void
+triggerEvent(size_t i) {
+    triggerEventAt(serverId, i);
+}
+
+/* Select the Severity of events with a Severity >= minSeverity */
+static UA_HistoryReadResponse
+readNodeEvents(const UA_NodeId nodeId, UA_DateTime startTime, UA_DateTime endTime,
+               UA_UInt32 numValues, UA_UInt16 minSeverity,
+               const UA_ByteString *continuationPoint) {
+    UA_ReadEventDetails details;
+    UA_ReadEventDetails_init(&details);
+    details.startTime = startTime;
+    details.endTime = endTime;
+    details.numValuesPerNode = numValues;
+
+    UA_SimpleAttributeOperand select;
+    setSelectClause(&select, "Severity");
+    details.filter.selectClausesSize = 1;
+    details.filter.selectClauses = &select;
+
+    UA_ContentFilterElement element;
+    UA_ContentFilterElement_init(&element);
+    UA_LiteralOperand literal;
+    UA_LiteralOperand_init(&literal);
+    UA_Variant_setScalar(&literal.value, &minSeverity, &UA_TYPES[UA_TYPES_UINT16]);
+    UA_ExtensionObject operands[2];
+    UA_ExtensionObject_setValue(&operands[0], &select,
+                                &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]);
+    UA_ExtensionObject_setValue(&operands[1], &literal,
+                                &UA_TYPES[UA_TYPES_LITERALOPERAND]);
+    element.filterOperator = UA_FILTEROPERATOR_GREATERTHANOREQUAL;
+    element.filterOperandsSize = 2;
+    element.filterOperands = operands;
+    details.filter.whereClause.elementsSize = 1;
+    details.filter.whereClause.elements = &element;
+
+    UA_HistoryReadValueId item;
+    UA_HistoryReadValueId_init(&item);
+    item.nodeId = nodeId;
+    if(continuationPoint)
+        item.continuationPoint = *continuationPoint;
+
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    UA_ExtensionObject_setValue(&request.historyReadDetails, &details,
+                                &UA_TYPES[UA_TYPES_READEVENTDETAILS]);
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    request.nodesToReadSize = 1;
+    request.nodesToRead = &item;
+    UA_HistoryReadResponse response = UA_Client_Service_historyRead(client, request);
+    UA_QualifiedName_clear(select.browsePath);
+    UA_free(select.browsePath);
+    return response;
+}
+
+static UA_HistoryReadResponse
+readEvents(UA_DateTime startTime, UA_DateTime endTime, UA_UInt32 numValues,
+           UA_UInt16 minSeverity, const UA_ByteString *continuationPoint) {
+    return readNodeEvents(serverId, startTime, endTime, numValues,
+                          minSeverity, continuationPoint);
+}
+
+static UA_HistoryEvent *
+historyEvent(UA_HistoryReadResponse *response) {
+    ck_assert_uint_eq(response->responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response->resultsSize, 1);
+    ck_assert_uint_eq(response->results[0].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert(response->results[0].historyData.content.decoded.type ==
+              &UA_TYPES[UA_TYPES_HISTORYEVENT]);
+    return (UA_HistoryEvent*)response->results[0].historyData.content.decoded.data;
+}
+
+static UA_UInt16
+eventSeverity(const UA_HistoryEvent *he, size_t i) {
+    ck_assert_uint_eq(he->events[i].eventFieldsSize, 1);
+    ck_assert(UA_Variant_hasScalarType(&he->events[i].eventFields[0],
+                                       &UA_TYPES[UA_TYPES_UINT16]));
+    return *(UA_UInt16*)he->events[i].eventFields[0].data;
+}
+
+START_TEST(Server_HistoricalEventsFilter) {
+    /* Trigger out of order */
+    for(size_t i = 0; i < 20; i++)
+        triggerEvent((i * 7) % 20);
+
+    /* Severity >= 10 in [5, 15) */
+    UA_HistoryReadResponse response =
+        readEvents(EVENT_BASE + 5 * UA_DATETIME_SEC, EVENT_BASE + 15 * UA_DATETIME_SEC,
+                   0, 10, NULL);
+    UA_HistoryEvent *he = historyEvent(&response);
+    ck_assert_uint_eq(he->eventsSize, 5);
+    for(size_t i = 0; i < he->eventsSize; i++)
+        ck_assert_uint_eq(eventSeverity(he, i), 10 + i);
+    ck_assert_uint_eq(response.results[0].continuationPoint.length, 0);
+    UA_HistoryReadResponse_clear(&response);
+
+    /* Reverse order from the startTime */
+    response = readEvents(EVENT_BASE + 15 * UA_DATETIME_SEC,
+                          EVENT_BASE + 5 * UA_DATETIME_SEC, 0, 0, NULL);
+    he = historyEvent(&response);
+    ck_assert_uint_eq(he->eventsSize, 10);
+    for(size_t i = 0; i < he->eventsSize; i++)
+        ck_assert_uint_eq(eventSeverity(he, i), 15 - i);
+    UA_HistoryReadResponse_clear(&response);
+
+    /* Without the endTime, numValuesPerNode is required */
+    response = readEvents(EVENT_BASE, 0, 0, 0, NULL);
+    ck_assert_uint_eq(response.results[0].statusCode,
+                      UA_STATUSCODE_BADINVALIDTIMESTAMPARGUMENT);
+    UA_HistoryReadResponse_clear(&response);
+} END_TEST
+
+START_TEST(Server_HistoricalEventsContinuation) {
+    for(size_t i = 0; i < 20; i++)
+        triggerEvent(i);
+
+    /* Read the events with severity >= 3 in batches of 4 */
+    UA_UInt16 expected = 3;
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    size_t reads = 0;
+    do {
+        UA_HistoryReadResponse response = readEvents(EVENT_BASE, 0, 4, 3, &cp);
+        UA_ByteString_clear(&cp);
+        UA_HistoryEvent *he = historyEvent(&response);
+        ck_assert_uint_le(he->eventsSize, 4);
+        for(size_t i = 0; i < he->eventsSize; i++)
+            ck_assert_uint_eq(eventSeverity(he, i), expected++);
+        UA_ByteString_copy(&response.results[0].continuationPoint, &cp);
+        UA_HistoryReadResponse_clear(&response);
+        reads++;
+    } while(cp.length > 0);
+    ck_assert_uint_eq(expected, 20);
+    ck_assert_uint_ge(reads, 5);
+} END_TEST
+
+START_TEST(Server_HistoricalEventsLimit) {
+    /* Only the last MAX_EVENTS events are retained */
+    for(size_t i = 0; i < MAX_EVENTS + 10; i++)
+        triggerEvent(i);
+    UA_HistoryReadResponse response =
+        readEvents(EVENT_BASE, EVENT_BASE + 1000 * UA_DATETIME_SEC, 0, 0, NULL);
+    UA_HistoryEvent *he = historyEvent(&response);
+    ck_assert_uint_eq(he->eventsSize, MAX_EVENTS);
+    ck_assert_uint_eq(eventSeverity(he, 0), 10);
+    ck_assert_uint_eq(eventSeverity(he, MAX_EVENTS - 1), MAX_EVENTS + 9);
+    UA_HistoryReadResponse_clear(&response);
+} END_TEST
+
+START_TEST(Server_HistoricalEventsLimitNotifiers) {
+    UA_NodeId areaId = UA_NODEID_STRING(1, "Area");
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, areaId,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Area"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                attr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    addHistoricalEventFilter(areaId);
+
+    /* The events of the Area are recorded for the Area and the Server. They
+     * arrive in reverse order. Each one becomes the oldest event of both
+     * notifiers. Once the limit is reached, both copies are removed first. */
+    for(size_t i = 20; i < 50; i++)
+        triggerEvent(i);
+    for(size_t i = 30; i > 0; i--)
+        triggerEventAt(areaId, i - 1);
+
+    UA_HistoryReadResponse response =
+        readEvents(EVENT_BASE, EVENT_BASE + 1000 * UA_DATETIME_SEC, 0, 0, NULL);
+    UA_HistoryEvent *he = historyEvent(&response);
+    ck_assert_uint_eq(he->eventsSize, 40);
+    ck_assert_uint_eq(eventSeverity(he, 0), 20);
+    ck_assert_uint_eq(eventSeverity(he, 39), 49);
+    UA_HistoryReadResponse_clear(&response);
+
+    response = readNodeEvents(areaId, EVENT_BASE, EVENT_BASE + 1000 * UA_DATETIME_SEC,
+                              0, 0, NULL);
+    he = historyEvent(&response);
+    ck_assert_uint_eq(he->eventsSize, MAX_EVENTS - 40);
+    ck_assert_uint_eq(eventSeverity(he, 0), 20);
+    ck_assert_uint_eq(eventSeverity(he, MAX_EVENTS - 41), 29);
+    UA_HistoryReadResponse_clear(&response);
+} END_TEST
+
+static Suite *
+testSuite_HistoricalEvents(void) {
+    Suite *s = suite_create("Server Historical Events");
+    TCase *tc_server = tcase_create("Server Historical Events");
+    tcase_add_checked_fixture(tc_server, setup, teardown);
+    tcase_add_test(tc_server, Server_HistoricalEventsFilter);
+    tcase_add_test(tc_server, Server_HistoricalEventsContinuation);
+    tcase_add_test(tc_server, Server_HistoricalEventsLimit);
+    tcase_add_test(tc_server, Server_HistoricalEventsLimitNotifiers);
+    suite_add_tcase(s, tc_server);
+    return s;
+}
+
+int main(void) {
+    Suite *s = testSuite_HistoricalEvents();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr,CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
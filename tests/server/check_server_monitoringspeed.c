@@ -83,12 +83,102 @@ START_TEST(monitorIntegerNoChanges) {
 }
 END_TEST
 
+#define WAVEFORMSIZE 10000
+
+static UA_Double waveform[WAVEFORMSIZE];
+
+static UA_StatusCode
+readWaveform(UA_Server *s, const UA_NodeId *sessionId, void *sessionContext,
+             const UA_NodeId *nodeId, void *nodeContext,
+             UA_Boolean includeSourceTimeStamp, const UA_NumericRange *range,
+             UA_DataValue *value) {
+    UA_Variant_setArray(&value->value, waveform, WAVEFORMSIZE,
+                        &UA_TYPES[UA_TYPES_DOUBLE]);
+    value->value.storageType = UA_VARIANT_DATA_NODELETE;
+    value->hasValue = true;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Sample a waveform array. The last element changes within the deadband or
+ * (without a deadband) is not changed at all. */
+static void
+monitorWaveform(UA_Boolean deadband) {
+    for(size_t i = 0; i < WAVEFORMSIZE; i++)
+        waveform[i] = (UA_Double)i;
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    attr.displayName = UA_LOCALIZEDTEXT("en-US","waveform");
+    UA_DataSource dataSource;
+    dataSource.read = readWaveform;
+    dataSource.write = NULL;
+    UA_NodeId waveformNodeId = UA_NODEID_STRING(1, "waveform");
+    UA_StatusCode retval =
+        UA_Server_addDataSourceVariableNode(server, waveformNodeId,
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "waveform"),
+                                            UA_NODEID_NULL, attr, dataSource,
+                                            NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_DataChangeFilter filter;
+    UA_DataChangeFilter_init(&filter);
+    filter.trigger = UA_DATACHANGETRIGGER_STATUSVALUE;
+    filter.deadbandType = UA_DEADBANDTYPE_ABSOLUTE;
+    filter.deadbandValue = 0.5;
+
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = waveformNodeId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    if(deadband)
+        UA_ExtensionObject_setValueNoDelete(&item.requestedParameters.filter, &filter,
+                                            &UA_TYPES[UA_TYPES_DATACHANGEFILTER]);
+    UA_MonitoredItemCreateResult res =
+        UA_Server_createDataChangeMonitoredItem(server, UA_TIMESTAMPSTORETURN_NEITHER,
+                                                item, NULL, dataChangeNotificationCallback);
+    ck_assert_uint_eq(res.statusCode, UA_STATUSCODE_GOOD);
+
+    callbackCount = 0;
+    UA_MonitoredItem *mon = LIST_FIRST(&server->adminSubscription->monitoredItems);
+
+    clock_t begin, finish;
+    begin = clock();
+
+    UA_LOCK(&server->serviceMutex);
+    for(int i = 0; i < 1000; i++) {
+        if(deadband)
+            waveform[WAVEFORMSIZE - 1] = (UA_Double)(WAVEFORMSIZE - 1) + ((i % 2) * 0.25);
+        UA_MonitoredItem_sample(server, mon);
+    }
+    UA_UNLOCK(&server->serviceMutex);
+
+    finish = clock();
+
+    double time_spent = (double)(finish - begin) / CLOCKS_PER_SEC;
+    printf("duration was %f s\n", time_spent);
+
+    ck_assert_uint_eq(callbackCount, 0);
+}
+
+START_TEST(monitorWaveformNoChanges) {
+    monitorWaveform(false);
+}
+END_TEST
+
+START_TEST(monitorWaveformDeadband) {
+    monitorWaveform(true);
+}
+END_TEST
+
 static Suite * monitoring_speed_suite (void) {
     Suite *s = suite_create ("Monitoring Speed");
 
     TCase* tc_datachange = tcase_create ("DataChange");
     tcase_add_checked_fixture(tc_datachange, setup, teardown);
     tcase_add_test (tc_datachange, monitorIntegerNoChanges);
+    tcase_add_test (tc_datachange, monitorWaveformNoChanges);
+    tcase_add_test (tc_datachange, monitorWaveformDeadband);
     suite_add_tcase (s, tc_datachange);
 
     return s;
@@ -0,0 +1,162 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+/* This example is just to see how fast we can write values. The server does
+   not open a TCP port. */
+
+#include <open62541/server_config_default.h>
+#include <open62541/plugin/nodestore_default.h>
+
+#include "server/ua_services.h"
+#include "ua_server_internal.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdio.h>
+
+#include "test_helpers.h"
+
+#define WRITENODES 1000 /* Number of nodes to be created for writing */
+#define WRITES 100000  /* Number of writes to perform */
+
+static UA_Server *server;
+static UA_NodeId writeNodeIds[WRITENODES];
+
+static void setup(void) {
+    server = UA_Server_newForUnitTest();
+    ck_assert(server != NULL);
+}
+
+static void setupHashMapOptions(void) {
+    UA_ServerConfig config;
+    memset(&config, 0, sizeof(UA_ServerConfig));
+    UA_Nodestore_HashMapWithOptions(&config.nodestore,
+                                    UA_NODESTORE_HASHMAP_DIRECTPOINTERS |
+                                    UA_NODESTORE_HASHMAP_INTERNSTRINGS);
+    UA_ServerConfig_setDefault(&config);
+    server = UA_Server_newWithConfig(&config);
+    ck_assert(server != NULL);
+}
+
+static void teardown(void) {
+    for(size_t i = 0; i < WRITENODES; i++)
+        UA_NodeId_clear(&writeNodeIds[i]);
+    UA_Server_delete(server);
+}
+
+static void
+addWriteNodes(const UA_DataType *type, void *initial) {
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Variant_setScalar(&attr.value, initial, type);
+    attr.dataType = type->typeId;
+    attr.valueRank = UA_VALUERANK_SCALAR;
+    attr.accessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE;
+    UA_NodeId parentNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId parentReferenceNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    for(size_t i = 0; i < WRITENODES; i++) {
+        char varName[20];
+        snprintf(varName, 20, "Variable %u", (UA_UInt32)i);
+        UA_NodeId myNodeId = UA_NODEID_STRING(1, varName);
+        UA_QualifiedName myName = UA_QUALIFIEDNAME(1, varName);
+        UA_StatusCode retval =
+            UA_Server_addVariableNode(server, myNodeId, parentNodeId,
+                                      parentReferenceNodeId, myName,
+                                      UA_NODEID_NULL, attr, NULL,
+                                      &writeNodeIds[i]);
+        ck_assert(retval == UA_STATUSCODE_GOOD);
+    }
+}
+
+/* Writes into the same variables over and over. Scalars of a fixed-size
+ * builtin type take the fast path for Value writes. Other values (here a
+ * String) are written with the full checks and a copy of the node. */
+static void
+runWrites(const char *name, const UA_DataType *type) {
+    UA_Double d = 0.0;
+    UA_String str = UA_STRING("Written value");
+    void *value = (type == &UA_TYPES[UA_TYPES_DOUBLE]) ? (void*)&d : (void*)&str;
+    addWriteNodes(type, value);
+
+    UA_WriteRequest request;
+    UA_WriteRequest_init(&request);
+    UA_WriteValue wv;
+    UA_WriteValue_init(&wv);
+    wv.attributeId = UA_ATTRIBUTEID_VALUE;
+    wv.value.hasValue = true;
+    wv.value.hasSourceTimestamp = true;
+    UA_Variant_setScalar(&wv.value.value, value, type);
+    request.nodesToWriteSize = 1;
+    request.nodesToWrite = &wv;
+
+    UA_WriteResponse res;
+    UA_WriteResponse_init(&res);
+
+    clock_t begin, finish;
+    begin = clock();
+
+    for(size_t i = 0; i < WRITES; i++) {
+        wv.nodeId = writeNodeIds[i % WRITENODES];
+        wv.value.sourceTimestamp = (UA_DateTime)i;
+        d = (UA_Double)i;
+
+        UA_LOCK(&server->serviceMutex);
+        Service_Write(server, &server->adminSession, &request, &res);
+        UA_UNLOCK(&server->serviceMutex);
+
+        ck_assert_uint_eq(res.resultsSize, 1);
+        ck_assert_uint_eq(res.results[0], UA_STATUSCODE_GOOD);
+        UA_WriteResponse_clear(&res);
+    }
+
+    finish = clock();
+
+    double time_spent = (double)(finish - begin) / CLOCKS_PER_SEC;
+    printf("%s: %d writes in %f s (%.0f writes/s)\n", name, WRITES,
+           time_spent, (double)WRITES / time_spent);
+
+    /* Check the last value */
+    UA_Variant out;
+    UA_StatusCode retval =
+        UA_Server_readValue(server, writeNodeIds[(WRITES - 1) % WRITENODES], &out);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_Variant_hasScalarType(&out, type));
+    ck_assert(UA_order(out.data, value, type) == UA_ORDER_EQ);
+    UA_Variant_clear(&out);
+}
+
+START_TEST(writeSpeed) {
+    runWrites("Double", &UA_TYPES[UA_TYPES_DOUBLE]);
+} END_TEST
+
+START_TEST(writeSpeedString) {
+    runWrites("String", &UA_TYPES[UA_TYPES_STRING]);
+} END_TEST
+
+static Suite * service_speed_suite (void) {
+    Suite *s = suite_create ("Service Speed");
+
+    TCase* tc_write = tcase_create ("Write");
+    tcase_add_checked_fixture(tc_write, setup, teardown);
+    tcase_add_test (tc_write, writeSpeed);
+    tcase_add_test (tc_write, writeSpeedString);
+    suite_add_tcase (s, tc_write);
+
+    TCase* tc_write_hm = tcase_create ("Write-HashMapOptions");
+    tcase_add_checked_fixture(tc_write_hm, setupHashMapOptions, teardown);
+    tcase_add_test (tc_write_hm, writeSpeed);
+    suite_add_tcase (s, tc_write_hm);
+
+    return s;
+}
+
+int main (void) {
+    int number_failed = 0;
+    Suite *s = service_speed_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr,CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed (sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
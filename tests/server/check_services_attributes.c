@@ -6,6 +6,7 @@
 
 #include "server/ua_server_internal.h"
 #include "server/ua_services.h"
+#include "server/ua_subscription.h"
 #include "testing_clock.h"
 #include "test_helpers.h"
 
@@ -1101,6 +1102,108 @@ START_TEST(WriteSingleAttributeExecutable) {
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
 } END_TEST
 
+static size_t onWriteCount = 0;
+
+static void
+countOnWrite(UA_Server *server_, const UA_NodeId *sessionId,
+             void *sessionContext, const UA_NodeId *nodeId,
+             void *nodeContext, const UA_NumericRange *range,
+             const UA_DataValue *data) {
+    onWriteCount++;
+}
+
+/* Repeated writes of the same scalar type update the value in-place */
+START_TEST(WriteSingleAttributeValueRepeated) {
+    UA_ValueCallback callback = {NULL, countOnWrite};
+    UA_StatusCode retval =
+        UA_Server_setVariableNode_valueCallback(server, UA_NODEID_STRING(1, "the.answer"),
+                                                callback);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    onWriteCount = 0;
+
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    wValue.nodeId = UA_NODEID_STRING(1, "the.answer");
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    wValue.value.hasValue = true;
+    wValue.value.hasStatus = true;
+    wValue.value.status = UA_STATUSCODE_UNCERTAININITIALVALUE;
+    for(UA_Int32 i = 0; i < 3; i++) {
+        UA_Variant_setScalar(&wValue.value.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        retval = UA_Server_write(server, &wValue);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    ck_assert_uint_eq(onWriteCount, 3);
+
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "the.answer");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_DataValue resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
+    ck_assert(resp.hasValue);
+    ck_assert(UA_Variant_hasScalarType(&resp.value, &UA_TYPES[UA_TYPES_INT32]));
+    ck_assert_int_eq(2, *(UA_Int32*)resp.value.data);
+    ck_assert(resp.hasStatus);
+    ck_assert_uint_eq(resp.status, UA_STATUSCODE_UNCERTAININITIALVALUE);
+    UA_DataValue_clear(&resp);
+
+    /* Change the type. Then write the new type repeatedly. */
+    UA_Double d = 1.5;
+    wValue.value.hasStatus = false;
+    UA_Variant_setScalar(&wValue.value.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    retval = UA_Server_write(server, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    d = 2.5;
+    retval = UA_Server_write(server, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(onWriteCount, 5);
+
+    resp = UA_Server_read(server, &rvi, UA_TIMESTAMPSTORETURN_NEITHER);
+    ck_assert(UA_Variant_hasScalarType(&resp.value, &UA_TYPES[UA_TYPES_DOUBLE]));
+    ck_assert(*(UA_Double*)resp.value.data == 2.5);
+    ck_assert(!resp.hasStatus);
+    UA_DataValue_clear(&resp);
+} END_TEST
+
+START_TEST(WriteSingleAttributeValueRepeatedNoAccess) {
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Int32 myInteger = 20;
+    UA_Variant_setScalar(&wValue.value.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = UA_NODEID_STRING(1, "the.answer");
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_StatusCode retval = UA_Server_write(server, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    retval = UA_Server_writeAccessLevel(server, UA_NODEID_STRING(1, "the.answer"),
+                                        UA_ACCESSLEVELMASK_READ);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    /* The local admin session has all rights. Write with a regular session. */
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_WriteRequest request;
+    UA_WriteRequest_init(&request);
+    request.nodesToWriteSize = 1;
+    request.nodesToWrite = &wValue;
+    UA_WriteResponse response;
+    UA_WriteResponse_init(&response);
+    myInteger = 21;
+    UA_LOCK(&server->serviceMutex);
+    Service_Write(server, &session, &request, &response);
+    UA_Session_clear(&session, server);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0], UA_STATUSCODE_BADUSERACCESSDENIED);
+    UA_WriteResponse_clear(&response);
+
+    UA_Variant value;
+    retval = UA_Server_readValue(server, UA_NODEID_STRING(1, "the.answer"), &value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(20, *(UA_Int32*)value.data);
+    UA_Variant_clear(&value);
+} END_TEST
+
 START_TEST(WriteSingleDataSourceAttributeValue) {
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
@@ -1207,6 +1310,193 @@ START_TEST(CheckDescriptionLocalization) {
     UA_LocalizedText_clear(&lt);
 } END_TEST
 
+#define BORROWEDSIZE 100
+
+static UA_Double borrowedArray[BORROWEDSIZE];
+static size_t borrowCount;
+static size_t releaseCount;
+
+static UA_StatusCode
+readBorrowed(UA_Server *server_, const UA_NodeId *sessionId, void *sessionContext,
+             const UA_NodeId *nodeId, void *nodeContext, UA_Boolean sourceTimeStamp,
+             const UA_NumericRange *range, UA_DataValue *value) {
+    UA_Variant_setArray(&value->value, borrowedArray, BORROWEDSIZE,
+                        &UA_TYPES[UA_TYPES_DOUBLE]);
+    value->value.storageType = UA_VARIANT_DATA_NODELETE;
+    value->hasValue = true;
+    borrowCount++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+writeBorrowed(UA_Server *server_, const UA_NodeId *sessionId, void *sessionContext,
+              const UA_NodeId *nodeId, void *nodeContext,
+              const UA_NumericRange *range, const UA_DataValue *value) {
+    if(range || !UA_Variant_hasArrayType(&value->value, &UA_TYPES[UA_TYPES_DOUBLE]) ||
+       value->value.arrayLength != BORROWEDSIZE)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    memcpy(borrowedArray, value->value.data, sizeof(borrowedArray));
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+releaseBorrowed(UA_Server *server_, const UA_NodeId *nodeId,
+                void *nodeContext, UA_DataValue *value) {
+    ck_assert_ptr_eq(value->value.data, borrowedArray);
+    ck_assert_ptr_eq(nodeContext, borrowedArray);
+    releaseCount++;
+}
+
+static void
+setupBorrowed(void) {
+    setup();
+    borrowCount = 0;
+    releaseCount = 0;
+    for(size_t i = 0; i < BORROWEDSIZE; i++)
+        borrowedArray[i] = (UA_Double)i;
+
+    UA_VariableAttributes vattr = UA_VariableAttributes_default;
+    UA_Variant_setArray(&vattr.value, borrowedArray, BORROWEDSIZE,
+                        &UA_TYPES[UA_TYPES_DOUBLE]);
+    vattr.dataType = UA_TYPES[UA_TYPES_DOUBLE].typeId;
+    vattr.valueRank = UA_VALUERANK_ONE_DIMENSION;
+    UA_UInt32 arrayDims[1] = {BORROWEDSIZE};
+    vattr.arrayDimensions = arrayDims;
+    vattr.arrayDimensionsSize = 1;
+    vattr.accessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE;
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "borrowed");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId,
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "borrowed"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  vattr, borrowedArray, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_ValueBackend backend;
+    memset(&backend, 0, sizeof(UA_ValueBackend));
+    backend.backendType = UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED;
+    backend.backend.borrowed.dataSource.read = readBorrowed;
+    backend.backend.borrowed.dataSource.write = writeBorrowed;
+    backend.backend.borrowed.release = releaseBorrowed;
+    retval = UA_Server_setVariableNode_valueBackend(server, nodeId, backend);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+/* The Read service returns the view into the application memory. It is
+ * released after the response was encoded. */
+START_TEST(ReadBorrowedDataSource) {
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "borrowed");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = &rvi;
+    request.nodesToReadSize = 1;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    UA_LOCK(&server->serviceMutex);
+    Service_Read(server, &server->adminSession, &request, &response);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert(response.results[0].hasValue);
+    ck_assert_ptr_eq(response.results[0].value.data, borrowedArray);
+    ck_assert_uint_eq(response.results[0].value.arrayLength, BORROWEDSIZE);
+    ck_assert(response.results[0].hasSourceTimestamp);
+    ck_assert_uint_eq(borrowCount, 1);
+    ck_assert_uint_eq(releaseCount, 0);
+
+    UA_LOCK(&server->serviceMutex);
+    UA_Server_releaseBorrowedValues(server);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(releaseCount, 1);
+    UA_ReadResponse_clear(&response);
+
+    /* The local API gets a copy and the view is released right away */
+    UA_Variant value;
+    UA_StatusCode retval = UA_Server_readValue(server, rvi.nodeId, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_ne(value.data, borrowedArray);
+    ck_assert(UA_Variant_hasArrayType(&value, &UA_TYPES[UA_TYPES_DOUBLE]));
+    ck_assert_uint_eq(value.arrayLength, BORROWEDSIZE);
+    ck_assert(((UA_Double*)value.data)[BORROWEDSIZE - 1] ==
+              (UA_Double)(BORROWEDSIZE - 1));
+    ck_assert_uint_eq(borrowCount, 2);
+    ck_assert_uint_eq(releaseCount, 2);
+
+    /* Write through the data source */
+    for(size_t i = 0; i < BORROWEDSIZE; i++)
+        ((UA_Double*)value.data)[i] = 2.0 * (UA_Double)i;
+    retval = UA_Server_writeValue(server, rvi.nodeId, value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(borrowedArray[BORROWEDSIZE - 1] == 2.0 * (UA_Double)(BORROWEDSIZE - 1));
+    UA_Variant_clear(&value);
+
+    /* Borrowed values that were not released are released with the server */
+    UA_LOCK(&server->serviceMutex);
+    Service_Read(server, &server->adminSession, &request, &response);
+    UA_UNLOCK(&server->serviceMutex);
+    UA_ReadResponse_clear(&response);
+    size_t expectedReleases = borrowCount;
+    UA_Server_delete(server);
+    server = UA_Server_newForUnitTest();
+    ck_assert_uint_eq(releaseCount, expectedReleases);
+} END_TEST
+
+START_TEST(BorrowedDataSourceNeedsRelease) {
+    UA_ValueBackend backend;
+    memset(&backend, 0, sizeof(UA_ValueBackend));
+    backend.backendType = UA_VALUEBACKENDTYPE_DATA_SOURCE_BORROWED;
+    backend.backend.borrowed.dataSource.read = readBorrowed;
+    UA_StatusCode retval =
+        UA_Server_setVariableNode_valueBackend(server, UA_NODEID_STRING(1, "borrowed"),
+                                               backend);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADCONFIGURATIONERROR);
+} END_TEST
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+/* MonitoredItems copy the sample only when it has changed */
+START_TEST(SampleBorrowedDataSource) {
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = UA_NODEID_STRING(1, "borrowed");
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    UA_MonitoredItemCreateResult res =
+        UA_Server_createDataChangeMonitoredItem(server, UA_TIMESTAMPSTORETURN_NEITHER,
+                                                item, NULL, NULL);
+    ck_assert_uint_eq(res.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(borrowCount, releaseCount);
+
+    UA_MonitoredItem *mon = LIST_FIRST(&server->adminSubscription->monitoredItems);
+    ck_assert_ptr_ne(mon, NULL);
+    ck_assert(mon->lastValue.hasValue);
+    ck_assert_ptr_ne(mon->lastValue.value.data, borrowedArray);
+    void *lastData = mon->lastValue.value.data;
+
+    /* Unchanged */
+    UA_LOCK(&server->serviceMutex);
+    UA_MonitoredItem_sample(server, mon);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_ptr_eq(mon->lastValue.value.data, lastData);
+    ck_assert_uint_eq(borrowCount, releaseCount);
+
+    /* Changed */
+    borrowedArray[50] = -1.0;
+    UA_LOCK(&server->serviceMutex);
+    UA_MonitoredItem_sample(server, mon);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_ptr_ne(mon->lastValue.value.data, borrowedArray);
+    ck_assert(((UA_Double*)mon->lastValue.value.data)[50] == -1.0);
+    ck_assert_uint_eq(borrowCount, releaseCount);
+} END_TEST
+#endif
+
 static Suite * testSuite_services_attributes(void) {
     Suite *s = suite_create("services_attributes_read");
 
@@ -1261,6 +1551,8 @@ static Suite * testSuite_services_attributes(void) {
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValue);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueWithServerTimestamp);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueEnum);
+    tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRepeated);
+    tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRepeatedNoAccess);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeStringToByteArray);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeDataType);
     tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRangeFromScalar);
@@ -1282,6 +1574,15 @@ static Suite * testSuite_services_attributes(void) {
     tcase_add_test(tc_localization, CheckDescriptionLocalization);
     suite_add_tcase(s, tc_localization);
 
+    TCase *tc_borrowed = tcase_create("borrowedDataSource");
+    tcase_add_checked_fixture(tc_borrowed, setupBorrowed, teardown);
+    tcase_add_test(tc_borrowed, ReadBorrowedDataSource);
+    tcase_add_test(tc_borrowed, BorrowedDataSourceNeedsRelease);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    tcase_add_test(tc_borrowed, SampleBorrowedDataSource);
+#endif
+    suite_add_tcase(s, tc_borrowed);
+
     return s;
 }
 
@@ -736,6 +736,134 @@ START_TEST(AddDoubleReference) {
 
 } END_TEST
 
+static void
+setBulkItem(UA_AddNodesItem *item, UA_NodeClass nodeClass, UA_NodeId nodeId,
+            UA_NodeId parentNodeId, UA_NodeId referenceTypeId, char *name,
+            UA_NodeId typeDefinition, void *attr, const UA_DataType *attrType) {
+    UA_AddNodesItem_init(item);
+    item->nodeClass = nodeClass;
+    item->requestedNewNodeId.nodeId = nodeId;
+    item->parentNodeId.nodeId = parentNodeId;
+    item->referenceTypeId = referenceTypeId;
+    item->browseName = UA_QUALIFIEDNAME(1, name);
+    item->typeDefinition.nodeId = typeDefinition;
+    UA_ExtensionObject_setValueNoDelete(&item->nodeAttributes, attr, attrType);
+}
+
+START_TEST(AddNodesBulk) {
+    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+    UA_VariableAttributes vAttr = UA_VariableAttributes_default;
+    UA_Int32 value = 42;
+    UA_Variant_setScalar(&vAttr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    UA_ReferenceTypeAttributes rAttr = UA_ReferenceTypeAttributes_default;
+    rAttr.inverseName = UA_LOCALIZEDTEXT("", "IsBulkRefOf");
+
+    UA_NodeId objectsId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId objId = UA_NODEID_STRING(1, "bulk.obj");
+    UA_NodeId varId = UA_NODEID_STRING(1, "bulk.var");
+    UA_NodeId refTypeId = UA_NODEID_STRING(1, "bulk.ref");
+    UA_NodeId obj2Id = UA_NODEID_STRING(1, "bulk.obj2");
+
+    /* The child and the user of the new ReferenceType come first */
+    UA_AddNodesItem items[4];
+    setBulkItem(&items[0], UA_NODECLASS_VARIABLE, varId, objId,
+                UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), "BulkVar",
+                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                &vAttr, &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]);
+    setBulkItem(&items[1], UA_NODECLASS_OBJECT, obj2Id, objectsId, refTypeId,
+                "BulkObj2", UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                &oAttr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    setBulkItem(&items[2], UA_NODECLASS_OBJECT, objId, objectsId,
+                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), "BulkObj",
+                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                &oAttr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    setBulkItem(&items[3], UA_NODECLASS_REFERENCETYPE, refTypeId,
+                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE), "BulkRef",
+                UA_NODEID_NULL, &rAttr, &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES]);
+
+    void *contexts[4] = {NULL, NULL, (void*)0x42, NULL};
+    UA_NodeId newIds[4];
+    size_t failedIndex = 0;
+    UA_Int32 constructed = handleCalled;
+    UA_StatusCode res = UA_Server_addNodesBulk(server, 4, items, contexts,
+                                               newIds, &failedIndex);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(failedIndex, SIZE_MAX);
+    ck_assert(UA_NodeId_equal(&newIds[0], &varId));
+    ck_assert(UA_NodeId_equal(&newIds[2], &objId));
+
+    /* The constructors were called */
+    ck_assert_int_eq(handleCalled, constructed + 4);
+    void *context = NULL;
+    UA_Server_getNodeContext(server, objId, &context);
+    ck_assert_ptr_eq(context, (void*)0x42);
+
+    /* The references are in place */
+    UA_NodeId target = findReference(objId, UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT));
+    ck_assert(UA_NodeId_equal(&target, &varId));
+    UA_NodeId_clear(&target);
+    target = findReference(objectsId, refTypeId);
+    ck_assert(UA_NodeId_equal(&target, &obj2Id));
+    UA_NodeId_clear(&target);
+
+    /* The value was type-checked and set */
+    UA_Variant out;
+    res = UA_Server_readValue(server, varId, &out);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    ck_assert(UA_Variant_hasScalarType(&out, &UA_TYPES[UA_TYPES_INT32]));
+    ck_assert_int_eq(*(UA_Int32*)out.data, 42);
+    UA_Variant_clear(&out);
+
+    for(size_t i = 0; i < 4; i++)
+        UA_NodeId_clear(&newIds[i]);
+} END_TEST
+
+START_TEST(AddNodesBulkRollback) {
+    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+    UA_NodeId objectsId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId objId = UA_NODEID_STRING(1, "bulk.obj");
+    UA_NodeId childId = UA_NODEID_STRING(1, "bulk.child");
+
+    /* The last item has an unknown parent. Fails when the references are
+     * added. */
+    UA_AddNodesItem items[3];
+    setBulkItem(&items[0], UA_NODECLASS_OBJECT, objId, objectsId,
+                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), "BulkObj",
+                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                &oAttr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    setBulkItem(&items[1], UA_NODECLASS_OBJECT, childId, objId,
+                UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), "BulkChild",
+                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                &oAttr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+    setBulkItem(&items[2], UA_NODECLASS_OBJECT, UA_NODEID_NULL,
+                UA_NODEID_STRING(1, "bulk.unknown"),
+                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), "BulkOrphan",
+                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                &oAttr, &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]);
+
+    size_t failedIndex = 0;
+    UA_StatusCode res = UA_Server_addNodesBulk(server, 3, items, NULL,
+                                               NULL, &failedIndex);
+    ck_assert_uint_ne(res, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(failedIndex, 2);
+
+    /* All new nodes were removed */
+    UA_NodeClass nc;
+    res = UA_Server_readNodeClass(server, objId, &nc);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADNODEIDUNKNOWN);
+    res = UA_Server_readNodeClass(server, childId, &nc);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADNODEIDUNKNOWN);
+
+    /* A duplicate NodeId fails when the nodes are inserted */
+    items[2].requestedNewNodeId.nodeId = objectsId;
+    res = UA_Server_addNodesBulk(server, 3, items, NULL, NULL, &failedIndex);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADNODEIDEXISTS);
+    ck_assert_uint_eq(failedIndex, 2);
+    res = UA_Server_readNodeClass(server, objId, &nc);
+    ck_assert_uint_eq(res, UA_STATUSCODE_BADNODEIDUNKNOWN);
+} END_TEST
+
 int main(void) {
     Suite *s = suite_create("services_nodemanagement");
 
@@ -767,6 +895,12 @@ int main(void) {
     tcase_add_test(tc_addreferences, AddDoubleReference);
     suite_add_tcase(s, tc_addreferences);
 
+    TCase *tc_addnodesbulk = tcase_create("addnodesbulk");
+    tcase_add_checked_fixture(tc_addnodesbulk, setup, teardown);
+    tcase_add_test(tc_addnodesbulk, AddNodesBulk);
+    tcase_add_test(tc_addnodesbulk, AddNodesBulkRollback);
+    suite_add_tcase(s, tc_addnodesbulk);
+
     SRunner *sr = srunner_create(s);
     srunner_set_fork_status(sr, CK_NOFORK);
     srunner_run_all(sr, CK_NORMAL);
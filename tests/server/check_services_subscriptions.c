@@ -584,6 +584,282 @@ START_TEST(Server_overflow) {
 }
 END_TEST
 
+START_TEST(Server_sharedLastValue) {
+    createSubscription();
+
+    /* Create a MonitoredItem with a queue */
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subscriptionId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SERVER;
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME);
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    item.requestedParameters.queueSize = 3;
+    item.requestedParameters.discardOldest = true;
+    request.itemsToCreateSize = 1;
+    request.itemsToCreate = &item;
+
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    UA_LOCK(&server->serviceMutex);
+    Service_CreateMonitoredItems(server, session, &request, &response);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    UA_UInt32 localMonitoredItemId = response.results[0].monitoredItemId;
+    UA_CreateMonitoredItemsResponse_clear(&response);
+
+    UA_Subscription *sub = UA_Session_getSubscriptionById(session, subscriptionId);
+    ck_assert_ptr_ne(sub, NULL);
+    UA_MonitoredItem *mon = UA_Subscription_getMonitoredItem(sub, localMonitoredItemId);
+    ck_assert_ptr_ne(mon, NULL);
+
+    /* Sample more values than fit into the queue */
+    for(size_t i = 0; i < 4; i++) {
+        UA_fakeSleep(1); /* modify the server's currenttime */
+        UA_LOCK(&server->serviceMutex);
+        UA_MonitoredItem_sample(server, mon);
+        UA_UNLOCK(&server->serviceMutex);
+    }
+    ck_assert_uint_eq(mon->queueSize, 3);
+
+    /* Only the newest Notification shares the value with lastValue */
+    UA_Notification *last = TAILQ_LAST(&mon->queue, NotificationQueue);
+    ck_assert_ptr_eq(mon->lastValueShared, last);
+    ck_assert_ptr_eq(last->data.dataChange.value.value.data, mon->lastValue.value.data);
+    ck_assert_int_eq(last->data.dataChange.value.value.storageType,
+                     UA_VARIANT_DATA_NODELETE);
+
+    /* The older Notifications own their (distinct) values */
+    UA_DateTime prev = 0;
+    UA_Notification *n;
+    TAILQ_FOREACH(n, &mon->queue, monEntry) {
+        const UA_Variant *v = &n->data.dataChange.value.value;
+        ck_assert(UA_Variant_hasScalarType(v, &UA_TYPES[UA_TYPES_DATETIME]));
+        ck_assert_int_gt(*(UA_DateTime*)v->data, prev);
+        prev = *(UA_DateTime*)v->data;
+        if(n != last)
+            ck_assert_int_eq(v->storageType, UA_VARIANT_DATA);
+    }
+
+    /* Disabling removes the queued Notifications and the last sample */
+    UA_LOCK(&server->serviceMutex);
+    UA_MonitoredItem_setMonitoringMode(server, mon, UA_MONITORINGMODE_DISABLED);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(mon->queueSize, 0);
+    ck_assert_ptr_eq(mon->lastValueShared, NULL);
+}
+END_TEST
+
+static void
+writeAndSample(UA_MonitoredItem *mon, const UA_NodeId id, UA_Double d) {
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_StatusCode res = UA_Server_writeValue(server, id, v);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_fakeSleep(1);
+    UA_LOCK(&server->serviceMutex);
+    UA_MonitoredItem_sample(server, mon);
+    UA_UNLOCK(&server->serviceMutex);
+}
+
+START_TEST(Server_notificationRing) {
+    /* Add a scalar numeric variable */
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Double d = 0.0;
+    UA_Variant_setScalar(&attr.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_NodeId varId = UA_NODEID_STRING(1, "ring");
+    UA_StatusCode res =
+        UA_Server_addVariableNode(server, varId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "ring"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    createSubscription();
+
+    /* Create a MonitoredItem with a queue */
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subscriptionId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = varId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    item.requestedParameters.queueSize = 3;
+    item.requestedParameters.discardOldest = true;
+    request.itemsToCreateSize = 1;
+    request.itemsToCreate = &item;
+
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    UA_LOCK(&server->serviceMutex);
+    Service_CreateMonitoredItems(server, session, &request, &response);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    UA_UInt32 localMonitoredItemId = response.results[0].monitoredItemId;
+    UA_CreateMonitoredItemsResponse_clear(&response);
+
+    UA_Subscription *sub = UA_Session_getSubscriptionById(session, subscriptionId);
+    ck_assert_ptr_ne(sub, NULL);
+    UA_MonitoredItem *mon = UA_Subscription_getMonitoredItem(sub, localMonitoredItemId);
+    ck_assert_ptr_ne(mon, NULL);
+
+    /* Overflow the queue. The samples are stored in the ring. */
+    for(size_t i = 1; i <= 4; i++)
+        writeAndSample(mon, varId, (UA_Double)i);
+    ck_assert_ptr_ne(mon->ring, NULL);
+    ck_assert_uint_eq(mon->ring->size, 3);
+    ck_assert_uint_eq(mon->queueSize, 3);
+    ck_assert(TAILQ_EMPTY(&mon->queue));
+    ck_assert_uint_eq(sub->notificationQueueSize, 3);
+    ck_assert_uint_eq(sub->dataChangeNotifications, 3);
+    ck_assert_ptr_eq(TAILQ_FIRST(&sub->notificationQueue), &mon->ring->notification);
+
+    /* Sampling converts the ring into individual Notifications */
+    UA_LOCK(&server->serviceMutex);
+    UA_MonitoredItem_setMonitoringMode(server, mon, UA_MONITORINGMODE_SAMPLING);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_ptr_eq(mon->ring, NULL);
+    ck_assert_uint_eq(mon->queueSize, 3);
+    ck_assert_uint_eq(sub->notificationQueueSize, 0);
+    UA_Double expected = 2.0;
+    UA_Notification *n;
+    TAILQ_FOREACH(n, &mon->queue, monEntry) {
+        const UA_DataValue *dv = &n->data.dataChange.value;
+        ck_assert(UA_Variant_hasScalarType(&dv->value, &UA_TYPES[UA_TYPES_DOUBLE]));
+        ck_assert(*(UA_Double*)dv->value.data == expected);
+        ck_assert(dv->hasServerTimestamp);
+        if(n == TAILQ_FIRST(&mon->queue)) {
+            /* The oldest sample carries the overflow InfoBits */
+            ck_assert(dv->hasStatus);
+            ck_assert_uint_eq(dv->status, UA_STATUSCODE_INFOTYPE_DATAVALUE |
+                              UA_STATUSCODE_INFOBITS_OVERFLOW);
+        } else {
+            ck_assert(!dv->hasStatus);
+        }
+        expected += 1.0;
+    }
+
+    /* Reporting again. New samples are queued behind the Notifications. */
+    UA_LOCK(&server->serviceMutex);
+    UA_MonitoredItem_setMonitoringMode(server, mon, UA_MONITORINGMODE_REPORTING);
+    UA_UNLOCK(&server->serviceMutex);
+    writeAndSample(mon, varId, 5.0);
+    ck_assert_ptr_eq(mon->ring, NULL);
+    ck_assert_uint_eq(mon->queueSize, 3);
+    n = TAILQ_LAST(&mon->queue, NotificationQueue);
+    ck_assert(*(UA_Double*)n->data.dataChange.value.value.data == 5.0);
+
+    /* Disabling removes everything */
+    UA_LOCK(&server->serviceMutex);
+    UA_MonitoredItem_setMonitoringMode(server, mon, UA_MONITORINGMODE_DISABLED);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(mon->queueSize, 0);
+    ck_assert_uint_eq(sub->notificationQueueSize, 0);
+}
+END_TEST
+
+START_TEST(Server_publishSendFailure) {
+    UA_ServerConfig *config = UA_Server_getConfig(server);
+    config->enableRetransmissionQueue = false;
+
+    /* Add a variable that stores its samples in a ring */
+    UA_VariableAttributes attr = UA_VariableAttributes_default;
+    UA_Double d = 0.0;
+    UA_Variant_setScalar(&attr.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_NodeId varId = UA_NODEID_STRING(1, "sendfailure");
+    UA_StatusCode res =
+        UA_Server_addVariableNode(server, varId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "sendfailure"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    createSubscription();
+    createMonitoredItem(); /* One regular Notification */
+    UA_Subscription *sub = UA_Session_getSubscriptionById(session, subscriptionId);
+    ck_assert_ptr_ne(sub, NULL);
+    UA_MonitoredItem *mon1 = UA_Subscription_getMonitoredItem(sub, monitoredItemId);
+    ck_assert_ptr_ne(mon1, NULL);
+
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subscriptionId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SERVER;
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = varId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    item.requestedParameters.queueSize = 2;
+    item.requestedParameters.discardOldest = true;
+    request.itemsToCreateSize = 1;
+    request.itemsToCreate = &item;
+    UA_CreateMonitoredItemsResponse response;
+    UA_CreateMonitoredItemsResponse_init(&response);
+    UA_LOCK(&server->serviceMutex);
+    Service_CreateMonitoredItems(server, session, &request, &response);
+    UA_UNLOCK(&server->serviceMutex);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    UA_MonitoredItem *mon2 =
+        UA_Subscription_getMonitoredItem(sub, response.results[0].monitoredItemId);
+    ck_assert_ptr_ne(mon2, NULL);
+    UA_CreateMonitoredItemsResponse_clear(&response);
+
+    for(size_t i = 1; i <= 3; i++)
+        writeAndSample(mon2, varId, (UA_Double)i);
+    ck_assert_ptr_ne(mon2->ring, NULL);
+    ck_assert_uint_eq(mon1->queueSize, 1);
+    ck_assert_uint_eq(mon2->queueSize, 2);
+    ck_assert_uint_eq(sub->notificationQueueSize, 3);
+    ck_assert_uint_eq(sub->dataChangeNotifications, 3);
+    UA_UInt32 sequenceNumber = sub->nextSequenceNumber;
+
+    /* The SecureChannel is closed. Sending the response fails. */
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    UA_Session_attachToSecureChannel(session, &channel);
+
+    UA_PublishResponseEntry *pre = (UA_PublishResponseEntry*)
+        UA_calloc(1, sizeof(UA_PublishResponseEntry));
+    ck_assert_ptr_ne(pre, NULL);
+    pre->requestId = 1;
+    pre->maxTime = UA_INT64_MAX;
+    UA_LOCK(&server->serviceMutex);
+    UA_Session_queuePublishReq(session, pre, false);
+    UA_Subscription_publish(server, sub);
+    UA_UNLOCK(&server->serviceMutex);
+
+    /* The Notifications are queued again in the original order */
+    ck_assert_uint_eq(mon1->queueSize, 1);
+    ck_assert_uint_eq(mon2->queueSize, 2);
+    ck_assert_uint_eq(mon2->ring->size, 2);
+    ck_assert_uint_eq(mon2->ring->sending, 0);
+    ck_assert_uint_eq(sub->notificationQueueSize, 3);
+    ck_assert_uint_eq(sub->dataChangeNotifications, 3);
+    ck_assert_ptr_eq(TAILQ_FIRST(&sub->notificationQueue), TAILQ_FIRST(&mon1->queue));
+    ck_assert_ptr_eq(TAILQ_LAST(&sub->notificationQueue, NotificationQueue),
+                     &mon2->ring->notification);
+    ck_assert(sub->late);
+
+    /* The sequence number was not used up */
+    ck_assert_uint_eq(sub->nextSequenceNumber, sequenceNumber);
+    ck_assert_uint_eq(sub->retransmissionQueueSize, 0);
+
+    UA_Session_detachFromSecureChannel(session);
+}
+END_TEST
+
 START_TEST(Server_setMonitoringMode) {
     createSubscription();
     createMonitoredItem();
@@ -877,6 +1153,9 @@ static Suite* testSuite_Client(void) {
     tcase_add_test(tc_server, Server_createMonitoredItems);
     tcase_add_test(tc_server, Server_modifyMonitoredItems);
     tcase_add_test(tc_server, Server_overflow);
+    tcase_add_test(tc_server, Server_sharedLastValue);
+    tcase_add_test(tc_server, Server_notificationRing);
+    tcase_add_test(tc_server, Server_publishSendFailure);
     tcase_add_test(tc_server, Server_setMonitoringMode);
     tcase_add_test(tc_server, Server_deleteMonitoredItems);
     tcase_add_test(tc_server, Server_republish);
@@ -129,6 +129,70 @@ START_TEST(Service_Browse_WithMaxResults) {
 }
 END_TEST
 
+START_TEST(Service_Browse_ContinuationAfterDelete) {
+    UA_Server *server = UA_Server_newForUnitTest();
+    ck_assert(server != NULL);
+
+    /* Small folder, the references are stored in an array */
+    UA_NodeId folderId;
+    UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addObjectNode(server, UA_NODEID_NULL,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Folder"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                                oAttr, NULL, &folderId);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    const size_t children = 10;
+    for(size_t i = 0; i < children; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "Child%u", (unsigned)i);
+        res = UA_Server_addObjectNode(server, UA_NODEID_NULL, folderId,
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                      UA_QUALIFIEDNAME(1, name),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                      oAttr, NULL, NULL);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = folderId;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br = UA_Server_browse(server, 3, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(br.referencesSize, 3);
+    ck_assert_uint_gt(br.continuationPoint.length, 0);
+
+    /* Delete the node where the continuation point stopped */
+    res = UA_Server_deleteNode(server, br.references[2].nodeId.nodeId, true);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    size_t total = 0;
+    UA_ByteString cp = br.continuationPoint;
+    br.continuationPoint = UA_BYTESTRING_NULL;
+    UA_BrowseResult_clear(&br);
+    while(cp.length > 0) {
+        br = UA_Server_browseNext(server, false, &cp);
+        ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+        UA_ByteString_clear(&cp);
+        cp = br.continuationPoint;
+        br.continuationPoint = UA_BYTESTRING_NULL;
+        total += br.referencesSize;
+        UA_BrowseResult_clear(&br);
+    }
+
+    /* The remaining children are all returned */
+    ck_assert_uint_eq(total, children - 3);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
 START_TEST(Service_Browse_WithBrowseName) {
     UA_Server *server = UA_Server_newForUnitTest();
     ck_assert(server != NULL);
@@ -271,6 +335,110 @@ START_TEST(Service_Browse_ReferenceTypes) {
 }
 END_TEST
 
+/* The supertypes are cached. Changes of the HasSubtype references must be
+ * visible in the following checks. */
+START_TEST(IsNodeInTree_TypeHierarchy) {
+    UA_Server *server = UA_Server_newForUnitTest();
+    ck_assert(server != NULL);
+
+    UA_NodeId baseObjectType = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE);
+    UA_NodeId folderType = UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE);
+    UA_NodeId typeA = UA_NODEID_STRING(1, "TypeA");
+    UA_NodeId typeB = UA_NODEID_STRING(1, "TypeB");
+    UA_ObjectTypeAttributes attr = UA_ObjectTypeAttributes_default;
+    UA_StatusCode res =
+        UA_Server_addObjectTypeNode(server, typeA, baseObjectType,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                    UA_QUALIFIEDNAME(1, "TypeA"), attr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    res = UA_Server_addObjectTypeNode(server, typeB, typeA,
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                      UA_QUALIFIEDNAME(1, "TypeB"), attr, NULL, NULL);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    UA_LOCK(&server->serviceMutex);
+    ck_assert(isNodeInTree_singleRef(server, &typeB, &typeB,
+                                     UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    ck_assert(isNodeInTree_singleRef(server, &typeB, &typeA,
+                                     UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    ck_assert(isNodeInTree_singleRef(server, &typeB, &baseObjectType,
+                                     UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    ck_assert(!isNodeInTree_singleRef(server, &typeB, &folderType,
+                                      UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    ck_assert(!isNodeInTree_singleRef(server, &typeA, &typeB,
+                                      UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    UA_UNLOCK(&server->serviceMutex);
+
+    /* Move TypeA below the FolderType */
+    res = UA_Server_deleteReference(server, baseObjectType,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE), true,
+                                    UA_EXPANDEDNODEID_NODEID(typeA), true);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    res = UA_Server_addReference(server, folderType,
+                                 UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                 UA_EXPANDEDNODEID_NODEID(typeA), true);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+
+    UA_LOCK(&server->serviceMutex);
+    ck_assert(isNodeInTree_singleRef(server, &typeB, &folderType,
+                                     UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    ck_assert(isNodeInTree_singleRef(server, &typeB, &baseObjectType,
+                                     UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    UA_UNLOCK(&server->serviceMutex);
+
+    /* Remove TypeB from the hierarchy */
+    res = UA_Server_deleteReference(server, typeA,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE), true,
+                                    UA_EXPANDEDNODEID_NODEID(typeB), true);
+    ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+    UA_LOCK(&server->serviceMutex);
+    ck_assert(!isNodeInTree_singleRef(server, &typeB, &folderType,
+                                      UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    UA_UNLOCK(&server->serviceMutex);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
+/* The supertypes of a deep hierarchy are not cached with the depth limit. The
+ * result must be the same as without the cache. */
+START_TEST(IsNodeInTree_TypeHierarchyDeep) {
+    UA_Server *server = UA_Server_newForUnitTest();
+    ck_assert(server != NULL);
+
+#define DEEP_TYPES (UA_MAX_TREE_RECURSE + 10)
+    UA_ObjectTypeAttributes attr = UA_ObjectTypeAttributes_default;
+    UA_NodeId types[DEEP_TYPES];
+    UA_NodeId parent = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE);
+    for(size_t i = 0; i < DEEP_TYPES; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "DeepType%u", (unsigned)i);
+        types[i] = UA_NODEID_NUMERIC(1, (UA_UInt32)(50000 + i));
+        UA_StatusCode res =
+            UA_Server_addObjectTypeNode(server, types[i], parent,
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                        UA_QUALIFIEDNAME(1, name), attr, NULL, NULL);
+        ck_assert_uint_eq(res, UA_STATUSCODE_GOOD);
+        parent = types[i];
+    }
+
+    /* Starting from the leaf hits the depth limit */
+    UA_NodeId *leaf = &types[DEEP_TYPES - 1];
+    UA_LOCK(&server->serviceMutex);
+    ck_assert(isNodeInTree_singleRef(server, leaf, &types[DEEP_TYPES - 2],
+                                     UA_REFERENCETYPEINDEX_HASSUBTYPE));
+
+    /* The type at the depth limit still sees all of its supertypes */
+    UA_NodeId *mid = &types[DEEP_TYPES - 1 - UA_MAX_TREE_RECURSE];
+    ck_assert(isNodeInTree_singleRef(server, mid, &types[0],
+                                     UA_REFERENCETYPEINDEX_HASSUBTYPE));
+    UA_UNLOCK(&server->serviceMutex);
+#undef DEEP_TYPES
+
+    UA_Server_delete(server);
+}
+END_TEST
+
 START_TEST(Service_Browse_Recursive) {
     UA_Server *server = UA_Server_newForUnitTest();
     ck_assert(server != NULL);
@@ -414,6 +582,93 @@ START_TEST(ServiceTest_TranslateBrowsePathsToNodeIds) {
 }
 END_TEST
 
+static UA_StatusCode
+translateCachedPath(UA_Client *client, UA_BrowsePath *browsePath, size_t *targetsSize) {
+    UA_TranslateBrowsePathsToNodeIdsRequest request;
+    UA_TranslateBrowsePathsToNodeIdsRequest_init(&request);
+    request.browsePaths = browsePath;
+    request.browsePathsSize = 1;
+    UA_TranslateBrowsePathsToNodeIdsResponse response =
+        UA_Client_Service_translateBrowsePathsToNodeIds(client, request);
+    ck_assert_int_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, 1);
+    UA_StatusCode res = response.results[0].statusCode;
+    *targetsSize = response.results[0].targetsSize;
+    UA_TranslateBrowsePathsToNodeIdsResponse_clear(&response);
+    return res;
+}
+
+/* The results of the service are cached. Adding and removing nodes must be
+ * visible in the following requests. */
+START_TEST(Service_TranslateBrowsePathsCacheInvalidation) {
+    UA_Client *client = UA_Client_newForUnitTest();
+    UA_StatusCode retVal = UA_Client_connect(client, "opc.tcp://localhost:4840");
+    ck_assert_int_eq(retVal, UA_STATUSCODE_GOOD);
+
+    UA_BrowsePath browsePath;
+    UA_BrowsePath_init(&browsePath);
+    UA_RelativePathElement rpe;
+    UA_RelativePathElement_init(&rpe);
+    rpe.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    rpe.targetName = UA_QUALIFIEDNAME(1, "CachedPath");
+    browsePath.startingNode = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    browsePath.relativePath.elements = &rpe;
+    browsePath.relativePath.elementsSize = 1;
+
+    /* Not found (twice, the second time from the cache) */
+    size_t targetsSize = 0;
+    for(size_t i = 0; i < 2; i++) {
+        retVal = translateCachedPath(client, &browsePath, &targetsSize);
+        ck_assert_uint_eq(retVal, UA_STATUSCODE_BADNOMATCH);
+        ck_assert_uint_eq(targetsSize, 0);
+    }
+
+    /* Found after adding the node */
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "CachedPath");
+    retVal = UA_Server_addObjectNode(server_translate_browse, nodeId,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_QUALIFIEDNAME(1, "CachedPath"),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                     UA_ObjectAttributes_default, NULL, NULL);
+    ck_assert_uint_eq(retVal, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < 2; i++) {
+        retVal = translateCachedPath(client, &browsePath, &targetsSize);
+        ck_assert_uint_eq(retVal, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(targetsSize, 1);
+    }
+
+    /* Not found after removing the reference */
+    retVal = UA_Server_deleteReference(server_translate_browse,
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), true,
+                                       UA_EXPANDEDNODEID_NODEID(nodeId), true);
+    ck_assert_uint_eq(retVal, UA_STATUSCODE_GOOD);
+    retVal = translateCachedPath(client, &browsePath, &targetsSize);
+    ck_assert_uint_eq(retVal, UA_STATUSCODE_BADNOMATCH);
+
+    /* Found again with a new reference */
+    retVal = UA_Server_addReference(server_translate_browse,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                    UA_EXPANDEDNODEID_NODEID(nodeId), true);
+    ck_assert_uint_eq(retVal, UA_STATUSCODE_GOOD);
+    retVal = translateCachedPath(client, &browsePath, &targetsSize);
+    ck_assert_uint_eq(retVal, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(targetsSize, 1);
+
+    /* Not found after deleting the node */
+    retVal = UA_Server_deleteNode(server_translate_browse, nodeId, true);
+    ck_assert_uint_eq(retVal, UA_STATUSCODE_GOOD);
+    retVal = translateCachedPath(client, &browsePath, &targetsSize);
+    ck_assert_uint_eq(retVal, UA_STATUSCODE_BADNOMATCH);
+
+    retVal = UA_Client_disconnect(client);
+    ck_assert_int_eq(retVal, UA_STATUSCODE_GOOD);
+    UA_Client_delete(client);
+}
+END_TEST
+
 /* Force a hash collision for the the browsename by using all zeros.. */
 START_TEST(Service_TranslateBrowsePathsWithHashCollision) {
     UA_Byte browseNames[4] = {0, 0, 0, 0};
@@ -501,13 +756,17 @@ static Suite *testSuite_Service_TranslateBrowsePathsToNodeIds(void) {
     tcase_add_test(tc_browse, Service_Browse_ClassMask);
     tcase_add_test(tc_browse, Service_Browse_ReferenceTypes);
     tcase_add_test(tc_browse, Service_Browse_WithMaxResults);
+    tcase_add_test(tc_browse, Service_Browse_ContinuationAfterDelete);
     tcase_add_test(tc_browse, Service_Browse_Recursive);
+    tcase_add_test(tc_browse, IsNodeInTree_TypeHierarchy);
+    tcase_add_test(tc_browse, IsNodeInTree_TypeHierarchyDeep);
     tcase_add_test(tc_browse, Service_Browse_Localization);
     suite_add_tcase(s, tc_browse);
 
     TCase *tc_translate = tcase_create("TranslateBrowsePathsToNodeIds");
     tcase_add_unchecked_fixture(tc_translate, setup_server, teardown_server);
     tcase_add_test(tc_translate, ServiceTest_TranslateBrowsePathsToNodeIds);
+    tcase_add_test(tc_translate, Service_TranslateBrowsePathsCacheInvalidation);
     tcase_add_test(tc_translate, Service_TranslateBrowsePathsWithHashCollision);
     tcase_add_test(tc_translate, Service_TranslateBrowsePathsNoMatches);
     tcase_add_test(tc_translate, BrowseSimplifiedBrowsePath);
@@ -524,6 +524,383 @@ START_TEST(uppropagation) {
     UA_DeleteMonitoredItemsResponse_clear(&deleteResponse);
 } END_TEST
 
+static size_t propagatedEvents;
+
+static void
+handler_events_count(UA_Client *lclient, UA_UInt32 subId, void *subContext,
+                     UA_UInt32 monId, void *monContext,
+                     size_t nEventFields, UA_Variant *eventFields) {
+    propagatedEvents++;
+}
+
+static void
+triggerAndCount(const UA_NodeId origin) {
+    UA_NodeId eventNodeId = UA_NODEID_NULL;
+    UA_StatusCode retval = eventSetup(&eventNodeId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = triggerEventLocked(eventNodeId, origin, NULL, UA_TRUE);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    sleepUntilAnswer(publishingInterval + 100);
+    retval = UA_Client_run_iterate(client, 0);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+/* The propagation paths of events are cached per origin. Adding and removing a
+ * HasNotifier reference must update the path. */
+START_TEST(propagationPathChange) {
+    UA_NodeId notifierId = UA_NODEID_STRING(1, "Notifier");
+    UA_NodeId sourceId = UA_NODEID_STRING(1, "Source");
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    attr.eventNotifier = UA_EVENTNOTIFIER_SUBSCRIBE_TO_EVENT;
+    serverMutexLock();
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, notifierId,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Notifier"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addObjectNode(server, sourceId,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_QUALIFIEDNAME(1, "Source"),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                     UA_ObjectAttributes_default, NULL, NULL);
+    serverMutexUnlock();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Monitor events at the notifier */
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = notifierId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_EVENTNOTIFIER;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    UA_EventFilter filter;
+    UA_EventFilter_init(&filter);
+    filter.selectClauses = selectClauses;
+    filter.selectClausesSize = nSelectClauses;
+    item.requestedParameters.filter.encoding = UA_EXTENSIONOBJECT_DECODED;
+    item.requestedParameters.filter.content.decoded.data = &filter;
+    item.requestedParameters.filter.content.decoded.type = &UA_TYPES[UA_TYPES_EVENTFILTER];
+    item.requestedParameters.queueSize = 10;
+    item.requestedParameters.discardOldest = true;
+    UA_MonitoredItemCreateResult result =
+        UA_Client_MonitoredItems_createEvent(client, subscriptionId,
+                                             UA_TIMESTAMPSTORETURN_BOTH, item,
+                                             NULL, handler_events_count, NULL);
+    ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_GOOD);
+
+    /* Not connected to the notifier */
+    propagatedEvents = 0;
+    triggerAndCount(sourceId);
+    ck_assert_uint_eq(propagatedEvents, 0);
+
+    /* The event propagates after adding a HasNotifier reference */
+    serverMutexLock();
+    retval = UA_Server_addReference(server, notifierId,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASNOTIFIER),
+                                    UA_EXPANDEDNODEID_NODEID(sourceId), true);
+    serverMutexUnlock();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    triggerAndCount(sourceId);
+    ck_assert_uint_eq(propagatedEvents, 1);
+
+    /* Removing the reference stops the propagation */
+    serverMutexLock();
+    retval = UA_Server_deleteReference(server, notifierId,
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HASNOTIFIER), true,
+                                       UA_EXPANDEDNODEID_NODEID(sourceId), true);
+    serverMutexUnlock();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    triggerAndCount(sourceId);
+    ck_assert_uint_eq(propagatedEvents, 1);
+
+    /* Clean up */
+    UA_DeleteMonitoredItemsRequest deleteRequest;
+    UA_DeleteMonitoredItemsRequest_init(&deleteRequest);
+    deleteRequest.subscriptionId = subscriptionId;
+    deleteRequest.monitoredItemIds = &result.monitoredItemId;
+    deleteRequest.monitoredItemIdsSize = 1;
+    UA_DeleteMonitoredItemsResponse deleteResponse =
+        UA_Client_MonitoredItems_delete(client, deleteRequest);
+    ck_assert_uint_eq(deleteResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_DeleteMonitoredItemsResponse_clear(&deleteResponse);
+
+    serverMutexLock();
+    UA_Server_deleteNode(server, sourceId, true);
+    UA_Server_deleteNode(server, notifierId, true);
+    serverMutexUnlock();
+} END_TEST
+
+static enum ZIP_CMP
+cmpEventPathOrigin(const UA_NodeId *a, const UA_NodeId *b) {
+    return (enum ZIP_CMP)UA_NodeId_order(a, b);
+}
+
+ZIP_FUNCTIONS(UA_EventPathTree, UA_EventPath, treeEntry,
+              UA_NodeId, origin, cmpEventPathOrigin)
+
+static UA_EventPath *
+findEventPath(const UA_NodeId *origin) {
+    serverMutexLock();
+    UA_EventPath *path = ZIP_FIND(UA_EventPathTree, &server->eventPaths.paths, origin);
+    serverMutexUnlock();
+    return path;
+}
+
+/* The event node is deleted after the event was triggered. That does not
+ * touch the cached propagation path. */
+START_TEST(propagationPathReuse) {
+    UA_NodeId originId = UA_NODEID_STRING(1, "ReuseOrigin");
+    serverMutexLock();
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, originId,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "ReuseOrigin"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                UA_ObjectAttributes_default, NULL, NULL);
+    serverMutexUnlock();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_NodeId eventNodeId;
+    retval = eventSetup(&eventNodeId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = triggerEventLocked(eventNodeId, originId, NULL, UA_TRUE);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_EventPath *path = findEventPath(&originId);
+    ck_assert_ptr_ne(path, NULL);
+    size_t pathsSize = server->eventPaths.pathsSize;
+
+    retval = eventSetup(&eventNodeId);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = triggerEventLocked(eventNodeId, originId, NULL, UA_TRUE);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(findEventPath(&originId), path);
+    ck_assert_uint_eq(server->eventPaths.pathsSize, pathsSize);
+
+    /* Deleting the origin drops the path */
+    serverMutexLock();
+    retval = UA_Server_deleteNode(server, originId, true);
+    serverMutexUnlock();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(findEventPath(&originId), NULL);
+} END_TEST
+
+/* Deleting a node on a cached propagation path without removing the references
+ * pointing to it stops the propagation at the missing node */
+START_TEST(propagationPathDeleteNode) {
+    UA_NodeId topId = UA_NODEID_STRING(1, "Top");
+    UA_NodeId middleId = UA_NODEID_STRING(1, "Middle");
+    UA_NodeId sourceId = UA_NODEID_STRING(1, "Source");
+    UA_ObjectAttributes attr = UA_ObjectAttributes_default;
+    attr.eventNotifier = UA_EVENTNOTIFIER_SUBSCRIBE_TO_EVENT;
+    serverMutexLock();
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, topId,
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                UA_QUALIFIEDNAME(1, "Top"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addObjectNode(server, middleId,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_QUALIFIEDNAME(1, "Middle"),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                     attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addObjectNode(server, sourceId,
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                     UA_QUALIFIEDNAME(1, "Source"),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                     UA_ObjectAttributes_default, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addReference(server, topId,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASNOTIFIER),
+                                    UA_EXPANDEDNODEID_NODEID(middleId), true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addReference(server, middleId,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASNOTIFIER),
+                                    UA_EXPANDEDNODEID_NODEID(sourceId), true);
+    serverMutexUnlock();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Monitor events at the top notifier */
+    UA_MonitoredItemCreateRequest item;
+    UA_MonitoredItemCreateRequest_init(&item);
+    item.itemToMonitor.nodeId = topId;
+    item.itemToMonitor.attributeId = UA_ATTRIBUTEID_EVENTNOTIFIER;
+    item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+    UA_EventFilter filter;
+    UA_EventFilter_init(&filter);
+    filter.selectClauses = selectClauses;
+    filter.selectClausesSize = nSelectClauses;
+    item.requestedParameters.filter.encoding = UA_EXTENSIONOBJECT_DECODED;
+    item.requestedParameters.filter.content.decoded.data = &filter;
+    item.requestedParameters.filter.content.decoded.type = &UA_TYPES[UA_TYPES_EVENTFILTER];
+    item.requestedParameters.queueSize = 10;
+    item.requestedParameters.discardOldest = true;
+    UA_MonitoredItemCreateResult result =
+        UA_Client_MonitoredItems_createEvent(client, subscriptionId,
+                                             UA_TIMESTAMPSTORETURN_BOTH, item,
+                                             NULL, handler_events_count, NULL);
+    ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_GOOD);
+
+    /* The path from the source over the middle node is cached */
+    propagatedEvents = 0;
+    triggerAndCount(sourceId);
+    ck_assert_uint_eq(propagatedEvents, 1);
+
+    /* Delete the middle node but keep the references pointing to it */
+    serverMutexLock();
+    retval = UA_Server_deleteNode(server, middleId, false);
+    serverMutexUnlock();
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    triggerAndCount(sourceId);
+    ck_assert_uint_eq(propagatedEvents, 1);
+
+    /* Clean up */
+    UA_DeleteMonitoredItemsRequest deleteRequest;
+    UA_DeleteMonitoredItemsRequest_init(&deleteRequest);
+    deleteRequest.subscriptionId = subscriptionId;
+    deleteRequest.monitoredItemIds = &result.monitoredItemId;
+    deleteRequest.monitoredItemIdsSize = 1;
+    UA_DeleteMonitoredItemsResponse deleteResponse =
+        UA_Client_MonitoredItems_delete(client, deleteRequest);
+    ck_assert_uint_eq(deleteResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_DeleteMonitoredItemsResponse_clear(&deleteResponse);
+
+    serverMutexLock();
+    UA_Server_deleteNode(server, sourceId, true);
+    UA_Server_deleteNode(server, topId, true);
+    serverMutexUnlock();
+} END_TEST
+
+static UA_StatusCode
+modifyEventFilter(UA_UInt32 monId, UA_EventFilter *filter) {
+    UA_MonitoredItemModifyRequest item;
+    UA_MonitoredItemModifyRequest_init(&item);
+    item.monitoredItemId = monId;
+    item.requestedParameters.filter.encoding = UA_EXTENSIONOBJECT_DECODED;
+    item.requestedParameters.filter.content.decoded.data = filter;
+    item.requestedParameters.filter.content.decoded.type = &UA_TYPES[UA_TYPES_EVENTFILTER];
+    item.requestedParameters.queueSize = 10;
+    item.requestedParameters.discardOldest = true;
+
+    UA_ModifyMonitoredItemsRequest request;
+    UA_ModifyMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subscriptionId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    request.itemsToModify = &item;
+    request.itemsToModifySize = 1;
+
+    UA_ModifyMonitoredItemsResponse response =
+        UA_Client_MonitoredItems_modify(client, request);
+    UA_StatusCode retval = response.responseHeader.serviceResult;
+    if(retval == UA_STATUSCODE_GOOD && response.resultsSize == 1)
+        retval = response.results[0].statusCode;
+    UA_ModifyMonitoredItemsResponse_clear(&response);
+    return retval;
+}
+
+/* The EventFilter is compiled when the MonitoredItem is created. Modifying the
+ * filter must replace the compiled program. */
+START_TEST(modifyFilter) {
+    UA_MonitoredItemCreateResult createResult =
+        addMonitoredItem(handler_events_count, true, true);
+    ck_assert_uint_eq(createResult.statusCode, UA_STATUSCODE_GOOD);
+
+    propagatedEvents = 0;
+    triggerAndCount(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER));
+    ck_assert_uint_eq(propagatedEvents, 1);
+
+    /* Where-clause "Severity > 1000" does not match the generated events. The
+     * Severity is also used in the select-clauses. */
+    UA_UInt16 threshold = 1000;
+    UA_LiteralOperand literal;
+    UA_LiteralOperand_init(&literal);
+    UA_Variant_setScalar(&literal.value, &threshold, &UA_TYPES[UA_TYPES_UINT16]);
+    UA_ExtensionObject operands[2];
+    UA_ExtensionObject_setValue(&operands[0], &selectClauses[0],
+                                &UA_TYPES[UA_TYPES_SIMPLEATTRIBUTEOPERAND]);
+    UA_ExtensionObject_setValue(&operands[1], &literal,
+                                &UA_TYPES[UA_TYPES_LITERALOPERAND]);
+    UA_ContentFilterElement element;
+    UA_ContentFilterElement_init(&element);
+    element.filterOperator = UA_FILTEROPERATOR_GREATERTHAN;
+    element.filterOperands = operands;
+    element.filterOperandsSize = 2;
+
+    UA_EventFilter filter;
+    UA_EventFilter_init(&filter);
+    filter.selectClauses = selectClauses;
+    filter.selectClausesSize = nSelectClauses;
+    filter.whereClause.elements = &element;
+    filter.whereClause.elementsSize = 1;
+    UA_StatusCode retval = modifyEventFilter(createResult.monitoredItemId, &filter);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    triggerAndCount(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER));
+    ck_assert_uint_eq(propagatedEvents, 1);
+
+    /* "Severity >= 1000" matches again */
+    element.filterOperator = UA_FILTEROPERATOR_GREATERTHANOREQUAL;
+    retval = modifyEventFilter(createResult.monitoredItemId, &filter);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    triggerAndCount(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER));
+    ck_assert_uint_eq(propagatedEvents, 2);
+
+    UA_DeleteMonitoredItemsRequest deleteRequest;
+    UA_DeleteMonitoredItemsRequest_init(&deleteRequest);
+    deleteRequest.subscriptionId = subscriptionId;
+    deleteRequest.monitoredItemIds = &createResult.monitoredItemId;
+    deleteRequest.monitoredItemIdsSize = 1;
+    UA_DeleteMonitoredItemsResponse deleteResponse =
+        UA_Client_MonitoredItems_delete(client, deleteRequest);
+    ck_assert_uint_eq(deleteResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_DeleteMonitoredItemsResponse_clear(&deleteResponse);
+} END_TEST
+
+/* A failed modification leaves the previous EventFilter in place */
+START_TEST(modifyFilterInvalid) {
+    UA_MonitoredItemCreateResult createResult =
+        addMonitoredItem(handler_events_count, true, true);
+    ck_assert_uint_eq(createResult.statusCode, UA_STATUSCODE_GOOD);
+
+    propagatedEvents = 0;
+    triggerAndCount(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER));
+    ck_assert_uint_eq(propagatedEvents, 1);
+
+    UA_ContentFilterElement element;
+    UA_ContentFilterElement_init(&element);
+    element.filterOperator = (UA_FilterOperator)(UA_FILTEROPERATOR_BITWISEOR + 1);
+
+    UA_EventFilter filter;
+    UA_EventFilter_init(&filter);
+    filter.selectClauses = selectClauses;
+    filter.selectClausesSize = nSelectClauses;
+    filter.whereClause.elements = &element;
+    filter.whereClause.elementsSize = 1;
+    UA_StatusCode retval = modifyEventFilter(createResult.monitoredItemId, &filter);
+    ck_assert_uint_ne(retval, UA_STATUSCODE_GOOD);
+
+    triggerAndCount(UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER));
+    ck_assert_uint_eq(propagatedEvents, 2);
+
+    UA_DeleteMonitoredItemsRequest deleteRequest;
+    UA_DeleteMonitoredItemsRequest_init(&deleteRequest);
+    deleteRequest.subscriptionId = subscriptionId;
+    deleteRequest.monitoredItemIds = &createResult.monitoredItemId;
+    deleteRequest.monitoredItemIdsSize = 1;
+    UA_DeleteMonitoredItemsResponse deleteResponse =
+        UA_Client_MonitoredItems_delete(client, deleteRequest);
+    ck_assert_uint_eq(deleteResponse.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    UA_DeleteMonitoredItemsResponse_clear(&deleteResponse);
+} END_TEST
+
 static void
 handler_events_overflow(UA_Client *lclient, UA_UInt32 subId, void *subContext,
                         UA_UInt32 monId, void *monContext,
@@ -923,6 +1300,11 @@ static Suite *testSuite_Client(void) {
     tcase_add_test(tc_server, createAbstractEventWithParent);
     tcase_add_test(tc_server, createNonAbstractEventWithParent);
     tcase_add_test(tc_server, uppropagation);
+    tcase_add_test(tc_server, propagationPathChange);
+    tcase_add_test(tc_server, propagationPathDeleteNode);
+    tcase_add_test(tc_server, propagationPathReuse);
+    tcase_add_test(tc_server, modifyFilter);
+    tcase_add_test(tc_server, modifyFilterInvalid);
     tcase_add_test(tc_server, eventOverflow);
     tcase_add_test(tc_server, multipleMonitoredItemsOneNode);
     tcase_add_test(tc_server, discardNewestOverflow);